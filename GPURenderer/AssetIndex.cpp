@@ -0,0 +1,692 @@
+#include "AssetIndex.h"
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <system_error>
+
+#ifdef __linux__
+#include <cerrno>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+namespace gpurenderer::assets {
+	namespace {
+		constexpr const char* kIndexMagic = "gpurenderer-asset-index";
+		constexpr int kIndexVersion = 1;
+		constexpr int kMaxDefaultScanThreads = 16;
+
+		std::string JoinRelative(const std::string& parent, const std::string& name) {
+			return parent.empty() ? name : parent + "/" + name;
+		}
+
+		bool IsWithin(const std::string& path, const std::string& directory) {
+			return directory.empty() || path == directory ||
+				(path.size() > directory.size() &&
+					path.compare(0, directory.size(), directory) == 0 &&
+					path[directory.size()] == '/');
+		}
+
+		std::string ToLower(std::string text) {
+			std::transform(text.begin(), text.end(), text.begin(), [](unsigned char c) {
+				return static_cast<char>(std::tolower(c));
+				});
+			return text;
+		}
+
+		std::string JoinExtensions(const ExtensionSet& extensions) {
+			std::vector<std::string> sorted(extensions.begin(), extensions.end());
+			std::sort(sorted.begin(), sorted.end());
+			std::string joined;
+			for (const std::string& extension : sorted) {
+				joined += (joined.empty() ? "" : " ") + extension;
+			}
+			return joined;
+		}
+
+		void InsertSorted(std::vector<std::string>& names, const std::string& name) {
+			auto it = std::lower_bound(names.begin(), names.end(), name);
+			if (it == names.end() || *it != name) {
+				names.insert(it, name);
+			}
+		}
+
+		void EraseSorted(std::vector<std::string>& names, const std::string& name) {
+			auto it = std::lower_bound(names.begin(), names.end(), name);
+			if (it != names.end() && *it == name) {
+				names.erase(it);
+			}
+		}
+	}
+
+	AssetIndexer::~AssetIndexer() {
+		Stop();
+	}
+
+	void AssetIndexer::Start(
+		const std::filesystem::path& root,
+		ExtensionSet extensions,
+		const std::filesystem::path& indexFile,
+		std::function<void()> onChanged,
+		int threadCount) {
+		Stop();
+		mRoot = root.lexically_normal();
+		mIndexFile = indexFile;
+		mExtensions = std::move(extensions);
+		mOnChanged = std::move(onChanged);
+		if (threadCount <= 0) {
+			const int hardware = static_cast<int>(std::thread::hardware_concurrency());
+			threadCount = std::clamp(hardware * 2, 4, kMaxDefaultScanThreads);
+		}
+		mThreadCount = threadCount;
+
+		mStopping = false;
+		mCancel = false;
+		mDirectories.clear();
+		mFiles.clear();
+		mRequests.clear();
+		mDirty = false;
+		mStats = IndexStats{};
+		mStats.scanning = true;
+		++mVersion;
+#ifdef __linux__
+		mInotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+#endif
+		mRequests.push_back(ScanRequest{std::string(), false});
+		mWorker = std::thread(&AssetIndexer::Run, this);
+	}
+
+	void AssetIndexer::Stop() {
+		{
+			std::lock_guard<std::mutex> lock(mMutex);
+			mStopping = true;
+		}
+		mCancel = true;
+		mWake.notify_all();
+		if (mWorker.joinable()) {
+			mWorker.join();
+		}
+		CloseWatches();
+		bool save = false;
+		{
+			std::lock_guard<std::mutex> lock(mMutex);
+			save = mDirty;
+		}
+		if (save) {
+			SaveIndex();
+		}
+		std::lock_guard<std::mutex> lock(mMutex);
+		mStats.scanning = false;
+	}
+
+	void AssetIndexer::Rescan(bool full) {
+		{
+			std::lock_guard<std::mutex> lock(mMutex);
+			if (!mWorker.joinable()) {
+				return;
+			}
+			mRequests.push_back(ScanRequest{std::string(), full});
+			mStats.scanning = true;
+		}
+		mWake.notify_one();
+	}
+
+	std::uint64_t AssetIndexer::Version() const {
+		std::lock_guard<std::mutex> lock(mMutex);
+		return mVersion;
+	}
+
+	std::vector<std::string> AssetIndexer::Files() const {
+		std::lock_guard<std::mutex> lock(mMutex);
+		return mFiles;
+	}
+
+	IndexStats AssetIndexer::Stats() const {
+		std::lock_guard<std::mutex> lock(mMutex);
+		IndexStats stats = mStats;
+		stats.files = mFiles.size();
+		stats.directories = mDirectories.size();
+		stats.watchedDirectories = mDirectoryWatches.size();
+		return stats;
+	}
+
+	void AssetIndexer::Run() {
+		if (LoadIndex() && mOnChanged) {
+			mOnChanged();
+		}
+
+		for (;;) {
+			ScanRequest request;
+			{
+				std::unique_lock<std::mutex> lock(mMutex);
+				mWake.wait(lock, [&] { return mStopping || !mRequests.empty(); });
+				if (mStopping) {
+					return;
+				}
+				request = std::move(mRequests.front());
+				mRequests.pop_front();
+			}
+
+			const auto start = std::chrono::steady_clock::now();
+			DirectoryMap scanned = ScanTree(request.directory, request.full);
+			if (mCancel) {
+				return;
+			}
+			std::vector<std::string> scannedDirectories;
+			scannedDirectories.reserve(scanned.size());
+			for (const auto& entry : scanned) {
+				scannedDirectories.push_back(entry.first);
+			}
+			MergeScan(request.directory, std::move(scanned));
+			WatchDirectories(scannedDirectories);
+
+			bool save = false;
+			{
+				std::lock_guard<std::mutex> lock(mMutex);
+				if (request.directory.empty()) {
+					mStats.scanMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+				}
+				const bool idle = mRequests.empty();
+				mStats.scanning = !idle;
+				save = idle && mDirty;
+			}
+			if (save) {
+				SaveIndex();
+			}
+			if (mOnChanged) {
+				mOnChanged();
+			}
+		}
+	}
+
+	// Lists directory and everything below it with mThreadCount workers sharing one queue. Listing is
+	// dominated by readdir/stat latency, so this scales well past the core count on network shares.
+	AssetIndexer::DirectoryMap AssetIndexer::ScanTree(const std::string& directory, bool full) {
+		struct ScanState {
+			std::mutex mutex;
+			std::condition_variable ready;
+			std::vector<std::string> queue;
+			size_t pending = 0;
+			size_t reused = 0;
+			DirectoryMap result;
+		} state;
+		state.queue.push_back(directory);
+		state.pending = 1;
+
+		auto worker = [&]() {
+			for (;;) {
+				std::string current;
+				{
+					std::unique_lock<std::mutex> lock(state.mutex);
+					state.ready.wait(lock, [&] { return !state.queue.empty() || state.pending == 0 || mCancel.load(); });
+					if (state.queue.empty() || mCancel.load()) {
+						state.ready.notify_all();
+						return;
+					}
+					current = std::move(state.queue.back());
+					state.queue.pop_back();
+				}
+
+				bool reused = false;
+				DirectoryEntry entry = ListDirectory(current, full, reused);
+				std::lock_guard<std::mutex> lock(state.mutex);
+				for (const std::string& subdirectory : entry.subdirectories) {
+					state.queue.push_back(JoinRelative(current, subdirectory));
+				}
+				state.pending += entry.subdirectories.size();
+				state.reused += reused ? 1 : 0;
+				state.result.emplace(std::move(current), std::move(entry));
+				--state.pending;
+				state.ready.notify_all();
+			}
+		};
+
+		std::vector<std::thread> threads;
+		for (int i = 1; i < mThreadCount; ++i) {
+			threads.emplace_back(worker);
+		}
+		worker();
+		for (std::thread& thread : threads) {
+			thread.join();
+		}
+
+		std::lock_guard<std::mutex> lock(mMutex);
+		if (directory.empty()) {
+			mStats.directoriesReused = state.reused;
+		}
+		return std::move(state.result);
+	}
+
+	AssetIndexer::DirectoryEntry AssetIndexer::ListDirectory(const std::string& directory, bool full, bool& reused) const {
+		namespace fs = std::filesystem;
+		DirectoryEntry entry;
+		const fs::path path = AbsolutePath(directory);
+		std::error_code error;
+		const auto writeTime = fs::last_write_time(path, error);
+		entry.mtime = error ? kUnknownMtime : static_cast<std::int64_t>(writeTime.time_since_epoch().count());
+
+		// A directory's mtime changes whenever an entry is added, removed or renamed in it, so an
+		// unchanged mtime means the stored listing is still exact.
+		if (!full && entry.mtime != kUnknownMtime) {
+			std::lock_guard<std::mutex> lock(mMutex);
+			auto previous = mDirectories.find(directory);
+			if (previous != mDirectories.end() && previous->second.mtime == entry.mtime) {
+				reused = true;
+				return previous->second;
+			}
+		}
+
+		fs::directory_iterator it(path, fs::directory_options::skip_permission_denied, error);
+		for (; !error && it != fs::directory_iterator() && !mCancel.load(); it.increment(error)) {
+			const std::string name = it->path().filename().string();
+			if (name.find('\n') != std::string::npos) {
+				continue;
+			}
+			std::error_code typeError;
+			// Symlinked directories are not followed, same as recursive_directory_iterator, to avoid cycles.
+			if (it->is_symlink(typeError)) {
+				if (MatchesExtension(name) && it->is_regular_file(typeError)) {
+					entry.files.push_back(name);
+				}
+			}
+			else if (it->is_directory(typeError)) {
+				entry.subdirectories.push_back(name);
+			}
+			else if (MatchesExtension(name) && it->is_regular_file(typeError)) {
+				entry.files.push_back(name);
+			}
+		}
+		std::sort(entry.files.begin(), entry.files.end());
+		std::sort(entry.subdirectories.begin(), entry.subdirectories.end());
+		return entry;
+	}
+
+	void AssetIndexer::MergeScan(const std::string& directory, DirectoryMap scanned) {
+		std::lock_guard<std::mutex> lock(mMutex);
+		for (auto it = mDirectories.begin(); it != mDirectories.end();) {
+			if (!IsWithin(it->first, directory)) {
+				++it;
+				continue;
+			}
+			if (scanned.find(it->first) == scanned.end()) {
+				RemoveWatchLocked(it->first);
+			}
+			it = mDirectories.erase(it);
+		}
+		for (auto& entry : scanned) {
+			mDirectories[entry.first] = std::move(entry.second);
+		}
+		mDirty = true;
+		PublishLocked();
+	}
+
+	void AssetIndexer::PublishLocked() {
+		mFiles.clear();
+		for (const auto& [directory, entry] : mDirectories) {
+			const std::filesystem::path base = AbsolutePath(directory);
+			for (const std::string& name : entry.files) {
+				mFiles.push_back((base / name).lexically_normal().string());
+			}
+		}
+		std::sort(mFiles.begin(), mFiles.end());
+		++mVersion;
+	}
+
+	bool AssetIndexer::MatchesExtension(const std::string& name) const {
+		const size_t dot = name.find_last_of('.');
+		return dot != std::string::npos && mExtensions.count(ToLower(name.substr(dot))) != 0;
+	}
+
+	std::filesystem::path AssetIndexer::AbsolutePath(const std::string& directory) const {
+		return directory.empty() ? mRoot : mRoot / std::filesystem::path(directory);
+	}
+
+	// Text format, one record per line:
+	//   gpurenderer-asset-index <version>
+	//   root <path>
+	//   extensions <ext> <ext> ...
+	//   D <mtime> <relative directory>   followed by its F <file> and S <subdirectory> lines
+	bool AssetIndexer::LoadIndex() {
+		std::ifstream input(mIndexFile);
+		if (!input) {
+			return false;
+		}
+
+		std::string line;
+		const std::string header = std::string(kIndexMagic) + " " + std::to_string(kIndexVersion);
+		if (!std::getline(input, line) || line != header) {
+			return false;
+		}
+		if (!std::getline(input, line) || line != "root " + mRoot.generic_string()) {
+			return false;
+		}
+		if (!std::getline(input, line) || line != "extensions " + JoinExtensions(mExtensions)) {
+			return false;
+		}
+
+		DirectoryMap loaded;
+		DirectoryEntry* current = nullptr;
+		while (std::getline(input, line)) {
+			if (line.size() < 2 || line[1] != ' ') {
+				return false;
+			}
+			const std::string value = line.substr(2);
+			if (line[0] == 'D') {
+				const size_t space = value.find(' ');
+				if (space == std::string::npos) {
+					return false;
+				}
+				DirectoryEntry& entry = loaded[value.substr(space + 1)];
+				entry.mtime = std::strtoll(value.c_str(), nullptr, 10);
+				current = &entry;
+			}
+			else if (current && line[0] == 'F') {
+				current->files.push_back(value);
+			}
+			else if (current && line[0] == 'S') {
+				current->subdirectories.push_back(value);
+			}
+			else {
+				return false;
+			}
+		}
+
+		std::lock_guard<std::mutex> lock(mMutex);
+		if (!mDirectories.empty()) {
+			return false;
+		}
+		mDirectories = std::move(loaded);
+		mStats.loadedFromDisk = true;
+		PublishLocked();
+		return true;
+	}
+
+	bool AssetIndexer::SaveIndex() {
+		if (mIndexFile.empty()) {
+			return false;
+		}
+
+		std::ostringstream output;
+		{
+			std::lock_guard<std::mutex> lock(mMutex);
+			output << kIndexMagic << ' ' << kIndexVersion << '\n';
+			output << "root " << mRoot.generic_string() << '\n';
+			output << "extensions " << JoinExtensions(mExtensions) << '\n';
+			for (const auto& [directory, entry] : mDirectories) {
+				output << "D " << entry.mtime << ' ' << directory << '\n';
+				for (const std::string& name : entry.files) {
+					output << "F " << name << '\n';
+				}
+				for (const std::string& name : entry.subdirectories) {
+					output << "S " << name << '\n';
+				}
+			}
+			mDirty = false;
+		}
+
+		std::error_code error;
+		std::filesystem::create_directories(mIndexFile.parent_path(), error);
+		std::filesystem::path temporary = mIndexFile;
+		temporary += ".tmp";
+		{
+			std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+			const std::string text = output.str();
+			if (!file || !file.write(text.data(), static_cast<std::streamsize>(text.size()))) {
+				std::fprintf(stderr, "Failed to write asset index %s\n", temporary.string().c_str());
+				return false;
+			}
+		}
+		std::filesystem::rename(temporary, mIndexFile, error);
+		if (error) {
+			std::fprintf(stderr, "Failed to replace asset index %s: %s\n", mIndexFile.string().c_str(), error.message().c_str());
+			std::filesystem::remove(temporary, error);
+			return false;
+		}
+		return true;
+	}
+
+	void AssetIndexer::WatchDirectories(const std::vector<std::string>& directories) {
+#ifdef __linux__
+		if (mInotifyFd < 0) {
+			return;
+		}
+		std::lock_guard<std::mutex> lock(mMutex);
+		for (const std::string& directory : directories) {
+			if (mDirectoryWatches.count(directory) != 0) {
+				continue;
+			}
+			const int watch = inotify_add_watch(
+				mInotifyFd, AbsolutePath(directory).c_str(),
+				IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_ONLYDIR);
+			if (watch < 0) {
+				if (errno == ENOSPC) {
+					std::fprintf(stderr, "Asset index: inotify watch limit reached after %zu directories; use Refresh for the rest\n",
+						mDirectoryWatches.size());
+					return;
+				}
+				continue;
+			}
+			mWatchDirectories[watch] = directory;
+			mDirectoryWatches[directory] = watch;
+		}
+#else
+		(void)directories;
+#endif
+	}
+
+	void AssetIndexer::RemoveWatchLocked(const std::string& directory) {
+		auto watch = mDirectoryWatches.find(directory);
+		if (watch == mDirectoryWatches.end()) {
+			return;
+		}
+#ifdef __linux__
+		inotify_rm_watch(mInotifyFd, watch->second);
+#endif
+		mWatchDirectories.erase(watch->second);
+		mDirectoryWatches.erase(watch);
+	}
+
+	void AssetIndexer::CloseWatches() {
+#ifdef __linux__
+		if (mInotifyFd >= 0) {
+			close(mInotifyFd);
+			mInotifyFd = -1;
+		}
+#endif
+		std::lock_guard<std::mutex> lock(mMutex);
+		mWatchDirectories.clear();
+		mDirectoryWatches.clear();
+	}
+
+	bool AssetIndexer::Poll() {
+#ifdef __linux__
+		if (mInotifyFd >= 0) {
+			alignas(inotify_event) char buffer[16384];
+			bool changed = false;
+			bool rescan = false;
+			std::vector<std::string> newDirectories;
+			std::lock_guard<std::mutex> lock(mMutex);
+			for (;;) {
+				const ssize_t length = read(mInotifyFd, buffer, sizeof(buffer));
+				if (length <= 0) {
+					break;
+				}
+				for (ssize_t offset = 0; offset < length;) {
+					const auto* event = reinterpret_cast<const inotify_event*>(buffer + offset);
+					offset += static_cast<ssize_t>(sizeof(inotify_event) + event->len);
+
+					if (event->mask & IN_Q_OVERFLOW) {
+						rescan = true;
+						continue;
+					}
+					auto watch = mWatchDirectories.find(event->wd);
+					if (watch == mWatchDirectories.end()) {
+						continue;
+					}
+					if (event->mask & IN_IGNORED) {
+						mDirectoryWatches.erase(watch->second);
+						mWatchDirectories.erase(watch);
+						continue;
+					}
+					if (event->len == 0) {
+						continue;
+					}
+
+					const std::string parent = watch->second;
+					const std::string name = event->name;
+					auto entry = mDirectories.find(parent);
+					if (entry == mDirectories.end()) {
+						continue;
+					}
+					const bool added = (event->mask & (IN_CREATE | IN_MOVED_TO)) != 0;
+					if (event->mask & IN_ISDIR) {
+						const std::string child = JoinRelative(parent, name);
+						if (added) {
+							InsertSorted(entry->second.subdirectories, name);
+							newDirectories.push_back(child);
+						}
+						else {
+							EraseSorted(entry->second.subdirectories, name);
+							for (auto it = mDirectories.begin(); it != mDirectories.end();) {
+								if (!IsWithin(it->first, child)) {
+									++it;
+									continue;
+								}
+								RemoveWatchLocked(it->first);
+								it = mDirectories.erase(it);
+							}
+						}
+					}
+					else if (MatchesExtension(name)) {
+						if (added) {
+							InsertSorted(entry->second.files, name);
+						}
+						else {
+							EraseSorted(entry->second.files, name);
+						}
+					}
+					else {
+						continue;
+					}
+					// The stored listing was patched by hand; make the next start list it again.
+					entry->second.mtime = kUnknownMtime;
+					changed = true;
+				}
+			}
+
+			if (changed) {
+				mDirty = true;
+				PublishLocked();
+			}
+			for (std::string& directory : newDirectories) {
+				mRequests.push_back(ScanRequest{std::move(directory), false});
+			}
+			if (rescan) {
+				mRequests.push_back(ScanRequest{std::string(), false});
+			}
+			if (!mRequests.empty()) {
+				mStats.scanning = true;
+				mWake.notify_one();
+			}
+		}
+#endif
+		std::lock_guard<std::mutex> lock(mMutex);
+		const bool changed = mVersion != mPolledVersion;
+		mPolledVersion = mVersion;
+		return changed;
+	}
+
+	std::filesystem::path PathCache::Resolve(const std::filesystem::path& path) {
+		if (path.empty()) {
+			return {};
+		}
+		std::error_code error;
+		std::filesystem::path absolute = std::filesystem::absolute(path, error);
+		if (error) {
+			return {};
+		}
+		absolute = absolute.lexically_normal();
+		// "dir/" normalizes to "dir/" with an empty filename; resolve the directory itself.
+		if (!absolute.has_filename() && absolute.has_relative_path()) {
+			absolute = absolute.parent_path();
+		}
+		std::lock_guard<std::mutex> lock(mMutex);
+		++mStats.lookups;
+		return ResolveLocked(absolute);
+	}
+
+	void PathCache::Clear() {
+		std::lock_guard<std::mutex> lock(mMutex);
+		mListings.clear();
+	}
+
+	PathCacheStats PathCache::Stats() const {
+		std::lock_guard<std::mutex> lock(mMutex);
+		return mStats;
+	}
+
+	std::filesystem::path PathCache::ResolveLocked(const std::filesystem::path& path) {
+		if (!path.has_relative_path()) {
+			return path;
+		}
+		const Listing& parent = ListLocked(path.parent_path());
+		if (parent.readable) {
+			return Lookup(parent, path.filename().string());
+		}
+		if (parent.path.empty()) {
+			return {};
+		}
+		// The parent exists but cannot be listed (e.g. execute-only); fall back to probing.
+		++mStats.statCalls;
+		const std::filesystem::path candidate = parent.path / path.filename();
+		std::error_code error;
+		return std::filesystem::exists(candidate, error) ? candidate : std::filesystem::path();
+	}
+
+	const PathCache::Listing& PathCache::ListLocked(const std::filesystem::path& directory) {
+		const std::string key = directory.string();
+		auto cached = mListings.find(key);
+		if (cached != mListings.end()) {
+			return cached->second;
+		}
+
+		Listing listing;
+		++mStats.directoryReads;
+		std::error_code error;
+		std::filesystem::directory_iterator it(directory, error);
+		if (!error) {
+			listing.readable = true;
+			listing.path = directory;
+			for (; !error && it != std::filesystem::directory_iterator(); it.increment(error)) {
+				std::string name = it->path().filename().string();
+				listing.foldedNames.emplace(ToLower(name), name);
+				listing.names.insert(std::move(name));
+			}
+		}
+		else if (error == std::errc::permission_denied) {
+			listing.path = directory;
+		}
+		else if (directory.has_relative_path()) {
+			// Missing under this spelling; the directory may still exist with different case. Listings
+			// live in an unordered_map, so references to other entries stay valid across the emplace.
+			const std::filesystem::path actual = ResolveLocked(directory);
+			if (!actual.empty() && actual != directory) {
+				listing = ListLocked(actual);
+			}
+		}
+		return mListings.emplace(key, std::move(listing)).first->second;
+	}
+
+	std::filesystem::path PathCache::Lookup(const Listing& listing, const std::string& name) {
+		if (listing.names.count(name) != 0) {
+			return listing.path / name;
+		}
+		auto folded = listing.foldedNames.find(ToLower(name));
+		return folded != listing.foldedNames.end() ? listing.path / folded->second : std::filesystem::path();
+	}
+}
@@ -0,0 +1,169 @@
+#pragma once
+
+#include <atomic>
+#include <climits>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <filesystem>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+// File system side of asset loading: cached path resolution and a background index of model files.
+namespace gpurenderer::assets {
+	// Lower-case extensions including the dot, e.g. ".obj".
+	using ExtensionSet = std::unordered_set<std::string>;
+
+	struct IndexStats {
+		size_t files = 0;
+		size_t directories = 0;
+		// Directories of the last scan whose listing was reused because their mtime was unchanged.
+		size_t directoriesReused = 0;
+		size_t watchedDirectories = 0;
+		double scanMs = 0.0;
+		bool scanning = false;
+		bool loadedFromDisk = false;
+	};
+
+	// Background index of loadable model files under a root directory. Directories are listed in parallel
+	// off the main thread, the result is persisted so the next start shows the list at once, and the
+	// persisted modification times let a rescan skip listing directories that did not change. On Linux the
+	// indexed tree is also watched with inotify so new and deleted files show up without a rescan.
+	class AssetIndexer {
+	public:
+		AssetIndexer() = default;
+		~AssetIndexer();
+		AssetIndexer(const AssetIndexer&) = delete;
+		AssetIndexer& operator=(const AssetIndexer&) = delete;
+
+		// Loads indexFile (if any) and starts a background rescan of root. onChanged is invoked from
+		// the worker thread whenever the file list changes. threadCount <= 0 picks a default suited to
+		// network file systems, where listing is latency bound.
+		void Start(
+			const std::filesystem::path& root,
+			ExtensionSet extensions,
+			const std::filesystem::path& indexFile,
+			std::function<void()> onChanged = {},
+			int threadCount = 0);
+		// Joins the worker and writes the index if it changed.
+		void Stop();
+		// Re-lists the whole tree. A full rescan ignores the stored directory mtimes.
+		void Rescan(bool full);
+		// Applies pending file watch events; call regularly from one thread. Returns true when the file
+		// list changed since the previous call, including changes published by background scans.
+		bool Poll();
+
+		// Incremented on every change of the file list.
+		std::uint64_t Version() const;
+		// Absolute, lexically normalized paths in sorted order.
+		std::vector<std::string> Files() const;
+		IndexStats Stats() const;
+		const std::filesystem::path& Root() const {
+			return mRoot;
+		}
+
+	private:
+		// File-clock ticks can be negative (libstdc++ counts from 2174), so "unknown" needs its own value.
+		static constexpr std::int64_t kUnknownMtime = INT64_MIN;
+
+		struct DirectoryEntry {
+			// File-clock ticks of the directory's last_write_time; kUnknownMtime forces a fresh listing.
+			std::int64_t mtime = kUnknownMtime;
+			std::vector<std::string> files;
+			std::vector<std::string> subdirectories;
+		};
+		using DirectoryMap = std::unordered_map<std::string, DirectoryEntry>;
+
+		struct ScanRequest {
+			// Relative to mRoot, generic separators; empty for the root itself.
+			std::string directory;
+			bool full = false;
+		};
+
+		void Run();
+		DirectoryMap ScanTree(const std::string& directory, bool full);
+		DirectoryEntry ListDirectory(const std::string& directory, bool full, bool& reused) const;
+		void MergeScan(const std::string& directory, DirectoryMap scanned);
+		void PublishLocked();
+		bool MatchesExtension(const std::string& name) const;
+		std::filesystem::path AbsolutePath(const std::string& directory) const;
+		bool LoadIndex();
+		bool SaveIndex();
+		void WatchDirectories(const std::vector<std::string>& directories);
+		void RemoveWatchLocked(const std::string& directory);
+		void CloseWatches();
+
+		std::filesystem::path mRoot;
+		std::filesystem::path mIndexFile;
+		ExtensionSet mExtensions;
+		std::function<void()> mOnChanged;
+		int mThreadCount = 1;
+
+		mutable std::mutex mMutex;
+		std::condition_variable mWake;
+		std::deque<ScanRequest> mRequests;
+		bool mStopping = false;
+		std::atomic<bool> mCancel{false};
+		std::thread mWorker;
+
+		DirectoryMap mDirectories;
+		std::vector<std::string> mFiles;
+		std::uint64_t mVersion = 0;
+		std::uint64_t mPolledVersion = 0;
+		bool mDirty = false;
+		IndexStats mStats;
+
+		int mInotifyFd = -1;
+		std::unordered_map<int, std::string> mWatchDirectories;
+		std::unordered_map<std::string, int> mDirectoryWatches;
+	};
+
+	struct PathCacheStats {
+		size_t lookups = 0;
+		// readdir passes; each directory is listed at most once between Clear calls.
+		size_t directoryReads = 0;
+		// Direct stat calls, only made for directories that exist but cannot be listed.
+		size_t statCalls = 0;
+	};
+
+	// Answers "does this file exist, and under which spelling" from cached directory listings instead
+	// of a stat per probe, which matters on network file systems where each stat is a round trip. Names
+	// that do not match exactly are matched case-insensitively (ASCII), since exported OBJ/MTL files
+	// often disagree with the files on disk about case. Thread-safe.
+	class PathCache {
+	public:
+		// The on-disk path of `path` (absolute, lexically normal, with corrected case), or an empty path
+		// when nothing matches.
+		std::filesystem::path Resolve(const std::filesystem::path& path);
+		bool Exists(const std::filesystem::path& path) {
+			return !Resolve(path).empty();
+		}
+		// Forgets every listing, e.g. before a load that should see files created since the last one.
+		void Clear();
+		PathCacheStats Stats() const;
+
+	private:
+		struct Listing {
+			bool readable = false;
+			// Spelling of the directory on disk; differs from the key when found by case-folding.
+			std::filesystem::path path;
+			std::unordered_set<std::string> names;
+			// Lower-cased name -> on-disk name; the first name in directory order wins.
+			std::unordered_map<std::string, std::string> foldedNames;
+		};
+
+		std::filesystem::path ResolveLocked(const std::filesystem::path& path);
+		const Listing& ListLocked(const std::filesystem::path& directory);
+		static std::filesystem::path Lookup(const Listing& listing, const std::string& name);
+
+		mutable std::mutex mMutex;
+		std::unordered_map<std::string, Listing> mListings;
+		PathCacheStats mStats;
+	};
+}
@@ -0,0 +1,149 @@
+#pragma once
+
+#include <coroutine>
+#include <exception>
+#include <optional>
+#include <utility>
+
+// Lazy C++20 coroutines for multi-stage work. An AsyncTask starts when it is first awaited and, once
+// it finishes, resumes its awaiter on whichever thread it finished on. The task does not pick threads
+// itself: its body moves between threads by awaiting an executor's awaitable (see the Resume* types in
+// RendererApp.cpp). Detach starts a task that nobody awaits and frees its frame when it finishes.
+namespace gpurenderer::jobs {
+	template <typename T = void>
+	class AsyncTask;
+
+	namespace detail {
+		struct FinalAwaiter {
+			bool await_ready() const noexcept {
+				return false;
+			}
+
+			// Symmetric transfer to the awaiter, so a chain of finishing tasks does not grow the stack.
+			template <typename Promise>
+			std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> handle) noexcept {
+				Promise& promise = handle.promise();
+				if (promise.continuation) {
+					return promise.continuation;
+				}
+				if (promise.detached) {
+					handle.destroy();
+				}
+				return std::noop_coroutine();
+			}
+
+			void await_resume() const noexcept {}
+		};
+
+		struct PromiseBase {
+			std::coroutine_handle<> continuation;
+			bool detached = false;
+
+			std::suspend_always initial_suspend() const noexcept {
+				return {};
+			}
+
+			FinalAwaiter final_suspend() const noexcept {
+				return {};
+			}
+
+			// Errors are reported through return values; an exception escaping a stage has nowhere to go.
+			void unhandled_exception() const noexcept {
+				std::terminate();
+			}
+		};
+	}
+
+	template <typename T>
+	class AsyncTask {
+	public:
+		struct promise_type : detail::PromiseBase {
+			std::optional<T> value;
+
+			AsyncTask get_return_object() {
+				return AsyncTask(std::coroutine_handle<promise_type>::from_promise(*this));
+			}
+
+			template <typename U>
+			void return_value(U&& result) {
+				value.emplace(std::forward<U>(result));
+			}
+		};
+
+		AsyncTask(AsyncTask&& other) noexcept : mHandle(std::exchange(other.mHandle, nullptr)) {}
+		AsyncTask(const AsyncTask&) = delete;
+		AsyncTask& operator=(const AsyncTask&) = delete;
+		AsyncTask& operator=(AsyncTask&&) = delete;
+
+		~AsyncTask() {
+			if (mHandle) {
+				mHandle.destroy();
+			}
+		}
+
+		bool await_ready() const noexcept {
+			return false;
+		}
+
+		std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiter) noexcept {
+			mHandle.promise().continuation = awaiter;
+			return mHandle;
+		}
+
+		T await_resume() {
+			return std::move(*mHandle.promise().value);
+		}
+
+	private:
+		explicit AsyncTask(std::coroutine_handle<promise_type> handle) : mHandle(handle) {}
+
+		std::coroutine_handle<promise_type> mHandle;
+	};
+
+	template <>
+	class AsyncTask<void> {
+	public:
+		struct promise_type : detail::PromiseBase {
+			AsyncTask get_return_object() {
+				return AsyncTask(std::coroutine_handle<promise_type>::from_promise(*this));
+			}
+
+			void return_void() const noexcept {}
+		};
+
+		AsyncTask(AsyncTask&& other) noexcept : mHandle(std::exchange(other.mHandle, nullptr)) {}
+		AsyncTask(const AsyncTask&) = delete;
+		AsyncTask& operator=(const AsyncTask&) = delete;
+		AsyncTask& operator=(AsyncTask&&) = delete;
+
+		~AsyncTask() {
+			if (mHandle) {
+				mHandle.destroy();
+			}
+		}
+
+		bool await_ready() const noexcept {
+			return false;
+		}
+
+		std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiter) noexcept {
+			mHandle.promise().continuation = awaiter;
+			return mHandle;
+		}
+
+		void await_resume() const noexcept {}
+
+		// Runs the task up to its first suspension on the calling thread; its frame frees itself once the
+		// task finishes.
+		friend void Detach(AsyncTask task) {
+			std::coroutine_handle<promise_type> handle = std::exchange(task.mHandle, nullptr);
+			handle.promise().detached = true;
+			handle.resume();
+		}
+
+	private:
+		explicit AsyncTask(std::coroutine_handle<promise_type> handle) : mHandle(handle) {}
+
+		std::coroutine_handle<promise_type> mHandle;
+	};
+}
@@ -0,0 +1,426 @@
+#include "EnvironmentFilter.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <thread>
+
+namespace gpurenderer::environment {
+	namespace {
+		constexpr float kPi = 3.14159265358979f;
+		// Samples are processed this many at a time, with one accumulator per lane, so the direction and
+		// weight math vectorizes without reassociating the sums.
+		constexpr size_t kLanes = 8;
+
+		struct Direction {
+			float x = 0.0f;
+			float y = 0.0f;
+			float z = 0.0f;
+		};
+
+		Direction Normalize(const Direction& d) {
+			const float length = std::sqrt(d.x * d.x + d.y * d.y + d.z * d.z);
+			return {d.x / length, d.y / length, d.z / length};
+		}
+
+		Direction Cross(const Direction& a, const Direction& b) {
+			return {a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x};
+		}
+
+		// Direction through the center of texel (x, y) of `face`, per the GL cube map face table.
+		Direction TexelDirection(int face, int x, int y, int size) {
+			const float sc = 2.0f * (static_cast<float>(x) + 0.5f) / static_cast<float>(size) - 1.0f;
+			const float tc = 2.0f * (static_cast<float>(y) + 0.5f) / static_cast<float>(size) - 1.0f;
+			switch (face) {
+			case 0:
+				return Normalize({1.0f, -tc, -sc});
+			case 1:
+				return Normalize({-1.0f, -tc, sc});
+			case 2:
+				return Normalize({sc, 1.0f, tc});
+			case 3:
+				return Normalize({sc, -1.0f, -tc});
+			case 4:
+				return Normalize({sc, -tc, 1.0f});
+			default:
+				return Normalize({-sc, -tc, -1.0f});
+			}
+		}
+
+		// Face and [0, 1] face coordinates GL samples for direction d.
+		void DirectionToFace(const Direction& d, int& face, float& s, float& t) {
+			const float ax = std::abs(d.x);
+			const float ay = std::abs(d.y);
+			const float az = std::abs(d.z);
+			float major = 0.0f;
+			float sc = 0.0f;
+			float tc = 0.0f;
+			if (ax >= ay && ax >= az) {
+				major = ax;
+				face = d.x > 0.0f ? 0 : 1;
+				sc = d.x > 0.0f ? -d.z : d.z;
+				tc = -d.y;
+			} else if (ay >= az) {
+				major = ay;
+				face = d.y > 0.0f ? 2 : 3;
+				sc = d.x;
+				tc = d.y > 0.0f ? d.z : -d.z;
+			} else {
+				major = az;
+				face = d.z > 0.0f ? 4 : 5;
+				sc = d.z > 0.0f ? d.x : -d.x;
+				tc = -d.y;
+			}
+			s = 0.5f * (sc / major + 1.0f);
+			t = 0.5f * (tc / major + 1.0f);
+		}
+
+		// Solid angle of texel (x, y) of a face, from the projected area of a unit cube face.
+		float TexelSolidAngle(int x, int y, int size) {
+			const float sc = 2.0f * (static_cast<float>(x) + 0.5f) / static_cast<float>(size) - 1.0f;
+			const float tc = 2.0f * (static_cast<float>(y) + 0.5f) / static_cast<float>(size) - 1.0f;
+			const float texelArea = 4.0f / (static_cast<float>(size) * static_cast<float>(size));
+			const float r2 = 1.0f + sc * sc + tc * tc;
+			return texelArea / (r2 * std::sqrt(r2));
+		}
+
+		CubeLevel Downsample(const CubeLevel& source) {
+			CubeLevel level;
+			level.size = std::max(source.size / 2, 1);
+			const size_t size = static_cast<size_t>(level.size);
+			const size_t sourceSize = static_cast<size_t>(source.size);
+			for (size_t f = 0; f < level.faces.size(); ++f) {
+				const std::vector<std::uint8_t>& src = source.faces[f];
+				std::vector<std::uint8_t>& dst = level.faces[f];
+				dst.resize(size * size * 3);
+				for (size_t y = 0; y < size; ++y) {
+					const size_t y0 = std::min(2 * y, sourceSize - 1);
+					const size_t y1 = std::min(2 * y + 1, sourceSize - 1);
+					for (size_t x = 0; x < size; ++x) {
+						const size_t x0 = std::min(2 * x, sourceSize - 1);
+						const size_t x1 = std::min(2 * x + 1, sourceSize - 1);
+						for (size_t c = 0; c < 3; ++c) {
+							const unsigned sum =
+								src[(y0 * sourceSize + x0) * 3 + c] + src[(y0 * sourceSize + x1) * 3 + c] +
+								src[(y1 * sourceSize + x0) * 3 + c] + src[(y1 * sourceSize + x1) * 3 + c];
+							dst[(y * size + x) * 3 + c] = static_cast<std::uint8_t>((sum + 2) / 4);
+						}
+					}
+				}
+			}
+			return level;
+		}
+
+		// Box-filtered copies of the source, sampled trilinearly so a wide lobe needs few samples.
+		class SourcePyramid {
+		public:
+			explicit SourcePyramid(const CubeLevel& source) : mSource(source) {
+				for (int size = source.size / 2; size >= 1; size /= 2) {
+					mReduced.push_back(Downsample(mReduced.empty() ? source : mReduced.back()));
+				}
+			}
+
+			int LevelCount() const {
+				return static_cast<int>(mReduced.size()) + 1;
+			}
+
+			const CubeLevel& Level(int level) const {
+				return level == 0 ? mSource : mReduced[static_cast<size_t>(level - 1)];
+			}
+
+			void Sample(const Direction& d, float lod, float rgb[3]) const {
+				int face = 0;
+				float s = 0.0f;
+				float t = 0.0f;
+				DirectionToFace(d, face, s, t);
+				lod = std::clamp(lod, 0.0f, static_cast<float>(LevelCount() - 1));
+				const int fine = static_cast<int>(lod);
+				const int coarse = std::min(fine + 1, LevelCount() - 1);
+				const float blend = lod - static_cast<float>(fine);
+				float fineRgb[3];
+				Bilinear(Level(fine), face, s, t, fineRgb);
+				if (blend <= 0.0f || coarse == fine) {
+					rgb[0] = fineRgb[0];
+					rgb[1] = fineRgb[1];
+					rgb[2] = fineRgb[2];
+					return;
+				}
+				float coarseRgb[3];
+				Bilinear(Level(coarse), face, s, t, coarseRgb);
+				for (int c = 0; c < 3; ++c) {
+					rgb[c] = fineRgb[c] + (coarseRgb[c] - fineRgb[c]) * blend;
+				}
+			}
+
+		private:
+			// Clamps at face edges rather than filtering across them; the seams this leaves are below what
+			// the 8-bit result resolves once a lobe is wide enough to reach an edge.
+			static void Bilinear(const CubeLevel& level, int face, float s, float t, float rgb[3]) {
+				const int size = level.size;
+				const float fx = std::clamp(s * static_cast<float>(size) - 0.5f, 0.0f, static_cast<float>(size - 1));
+				const float fy = std::clamp(t * static_cast<float>(size) - 0.5f, 0.0f, static_cast<float>(size - 1));
+				const int x0 = static_cast<int>(fx);
+				const int y0 = static_cast<int>(fy);
+				const int x1 = std::min(x0 + 1, size - 1);
+				const int y1 = std::min(y0 + 1, size - 1);
+				const float wx = fx - static_cast<float>(x0);
+				const float wy = fy - static_cast<float>(y0);
+				const std::uint8_t* pixels = level.faces[static_cast<size_t>(face)].data();
+				const size_t row = static_cast<size_t>(size);
+				const std::uint8_t* p00 = pixels + (static_cast<size_t>(y0) * row + static_cast<size_t>(x0)) * 3;
+				const std::uint8_t* p01 = pixels + (static_cast<size_t>(y0) * row + static_cast<size_t>(x1)) * 3;
+				const std::uint8_t* p10 = pixels + (static_cast<size_t>(y1) * row + static_cast<size_t>(x0)) * 3;
+				const std::uint8_t* p11 = pixels + (static_cast<size_t>(y1) * row + static_cast<size_t>(x1)) * 3;
+				for (int c = 0; c < 3; ++c) {
+					const float top = static_cast<float>(p00[c]) + (static_cast<float>(p01[c]) - static_cast<float>(p00[c])) * wx;
+					const float bottom = static_cast<float>(p10[c]) + (static_cast<float>(p11[c]) - static_cast<float>(p10[c])) * wx;
+					rgb[c] = top + (bottom - top) * wy;
+				}
+			}
+
+			const CubeLevel& mSource;
+			std::vector<CubeLevel> mReduced;
+		};
+
+		// Lobe samples in tangent space (z along the normal), padded to whole lanes with zero weight.
+		struct LobeSamples {
+			std::vector<float> x;
+			std::vector<float> y;
+			std::vector<float> z;
+			std::vector<float> weight;
+			std::vector<float> lod;
+		};
+
+		float RadicalInverse(std::uint32_t bits) {
+			bits = (bits << 16u) | (bits >> 16u);
+			bits = ((bits & 0x55555555u) << 1u) | ((bits & 0xAAAAAAAAu) >> 1u);
+			bits = ((bits & 0x33333333u) << 2u) | ((bits & 0xCCCCCCCCu) >> 2u);
+			bits = ((bits & 0x0F0F0F0Fu) << 4u) | ((bits & 0xF0F0F0F0u) >> 4u);
+			bits = ((bits & 0x00FF00FFu) << 8u) | ((bits & 0xFF00FF00u) >> 8u);
+			return static_cast<float>(bits) * 2.3283064365386963e-10f;
+		}
+
+		// GGX importance samples for a view along the normal (the usual N = V = R split-sum assumption).
+		// Each reads the source level whose texels match the sample's share of the lobe (filtered
+		// importance sampling), which keeps a few dozen samples free of fireflies.
+		LobeSamples BuildLobeSamples(float roughness, int sampleCount, int sourceSize) {
+			LobeSamples samples;
+			const float alpha = roughness * roughness;
+			const float alpha2 = alpha * alpha;
+			const float texelSolidAngle = 4.0f * kPi / (6.0f * static_cast<float>(sourceSize) * static_cast<float>(sourceSize));
+			for (int i = 0; i < sampleCount; ++i) {
+				const float phi = 2.0f * kPi * (static_cast<float>(i) + 0.5f) / static_cast<float>(sampleCount);
+				const float v = RadicalInverse(static_cast<std::uint32_t>(i));
+				const float cosTheta = std::sqrt((1.0f - v) / (1.0f + (alpha2 - 1.0f) * v));
+				const float sinTheta = std::sqrt(std::max(1.0f - cosTheta * cosTheta, 0.0f));
+				const float nDotL = 2.0f * cosTheta * cosTheta - 1.0f;
+				if (nDotL <= 0.0f) {
+					continue;
+				}
+				const float denominator = cosTheta * cosTheta * (alpha2 - 1.0f) + 1.0f;
+				const float distribution = alpha2 / (kPi * denominator * denominator);
+				const float pdf = std::max(distribution * 0.25f, 1e-6f);
+				const float sampleSolidAngle = 1.0f / (static_cast<float>(sampleCount) * pdf);
+				samples.x.push_back(2.0f * cosTheta * sinTheta * std::cos(phi));
+				samples.y.push_back(2.0f * cosTheta * sinTheta * std::sin(phi));
+				samples.z.push_back(nDotL);
+				samples.weight.push_back(nDotL);
+				samples.lod.push_back(std::max(0.5f * std::log2(sampleSolidAngle / texelSolidAngle) + 1.0f, 0.0f));
+			}
+			const size_t padded = (samples.x.size() + kLanes - 1) / kLanes * kLanes;
+			samples.x.resize(padded, 0.0f);
+			samples.y.resize(padded, 0.0f);
+			samples.z.resize(padded, 1.0f);
+			samples.weight.resize(padded, 0.0f);
+			samples.lod.resize(padded, 0.0f);
+			return samples;
+		}
+
+		std::uint8_t ToByte(float value) {
+			return static_cast<std::uint8_t>(std::clamp(value + 0.5f, 0.0f, 255.0f));
+		}
+
+		// Calls body(face, row) for every row of a level with six faces of `size` rows, spread through
+		// settings.parallelFor or else over settings.threadCount threads.
+		template <typename Body>
+		void ForEachFaceRow(int size, const FilterSettings& settings, const Body& body) {
+			const int rows = 6 * size;
+			if (settings.parallelFor) {
+				settings.parallelFor(static_cast<size_t>(rows), [&](size_t begin, size_t end) {
+					for (size_t row = begin; row < end; ++row) {
+						body(static_cast<int>(row) / size, static_cast<int>(row) % size);
+					}
+				});
+				return;
+			}
+			int threadCount = settings.threadCount;
+			if (threadCount <= 0) {
+				threadCount = static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+			}
+			threadCount = std::clamp(threadCount, 1, rows);
+			std::atomic<int> next{0};
+			auto worker = [&]() {
+				for (int row = next.fetch_add(1); row < rows; row = next.fetch_add(1)) {
+					body(row / size, row % size);
+				}
+			};
+			std::vector<std::thread> threads;
+			for (int i = 1; i < threadCount; ++i) {
+				threads.emplace_back(worker);
+			}
+			worker();
+			for (std::thread& thread : threads) {
+				thread.join();
+			}
+		}
+
+		CubeLevel FilterGlossyLevel(const SourcePyramid& pyramid, int size, const LobeSamples& samples, const FilterSettings& settings) {
+			CubeLevel level;
+			level.size = size;
+			for (std::vector<std::uint8_t>& face : level.faces) {
+				face.resize(static_cast<size_t>(size) * static_cast<size_t>(size) * 3);
+			}
+			ForEachFaceRow(size, settings, [&](int face, int y) {
+				std::uint8_t* out = level.faces[static_cast<size_t>(face)].data() + static_cast<size_t>(y) * static_cast<size_t>(size) * 3;
+				for (int x = 0; x < size; ++x) {
+					const Direction n = TexelDirection(face, x, y, size);
+					const Direction up = std::abs(n.z) < 0.999f ? Direction{0.0f, 0.0f, 1.0f} : Direction{1.0f, 0.0f, 0.0f};
+					const Direction tangent = Normalize(Cross(up, n));
+					const Direction bitangent = Cross(n, tangent);
+					float sum[3] = {0.0f, 0.0f, 0.0f};
+					float weightSum = 0.0f;
+					for (size_t base = 0; base < samples.x.size(); base += kLanes) {
+						float dx[kLanes];
+						float dy[kLanes];
+						float dz[kLanes];
+						for (size_t lane = 0; lane < kLanes; ++lane) {
+							const float sx = samples.x[base + lane];
+							const float sy = samples.y[base + lane];
+							const float sz = samples.z[base + lane];
+							dx[lane] = tangent.x * sx + bitangent.x * sy + n.x * sz;
+							dy[lane] = tangent.y * sx + bitangent.y * sy + n.y * sz;
+							dz[lane] = tangent.z * sx + bitangent.z * sy + n.z * sz;
+						}
+						for (size_t lane = 0; lane < kLanes; ++lane) {
+							const float weight = samples.weight[base + lane];
+							if (weight <= 0.0f) {
+								continue;
+							}
+							float rgb[3];
+							pyramid.Sample({dx[lane], dy[lane], dz[lane]}, samples.lod[base + lane], rgb);
+							sum[0] += rgb[0] * weight;
+							sum[1] += rgb[1] * weight;
+							sum[2] += rgb[2] * weight;
+							weightSum += weight;
+						}
+					}
+					const float scale = weightSum > 0.0f ? 1.0f / weightSum : 0.0f;
+					out[x * 3 + 0] = ToByte(sum[0] * scale);
+					out[x * 3 + 1] = ToByte(sum[1] * scale);
+					out[x * 3 + 2] = ToByte(sum[2] * scale);
+				}
+			});
+			return level;
+		}
+
+		// Cosine-weighted integral of the whole sphere for every output texel, read from a small level of
+		// the pyramid held as direction * solid angle and color arrays.
+		CubeLevel FilterIrradiance(const SourcePyramid& pyramid, int size, const FilterSettings& settings) {
+			int sourceLevel = 0;
+			while (sourceLevel + 1 < pyramid.LevelCount() && pyramid.Level(sourceLevel).size > size) {
+				++sourceLevel;
+			}
+			const CubeLevel& source = pyramid.Level(sourceLevel);
+			const size_t texels = 6 * static_cast<size_t>(source.size) * static_cast<size_t>(source.size);
+			const size_t padded = (texels + kLanes - 1) / kLanes * kLanes;
+			std::vector<float> wx(padded, 0.0f);
+			std::vector<float> wy(padded, 0.0f);
+			std::vector<float> wz(padded, 0.0f);
+			std::vector<float> r(padded, 0.0f);
+			std::vector<float> g(padded, 0.0f);
+			std::vector<float> b(padded, 0.0f);
+			size_t index = 0;
+			for (int face = 0; face < 6; ++face) {
+				const std::uint8_t* pixels = source.faces[static_cast<size_t>(face)].data();
+				for (int y = 0; y < source.size; ++y) {
+					for (int x = 0; x < source.size; ++x, ++index) {
+						const Direction d = TexelDirection(face, x, y, source.size);
+						const float solidAngle = TexelSolidAngle(x, y, source.size);
+						wx[index] = d.x * solidAngle;
+						wy[index] = d.y * solidAngle;
+						wz[index] = d.z * solidAngle;
+						const std::uint8_t* texel = pixels + (static_cast<size_t>(y) * static_cast<size_t>(source.size) + static_cast<size_t>(x)) * 3;
+						r[index] = static_cast<float>(texel[0]);
+						g[index] = static_cast<float>(texel[1]);
+						b[index] = static_cast<float>(texel[2]);
+					}
+				}
+			}
+
+			CubeLevel level;
+			level.size = size;
+			for (std::vector<std::uint8_t>& face : level.faces) {
+				face.resize(static_cast<size_t>(size) * static_cast<size_t>(size) * 3);
+			}
+			ForEachFaceRow(size, settings, [&](int face, int y) {
+				std::uint8_t* out = level.faces[static_cast<size_t>(face)].data() + static_cast<size_t>(y) * static_cast<size_t>(size) * 3;
+				for (int x = 0; x < size; ++x) {
+					const Direction n = TexelDirection(face, x, y, size);
+					float sumR[kLanes] = {};
+					float sumG[kLanes] = {};
+					float sumB[kLanes] = {};
+					for (size_t base = 0; base < padded; base += kLanes) {
+						for (size_t lane = 0; lane < kLanes; ++lane) {
+							const size_t i = base + lane;
+							const float weight = std::max(n.x * wx[i] + n.y * wy[i] + n.z * wz[i], 0.0f);
+							sumR[lane] += weight * r[i];
+							sumG[lane] += weight * g[i];
+							sumB[lane] += weight * b[i];
+						}
+					}
+					float rgb[3] = {0.0f, 0.0f, 0.0f};
+					for (size_t lane = 0; lane < kLanes; ++lane) {
+						rgb[0] += sumR[lane];
+						rgb[1] += sumG[lane];
+						rgb[2] += sumB[lane];
+					}
+					// The cosine lobe integrates to pi, so a uniform environment comes back unchanged.
+					out[x * 3 + 0] = ToByte(rgb[0] / kPi);
+					out[x * 3 + 1] = ToByte(rgb[1] / kPi);
+					out[x * 3 + 2] = ToByte(rgb[2] / kPi);
+				}
+			});
+			return level;
+		}
+	}
+
+	float LevelRoughness(int level, int levelCount) {
+		return levelCount > 1 ? static_cast<float>(level) / static_cast<float>(levelCount - 1) : 0.0f;
+	}
+
+	PrefilteredCube Prefilter(const CubeLevel& source, const FilterSettings& settings) {
+		PrefilteredCube result;
+		const size_t faceBytes = static_cast<size_t>(std::max(source.size, 0)) * static_cast<size_t>(std::max(source.size, 0)) * 3;
+		if (source.size <= 0) {
+			return result;
+		}
+		for (const std::vector<std::uint8_t>& face : source.faces) {
+			if (face.size() != faceBytes) {
+				return result;
+			}
+		}
+
+		const SourcePyramid pyramid(source);
+		const int levelCount = std::clamp(settings.levelCount, 1, pyramid.LevelCount());
+		result.levels.reserve(static_cast<size_t>(levelCount));
+		result.levels.push_back(source);
+		for (int level = 1; level < levelCount; ++level) {
+			const float roughness = LevelRoughness(level, levelCount);
+			const int sampleCount = std::max(static_cast<int>(kLanes), settings.sampleCount * level / (levelCount - 1));
+			const LobeSamples samples = BuildLobeSamples(roughness, sampleCount, source.size);
+			result.levels.push_back(FilterGlossyLevel(pyramid, std::max(source.size >> level, 1), samples, settings));
+		}
+		result.irradiance = FilterIrradiance(pyramid, std::max(settings.irradianceSize, 1), settings);
+		return result;
+	}
+}
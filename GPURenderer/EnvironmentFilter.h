@@ -0,0 +1,46 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+// CPU prefiltering of an environment cube map for image-based lighting: a chain of levels convolved
+// with GGX lobes of increasing roughness, sampled for glossy reflections by level, and a small
+// cosine-convolved irradiance cube for diffuse lighting. Rows of output texels are spread over worker
+// threads; the per-texel sample loops run over fixed-width lanes so the compiler can vectorize them.
+namespace gpurenderer::environment {
+	// Six square RGB8 faces in GL cube map order (+X, -X, +Y, -Y, +Z, -Z), each stored with GL's row
+	// order, i.e. the first row is t = 0.
+	struct CubeLevel {
+		int size = 0;
+		std::array<std::vector<std::uint8_t>, 6> faces;
+	};
+
+	struct FilterSettings {
+		// Levels of the glossy chain, level 0 being the unfiltered source; clamped to the source's mip count.
+		int levelCount = 6;
+		// GGX samples per texel of the roughest level; smoother levels use fewer.
+		int sampleCount = 64;
+		int irradianceSize = 32;
+		// <= 0 uses every hardware thread.
+		int threadCount = 0;
+		// When set, rows are spread by calling parallelFor(count, body) instead of over threadCount
+		// threads of the filter's own; body(begin, end) covers rows [begin, end). Lets a caller that is
+		// already on a job worker share its pool rather than start more threads.
+		std::function<void(size_t, const std::function<void(size_t, size_t)>&)> parallelFor;
+	};
+
+	struct PrefilteredCube {
+		// levels[i] is (size >> i) square, convolved with a GGX lobe of LevelRoughness(i, levels.size()).
+		std::vector<CubeLevel> levels;
+		CubeLevel irradiance;
+	};
+
+	// Perceptual roughness the chain's level `level` was convolved with: 0 at level 0, 1 at the last.
+	float LevelRoughness(int level, int levelCount);
+
+	// source must hold six faces of source.size texels square. Returns an empty chain when it does not.
+	PrefilteredCube Prefilter(const CubeLevel& source, const FilterSettings& settings);
+}
@@ -2,47 +2,135 @@
 
 #include "RendererApp.h"
 
+#include <algorithm>
 #include <cstdio>
 #include <cstdlib>
 #include <string>
+#include <vector>
 
 namespace {
 	struct AppConfig {
 		std::string objPath;
 		int windowWidth = gpurenderer::config::kDefaultWindowWidth;
 		int windowHeight = gpurenderer::config::kDefaultWindowHeight;
+		std::string softwareOutputPath;
+		std::string goldenPath;
+		double goldenTolerance = gpurenderer::config::kDefaultGoldenTolerance;
+		gpurenderer::FramePacingOptions pacing;
+		bool onDemand = false;
+		bool compressTextures = false;
 	};
 
-	AppConfig ParseArgs(int argc, char** argv) {
-		if (argc < 2) {
-			std::fprintf(stderr, gpurenderer::config::kUsageFormat, argv[0]);
-			std::exit(1);
+	[[noreturn]] void ExitWithUsage(const char* program) {
+		std::fprintf(stderr, gpurenderer::config::kUsageFormat, program);
+		std::exit(1);
+	}
+
+	// "vsync", "uncapped" or a target frame rate.
+	bool ParsePacing(const std::string& value, gpurenderer::FramePacingOptions& pacing) {
+		if (value == "vsync") {
+			pacing.pacing = gpurenderer::FramePacing::VSync;
+			return true;
+		}
+		if (value == "uncapped") {
+			pacing.pacing = gpurenderer::FramePacing::Uncapped;
+			return true;
+		}
+		const double fps = std::atof(value.c_str());
+		if (fps <= 0.0) {
+			return false;
 		}
+		pacing.pacing = gpurenderer::FramePacing::TargetFps;
+		pacing.targetFps = fps;
+		return true;
+	}
 
+	AppConfig ParseArgs(int argc, char** argv) {
 		AppConfig config;
-		config.objPath = argv[1];
-		if (argc > 2) {
-			const int width = std::atoi(argv[2]);
+		std::vector<const char*> positional;
+		for (int i = 1; i < argc; ++i) {
+			const std::string arg = argv[i];
+			const bool hasValue = i + 1 < argc;
+			if (arg == "--on-demand") {
+				config.onDemand = true;
+				continue;
+			}
+			if (arg == "--compress-textures") {
+				config.compressTextures = true;
+				continue;
+			}
+			if (arg == "--pacing" || arg == "--frames-in-flight") {
+				if (!hasValue) {
+					ExitWithUsage(argv[0]);
+				}
+				const char* value = argv[++i];
+				if (arg == "--pacing") {
+					if (!ParsePacing(value, config.pacing)) {
+						ExitWithUsage(argv[0]);
+					}
+				} else {
+					config.pacing.framesInFlight = std::clamp(std::atoi(value), 1, gpurenderer::config::kMaxFramesInFlight);
+				}
+				continue;
+			}
+			if (arg == "--software" || arg == "--golden" || arg == "--golden-tolerance") {
+				if (!hasValue) {
+					ExitWithUsage(argv[0]);
+				}
+				const char* value = argv[++i];
+				if (arg == "--software") {
+					config.softwareOutputPath = value;
+				} else if (arg == "--golden") {
+					config.goldenPath = value;
+				} else {
+					config.goldenTolerance = std::max(0.0, std::atof(value));
+				}
+				continue;
+			}
+			positional.push_back(argv[i]);
+		}
+		if (positional.empty()) {
+			ExitWithUsage(argv[0]);
+		}
+
+		config.objPath = positional[0];
+		if (positional.size() > 1) {
+			const int width = std::atoi(positional[1]);
 			if (width > 0) {
 				config.windowWidth = width;
 			}
 		}
-		if (argc > 3) {
-			const int height = std::atoi(argv[3]);
+		if (positional.size() > 2) {
+			const int height = std::atoi(positional[2]);
 			if (height > 0) {
 				config.windowHeight = height;
 			}
 		}
 		return config;
 	}
+
+	int RunSoftware(const AppConfig& config, const std::string& outputPath) {
+		gpurenderer::SoftwareRenderOptions options;
+		options.objPath = config.objPath;
+		options.width = config.windowWidth;
+		options.height = config.windowHeight;
+		options.outputPath = outputPath;
+		options.goldenPath = config.goldenPath;
+		options.goldenTolerance = config.goldenTolerance;
+		return gpurenderer::RunSoftwareRenderer(options);
+	}
 }
 
 int main(int argc, char** argv) {
 	const AppConfig config = ParseArgs(argc, argv);
+	if (!config.softwareOutputPath.empty() || !config.goldenPath.empty()) {
+		return RunSoftware(config, config.softwareOutputPath);
+	}
 
 	if (!glfwInit()) {
-		std::fprintf(stderr, "Failed to initialize GLFW.\n");
-		return 1;
+		std::fprintf(stderr, "Failed to initialize GLFW. Falling back to the software renderer (%s).\n",
+			gpurenderer::config::kSoftwareFallbackOutput);
+		return RunSoftware(config, gpurenderer::config::kSoftwareFallbackOutput);
 	}
 
 	auto createWindow = [&](bool requestGl21) -> GLFWwindow* {
@@ -67,14 +155,16 @@ int main(int argc, char** argv) {
 		window = createWindow(false);
 	}
 	if (!window) {
-		std::fprintf(stderr, "Failed to create GLFW window.\n");
+		std::fprintf(stderr, "Failed to create GLFW window. Falling back to the software renderer (%s).\n",
+			gpurenderer::config::kSoftwareFallbackOutput);
 		glfwTerminate();
-		return 1;
+		return RunSoftware(config, gpurenderer::config::kSoftwareFallbackOutput);
 	}
 
 	glfwMakeContextCurrent(window);
 	glfwSwapInterval(1);
 
+	gpurenderer::SetTextureCompression(config.compressTextures);
 	if (!gpurenderer::Initialize(window, config.objPath)) {
 		gpurenderer::Shutdown();
 		glfwDestroyWindow(window);
@@ -89,13 +179,18 @@ int main(int argc, char** argv) {
 	glfwSetKeyCallback(window, gpurenderer::OnKey);
 	glfwSetCharCallback(window, gpurenderer::OnChar);
 
+	gpurenderer::ConfigureFramePacing(config.pacing);
+	gpurenderer::SetOnDemandRendering(config.onDemand);
 	glfwShowWindow(window);
 	glfwFocusWindow(window);
 
 	while (!glfwWindowShouldClose(window)) {
-		glfwPollEvents();
+		if (!gpurenderer::PumpEvents()) {
+			continue;
+		}
 		gpurenderer::RenderFrame();
 		glfwSwapBuffers(window);
+		gpurenderer::FinishFrame();
 	}
 
 	gpurenderer::Shutdown();
@@ -0,0 +1,838 @@
+#include <GLFW/glfw3.h>
+
+#include "JobSystem.h"
+#include "RendererApp.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+// Benchmark driver for the load, build and frame paths. Scenes are generated procedurally from a fixed
+// seed so two runs (or two machines) time byte-identical inputs; results go to a flat JSON file that a
+// second invocation can diff against a baseline.
+namespace {
+	constexpr const char* kUsage =
+		"Usage: %s [--out results.json] [--work-dir dir] [--scene name:triangles:materials:textureSize]...\n"
+		"          [--frames N] [--size W H] [--no-gl] [--hardware-gl] [--no-jobs]\n"
+		"       %s --compare baseline.json current.json [--threshold percent]\n"
+		"       %s --job-stress rounds\n";
+	constexpr const char* kDefaultOutput = "bench_results.json";
+	constexpr const char* kDefaultWorkDir = "bench_scenes";
+	constexpr int kSchemaVersion = 1;
+	constexpr int kDefaultFrames = 20;
+	constexpr int kWarmupFrames = 2;
+	constexpr int kDefaultWidth = 960;
+	constexpr int kDefaultHeight = 540;
+	constexpr double kDefaultThresholdPercent = 10.0;
+	// Timings below this many milliseconds of change are treated as noise regardless of percentage.
+	constexpr double kNoiseFloorMs = 0.05;
+	constexpr int kCubemapFaceSize = 64;
+	constexpr std::uint64_t kSceneSeed = 0x6750555265u;
+	// Job system microbenchmarks: each is repeated and the fastest repetition reported.
+	constexpr int kJobBenchRepeats = 5;
+	constexpr size_t kJobBenchEmptyJobs = 100000;
+	constexpr size_t kJobBenchChainLength = 10000;
+	constexpr size_t kJobBenchMainJobs = 10000;
+	constexpr size_t kJobBenchElements = 1u << 23;
+	constexpr size_t kJobBenchGrain = 1u << 14;
+	// Job stress test: jobs per random graph, and the most dependencies one job takes.
+	constexpr size_t kStressJobs = 2000;
+	constexpr int kStressMaxDependencies = 3;
+	constexpr int kStressSubmitters = 2;
+
+	struct SceneSpec {
+		std::string name;
+		size_t triangles = 0;
+		int materials = 1;
+		int textureSize = 256;
+	};
+
+	const std::array<SceneSpec, 3> kDefaultScenes{{
+		{"small", 20000, 2, 256},
+		{"medium", 200000, 8, 512},
+		{"large", 1000000, 16, 1024}
+	}};
+
+	struct BenchConfig {
+		std::string outputPath = kDefaultOutput;
+		std::filesystem::path workDir = kDefaultWorkDir;
+		std::vector<SceneSpec> scenes;
+		int frames = kDefaultFrames;
+		int width = kDefaultWidth;
+		int height = kDefaultHeight;
+		bool runGl = true;
+		bool forceSoftwareGl = true;
+		bool runJobs = true;
+		int jobStressRounds = 0;
+		bool compare = false;
+		std::string baselinePath;
+		std::string currentPath;
+		double thresholdPercent = kDefaultThresholdPercent;
+	};
+
+	struct BenchResult {
+		std::string scene;
+		std::string metric;
+		double value = 0.0;
+	};
+
+	[[noreturn]] void ExitWithUsage(const char* program) {
+		std::fprintf(stderr, kUsage, program, program, program);
+		std::exit(2);
+	}
+
+	bool ParseSceneSpec(const std::string& text, SceneSpec& spec) {
+		const size_t first = text.find(':');
+		const size_t second = first == std::string::npos ? first : text.find(':', first + 1);
+		const size_t third = second == std::string::npos ? second : text.find(':', second + 1);
+		if (third == std::string::npos || first == 0) {
+			return false;
+		}
+		spec.name = text.substr(0, first);
+		spec.triangles = static_cast<size_t>(std::strtoull(text.c_str() + first + 1, nullptr, 10));
+		spec.materials = std::atoi(text.c_str() + second + 1);
+		spec.textureSize = std::atoi(text.c_str() + third + 1);
+		return spec.triangles >= 2 && spec.materials >= 1 && spec.textureSize >= 1;
+	}
+
+	BenchConfig ParseArgs(int argc, char** argv) {
+		BenchConfig config;
+		for (int i = 1; i < argc; ++i) {
+			const std::string arg = argv[i];
+			auto next = [&]() -> const char* {
+				if (i + 1 >= argc) {
+					ExitWithUsage(argv[0]);
+				}
+				return argv[++i];
+			};
+			if (arg == "--out") {
+				config.outputPath = next();
+			} else if (arg == "--work-dir") {
+				config.workDir = next();
+			} else if (arg == "--scene") {
+				SceneSpec spec;
+				if (!ParseSceneSpec(next(), spec)) {
+					ExitWithUsage(argv[0]);
+				}
+				config.scenes.push_back(spec);
+			} else if (arg == "--frames") {
+				config.frames = std::max(1, std::atoi(next()));
+			} else if (arg == "--size") {
+				config.width = std::max(1, std::atoi(next()));
+				config.height = std::max(1, std::atoi(next()));
+			} else if (arg == "--no-gl") {
+				config.runGl = false;
+			} else if (arg == "--hardware-gl") {
+				config.forceSoftwareGl = false;
+			} else if (arg == "--no-jobs") {
+				config.runJobs = false;
+			} else if (arg == "--job-stress") {
+				config.jobStressRounds = std::max(1, std::atoi(next()));
+			} else if (arg == "--compare") {
+				config.compare = true;
+				config.baselinePath = next();
+				config.currentPath = next();
+			} else if (arg == "--threshold") {
+				config.thresholdPercent = std::max(0.0, std::atof(next()));
+			} else {
+				ExitWithUsage(argv[0]);
+			}
+		}
+		if (config.scenes.empty()) {
+			config.scenes.assign(kDefaultScenes.begin(), kDefaultScenes.end());
+		}
+		return config;
+	}
+
+	// SplitMix64; used instead of <random> distributions, whose output differs between standard libraries.
+	struct SceneRandom {
+		std::uint64_t state = 0;
+
+		std::uint64_t Next() {
+			std::uint64_t z = (state += 0x9E3779B97F4A7C15ull);
+			z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+			z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+			return z ^ (z >> 31);
+		}
+
+		float Unit() {
+			return static_cast<float>(Next() >> 40) * (1.0f / 16777216.0f);
+		}
+	};
+
+	// Minimal PNG encoder using stored (uncompressed) deflate blocks. Decode cost is dominated by
+	// stb_image's PNG path rather than inflate, which keeps the texture stage deterministic.
+	struct PngWriter {
+		std::array<std::uint32_t, 256> crcTable{};
+
+		PngWriter() {
+			for (std::uint32_t n = 0; n < 256; ++n) {
+				std::uint32_t c = n;
+				for (int k = 0; k < 8; ++k) {
+					c = (c & 1u) ? (0xEDB88320u ^ (c >> 1)) : (c >> 1);
+				}
+				crcTable[n] = c;
+			}
+		}
+
+		static void PutBigEndian(std::vector<unsigned char>& out, std::uint32_t value) {
+			out.push_back(static_cast<unsigned char>(value >> 24));
+			out.push_back(static_cast<unsigned char>(value >> 16));
+			out.push_back(static_cast<unsigned char>(value >> 8));
+			out.push_back(static_cast<unsigned char>(value));
+		}
+
+		void PutChunk(std::vector<unsigned char>& out, const char* type, const std::vector<unsigned char>& data) const {
+			PutBigEndian(out, static_cast<std::uint32_t>(data.size()));
+			const size_t crcStart = out.size();
+			out.insert(out.end(), type, type + 4);
+			out.insert(out.end(), data.begin(), data.end());
+			std::uint32_t crc = 0xFFFFFFFFu;
+			for (size_t i = crcStart; i < out.size(); ++i) {
+				crc = crcTable[(crc ^ out[i]) & 0xFFu] ^ (crc >> 8);
+			}
+			PutBigEndian(out, crc ^ 0xFFFFFFFFu);
+		}
+
+		bool WriteRgb(const std::filesystem::path& path, int width, int height, const std::vector<unsigned char>& rgb) const {
+			const size_t rowBytes = static_cast<size_t>(width) * 3u;
+			std::vector<unsigned char> raw;
+			raw.reserve((rowBytes + 1u) * static_cast<size_t>(height));
+			for (int y = 0; y < height; ++y) {
+				raw.push_back(0);
+				const unsigned char* row = rgb.data() + static_cast<size_t>(y) * rowBytes;
+				raw.insert(raw.end(), row, row + rowBytes);
+			}
+
+			std::vector<unsigned char> zlib{0x78, 0x01};
+			constexpr size_t kMaxStoredBlock = 65535;
+			size_t offset = 0;
+			do {
+				const size_t length = std::min(kMaxStoredBlock, raw.size() - offset);
+				const bool last = offset + length == raw.size();
+				zlib.push_back(last ? 1 : 0);
+				zlib.push_back(static_cast<unsigned char>(length & 0xFFu));
+				zlib.push_back(static_cast<unsigned char>(length >> 8));
+				zlib.push_back(static_cast<unsigned char>(~length & 0xFFu));
+				zlib.push_back(static_cast<unsigned char>((~length >> 8) & 0xFFu));
+				zlib.insert(zlib.end(), raw.begin() + static_cast<std::ptrdiff_t>(offset), raw.begin() + static_cast<std::ptrdiff_t>(offset + length));
+				offset += length;
+			} while (offset < raw.size());
+			std::uint32_t a = 1;
+			std::uint32_t b = 0;
+			for (unsigned char byte : raw) {
+				a = (a + byte) % 65521u;
+				b = (b + a) % 65521u;
+			}
+			PutBigEndian(zlib, (b << 16) | a);
+
+			std::vector<unsigned char> header;
+			PutBigEndian(header, static_cast<std::uint32_t>(width));
+			PutBigEndian(header, static_cast<std::uint32_t>(height));
+			header.insert(header.end(), {8, 2, 0, 0, 0});
+
+			std::vector<unsigned char> png{0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+			PutChunk(png, "IHDR", header);
+			PutChunk(png, "IDAT", zlib);
+			PutChunk(png, "IEND", {});
+
+			std::ofstream file(path, std::ios::binary);
+			file.write(reinterpret_cast<const char*>(png.data()), static_cast<std::streamsize>(png.size()));
+			return static_cast<bool>(file);
+		}
+	};
+
+	std::string SceneStamp(const SceneSpec& spec) {
+		char stamp[160];
+		std::snprintf(stamp, sizeof(stamp), "# gpurenderer-bench scene v%d %zu %d %d",
+			kSchemaVersion, spec.triangles, spec.materials, spec.textureSize);
+		return stamp;
+	}
+
+	bool WriteCheckerTexture(const PngWriter& png, const std::filesystem::path& path, int size, SceneRandom& random) {
+		const std::array<unsigned char, 3> base{
+			static_cast<unsigned char>(64 + random.Next() % 192),
+			static_cast<unsigned char>(64 + random.Next() % 192),
+			static_cast<unsigned char>(64 + random.Next() % 192)};
+		const int cell = std::max(1, size / 8);
+		std::vector<unsigned char> rgb(static_cast<size_t>(size) * static_cast<size_t>(size) * 3u);
+		for (int y = 0; y < size; ++y) {
+			for (int x = 0; x < size; ++x) {
+				const bool dark = ((x / cell) + (y / cell)) % 2 == 0;
+				const unsigned char noise = static_cast<unsigned char>(random.Next() & 0x1Fu);
+				unsigned char* texel = rgb.data() + (static_cast<size_t>(y) * static_cast<size_t>(size) + static_cast<size_t>(x)) * 3u;
+				for (int c = 0; c < 3; ++c) {
+					const int value = (dark ? base[c] / 2 : base[c]) + noise;
+					texel[c] = static_cast<unsigned char>(std::min(value, 255));
+				}
+			}
+		}
+		return png.WriteRgb(path, size, size, rgb);
+	}
+
+	// Unit cube and a gradient cubemap so Initialize finds its environment assets next to the scene.
+	bool WriteEnvironment(const PngWriter& png, const std::filesystem::path& dir) {
+		std::error_code ec;
+		std::filesystem::create_directories(dir / "cube", ec);
+		std::filesystem::create_directories(dir / "cubemap", ec);
+		if (ec) {
+			return false;
+		}
+		std::ofstream cube(dir / "cube" / "cube.obj");
+		cube << "v -1 -1 -1\nv 1 -1 -1\nv 1 1 -1\nv -1 1 -1\nv -1 -1 1\nv 1 -1 1\nv 1 1 1\nv -1 1 1\n"
+			"f 1 3 2\nf 1 4 3\nf 5 6 7\nf 5 7 8\nf 1 2 6\nf 1 6 5\n"
+			"f 4 7 3\nf 4 8 7\nf 1 5 8\nf 1 8 4\nf 2 3 7\nf 2 7 6\n";
+		if (!cube) {
+			return false;
+		}
+
+		const std::array<const char*, 6> faces{
+			"cubemap_posx.png", "cubemap_negx.png", "cubemap_posy.png",
+			"cubemap_negy.png", "cubemap_posz.png", "cubemap_negz.png"};
+		std::vector<unsigned char> rgb(static_cast<size_t>(kCubemapFaceSize) * kCubemapFaceSize * 3u);
+		for (size_t face = 0; face < faces.size(); ++face) {
+			for (int y = 0; y < kCubemapFaceSize; ++y) {
+				for (int x = 0; x < kCubemapFaceSize; ++x) {
+					unsigned char* texel = rgb.data() + (static_cast<size_t>(y) * kCubemapFaceSize + static_cast<size_t>(x)) * 3u;
+					texel[0] = static_cast<unsigned char>(40 + face * 30);
+					texel[1] = static_cast<unsigned char>(x * 255 / kCubemapFaceSize);
+					texel[2] = static_cast<unsigned char>(y * 255 / kCubemapFaceSize);
+				}
+			}
+			if (!png.WriteRgb(dir / "cubemap" / faces[face], kCubemapFaceSize, kCubemapFaceSize, rgb)) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	// Writes <dir>/scene.obj: a rippled grid with positions and UVs only, so LoadMesh runs normal
+	// generation, split into one horizontal band per material. Reuses an existing scene with the same stamp.
+	bool GenerateScene(const SceneSpec& spec, const std::filesystem::path& dir, std::filesystem::path& objPath) {
+		objPath = dir / "scene.obj";
+		const std::string stamp = SceneStamp(spec);
+		{
+			std::ifstream existing(objPath);
+			std::string firstLine;
+			if (existing && std::getline(existing, firstLine) && firstLine == stamp) {
+				return true;
+			}
+		}
+
+		std::error_code ec;
+		std::filesystem::create_directories(dir, ec);
+		if (ec) {
+			std::fprintf(stderr, "Failed to create scene directory: %s\n", dir.string().c_str());
+			return false;
+		}
+		const PngWriter png;
+		SceneRandom random{kSceneSeed ^ spec.triangles};
+		if (!WriteEnvironment(png, dir)) {
+			std::fprintf(stderr, "Failed to write environment assets in: %s\n", dir.string().c_str());
+			return false;
+		}
+
+		std::ofstream mtl(dir / "scene.mtl");
+		for (int m = 0; m < spec.materials; ++m) {
+			const std::string texture = "texture_" + std::to_string(m) + ".png";
+			if (!WriteCheckerTexture(png, dir / texture, spec.textureSize, random)) {
+				std::fprintf(stderr, "Failed to write texture: %s\n", texture.c_str());
+				return false;
+			}
+			mtl << "newmtl material_" << m << "\nKa 0.1 0.1 0.1\nKd 0.8 0.8 0.8\nKs 0.3 0.3 0.3\nNs 32\nmap_Kd " << texture << "\n\n";
+		}
+		if (!mtl) {
+			return false;
+		}
+
+		const size_t quads = std::max<size_t>(1, spec.triangles / 2u);
+		const size_t columns = std::max<size_t>(1, static_cast<size_t>(std::ceil(std::sqrt(static_cast<double>(quads)))));
+		const size_t rows = std::max<size_t>(1, (quads + columns - 1) / columns);
+		const float phase = random.Unit() * 6.2831853f;
+
+		std::ofstream obj(objPath, std::ios::binary);
+		std::vector<char> buffer(1u << 20);
+		obj.rdbuf()->pubsetbuf(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+		obj << stamp << "\nmtllib scene.mtl\n";
+		char line[128];
+		for (size_t y = 0; y <= rows; ++y) {
+			for (size_t x = 0; x <= columns; ++x) {
+				const float u = static_cast<float>(x) / static_cast<float>(columns);
+				const float v = static_cast<float>(y) / static_cast<float>(rows);
+				const float height = 0.08f * std::sin(u * 25.0f + phase) * std::cos(v * 19.0f - phase);
+				const int length = std::snprintf(line, sizeof(line), "v %.5f %.5f %.5f\nvt %.5f %.5f\n",
+					u * 2.0f - 1.0f, height, v * 2.0f - 1.0f, u * 4.0f, v * 4.0f);
+				obj.write(line, length);
+			}
+		}
+		int currentMaterial = -1;
+		for (size_t y = 0; y < rows; ++y) {
+			const int material = static_cast<int>(y * static_cast<size_t>(spec.materials) / rows);
+			if (material != currentMaterial) {
+				obj << "usemtl material_" << material << "\n";
+				currentMaterial = material;
+			}
+			for (size_t x = 0; x < columns; ++x) {
+				const size_t i0 = y * (columns + 1) + x + 1;
+				const size_t i1 = i0 + 1;
+				const size_t i2 = i0 + columns + 1;
+				const size_t i3 = i2 + 1;
+				const int length = std::snprintf(line, sizeof(line), "f %zu/%zu %zu/%zu %zu/%zu\nf %zu/%zu %zu/%zu %zu/%zu\n",
+					i0, i0, i2, i2, i1, i1, i1, i1, i2, i2, i3, i3);
+				obj.write(line, length);
+			}
+		}
+		obj.flush();
+		if (!obj) {
+			std::fprintf(stderr, "Failed to write scene: %s\n", objPath.string().c_str());
+			return false;
+		}
+		std::printf("Generated scene '%s': %zu triangles, %d materials, %dpx textures.\n",
+			spec.name.c_str(), rows * columns * 2u, spec.materials, spec.textureSize);
+		return true;
+	}
+
+	void AddPassResults(std::vector<BenchResult>& results, const std::string& scene, const char* prefix, const gpurenderer::PassTimings& timings) {
+		const double frames = static_cast<double>(std::max(timings.frames, 1));
+		const std::string p(prefix);
+		results.push_back({scene, p + ".shadow_ms", timings.shadowMs / frames});
+		results.push_back({scene, p + ".reflection_ms", timings.reflectionMs / frames});
+		results.push_back({scene, p + ".main_ms", timings.mainMs / frames});
+		results.push_back({scene, p + ".frame_ms", timings.frameMs / frames});
+	}
+
+	bool RunSoftwareBench(const BenchConfig& config, const SceneSpec& spec, const std::filesystem::path& objPath, std::vector<BenchResult>& results) {
+		gpurenderer::PassTimings passes;
+		gpurenderer::SoftwareRenderOptions options;
+		options.objPath = objPath.string();
+		options.width = config.width;
+		options.height = config.height;
+		options.frameCount = config.frames;
+		options.passTimings = &passes;
+		if (gpurenderer::RunSoftwareRenderer(options) != 0) {
+			std::fprintf(stderr, "Software run failed for scene '%s'.\n", spec.name.c_str());
+			return false;
+		}
+		const gpurenderer::LoadTimings& load = gpurenderer::GetLastLoadTimings();
+		results.push_back({spec.name, "load.import_ms", load.importMs});
+		results.push_back({spec.name, "load.mesh_build_ms", load.meshBuildMs});
+		results.push_back({spec.name, "load.normals_ms", load.normalsMs});
+		results.push_back({spec.name, "load.texture_decode_ms", load.textureDecodeMs});
+		results.push_back({spec.name, "load.triangles", static_cast<double>(load.triangles)});
+		results.push_back({spec.name, "load.textures", static_cast<double>(load.textures)});
+		results.push_back({spec.name, "load.directory_reads", static_cast<double>(load.directoryReads)});
+		results.push_back({spec.name, "load.stat_calls", static_cast<double>(load.statCalls)});
+		AddPassResults(results, spec.name, "software", passes);
+		return true;
+	}
+
+	bool RunGlBench(GLFWwindow* window, const BenchConfig& config, const SceneSpec& spec, const std::filesystem::path& objPath, std::vector<BenchResult>& results) {
+		if (!gpurenderer::Initialize(window, objPath.string())) {
+			gpurenderer::Shutdown();
+			std::fprintf(stderr, "GL initialization failed for scene '%s'.\n", spec.name.c_str());
+			return false;
+		}
+		const gpurenderer::LoadTimings load = gpurenderer::GetLastLoadTimings();
+		gpurenderer::MeasureFramePasses(kWarmupFrames);
+		const gpurenderer::PassTimings passes = gpurenderer::MeasureFramePasses(config.frames);
+		gpurenderer::Shutdown();
+		results.push_back({spec.name, "gl.texture_upload_ms", load.textureUploadMs});
+		results.push_back({spec.name, "gl.geometry_upload_ms", load.geometryUploadMs});
+		AddPassResults(results, spec.name, "gl", passes);
+		return true;
+	}
+
+	GLFWwindow* CreateBenchWindow(const BenchConfig& config) {
+		if (config.forceSoftwareGl) {
+			// Mesa's llvmpipe gives comparable GL numbers across machines; --hardware-gl opts out.
+#ifdef _WIN32
+			_putenv_s("LIBGL_ALWAYS_SOFTWARE", "1");
+#else
+			setenv("LIBGL_ALWAYS_SOFTWARE", "1", 1);
+#endif
+		}
+		if (!glfwInit()) {
+			return nullptr;
+		}
+		glfwDefaultWindowHints();
+		glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 2);
+		glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 1);
+		glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+		GLFWwindow* window = glfwCreateWindow(config.width, config.height, "GPURendererBench", nullptr, nullptr);
+		if (!window) {
+			glfwTerminate();
+			return nullptr;
+		}
+		glfwMakeContextCurrent(window);
+		glfwSwapInterval(0);
+		return window;
+	}
+
+	template <typename Body>
+	double FastestMs(const Body& body) {
+		double best = 0.0;
+		for (int repeat = 0; repeat < kJobBenchRepeats; ++repeat) {
+			const auto start = std::chrono::steady_clock::now();
+			body();
+			const double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+			best = repeat == 0 ? ms : std::min(best, ms);
+		}
+		return best;
+	}
+
+	// Scheduling overhead (empty jobs, a dependency chain, worker to main thread hand-offs) and the
+	// parallel-for speedup on a memory-bound reduction.
+	void RunJobBench(std::vector<BenchResult>& results) {
+		namespace jobs = gpurenderer::jobs;
+		jobs::JobSystem jobSystem;
+
+		const double emptyMs = FastestMs([&] {
+			std::vector<jobs::Job> batch;
+			batch.reserve(kJobBenchEmptyJobs);
+			for (size_t i = 0; i < kJobBenchEmptyJobs; ++i) {
+				batch.push_back(jobSystem.Submit([] {}));
+			}
+			jobSystem.Wait(jobSystem.Submit([] {}, batch));
+		});
+		const double chainMs = FastestMs([&] {
+			jobs::Job previous;
+			for (size_t i = 0; i < kJobBenchChainLength; ++i) {
+				previous = jobSystem.Submit([] {}, {previous});
+			}
+			jobSystem.Wait(previous);
+		});
+		const double mainMs = FastestMs([&] {
+			std::vector<jobs::Job> batch;
+			batch.reserve(kJobBenchMainJobs);
+			for (size_t i = 0; i < kJobBenchMainJobs; ++i) {
+				batch.push_back(jobSystem.SubmitToMainThread([] {}, {jobSystem.Submit([] {})}));
+			}
+			jobSystem.Wait(batch);
+		});
+
+		std::vector<float> values(kJobBenchElements);
+		for (size_t i = 0; i < values.size(); ++i) {
+			values[i] = static_cast<float>(i % 1000) * 0.001f;
+		}
+		auto sumRange = [&](size_t begin, size_t end) {
+			double sum = 0.0;
+			for (size_t i = begin; i < end; ++i) {
+				sum += std::sqrt(values[i]);
+			}
+			return sum;
+		};
+		double serialSum = 0.0;
+		const double serialMs = FastestMs([&] {
+			serialSum = sumRange(0, values.size());
+		});
+		std::vector<double> partials((values.size() + kJobBenchGrain - 1) / kJobBenchGrain);
+		const double parallelMs = FastestMs([&] {
+			jobSystem.ParallelFor(values.size(), kJobBenchGrain, [&](size_t begin, size_t end) {
+				partials[begin / kJobBenchGrain] = sumRange(begin, end);
+			});
+		});
+		double parallelSum = 0.0;
+		for (double partial : partials) {
+			parallelSum += partial;
+		}
+		if (std::fabs(parallelSum - serialSum) > 1e-6 * std::fabs(serialSum)) {
+			std::fprintf(stderr, "Parallel sum %.6f differs from serial sum %.6f.\n", parallelSum, serialSum);
+		}
+
+		std::printf("Job system: %d workers; %zu empty jobs %.2f ms, chain of %zu %.2f ms, %zu main thread hand-offs %.2f ms, "
+			"parallel sum %.2f ms vs %.2f ms serial (%.1fx).\n",
+			jobSystem.WorkerCount(),
+			kJobBenchEmptyJobs, emptyMs,
+			kJobBenchChainLength, chainMs,
+			kJobBenchMainJobs, mainMs,
+			parallelMs, serialMs, serialMs / std::max(parallelMs, 1e-6));
+		results.push_back({"jobs", "jobs.empty_jobs_ms", emptyMs});
+		results.push_back({"jobs", "jobs.dependency_chain_ms", chainMs});
+		results.push_back({"jobs", "jobs.main_thread_jobs_ms", mainMs});
+		results.push_back({"jobs", "jobs.serial_sum_ms", serialMs});
+		results.push_back({"jobs", "jobs.parallel_sum_ms", parallelMs});
+	}
+
+	// One random job graph: every job adds its dependencies' results to its own, some run on the main
+	// thread, some fan out a nested parallel-for, and outside threads submit and wait on jobs of their
+	// own meanwhile. The results are checked against a serial evaluation of the same graph. Meant to be
+	// run from a -DGPURENDERER_SANITIZE_THREAD=ON build, where ThreadSanitizer also checks that every
+	// dependency's result is visible to the jobs that read it.
+	bool RunJobStressRound(int round) {
+		namespace jobs = gpurenderer::jobs;
+		struct Node {
+			std::vector<size_t> dependencies;
+			bool mainThread = false;
+			bool nested = false;
+		};
+		SceneRandom random{kSceneSeed + static_cast<std::uint64_t>(round)};
+		std::vector<Node> nodes(kStressJobs);
+		std::vector<std::uint64_t> expected(kStressJobs);
+		constexpr size_t kNestedCount = 64;
+		constexpr std::uint64_t kNestedSum = kNestedCount * (kNestedCount - 1) / 2;
+		for (size_t i = 0; i < nodes.size(); ++i) {
+			Node& node = nodes[i];
+			const int dependencyCount = i == 0 ? 0 : static_cast<int>(random.Next() % (kStressMaxDependencies + 1));
+			for (int d = 0; d < dependencyCount; ++d) {
+				node.dependencies.push_back(static_cast<size_t>(random.Next() % i));
+			}
+			node.mainThread = random.Next() % 16 == 0;
+			node.nested = random.Next() % 8 == 0;
+			expected[i] = i + 1 + (node.nested ? kNestedSum : 0);
+			for (size_t dependency : node.dependencies) {
+				expected[i] += expected[dependency];
+			}
+		}
+
+		jobs::JobSystem jobSystem(1 + round % 4);
+		std::vector<std::uint64_t> computed(kStressJobs, 0);
+		std::vector<jobs::Job> submitted(kStressJobs);
+		std::atomic<size_t> outsideJobs{0};
+		std::vector<std::thread> submitters;
+		for (int t = 0; t < kStressSubmitters; ++t) {
+			submitters.emplace_back([&jobSystem, &outsideJobs] {
+				for (int batch = 0; batch < 10; ++batch) {
+					std::vector<jobs::Job> own;
+					for (int i = 0; i < 50; ++i) {
+						own.push_back(jobSystem.Submit([&outsideJobs] {
+							outsideJobs.fetch_add(1);
+						}, {own.empty() ? jobs::Job() : own.back()}));
+					}
+					jobSystem.Wait(own);
+				}
+			});
+		}
+		for (size_t i = 0; i < nodes.size(); ++i) {
+			const Node& node = nodes[i];
+			auto work = [&jobSystem, &nodes, &computed, i] {
+				std::uint64_t value = i + 1;
+				for (size_t dependency : nodes[i].dependencies) {
+					value += computed[dependency];
+				}
+				if (nodes[i].nested) {
+					std::atomic<std::uint64_t> nested{0};
+					jobSystem.ParallelFor(kNestedCount, 4, [&nested](size_t begin, size_t end) {
+						for (size_t k = begin; k < end; ++k) {
+							nested.fetch_add(k);
+						}
+					});
+					value += nested.load();
+				}
+				computed[i] = value;
+			};
+			std::vector<jobs::Job> dependencies;
+			for (size_t dependency : node.dependencies) {
+				dependencies.push_back(submitted[dependency]);
+			}
+			submitted[i] = node.mainThread ?
+				jobSystem.SubmitToMainThread(work, dependencies) :
+				jobSystem.Submit(work, dependencies);
+		}
+		jobSystem.Wait(submitted);
+		for (std::thread& submitter : submitters) {
+			submitter.join();
+		}
+
+		size_t mismatches = 0;
+		for (size_t i = 0; i < nodes.size(); ++i) {
+			mismatches += computed[i] != expected[i] ? 1u : 0u;
+		}
+		const size_t expectedOutside = static_cast<size_t>(kStressSubmitters) * 10u * 50u;
+		if (mismatches > 0 || outsideJobs.load() != expectedOutside) {
+			std::fprintf(stderr, "Job stress round %d: %zu wrong result(s), %zu of %zu outside jobs ran.\n",
+				round, mismatches, outsideJobs.load(), expectedOutside);
+			return false;
+		}
+		return true;
+	}
+
+	int RunJobStress(int rounds) {
+		int failures = 0;
+		for (int round = 0; round < rounds; ++round) {
+			failures += RunJobStressRound(round) ? 0 : 1;
+		}
+		std::printf("Job stress: %d of %d round(s) failed.\n", failures, rounds);
+		return failures > 0 ? 1 : 0;
+	}
+
+	std::string EscapeJson(const std::string& text) {
+		std::string escaped;
+		for (char c : text) {
+			if (c == '"' || c == '\\') {
+				escaped.push_back('\\');
+				escaped.push_back(c);
+			} else if (static_cast<unsigned char>(c) >= 0x20) {
+				escaped.push_back(c);
+			}
+		}
+		return escaped;
+	}
+
+	// One result per line so ReadResults (and diff tools) can work line by line.
+	bool WriteResults(const BenchConfig& config, const std::string& glRenderer, const std::vector<BenchResult>& results) {
+		FILE* file = std::fopen(config.outputPath.c_str(), "w");
+		if (!file) {
+			std::fprintf(stderr, "Failed to open %s for writing.\n", config.outputPath.c_str());
+			return false;
+		}
+		std::fprintf(file, "{\n  \"schema\": %d,\n  \"frames\": %d,\n  \"width\": %d,\n  \"height\": %d,\n  \"gl_renderer\": \"%s\",\n  \"results\": [\n",
+			kSchemaVersion, config.frames, config.width, config.height, EscapeJson(glRenderer).c_str());
+		for (size_t i = 0; i < results.size(); ++i) {
+			std::fprintf(file, "    {\"scene\": \"%s\", \"metric\": \"%s\", \"value\": %.6f}%s\n",
+				EscapeJson(results[i].scene).c_str(),
+				results[i].metric.c_str(),
+				results[i].value,
+				i + 1 < results.size() ? "," : "");
+		}
+		std::fprintf(file, "  ]\n}\n");
+		return std::fclose(file) == 0;
+	}
+
+	bool ExtractJsonString(const std::string& line, const char* key, std::string& value) {
+		const std::string pattern = std::string("\"") + key + "\": \"";
+		const size_t start = line.find(pattern);
+		if (start == std::string::npos) {
+			return false;
+		}
+		const size_t begin = start + pattern.size();
+		const size_t end = line.find('"', begin);
+		if (end == std::string::npos) {
+			return false;
+		}
+		value = line.substr(begin, end - begin);
+		return true;
+	}
+
+	// Reads files written by WriteResults; keyed by "scene/metric".
+	bool ReadResults(const std::string& path, std::map<std::string, double>& values) {
+		std::ifstream file(path);
+		if (!file) {
+			std::fprintf(stderr, "Failed to open %s.\n", path.c_str());
+			return false;
+		}
+		std::string line;
+		while (std::getline(file, line)) {
+			std::string scene;
+			std::string metric;
+			const size_t valuePos = line.find("\"value\": ");
+			if (!ExtractJsonString(line, "scene", scene) || !ExtractJsonString(line, "metric", metric) || valuePos == std::string::npos) {
+				continue;
+			}
+			values[scene + "/" + metric] = std::atof(line.c_str() + valuePos + 9);
+		}
+		if (values.empty()) {
+			std::fprintf(stderr, "No benchmark results found in %s.\n", path.c_str());
+			return false;
+		}
+		return true;
+	}
+
+	bool IsTimingMetric(const std::string& key) {
+		return key.size() > 3 && key.compare(key.size() - 3, 3, "_ms") == 0;
+	}
+
+	// Returns 0 when nothing regressed, 1 on a regression or changed scene, 2 on unreadable input.
+	int CompareResults(const BenchConfig& config) {
+		std::map<std::string, double> baseline;
+		std::map<std::string, double> current;
+		if (!ReadResults(config.baselinePath, baseline) || !ReadResults(config.currentPath, current)) {
+			return 2;
+		}
+
+		int regressions = 0;
+		int mismatches = 0;
+		std::printf("%-36s %12s %12s %9s\n", "metric", "baseline", "current", "change");
+		for (const auto& [key, base] : baseline) {
+			const auto it = current.find(key);
+			if (it == current.end()) {
+				std::printf("%-36s %12.3f %12s %9s  MISSING\n", key.c_str(), base, "-", "-");
+				++mismatches;
+				continue;
+			}
+			const double value = it->second;
+			const double percent = base > 0.0 ? (value - base) / base * 100.0 : 0.0;
+			const char* flag = "";
+			if (!IsTimingMetric(key)) {
+				if (value != base) {
+					flag = "  SCENE CHANGED";
+					++mismatches;
+				}
+			} else if (percent > config.thresholdPercent && value - base > kNoiseFloorMs) {
+				flag = "  REGRESSION";
+				++regressions;
+			} else if (percent < -config.thresholdPercent && base - value > kNoiseFloorMs) {
+				flag = "  improved";
+			}
+			std::printf("%-36s %12.3f %12.3f %+8.1f%%%s\n", key.c_str(), base, value, percent, flag);
+		}
+		for (const auto& [key, value] : current) {
+			if (baseline.find(key) == baseline.end()) {
+				std::printf("%-36s %12s %12.3f %9s  NEW\n", key.c_str(), "-", value, "-");
+			}
+		}
+		std::printf("%d regression(s) over %.1f%%, %d mismatched metric(s).\n", regressions, config.thresholdPercent, mismatches);
+		return (regressions > 0 || mismatches > 0) ? 1 : 0;
+	}
+
+	int RunBenchmarks(const BenchConfig& config) {
+		GLFWwindow* window = config.runGl ? CreateBenchWindow(config) : nullptr;
+		std::string glRenderer = "none";
+		if (window) {
+			const char* renderer = reinterpret_cast<const char*>(glGetString(GL_RENDERER));
+			glRenderer = renderer ? renderer : "unknown";
+			std::printf("GL renderer: %s\n", glRenderer.c_str());
+		} else if (config.runGl) {
+			std::fprintf(stderr, "No GL context available; timing the software paths only.\n");
+		}
+
+		std::vector<BenchResult> results;
+		bool ok = true;
+		if (config.runJobs) {
+			RunJobBench(results);
+		}
+		for (const SceneSpec& spec : config.scenes) {
+			std::filesystem::path objPath;
+			if (!GenerateScene(spec, config.workDir / spec.name, objPath)) {
+				ok = false;
+				continue;
+			}
+			ok = RunSoftwareBench(config, spec, objPath, results) && ok;
+			if (window) {
+				ok = RunGlBench(window, config, spec, objPath, results) && ok;
+			}
+		}
+
+		if (window) {
+			glfwDestroyWindow(window);
+			glfwTerminate();
+		}
+		if (!WriteResults(config, glRenderer, results)) {
+			return 2;
+		}
+		std::printf("Wrote %zu results to %s\n", results.size(), config.outputPath.c_str());
+		return ok ? 0 : 1;
+	}
+}
+
+int main(int argc, char** argv) {
+	const BenchConfig config = ParseArgs(argc, argv);
+	if (config.compare) {
+		return CompareResults(config);
+	}
+	if (config.jobStressRounds > 0) {
+		return RunJobStress(config.jobStressRounds);
+	}
+	return RunBenchmarks(config);
+}
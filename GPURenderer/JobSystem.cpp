@@ -0,0 +1,351 @@
+#include "JobSystem.h"
+
+#include <algorithm>
+#include <utility>
+
+namespace gpurenderer::jobs {
+	struct Task {
+		std::function<void()> work;
+		bool mainThread = false;
+		// Unfinished dependencies, plus one held by the submitter until every dependency is registered.
+		std::atomic<int> pending{1};
+		std::atomic<bool> done{false};
+		std::mutex mutex;
+		// Guarded by mutex, like continuations; done is its lock-free mirror for waiters.
+		bool finished = false;
+		std::vector<Job> continuations;
+	};
+
+	namespace {
+		thread_local const JobSystem* tOwner = nullptr;
+		thread_local int tWorker = -1;
+
+		bool IsDone(const Job& job) {
+			return !job || job->done.load();
+		}
+	}
+
+	JobSystem::JobSystem(int workerCount) : mMainThread(std::this_thread::get_id()) {
+		if (workerCount <= 0) {
+			const unsigned int hardware = std::thread::hardware_concurrency();
+			workerCount = std::max(1, static_cast<int>(hardware) - 1);
+		}
+		for (int i = 0; i < workerCount; ++i) {
+			mQueues.push_back(std::make_unique<WorkerQueue>());
+		}
+		for (int i = 0; i < workerCount; ++i) {
+			mWorkers.emplace_back(&JobSystem::WorkerLoop, this, i);
+		}
+	}
+
+	// Workers finish what is already queued before they exit. Jobs still waiting on a dependency and
+	// main thread jobs nobody ran are dropped.
+	JobSystem::~JobSystem() {
+		mStopping.store(true);
+		{
+			std::lock_guard<std::mutex> lock(mSleepMutex);
+		}
+		mSleep.notify_all();
+		for (std::thread& worker : mWorkers) {
+			worker.join();
+		}
+	}
+
+	Job JobSystem::Submit(std::function<void()> work, std::initializer_list<Job> dependencies) {
+		Job job = Create(std::move(work), false);
+		for (const Job& dependency : dependencies) {
+			Depend(job, dependency);
+		}
+		Release(job);
+		return job;
+	}
+
+	Job JobSystem::Submit(std::function<void()> work, const std::vector<Job>& dependencies) {
+		Job job = Create(std::move(work), false);
+		for (const Job& dependency : dependencies) {
+			Depend(job, dependency);
+		}
+		Release(job);
+		return job;
+	}
+
+	Job JobSystem::SubmitToMainThread(std::function<void()> work, std::initializer_list<Job> dependencies) {
+		Job job = Create(std::move(work), true);
+		for (const Job& dependency : dependencies) {
+			Depend(job, dependency);
+		}
+		Release(job);
+		return job;
+	}
+
+	Job JobSystem::SubmitToMainThread(std::function<void()> work, const std::vector<Job>& dependencies) {
+		Job job = Create(std::move(work), true);
+		for (const Job& dependency : dependencies) {
+			Depend(job, dependency);
+		}
+		Release(job);
+		return job;
+	}
+
+	// The context thread only runs main thread jobs here: stealing could pull a long load stage onto it
+	// in the middle of a frame. Workers and other threads help with whatever is queued.
+	void JobSystem::Wait(const Job& job) {
+		const bool mainThread = IsMainThread();
+		const int worker = tOwner == this ? tWorker : -1;
+		while (!IsDone(job)) {
+			Job next = mainThread ? PopMainThreadJob() : FindJob(worker);
+			if (next) {
+				Execute(next);
+				continue;
+			}
+			std::unique_lock<std::mutex> lock(mSleepMutex);
+			mSleepers.fetch_add(1);
+			mSleep.wait(lock, [&] {
+				return IsDone(job) || (mainThread ? mMainQueued.load() > 0 : mQueued.load() > 0);
+			});
+			mSleepers.fetch_sub(1);
+		}
+	}
+
+	void JobSystem::Wait(const std::vector<Job>& jobs) {
+		for (const Job& job : jobs) {
+			Wait(job);
+		}
+	}
+
+	size_t JobSystem::RunMainThreadJobs() {
+		if (!IsMainThread()) {
+			return 0;
+		}
+		size_t ran = 0;
+		while (Job job = PopMainThreadJob()) {
+			Execute(job);
+			++ran;
+		}
+		return ran;
+	}
+
+	void JobSystem::ParallelFor(size_t count, size_t grain, const std::function<void(size_t, size_t)>& body) {
+		grain = std::max<size_t>(grain, 1);
+		const size_t ranges = (count + grain - 1) / grain;
+		if (ranges <= 1) {
+			if (count > 0) {
+				body(0, count);
+			}
+			return;
+		}
+
+		// Helpers may start after the caller has returned, so they share this state rather than the
+		// caller's stack. A helper that finds no range left returns without touching body.
+		struct Shared {
+			const std::function<void(size_t, size_t)>* body = nullptr;
+			size_t count = 0;
+			size_t grain = 0;
+			size_t ranges = 0;
+			std::atomic<size_t> next{0};
+			std::atomic<size_t> finished{0};
+			std::mutex mutex;
+			std::condition_variable allFinished;
+		};
+		auto shared = std::make_shared<Shared>();
+		shared->body = &body;
+		shared->count = count;
+		shared->grain = grain;
+		shared->ranges = ranges;
+		auto run = [](Shared& state) {
+			for (size_t begin = state.next.fetch_add(state.grain); begin < state.count;
+				begin = state.next.fetch_add(state.grain)) {
+				(*state.body)(begin, std::min(begin + state.grain, state.count));
+				if (state.finished.fetch_add(1) + 1 == state.ranges) {
+					std::lock_guard<std::mutex> lock(state.mutex);
+					state.allFinished.notify_all();
+				}
+			}
+		};
+		const size_t helperCount = std::min(ranges - 1, mQueues.size());
+		for (size_t i = 0; i < helperCount; ++i) {
+			Submit([shared, run] {
+				run(*shared);
+			});
+		}
+
+		// Once the caller runs out of ranges, the rest are already running elsewhere; wait for those
+		// rather than for the helper jobs, which would mean running (or, on the context thread,
+		// sleeping behind) unrelated queued work.
+		run(*shared);
+		std::unique_lock<std::mutex> lock(shared->mutex);
+		shared->allFinished.wait(lock, [&] {
+			return shared->finished.load() == ranges;
+		});
+	}
+
+	bool JobSystem::IsMainThread() const {
+		return std::this_thread::get_id() == mMainThread;
+	}
+
+	int JobSystem::WorkerCount() const {
+		return static_cast<int>(mWorkers.size());
+	}
+
+	JobStats JobSystem::Stats() const {
+		JobStats stats;
+		stats.executed = mExecuted.load();
+		stats.stolen = mStolen.load();
+		stats.mainThread = mMainExecuted.load();
+		return stats;
+	}
+
+	Job JobSystem::Create(std::function<void()> work, bool mainThread) {
+		Job job = std::make_shared<Task>();
+		job->work = std::move(work);
+		job->mainThread = mainThread;
+		return job;
+	}
+
+	void JobSystem::Depend(const Job& job, const Job& dependency) {
+		if (!dependency) {
+			return;
+		}
+		std::lock_guard<std::mutex> lock(dependency->mutex);
+		if (dependency->finished) {
+			return;
+		}
+		job->pending.fetch_add(1);
+		dependency->continuations.push_back(job);
+	}
+
+	void JobSystem::Release(const Job& job) {
+		if (job->pending.fetch_sub(1) == 1) {
+			Enqueue(job);
+		}
+	}
+
+	void JobSystem::Enqueue(const Job& job) {
+		if (job->mainThread) {
+			{
+				std::lock_guard<std::mutex> lock(mMainMutex);
+				mMainJobs.push_back(job);
+				mMainQueued.fetch_add(1);
+			}
+		} else {
+			// Jobs spawned by a worker stay on its deque; the rest are dealt round robin.
+			const size_t index = tOwner == this && tWorker >= 0 ?
+				static_cast<size_t>(tWorker) :
+				mNextQueue.fetch_add(1) % mQueues.size();
+			WorkerQueue& queue = *mQueues[index];
+			{
+				std::lock_guard<std::mutex> lock(queue.mutex);
+				queue.jobs.push_back(job);
+				mQueued.fetch_add(1);
+			}
+		}
+		Wake();
+	}
+
+	Job JobSystem::PopMainThreadJob() {
+		if (mMainQueued.load() == 0) {
+			return nullptr;
+		}
+		std::lock_guard<std::mutex> lock(mMainMutex);
+		if (mMainJobs.empty()) {
+			return nullptr;
+		}
+		Job job = std::move(mMainJobs.front());
+		mMainJobs.pop_front();
+		mMainQueued.fetch_sub(1);
+		return job;
+	}
+
+	// Own deque from the back, then the others from the front. worker is -1 on threads outside the pool.
+	Job JobSystem::FindJob(int worker) {
+		if (mQueued.load() == 0) {
+			return nullptr;
+		}
+		if (worker >= 0) {
+			WorkerQueue& own = *mQueues[static_cast<size_t>(worker)];
+			std::lock_guard<std::mutex> lock(own.mutex);
+			if (!own.jobs.empty()) {
+				Job job = std::move(own.jobs.back());
+				own.jobs.pop_back();
+				mQueued.fetch_sub(1);
+				return job;
+			}
+		}
+		const size_t queueCount = mQueues.size();
+		const size_t start = worker >= 0 ? static_cast<size_t>(worker) + 1 : mNextQueue.load();
+		for (size_t i = 0; i < queueCount; ++i) {
+			const size_t victim = (start + i) % queueCount;
+			if (static_cast<int>(victim) == worker) {
+				continue;
+			}
+			WorkerQueue& queue = *mQueues[victim];
+			std::lock_guard<std::mutex> lock(queue.mutex);
+			if (!queue.jobs.empty()) {
+				Job job = std::move(queue.jobs.front());
+				queue.jobs.pop_front();
+				mQueued.fetch_sub(1);
+				mStolen.fetch_add(1, std::memory_order_relaxed);
+				return job;
+			}
+		}
+		return nullptr;
+	}
+
+	void JobSystem::Execute(const Job& job) {
+		std::function<void()> work = std::move(job->work);
+		job->work = nullptr;
+		if (work) {
+			work();
+		}
+		std::vector<Job> continuations;
+		{
+			std::lock_guard<std::mutex> lock(job->mutex);
+			job->finished = true;
+			continuations.swap(job->continuations);
+		}
+		job->done.store(true);
+		mExecuted.fetch_add(1, std::memory_order_relaxed);
+		if (job->mainThread) {
+			mMainExecuted.fetch_add(1, std::memory_order_relaxed);
+		}
+		for (const Job& continuation : continuations) {
+			Release(continuation);
+		}
+		Wake();
+	}
+
+	// A sleeper increments mSleepers and then tests its condition; a waker changes the state and then
+	// reads mSleepers. Both sides are sequentially consistent (the state is done and the queue counters,
+	// all seq_cst), and the fence keeps the read below from moving ahead of the waker's change, so at
+	// least one side sees the other: the sleeper finds the change or this finds the sleeper.
+	void JobSystem::Wake() {
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		if (mSleepers.load() == 0) {
+			return;
+		}
+		{
+			std::lock_guard<std::mutex> lock(mSleepMutex);
+		}
+		mSleep.notify_all();
+	}
+
+	void JobSystem::WorkerLoop(int worker) {
+		tOwner = this;
+		tWorker = worker;
+		for (;;) {
+			if (Job job = FindJob(worker)) {
+				Execute(job);
+				continue;
+			}
+			std::unique_lock<std::mutex> lock(mSleepMutex);
+			mSleepers.fetch_add(1);
+			mSleep.wait(lock, [&] {
+				return mQueued.load() > 0 || mStopping.load();
+			});
+			mSleepers.fetch_sub(1);
+			if (mStopping.load() && mQueued.load() == 0) {
+				return;
+			}
+		}
+	}
+}
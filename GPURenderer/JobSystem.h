@@ -0,0 +1,102 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <initializer_list>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// CPU job system: a fixed pool of workers, each with its own deque. A worker pushes the jobs it spawns
+// to the back of its deque and pops from the back, so nested work stays hot in its cache; idle workers
+// steal from the front of the others. Jobs may depend on earlier jobs and only become runnable once
+// those finish. Jobs that touch the GL context go to a separate queue that only the thread which
+// created the system (the context thread) drains, from RunMainThreadJobs or while it waits on a job.
+namespace gpurenderer::jobs {
+	struct Task;
+
+	// Handle to a submitted job. An empty handle counts as finished.
+	using Job = std::shared_ptr<Task>;
+
+	struct JobStats {
+		size_t executed = 0;
+		size_t stolen = 0;
+		size_t mainThread = 0;
+	};
+
+	class JobSystem {
+	public:
+		// workerCount <= 0 uses one worker per hardware thread besides the calling one.
+		explicit JobSystem(int workerCount = 0);
+		~JobSystem();
+
+		JobSystem(const JobSystem&) = delete;
+		JobSystem& operator=(const JobSystem&) = delete;
+
+		// Queues work to run on a worker once every job in dependencies has finished.
+		Job Submit(std::function<void()> work, std::initializer_list<Job> dependencies = {});
+		Job Submit(std::function<void()> work, const std::vector<Job>& dependencies);
+
+		// Same, but the job runs on the context thread.
+		Job SubmitToMainThread(std::function<void()> work, std::initializer_list<Job> dependencies = {});
+		Job SubmitToMainThread(std::function<void()> work, const std::vector<Job>& dependencies);
+
+		// Blocks until job has finished. Workers run other queued jobs meanwhile; the context thread only
+		// runs main thread jobs, so a wait there never picks up unrelated worker jobs.
+		void Wait(const Job& job);
+		void Wait(const std::vector<Job>& jobs);
+
+		// Runs the main thread jobs queued so far. Context thread only; returns how many ran.
+		size_t RunMainThreadJobs();
+
+		// Calls body(begin, end) over [0, count) in ranges of at most grain items, on the workers and
+		// the calling thread, and returns once every range is done. The caller only runs ranges of this
+		// loop, never other jobs. Safe to call from inside a job.
+		void ParallelFor(size_t count, size_t grain, const std::function<void(size_t, size_t)>& body);
+
+		bool IsMainThread() const;
+		int WorkerCount() const;
+		JobStats Stats() const;
+
+	private:
+		struct WorkerQueue {
+			std::mutex mutex;
+			std::deque<Job> jobs;
+		};
+
+		Job Create(std::function<void()> work, bool mainThread);
+		void Depend(const Job& job, const Job& dependency);
+		void Release(const Job& job);
+		void Enqueue(const Job& job);
+		Job PopMainThreadJob();
+		Job FindJob(int worker);
+		void Execute(const Job& job);
+		void Wake();
+		void WorkerLoop(int worker);
+
+		std::thread::id mMainThread;
+		std::vector<std::unique_ptr<WorkerQueue>> mQueues;
+		std::vector<std::thread> mWorkers;
+
+		std::mutex mMainMutex;
+		std::deque<Job> mMainJobs;
+		std::atomic<size_t> mMainQueued{0};
+
+		// Jobs sitting in worker deques.
+		std::atomic<size_t> mQueued{0};
+		std::atomic<size_t> mNextQueue{0};
+
+		std::mutex mSleepMutex;
+		std::condition_variable mSleep;
+		std::atomic<int> mSleepers{0};
+		std::atomic<bool> mStopping{false};
+
+		std::atomic<size_t> mExecuted{0};
+		std::atomic<size_t> mStolen{0};
+		std::atomic<size_t> mMainExecuted{0};
+	};
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <utility>
+
+// Unbounded multi-producer, single-consumer queue (Vyukov's intrusive list). Producers never lock or
+// wait: a push is one exchange on the head plus a store. The consumer owns the tail and keeps one
+// node whose value has already been taken. An item pushed while another producer is between its
+// exchange and its store stays invisible until that store lands, so TryPop may briefly miss it;
+// WaitPop then sleeps until the next push signals.
+namespace gpurenderer::jobs {
+	template <typename T>
+	class MpscQueue {
+	public:
+		MpscQueue() : mHead(new Node()), mTail(mHead.load()) {}
+
+		~MpscQueue() {
+			T discarded;
+			while (TryPop(discarded)) {
+			}
+			delete mTail;
+		}
+
+		MpscQueue(const MpscQueue&) = delete;
+		MpscQueue& operator=(const MpscQueue&) = delete;
+
+		// Any thread.
+		void Push(T value) {
+			Node* node = new Node();
+			node->value = std::move(value);
+			Node* previous = mHead.exchange(node, std::memory_order_acq_rel);
+			previous->next.store(node, std::memory_order_release);
+			mSignal.fetch_add(1, std::memory_order_release);
+			mSignal.notify_one();
+		}
+
+		// Consumer only.
+		bool TryPop(T& value) {
+			Node* tail = mTail;
+			Node* next = tail->next.load(std::memory_order_acquire);
+			if (next == nullptr) {
+				return false;
+			}
+			value = std::move(next->value);
+			mTail = next;
+			delete tail;
+			return true;
+		}
+
+		// Consumer only; blocks until an item arrives.
+		void WaitPop(T& value) {
+			for (;;) {
+				const std::uint32_t seen = mSignal.load(std::memory_order_acquire);
+				if (TryPop(value)) {
+					return;
+				}
+				mSignal.wait(seen, std::memory_order_acquire);
+			}
+		}
+
+	private:
+		struct Node {
+			std::atomic<Node*> next{nullptr};
+			T value{};
+		};
+
+		std::atomic<Node*> mHead;
+		Node* mTail;
+		std::atomic<std::uint32_t> mSignal{0};
+	};
+}
@@ -1,13 +1,22 @@
 #include <GLFW/glfw3.h>
 
+#include "AssetIndex.h"
+#include "AsyncTask.h"
+#include "EnvironmentFilter.h"
+#include "JobSystem.h"
+#include "MpscQueue.h"
 #include "RendererApp.h"
+#include "SoftwareRasterizer.h"
+#include "TextureCompression.h"
 
 #include <imgui.h>
 #include <backends/imgui_impl_glfw.h>
 #include <backends/imgui_impl_opengl2.h>
 #include <backends/imgui_impl_opengl3.h>
 
+#include <assimp/DefaultIOSystem.h>
 #include <assimp/Importer.hpp>
+#include <assimp/ProgressHandler.hpp>
 #include <assimp/material.h>
 #include <assimp/postprocess.h>
 #include <assimp/scene.h>
@@ -18,21 +27,37 @@
 
 #include <algorithm>
 #include <array>
+#include <atomic>
 #include <chrono>
 #include <cctype>
+#include <cfloat>
 #include <cmath>
+#include <condition_variable>
 #include <cstddef>
+#include <cstdint>
 #include <cstring>
 #include <cstdio>
 #include <cstdlib>
+#include <deque>
 #include <filesystem>
 #include <fstream>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <mutex>
 #include <sstream>
 #include <string>
 #include <system_error>
+#include <thread>
+#include <tuple>
 #include <unordered_map>
 #include <vector>
 
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
 
@@ -100,6 +125,9 @@
 #ifndef GL_LUMINANCE
 #define GL_LUMINANCE 0x1909
 #endif
+#ifndef GL_BGRA
+#define GL_BGRA 0x80E1
+#endif
 #ifndef GL_LUMINANCE_ALPHA
 #define GL_LUMINANCE_ALPHA 0x190A
 #endif
@@ -145,8 +173,121 @@
 #ifndef GL_POLYGON_OFFSET_FILL
 #define GL_POLYGON_OFFSET_FILL 0x8037
 #endif
+#ifndef GL_DYNAMIC_DRAW
+#define GL_DYNAMIC_DRAW 0x88E8
+#endif
+#ifndef GL_COPY_READ_BUFFER
+#define GL_COPY_READ_BUFFER 0x8F36
+#endif
+#ifndef GL_COPY_WRITE_BUFFER
+#define GL_COPY_WRITE_BUFFER 0x8F37
+#endif
+#ifndef GL_TEXTURE_WIDTH
+#define GL_TEXTURE_WIDTH 0x1000
+#endif
+#ifndef GL_TEXTURE_HEIGHT
+#define GL_TEXTURE_HEIGHT 0x1001
+#endif
+#ifndef GL_TEXTURE_INTERNAL_FORMAT
+#define GL_TEXTURE_INTERNAL_FORMAT 0x1003
+#endif
+#ifndef GL_PACK_ALIGNMENT
+#define GL_PACK_ALIGNMENT 0x0D05
+#endif
+#ifndef GL_SYNC_GPU_COMMANDS_COMPLETE
+#define GL_SYNC_GPU_COMMANDS_COMPLETE 0x9117
+#endif
+#ifndef GL_SYNC_FLUSH_COMMANDS_BIT
+#define GL_SYNC_FLUSH_COMMANDS_BIT 0x00000001
+#endif
+#ifndef GL_TIMEOUT_EXPIRED
+#define GL_TIMEOUT_EXPIRED 0x911B
+#endif
+#ifndef GL_WAIT_FAILED
+#define GL_WAIT_FAILED 0x911D
+#endif
+#ifndef GL_PROGRAM_BINARY_RETRIEVABLE_HINT
+#define GL_PROGRAM_BINARY_RETRIEVABLE_HINT 0x8257
+#endif
+#ifndef GL_PROGRAM_BINARY_LENGTH
+#define GL_PROGRAM_BINARY_LENGTH 0x8741
+#endif
+#ifndef GL_NUM_PROGRAM_BINARY_FORMATS
+#define GL_NUM_PROGRAM_BINARY_FORMATS 0x87FE
+#endif
+#ifndef GL_COMPLETION_STATUS_KHR
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+#endif
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+#endif
+#ifndef GL_COMPRESSED_RGBA_S3TC_DXT5_EXT
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+#endif
+#ifndef GL_COMPRESSED_RED_RGTC1
+#define GL_COMPRESSED_RED_RGTC1 0x8DBB
+#endif
+#ifndef GL_COMPRESSED_RG_RGTC2
+#define GL_COMPRESSED_RG_RGTC2 0x8DBD
+#endif
+#ifndef GL_COMPRESSED_RGBA_BPTC_UNORM
+#define GL_COMPRESSED_RGBA_BPTC_UNORM 0x8E8C
+#endif
+#ifndef GL_TEXTURE_SWIZZLE_RGBA
+#define GL_TEXTURE_SWIZZLE_RGBA 0x8E46
+#endif
+#ifndef GL_TEXTURE_BASE_LEVEL
+#define GL_TEXTURE_BASE_LEVEL 0x813C
+#endif
+#ifndef GL_TEXTURE_MAX_LEVEL
+#define GL_TEXTURE_MAX_LEVEL 0x813D
+#endif
+#ifndef GL_PIXEL_UNPACK_BUFFER
+#define GL_PIXEL_UNPACK_BUFFER 0x88EC
+#endif
+#ifndef GL_STREAM_DRAW
+#define GL_STREAM_DRAW 0x88E0
+#endif
+#ifndef GL_MAP_WRITE_BIT
+#define GL_MAP_WRITE_BIT 0x0002
+#endif
+#ifndef GL_MAP_INVALIDATE_BUFFER_BIT
+#define GL_MAP_INVALIDATE_BUFFER_BIT 0x0008
+#endif
+#ifndef GL_ALREADY_SIGNALED
+#define GL_ALREADY_SIGNALED 0x911A
+#endif
+#ifndef GL_CONDITION_SATISFIED
+#define GL_CONDITION_SATISFIED 0x911C
+#endif
+#ifndef GL_TEXTURE4
+#define GL_TEXTURE4 0x84C4
+#endif
+#ifndef GL_TEXTURE5
+#define GL_TEXTURE5 0x84C5
+#endif
+#ifndef GL_TEXTURE6
+#define GL_TEXTURE6 0x84C6
+#endif
+#ifndef GL_TEXTURE_2D_ARRAY
+#define GL_TEXTURE_2D_ARRAY 0x8C1A
+#endif
+#ifndef GL_MAX_ARRAY_TEXTURE_LAYERS
+#define GL_MAX_ARRAY_TEXTURE_LAYERS 0x88FF
+#endif
+#ifndef GL_TEXTURE_COMPRESSED_IMAGE_SIZE
+#define GL_TEXTURE_COMPRESSED_IMAGE_SIZE 0x86A0
+#endif
+#ifndef GL_TEXTURE_COMPRESSED
+#define GL_TEXTURE_COMPRESSED 0x86A1
+#endif
 
 namespace {
+	namespace software = gpurenderer::software;
+	namespace compression = gpurenderer::compression;
+	namespace environment = gpurenderer::environment;
+	namespace jobs = gpurenderer::jobs;
+
 	constexpr float kRotationSpeedDegPerPixel = 0.5f;
 	constexpr float kLightRotationSpeedDegPerPixel = 0.6f;
 	constexpr float kZoomSpeed = 1.0f;
@@ -181,6 +322,61 @@ namespace {
 	constexpr float kSpotLightInnerDeg = 18.0f;
 	constexpr float kSpotLightOuterDeg = 28.0f;
 	constexpr size_t kMaxObjPathLength = 1024;
+	constexpr size_t kMaxModelFilterLength = 256;
+	// Unreferenced textures stay cached for reuse until the resident total passes this.
+	constexpr int kDefaultTextureBudgetMb = 1024;
+	constexpr int kMaxTextureBudgetMb = 16384;
+	// Streamed texture uploads: ring of pixel unpack buffers and the bytes started per frame.
+	constexpr size_t kUploadRingSlots = 4;
+	constexpr int kDefaultUploadBudgetMb = 8;
+	constexpr int kMaxUploadBudgetMb = 256;
+	// Streamed cubemap faces sample a mip level at most this large until level 0 has arrived.
+	constexpr int kPlaceholderMaxSize = 8;
+	// Progressive textures upload every level up to this size at load; finer ones stream on demand.
+	constexpr int kPreviewTextureSize = 128;
+	constexpr unsigned int kMaxStreamerWorkers = 3;
+	// GL's initial GL_TEXTURE_MAX_LEVEL, restored on streamed textures that get a mip chain.
+	constexpr GLint kDefaultMaxTextureLevel = 1000;
+	constexpr GLuint kInstanceModelLocation = 3;
+	constexpr GLuint kInstanceNormalLocation = 7;
+	// Per-vertex model-local material index, read by the material-table shader variant.
+	constexpr GLuint kMaterialSlotLocation = 10;
+	// Materials one table draw can address. Each takes three vec4 rows, which with the matrices still
+	// fits the 128 vertex uniform vectors GL 2.0 guarantees.
+	constexpr int kMaterialTableSize = 32;
+	constexpr int kMaxGridInstancesPerAxis = 32;
+	// Job sizes: vertices converted per mesh build job, and the instance count from which frustum
+	// culling tests instances on the job system rather than inline.
+	constexpr size_t kMeshBuildGrain = 1u << 15;
+	constexpr size_t kParallelCullMinInstances = 4096;
+	constexpr size_t kCullGrain = 1024;
+	constexpr size_t kArenaMinVertices = 1u << 16;
+	constexpr size_t kArenaMinIndices = 1u << 18;
+	constexpr size_t kIndexUploadChunk = 1u << 16;
+	constexpr double kSoftwareComparePixelThreshold = 8.0;
+	constexpr const char* kGpuCaptureFile = "gpu_capture.ppm";
+	constexpr const char* kSoftwareReferenceFile = "software_reference.ppm";
+	constexpr int kMaxFramesInFlight = gpurenderer::config::kMaxFramesInFlight;
+	constexpr std::uint64_t kFenceWaitTimeoutNs = 100000000u;
+	// Frame-time histogram: 1 ms buckets, the last one collecting everything slower.
+	constexpr int kFrameHistogramBuckets = 40;
+	constexpr float kFrameHistogramBucketMs = 1.0f;
+	constexpr size_t kFrameTimeHistory = 240;
+	// Frames still drawn after the last change so ImGui hover and focus state can settle.
+	constexpr int kRedrawSettleFrames = 3;
+	// Modification-time polling period for shader hot reload where inotify is unavailable.
+	constexpr std::chrono::milliseconds kShaderPollInterval(500);
+	// Bump when LinkProgram's attribute bindings or the cache file layout change.
+	constexpr std::uint32_t kProgramCacheVersion = 1;
+	constexpr char kProgramCacheMagic[4] = {'G', 'P', 'R', 'B'};
+	// Bump when the compressed texture cache layout or the block encoders change.
+	constexpr std::uint32_t kTextureCacheVersion = 1;
+	constexpr char kTextureCacheMagic[4] = {'G', 'P', 'B', 'C'};
+	// Bump when the prefiltered environment cache layout or the filter itself changes.
+	constexpr std::uint32_t kEnvironmentCacheVersion = 1;
+	constexpr char kEnvironmentCacheMagic[4] = {'G', 'P', 'E', 'N'};
+	// Share of the irradiance cube added to lit surfaces as diffuse environment light.
+	constexpr float kEnvDiffuseStrength = 0.25f;
 	const std::array<const char*, 6> kCubemapFaceFiles{
 		"cubemap_posx.png",
 		"cubemap_negx.png",
@@ -231,11 +427,8 @@ namespace {
 		}
 	};
 
-	struct Vertex {
-		glm::vec3 position;
-		glm::vec3 normal;
-		glm::vec2 texcoord;
-	};
+	// Shared with the software rasterizer so CPU mesh copies feed it without conversion.
+	using Vertex = software::Vertex;
 
 	struct Material {
 		std::string name;
@@ -255,6 +448,32 @@ namespace {
 		int materialIndex = 0;
 	};
 
+	// One placed copy of the loaded model. The transform is applied about the model's bounds center.
+	struct SceneInstance {
+		glm::vec3 translation{0.0f};
+		glm::vec3 rotationDeg{0.0f};
+		glm::vec3 scale{1.0f};
+		int materialOverride = -1;
+		bool visible = true;
+	};
+
+	// Per-instance vertex attributes: locations 3-6 hold the model columns, 7-9 the normal matrix.
+	struct InstanceAttributes {
+		glm::mat4 model{1.0f};
+		glm::mat3 normal{1.0f};
+	};
+
+	// A contiguous range of the instance buffer that shares a material override.
+	struct InstanceRun {
+		int first = 0;
+		int count = 0;
+		int materialOverride = -1;
+	};
+
+	struct FrustumPlanes {
+		std::array<glm::vec4, 6> planes{};
+	};
+
 	struct OrbitCamera {
 		float yawDeg = 0.0f;
 		float pitchDeg = 0.0f;
@@ -278,18 +497,401 @@ namespace {
 		int height = 0;
 	};
 
-	struct GLMeshBuffers {
+	enum class LightMarkerShape {
+		Point = 0,
+		Cube = 1,
+		Sphere = 2,
+		LightObject = 3
+	};
+
+	// What happens to the CPU-side vertex/index copies once they have been uploaded to the GPU.
+	enum class MeshRetentionPolicy {
+		Keep = 0,
+		Drop = 1,
+		KeepCompressed = 2
+	};
+
+	// Lossless byte streams: vertex floats are XOR-delta coded against the previous vertex and
+	// indices are zigzag-delta coded, both stored as LEB128 varints.
+	struct CompressedMesh {
+		std::vector<std::uint8_t> vertexStream;
+		std::vector<std::uint8_t> indexStream;
+		size_t vertexCount = 0;
+		size_t indexCount = 0;
+
+		bool Empty() const {
+			return vertexCount == 0 && indexCount == 0;
+		}
+
+		size_t ByteSize() const {
+			return vertexStream.size() + indexStream.size();
+		}
+	};
+
+	// A contiguous element range inside one of the shared geometry buffers.
+	struct ArenaRange {
+		size_t offset = 0;
+		size_t count = 0;
+	};
+
+	// First-fit free-list suballocator over a linear element range; freed ranges are coalesced.
+	struct RangeAllocator {
+		std::vector<ArenaRange> freeRanges;
+		size_t capacity = 0;
+		size_t used = 0;
+
+		void Reset(size_t newCapacity) {
+			freeRanges.clear();
+			capacity = newCapacity;
+			used = 0;
+			if (newCapacity > 0) {
+				freeRanges.push_back(ArenaRange{0, newCapacity});
+			}
+		}
+
+		void Grow(size_t newCapacity) {
+			if (newCapacity <= capacity) {
+				return;
+			}
+			if (!freeRanges.empty() && freeRanges.back().offset + freeRanges.back().count == capacity) {
+				freeRanges.back().count += newCapacity - capacity;
+			} else {
+				freeRanges.push_back(ArenaRange{capacity, newCapacity - capacity});
+			}
+			capacity = newCapacity;
+		}
+
+		bool Allocate(size_t count, ArenaRange& range) {
+			if (count == 0) {
+				range = ArenaRange{};
+				return true;
+			}
+			for (auto it = freeRanges.begin(); it != freeRanges.end(); ++it) {
+				if (it->count < count) {
+					continue;
+				}
+				range = ArenaRange{it->offset, count};
+				it->offset += count;
+				it->count -= count;
+				if (it->count == 0) {
+					freeRanges.erase(it);
+				}
+				used += count;
+				return true;
+			}
+			return false;
+		}
+
+		void Free(const ArenaRange& range) {
+			if (range.count == 0) {
+				return;
+			}
+			auto it = std::lower_bound(freeRanges.begin(), freeRanges.end(), range.offset, [](const ArenaRange& entry, size_t offset) {
+				return entry.offset < offset;
+				});
+			it = freeRanges.insert(it, range);
+			used -= range.count;
+			auto next = it + 1;
+			if (next != freeRanges.end() && it->offset + it->count == next->offset) {
+				it->count += next->count;
+				freeRanges.erase(next);
+			}
+			if (it != freeRanges.begin()) {
+				auto prev = it - 1;
+				if (prev->offset + prev->count == it->offset) {
+					prev->count += it->count;
+					freeRanges.erase(it);
+				}
+			}
+		}
+
+		size_t LargestFreeRange() const {
+			size_t largest = 0;
+			for (const ArenaRange& range : freeRanges) {
+				largest = std::max(largest, range.count);
+			}
+			return largest;
+		}
+	};
+
+	// Shared vertex/index buffers that every mesh (models, plane, skybox, light markers) suballocates from,
+	// so switching meshes inside a pass is only a different index offset.
+	struct GeometryArena {
 		GLuint vao = 0;
 		GLuint vbo = 0;
 		GLuint ebo = 0;
+		// One float per vertex of vbo: the model-local material index. Only allocated when material
+		// batching is supported.
+		GLuint materialVbo = 0;
+		RangeAllocator vertices;
+		RangeAllocator indices;
+	};
+
+	struct ArenaMesh {
+		ArenaRange vertexRange;
+		ArenaRange indexRange;
+
+		int IndexCount() const {
+			return static_cast<int>(indexRange.count);
+		}
+
+		const void* IndexOffset() const {
+			return reinterpret_cast<const void*>(indexRange.offset * sizeof(unsigned int));
+		}
+	};
+
+	// CPU copy of a small arena mesh (plane, skybox, light markers) for the software renderer.
+	struct CpuMesh {
+		std::vector<Vertex> vertices;
+		std::vector<unsigned int> indices;
+	};
+
+	// One loaded model file. Geometry lives in the shared arena and materials in the shared pool at
+	// gMaterials[materialBase, materialBase + materialCount); the CPU copies follow the retention policy.
+	struct SceneModel {
+		std::string path;
+		std::vector<Vertex> vertices;
+		std::vector<unsigned int> indices;
+		CompressedMesh compressedMesh;
+		size_t vertexCount = 0;
+		size_t indexCount = 0;
+		std::vector<Submesh> submeshes;
+		int materialBase = 0;
+		int materialCount = 0;
+		Bounds bounds;
+		ArenaRange vertexRange;
+		ArenaRange indexRange;
+		glm::vec3 translation{0.0f};
+		glm::vec3 rotationDeg{0.0f};
+		glm::vec3 scale{1.0f};
+		bool visible = true;
+		std::vector<SceneInstance> instances = std::vector<SceneInstance>(1);
+		// Set once the arena's material stream holds this model's per-vertex material indices.
+		bool materialSlots = false;
+		// Generation of the async load that added the model, which may still be adding its textures;
+		// 0 for models loaded synchronously.
+		std::uint64_t loadGeneration = 0;
+	};
+
+	// One submesh of one model, flattened so every pass walks a single contiguous array.
+	// indexOffset addresses the arena's element buffer and materialIndex the shared material pool.
+	struct DrawRecord {
+		int modelIndex = 0;
+		int materialIndex = 0;
+		int indexOffset = 0;
 		int indexCount = 0;
+		// Set on records drawn through the material table, which may cover several submeshes: the
+		// texture arrays to bind (-1 for none) and the range of gDrawRecordParts holding the submesh
+		// records merged into this one.
+		int diffuseArray = -1;
+		int specularArray = -1;
+		ArenaRange parts{};
+
+		bool UsesTable() const {
+			return parts.count > 0;
+		}
 	};
 
-	enum class LightMarkerShape {
-		Point = 0,
-		Cube = 1,
-		Sphere = 2,
-		LightObject = 3
+	// Instance runs that survived culling in one pass, grouped by model via modelRunSpans.
+	struct PassInstanceRuns {
+		std::vector<InstanceRun> runs;
+		std::vector<ArenaRange> modelRunSpans;
+		int visibleCount = 0;
+	};
+
+	// Everything a frame needs that can be worked out without GL: matrices and each pass's culled
+	// instance runs. Built before the frame waits for an in-flight slot.
+	struct FramePlan {
+		glm::mat4 model{1.0f};
+		glm::mat4 view{1.0f};
+		glm::mat4 projection{1.0f};
+		glm::mat4 reflectionView{1.0f};
+		glm::mat4 reflectionViewProj{1.0f};
+		bool drawReflection = false;
+		PassInstanceRuns shadowRuns;
+		PassInstanceRuns reflectionRuns;
+		PassInstanceRuns mainRuns;
+	};
+
+	using GlSyncHandle = void*;
+
+	// Bounds how far the CPU runs ahead of the GPU and paces presentation. Frame N waits on the fence of
+	// frame N - framesInFlight before submitting, so building frame N's GUI and draw lists overlaps the
+	// GPU work of the frames still in flight. Instance data is written into per-slot buffers for the same
+	// reason: a slot is only rewritten once its previous frame's fence has passed.
+	struct FrameScheduler {
+		gpurenderer::FramePacing pacing = gpurenderer::FramePacing::VSync;
+		float targetFps = static_cast<float>(gpurenderer::config::kDefaultTargetFps);
+		int framesInFlight = gpurenderer::config::kDefaultFramesInFlight;
+		std::array<GlSyncHandle, kMaxFramesInFlight> fences{};
+		size_t submittedFrames = 0;
+		int appliedSwapInterval = -1;
+		std::chrono::steady_clock::time_point lastPresent{};
+		std::chrono::steady_clock::time_point nextDeadline{};
+		float cpuBuildMs = 0.0f;
+		float fenceWaitMs = 0.0f;
+		float submitMs = 0.0f;
+		size_t fenceTimeouts = 0;
+		std::array<float, kFrameHistogramBuckets> histogram{};
+		std::array<float, kFrameTimeHistory> history{};
+		size_t historyCount = 0;
+
+		size_t CurrentSlot() const {
+			return submittedFrames % kMaxFramesInFlight;
+		}
+
+		void RecordFrameTime(float milliseconds) {
+			const int bucket = std::min(static_cast<int>(milliseconds / kFrameHistogramBucketMs), kFrameHistogramBuckets - 1);
+			histogram[static_cast<size_t>(std::max(bucket, 0))] += 1.0f;
+			history[historyCount % kFrameTimeHistory] = milliseconds;
+			++historyCount;
+		}
+
+		void ResetStatistics() {
+			histogram.fill(0.0f);
+			historyCount = 0;
+			fenceTimeouts = 0;
+			lastPresent = {};
+		}
+
+		// Percentile (0-1) of the recent frame times.
+		float RecentPercentile(float fraction) const {
+			const size_t count = std::min(historyCount, kFrameTimeHistory);
+			if (count == 0) {
+				return 0.0f;
+			}
+			std::vector<float> sorted(history.begin(), history.begin() + static_cast<std::ptrdiff_t>(count));
+			const size_t rank = std::min(count - 1, static_cast<size_t>(fraction * static_cast<float>(count - 1) + 0.5f));
+			std::nth_element(sorted.begin(), sorted.begin() + static_cast<std::ptrdiff_t>(rank), sorted.end());
+			return sorted[rank];
+		}
+	};
+
+	struct MipLevel {
+		int width = 0;
+		int height = 0;
+		std::shared_ptr<const unsigned char> pixels;
+	};
+
+	// CPU copy of a progressive texture's mip chain. Level 0 is the decoded image; a streamer worker
+	// box-filters the others and then sets ready.
+	struct MipChain {
+		std::vector<MipLevel> levels;
+		std::atomic<bool> ready{false};
+	};
+
+	// Texels of one texture image (a mip level of a 2D texture, or a cubemap face) waiting for the
+	// upload ring. The pixels are shared with the ring slot copying a band of them.
+	struct PendingUpload {
+		GLuint texture = 0;
+		std::uint64_t serial = 0;
+		GLenum target = GL_TEXTURE_2D;
+		GLint level = 0;
+		GLenum sourceFormat = GL_RGBA;
+		int width = 0;
+		int height = 0;
+		size_t rowBytes = 0;
+		int nextRow = 0;
+		std::shared_ptr<const unsigned char> pixels;
+	};
+
+	struct StreamedTexture {
+		GLenum bindTarget = GL_TEXTURE_2D;
+		// Tells a recycled texture name apart from the texture a band was queued for.
+		std::uint64_t serial = 0;
+		// Images whose last band has not been issued yet.
+		int pendingImages = 0;
+		bool generateMipmaps = false;
+		// Highest level kept once streaming ends without generating mipmaps, e.g. a prefiltered chain
+		// whose smaller levels were uploaded up front.
+		int maxLevel = 0;
+		// Progressive 2D textures only. Levels [residentLevel, levelCount) are on the GPU and
+		// GL_TEXTURE_BASE_LEVEL clamps sampling to them; residency moves toward targetLevel, one level
+		// at a time when refining, and never goes coarser than previewLevel.
+		std::shared_ptr<MipChain> chain;
+		bool chainApplied = false;
+		GLenum format = GL_RGBA;
+		GLenum sourceFormat = GL_RGBA;
+		int channels = 4;
+		int width = 0;
+		int height = 0;
+		int levelCount = 1;
+		int previewLevel = 0;
+		int residentLevel = 0;
+		int targetLevel = 0;
+		// Level being streamed in, or -1.
+		int uploadingLevel = -1;
+		// Screen pixels covered by submeshes using the texture in the last planned frame.
+		float coverage = 0.0f;
+	};
+
+	// One pixel unpack buffer of the upload ring. A band of rows moves Free -> Copying (buffer mapped,
+	// a worker fills it) -> InFlight (glTexSubImage2D sourced from it, fence pending) -> Free.
+	struct UploadSlot {
+		enum class State {
+			Free,
+			Copying,
+			InFlight
+		};
+		State state = State::Free;
+		GLuint buffer = 0;
+		size_t capacity = 0;
+		std::atomic<bool> copied{false};
+		GlSyncHandle fence = nullptr;
+		std::chrono::steady_clock::time_point issued{};
+		GLuint texture = 0;
+		std::uint64_t serial = 0;
+		GLenum target = GL_TEXTURE_2D;
+		GLint level = 0;
+		GLenum sourceFormat = GL_RGBA;
+		int width = 0;
+		int firstRow = 0;
+		int rows = 0;
+		size_t bytes = 0;
+		bool lastBand = false;
+		std::shared_ptr<const unsigned char> pixels;
+	};
+
+	// Streams texture uploads through a ring of pixel unpack buffers instead of blocking a load on
+	// glTexImage2D. Large 2D textures are progressive: a preview mip chain is uploaded at once and the
+	// finer levels are streamed in as screen coverage asks for them (UpdateTextureResidency); cubemap
+	// faces show a tiny placeholder level until level 0 arrives. Each frame workers copy up to
+	// budgetMb of rows into mapped buffers, the next frame sources glTexSubImage2D from them, and a
+	// fence per slot says when the buffer may be reused. The fences double as the stall measurement:
+	// a frame that finds its next slot still in flight counts as a ring stall.
+	struct TextureStreamer {
+		bool supported = false;
+		bool enabled = true;
+		int budgetMb = kDefaultUploadBudgetMb;
+		std::deque<PendingUpload> queue;
+		std::unordered_map<GLuint, StreamedTexture> textures;
+		std::array<UploadSlot, kUploadRingSlots> slots;
+		size_t nextSlot = 0;
+		std::uint64_t nextSerial = 1;
+		// Set by UpdateTextureResidency while some texture is below the level it should reach.
+		bool refinementPending = false;
+
+		// Band copies and mip chain builds.
+		std::vector<std::thread> workers;
+		std::mutex mutex;
+		std::condition_variable wake;
+		std::deque<std::function<void()>> tasks;
+		bool stopping = false;
+		std::atomic<bool> abandonChains{false};
+
+		size_t uploadedBytes = 0;
+		size_t completedTextures = 0;
+		size_t fenceStalls = 0;
+		size_t copyStalls = 0;
+		size_t fenceSamples = 0;
+		double fenceLatencyMs = 0.0;
+		double maxFenceLatencyMs = 0.0;
+		// Longest glTexSubImage2D call; stays near zero while uploads really are asynchronous.
+		double maxIssueMs = 0.0;
+		size_t progressiveTextures = 0;
+		size_t progressiveBytes = 0;
+		size_t levelsRefined = 0;
+		size_t levelsTrimmed = 0;
 	};
 
 	const char* kFallbackVertexShader = R"(#version 120
@@ -297,6 +899,8 @@ namespace {
 attribute vec3 aPosition;
 attribute vec3 aNormal;
 attribute vec2 aTexCoord;
+attribute mat4 aInstanceModel;
+attribute mat3 aInstanceNormal;
 
 uniform mat4 uMvp;
 uniform mat4 uModel;
@@ -308,17 +912,28 @@ varying vec3 vPositionView;
 varying vec2 vTexCoord;
 
 void main() {
-	vec4 worldPos = uModel * vec4(aPosition, 1.0);
+	vec4 localPos = aInstanceModel * vec4(aPosition, 1.0);
+	vec4 worldPos = uModel * localPos;
 	vec4 viewPos = uView * worldPos;
 	vPositionView = viewPos.xyz;
-	vNormal = normalize(uNormalMatrix * aNormal);
+	vNormal = normalize(uNormalMatrix * (aInstanceNormal * aNormal));
 	vTexCoord = aTexCoord;
-	gl_Position = uMvp * vec4(aPosition, 1.0);
+	gl_Position = uMvp * localPos;
 }
 )";
 
 const char* kFallbackFragmentShader = R"(#version 120
 
+#ifndef SHADE_MODE
+#define SHADE_MODE 0
+#endif
+#ifndef HAS_DIFFUSE_MAP
+#define HAS_DIFFUSE_MAP 1
+#endif
+#ifndef HAS_SPECULAR_MAP
+#define HAS_SPECULAR_MAP 1
+#endif
+
 varying vec3 vNormal;
 varying vec3 vPositionView;
 varying vec2 vTexCoord;
@@ -328,30 +943,18 @@ uniform vec3 uLightColor;
 uniform vec3 uAmbientColor;
 uniform vec3 uDiffuseColor;
 uniform vec3 uSpecularColor;
-uniform vec3 uMarkerColor;
 uniform float uShininess;
-uniform int uShadeMode;
 uniform sampler2D uDiffuseMap;
 uniform sampler2D uSpecularMap;
-uniform int uUseDiffuseMap;
-uniform int uUseSpecularMap;
 uniform vec3 uPlaneColorBias;
 
 void main() {
-	if (uShadeMode == 1) {
-		gl_FragColor = vec4(clamp(vNormal, 0.0, 1.0), 1.0);
-		return;
-	}
-	if (uShadeMode == 2) {
-		gl_FragColor = vec4(uMarkerColor, 1.0);
-		return;
-	}
-	if (uShadeMode == 3) {
-		vec3 planeColor = texture2D(uDiffuseMap, vTexCoord).rgb + uPlaneColorBias;
-		gl_FragColor = vec4(clamp(planeColor, 0.0, 1.0), 1.0);
-		return;
-	}
-
+#if SHADE_MODE == 1
+	gl_FragColor = vec4(clamp(vNormal, 0.0, 1.0), 1.0);
+#elif SHADE_MODE == 2
+	vec3 planeColor = texture2D(uDiffuseMap, vTexCoord).rgb + uPlaneColorBias;
+	gl_FragColor = vec4(clamp(planeColor, 0.0, 1.0), 1.0);
+#else
 	vec3 n = normalize(vNormal);
 	vec3 lightDir = normalize(uLightPosView - vPositionView);
 	float cosTheta = dot(n, lightDir);
@@ -363,32 +966,37 @@ void main() {
 		spec = pow(max(dot(n, halfDir), 0.0), uShininess);
 	}
 
-	vec3 diffuseTex = (uUseDiffuseMap == 1)
-		? texture2D(uDiffuseMap, vTexCoord).rgb
-		: vec3(1.0);
-	vec3 specularTex = (uUseSpecularMap == 1)
-		? texture2D(uSpecularMap, vTexCoord).rgb
-		: vec3(1.0);
-
-	vec3 diffuseColor = (uUseDiffuseMap == 1) ? diffuseTex : uDiffuseColor;
-	vec3 specularColor = uSpecularColor * specularTex;
+#if HAS_DIFFUSE_MAP
+	vec3 diffuseTex = texture2D(uDiffuseMap, vTexCoord).rgb;
+	vec3 diffuseColor = diffuseTex;
+	vec3 ambientColor = diffuseTex * uAmbientColor;
+#else
+	vec3 diffuseColor = uDiffuseColor;
+	vec3 ambientColor = uAmbientColor;
+#endif
+#if HAS_SPECULAR_MAP
+	vec3 specularColor = uSpecularColor * texture2D(uSpecularMap, vTexCoord).rgb;
+#else
+	vec3 specularColor = uSpecularColor;
+#endif
 
-	vec3 ambientColor = (uUseDiffuseMap == 1) ? (diffuseTex * uAmbientColor) : uAmbientColor;
 	vec3 ambient = ambientColor * uLightColor;
 	vec3 diffuse = diffuseColor * diff * uLightColor;
 	vec3 specular = specularColor * spec * uLightColor;
 
 	gl_FragColor = vec4(ambient + diffuse + specular, 1.0);
+#endif
 }
 )";
 
 	const char* kDepthVertexShader = R"(#version 120
 
 attribute vec3 aPosition;
+attribute mat4 aInstanceModel;
 uniform mat4 uDepthMvp;
 
 void main() {
-	gl_Position = uDepthMvp * vec4(aPosition, 1.0);
+	gl_Position = uDepthMvp * (aInstanceModel * vec4(aPosition, 1.0));
 }
 )";
 
@@ -396,6 +1004,50 @@ void main() {
 
 void main() {
 }
+)";
+
+	// Skybox: positions are cube directions and the clip position is pinned to the far plane (z = w),
+	// so with GL_LEQUAL every pixel already covered by geometry fails the early depth test.
+	const char* kSkyboxVertexShader = R"(#version 120
+
+attribute vec3 aPosition;
+uniform mat4 uSkyboxMvp;
+varying vec3 vDirection;
+
+void main() {
+	vDirection = aPosition;
+	gl_Position = (uSkyboxMvp * vec4(aPosition, 1.0)).xyww;
+}
+)";
+
+	const char* kSkyboxFragmentShader = R"(#version 120
+
+uniform samplerCube uEnvMap;
+varying vec3 vDirection;
+
+void main() {
+	gl_FragColor = vec4(textureCube(uEnvMap, normalize(vDirection)).rgb, 1.0);
+}
+)";
+
+	// Flat-colored light markers.
+	const char* kUnlitVertexShader = R"(#version 120
+
+attribute vec3 aPosition;
+uniform mat4 uUnlitMvp;
+
+void main() {
+	gl_Position = uUnlitMvp * vec4(aPosition, 1.0);
+}
+)";
+
+	const char* kUnlitFragmentShader = R"(#version 120
+
+uniform vec3 uUnlitColor;
+
+void main() {
+	gl_FragColor = vec4(uUnlitColor, 1.0);
+}
 )";
 
 	int gWindowWidth = gpurenderer::config::kDefaultWindowWidth;
@@ -426,12 +1078,38 @@ void main() {
 	std::filesystem::path gAssetRoot;
 	std::string gEnvironmentLoadStatus;
 
-	std::vector<Vertex> gVertices;
-	std::vector<unsigned int> gIndices;
-	std::vector<Submesh> gSubmeshes;
+	std::vector<SceneModel> gSceneModels;
+	int gSelectedModelIndex = 0;
+	GeometryArena gGeometryArena;
+	std::vector<DrawRecord> gDrawRecords;
+	std::vector<DrawRecord> gDrawRecordParts;
+	bool gDrawRecordsDirty = true;
+	// Full-size copies are opt-in; by default only the compact copy outlives the upload.
+	int gMeshRetentionPolicy = static_cast<int>(MeshRetentionPolicy::KeepCompressed);
 	std::vector<Material> gMaterials;
-	std::unordered_map<std::string, GLuint> gTextureCache;
-	int gIndexCount = 0;
+	struct TextureCacheEntry {
+		GLuint texture = 0;
+		// Estimated GPU (or software) footprint including the mip chain.
+		size_t bytes = 0;
+		// Materials in gMaterials using the texture; only entries at zero may be evicted.
+		int references = 0;
+		std::uint64_t lastUse = 0;
+	};
+
+	// Textures shared by key: the resolved file path, or the scene-qualified index of an embedded
+	// texture. Unreferenced entries are kept for reuse and evicted least recently used first once
+	// residentBytes exceeds the budget.
+	struct TextureCache {
+		std::unordered_map<std::string, TextureCacheEntry> entries;
+		std::unordered_map<GLuint, std::string> keys;
+		size_t residentBytes = 0;
+		int budgetMb = kDefaultTextureBudgetMb;
+		std::uint64_t useClock = 0;
+		size_t hits = 0;
+		size_t misses = 0;
+		size_t evictions = 0;
+	};
+	TextureCache gTextureCache;
 	Bounds gBounds;
 	glm::vec3 gCenter(0.0f);
 
@@ -459,36 +1137,181 @@ void main() {
 	float gPlaneRttReflectionBrightness = kPlaneRttReflectionBrightness;
 	int gSelectedMaterialIndex = 0;
 	char gObjPathInput[kMaxObjPathLength]{};
-	std::vector<std::string> gAvailableObjFiles;
-	int gSelectedObjIndex = -1;
+	// Model files under the working directory, indexed in the background; see AssetIndex.h.
+	gpurenderer::assets::AssetIndexer gAssetIndexer;
+	// Every model, texture and environment path is resolved through this; see PathCache.
+	gpurenderer::assets::PathCache gPathCache;
+	char gModelFilterInput[kMaxModelFilterLength]{};
+	std::string gSelectedModelPath;
+
+	// Files of the last indexer version that match the filter; rebuilt only when either changes.
+	struct ModelListCache {
+		std::uint64_t version = UINT64_MAX;
+		std::string filter;
+		std::vector<std::string> files;
+		std::vector<size_t> matches;
+	};
+	ModelListCache gModelList;
 	std::string gModelLoadStatus;
-	GLuint gVao = 0;
-	GLuint gVbo = 0;
-	GLuint gEbo = 0;
-	GLuint gPlaneVao = 0;
-	GLuint gPlaneVbo = 0;
-	GLuint gPlaneEbo = 0;
-	int gPlaneIndexCount = 0;
-	GLuint gBackgroundVao = 0;
-	GLuint gBackgroundVbo = 0;
-	GLuint gBackgroundEbo = 0;
-	int gBackgroundIndexCount = 0;
-	GLuint gLightVao = 0;
-	GLuint gLightVbo = 0;
-	GLMeshBuffers gLightCubeMesh;
-	GLMeshBuffers gLightSphereMesh;
-	GLMeshBuffers gLightObjectMesh;
+	ArenaMesh gPlaneMesh;
+	ArenaMesh gBackgroundMesh;
+	ArenaMesh gLightPointMesh;
+	ArenaMesh gLightCubeMesh;
+	ArenaMesh gLightSphereMesh;
+	ArenaMesh gLightObjectMesh;
+	CpuMesh gPlaneCpuMesh;
+	CpuMesh gBackgroundCpuMesh;
+	CpuMesh gLightCubeCpuMesh;
+	CpuMesh gLightSphereCpuMesh;
+	CpuMesh gLightObjectCpuMesh;
 	bool gShowLightMarker = true;
 	int gLightMarkerShape = static_cast<int>(LightMarkerShape::Point);
 	bool gHasLightObjectMesh = false;
 	std::string gLightObjectStatus;
 	GLRenderTexture gRenderTexture;
 	GLShadowMap gShadowMap;
+	int gSelectedInstanceIndex = 0;
+	int gInstanceGridRows = 4;
+	int gInstanceGridColumns = 4;
+	float gInstanceGridSpacing = 1.25f;
+	std::vector<InstanceAttributes> gInstanceAttributes;
+	std::vector<Bounds> gInstanceBounds;
+	std::vector<int> gInstanceMaterialOverrides;
+	std::vector<ArenaRange> gInstanceModelSpans;
+	// Instance attribute buffers, one per in-flight slot; gInstanceVbo is the current frame's.
+	std::array<GLuint, kMaxFramesInFlight> gInstanceVboRing{};
+	std::array<size_t, kMaxFramesInFlight> gInstanceVboCapacity{};
+	GLuint gInstanceVbo = 0;
+	bool gHasFenceSync = false;
+	FrameScheduler gFrameScheduler;
+	TextureStreamer gTextureStreamer;
+	// Created on first use by the thread that owns the GL context; see Jobs().
+	std::unique_ptr<jobs::JobSystem> gJobSystem;
+	// GL work handed to the upload thread: upload runs on its context, publish on the render thread
+	// once the fence the upload thread set after upload has passed.
+	struct UploadRequest {
+		std::function<void()> upload;
+		std::function<void()> publish;
+		GlSyncHandle fence = nullptr;
+		std::chrono::steady_clock::time_point submitted;
+	};
+	// A hidden window whose context shares objects with gWindow, current on a thread of its own.
+	struct UploadThread {
+		GLFWwindow* window = nullptr;
+		std::thread thread;
+		// Fed by the render thread and job workers; a null request stops the thread.
+		jobs::MpscQueue<std::shared_ptr<UploadRequest>> requests;
+		jobs::MpscQueue<std::shared_ptr<UploadRequest>> completed;
+		// Render thread: completed requests whose fence has not passed yet, oldest first.
+		std::deque<std::shared_ptr<UploadRequest>> fenced;
+		// Submitted and not yet published.
+		std::atomic<size_t> inFlight{0};
+		size_t published = 0;
+		// Submission to publication.
+		double publishLatencyMs = 0.0;
+		double maxPublishLatencyMs = 0.0;
+	};
+	UploadThread gUploadThread;
+	// Blocking file reads of async loads, kept off the job workers; an empty function stops the thread.
+	struct IoThread {
+		std::thread thread;
+		jobs::MpscQueue<std::function<void()>> work;
+	};
+	IoThread gIoThread;
+	// Work other threads hand to the render thread, run at the start of a frame.
+	jobs::MpscQueue<std::function<void()>> gRenderThreadWork;
+	bool gOnDemandRendering = false;
+	int gPendingRedrawFrames = kRedrawSettleFrames;
+	// Set when a GUI widget is being dragged or edited; keeps the on-demand loop drawing every frame.
+	bool gGuiAnimating = false;
+	std::atomic<bool> gRedrawRequested{false};
+	size_t gRenderedFrameCount = 0;
+	size_t gIdleWakeupCount = 0;
+	bool gHasInstancing = false;
+	bool gHasCopyBuffer = false;
+	int gLastMainInstances = 0;
+	int gLastReflectionInstances = 0;
+	int gLastShadowInstances = 0;
 	GLuint gEnvironmentCubemap = 0;
+	// Cosine-convolved companion of gEnvironmentCubemap; 0 when the environment is not prefiltered.
+	GLuint gIrradianceCubemap = 0;
+	// Convolve the environment with GGX lobes for glossy reflections, rather than box-filtering its mips.
+	bool gPrefilterEnvironment = true;
+	float gEnvDiffuseStrength = kEnvDiffuseStrength;
+	struct EnvironmentLoadStats {
+		int faceSize = 0;
+		// Levels of the prefiltered chain, sampled by roughness; 1 for box-filtered mips.
+		int levels = 1;
+		bool fromCache = false;
+		double decodeMs = 0.0;
+		double prefilterMs = 0.0;
+	};
+	EnvironmentLoadStats gEnvironmentStats;
 	bool gHasAnisotropicFiltering = false;
 	float gMaxAnisotropy = 1.0f;
+	// Block-compress textures on load; takes effect for textures that are not cached yet.
+	bool gCompressTextures = false;
+	bool gHasS3tc = false;
+	bool gHasRgtc = false;
+	bool gHasBptc = false;
+	bool gHasTextureSwizzle = false;
+	struct TextureCompressionStats {
+		size_t encoded = 0;
+		size_t loadedFromDisk = 0;
+		double encodeMs = 0.0;
+		// Uncompressed (RGB padded to RGBA) and compressed sizes of every compressed texture.
+		size_t sourceBytes = 0;
+		size_t compressedBytes = 0;
+	};
+	TextureCompressionStats gTextureCompressionStats;
+	// Material textures copied into GL_TEXTURE_2D_ARRAYs, so submeshes with different materials can be
+	// merged into one draw that looks its material up in a uniform table.
+	struct TextureArray {
+		GLuint texture = 0;
+		int layers = 0;
+		size_t bytes = 0;
+	};
+	struct PackedTextureLayer {
+		int array = -1;
+		int layer = 0;
+	};
+	struct MaterialBatching {
+		bool supported = false;
+		bool enabled = true;
+		// GPU copies into the arrays; without them uncompressed textures are read back instead and
+		// compressed ones are left unpacked.
+		bool hasCopyImage = false;
+		GLint maxLayers = 0;
+		// Set when the scene's materials change; the arrays are rebuilt by UpdateMaterialBatches.
+		bool dirty = true;
+		// Cleared when the table shader variant is unusable, so draws fall back to one material at a time.
+		bool shaderReady = true;
+		std::vector<TextureArray> arrays;
+		std::unordered_map<GLuint, PackedTextureLayer> layers;
+		size_t arrayBytes = 0;
+		size_t mergedRecords = 0;
+		size_t mergedSubmeshes = 0;
+		double packMs = 0.0;
+	};
+	MaterialBatching gMaterialBatching;
+	// Default main shader variant; nonzero once shader.vert/shader.frag have compiled.
 	GLuint gProgram = 0;
 	GLuint gDepthProgram = 0;
+	GLuint gSkyboxProgram = 0;
+	GLuint gUnlitProgram = 0;
+	struct ProgramCacheStats {
+		int hits = 0;
+		int misses = 0;
+		int rejected = 0;
+		int stored = 0;
+	};
+	bool gHasProgramBinary = false;
+	// KHR/ARB_parallel_shader_compile: compiles run on driver threads and can be polled without blocking.
+	bool gHasParallelShaderCompile = false;
+	// GL vendor/renderer/version, folded into every program cache key.
+	std::string gProgramCacheDriverKey;
+	std::filesystem::path gProgramCacheDir;
+	ProgramCacheStats gProgramCacheStats;
 	GLint gMvpLocation = -1;
 	GLint gModelLocation = -1;
 	GLint gViewLocation = -1;
@@ -499,18 +1322,16 @@ void main() {
 	GLint gAmbientLocation = -1;
 	GLint gDiffuseLocation = -1;
 	GLint gSpecularLocation = -1;
-	GLint gMarkerColorLocation = -1;
 	GLint gShininessLocation = -1;
-	GLint gShadeModeLocation = -1;
 	GLint gDiffuseMapLocation = -1;
 	GLint gSpecularMapLocation = -1;
-	GLint gUseDiffuseMapLocation = -1;
-	GLint gUseSpecularMapLocation = -1;
 	GLint gPlaneColorBiasLocation = -1;
 	GLint gEnvMapLocation = -1;
-	GLint gUseEnvMapLocation = -1;
 	GLint gInvViewRotationLocation = -1;
 	GLint gEnvReflectionStrengthLocation = -1;
+	GLint gEnvMaxLodLocation = -1;
+	GLint gIrradianceMapLocation = -1;
+	GLint gEnvDiffuseStrengthLocation = -1;
 	GLint gPlaneReflectionStrengthLocation = -1;
 	GLint gPlaneEnvStrengthLocation = -1;
 	GLint gPlaneReflectionBrightnessLocation = -1;
@@ -518,12 +1339,102 @@ void main() {
 	GLint gLightDirLocation = -1;
 	GLint gLightViewProjLocation = -1;
 	GLint gShadowMapLocation = -1;
-	GLint gReceiveShadowsLocation = -1;
 	GLint gShadowBiasLocation = -1;
-	GLint gUseSpotLightLocation = -1;
 	GLint gSpotCosInnerLocation = -1;
 	GLint gSpotCosOuterLocation = -1;
+	GLint gMaterialTableLocation = -1;
+	GLint gDiffuseArrayLocation = -1;
+	GLint gSpecularArrayLocation = -1;
 	GLint gDepthMvpLocation = -1;
+	GLint gSkyboxMvpLocation = -1;
+	GLint gUnlitMvpLocation = -1;
+	GLint gUnlitColorLocation = -1;
+
+	// Permutation key of shader.vert/shader.frag: the low bits hold SHADE_MODE, the rest are feature
+	// switches. Each pass binds the smallest variant that covers what it draws.
+	constexpr std::uint32_t kShadeModeBlinn = 0;
+	constexpr std::uint32_t kShadeModeNormals = 1;
+	constexpr std::uint32_t kShadeModePlane = 2;
+	constexpr std::uint32_t kShadeModeMask = 0x7u;
+	constexpr std::uint32_t kVariantDiffuseMap = 1u << 3;
+	constexpr std::uint32_t kVariantSpecularMap = 1u << 4;
+	constexpr std::uint32_t kVariantEnvMap = 1u << 5;
+	constexpr std::uint32_t kVariantShadows = 1u << 6;
+	constexpr std::uint32_t kVariantSpotLight = 1u << 7;
+	// Material colors and texture layers come from a per-vertex index into uMaterialTable.
+	constexpr std::uint32_t kVariantMaterialTable = 1u << 8;
+	// Everything enabled; compiled eagerly so a broken shader.frag is reported at load/reload time.
+	constexpr std::uint32_t kDefaultShaderVariant =
+		kShadeModeBlinn | kVariantDiffuseMap | kVariantSpecularMap | kVariantEnvMap | kVariantShadows | kVariantSpotLight;
+
+	struct ShaderFeatureDefine {
+		std::uint32_t bit;
+		const char* name;
+		const char* label;
+	};
+	const ShaderFeatureDefine kShaderFeatureDefines[] = {
+		{kVariantDiffuseMap, "HAS_DIFFUSE_MAP", "diffuse"},
+		{kVariantSpecularMap, "HAS_SPECULAR_MAP", "specular"},
+		{kVariantEnvMap, "HAS_ENV_MAP", "env"},
+		{kVariantShadows, "RECEIVE_SHADOWS", "shadows"},
+		{kVariantSpotLight, "USE_SPOT_LIGHT", "spot"},
+		{kVariantMaterialTable, "MATERIAL_TABLE", "table"}
+	};
+
+	// Uniforms of the main program. Binding a variant copies its locations into these globals;
+	// samplers with a texture unit are pointed at it once after linking.
+	struct MainUniformSlot {
+		const char* name;
+		GLint* location;
+		int textureUnit;
+	};
+	const MainUniformSlot kMainUniforms[] = {
+		{"uMvp", &gMvpLocation, -1},
+		{"uModel", &gModelLocation, -1},
+		{"uView", &gViewLocation, -1},
+		{"uNormalMatrix", &gNormalMatrixLocation, -1},
+		{"uWorldNormalMatrix", &gWorldNormalMatrixLocation, -1},
+		{"uLightPosView", &gLightPosLocation, -1},
+		{"uLightColor", &gLightColorLocation, -1},
+		{"uAmbientColor", &gAmbientLocation, -1},
+		{"uDiffuseColor", &gDiffuseLocation, -1},
+		{"uSpecularColor", &gSpecularLocation, -1},
+		{"uShininess", &gShininessLocation, -1},
+		{"uDiffuseMap", &gDiffuseMapLocation, 0},
+		{"uSpecularMap", &gSpecularMapLocation, 1},
+		{"uPlaneColorBias", &gPlaneColorBiasLocation, -1},
+		{"uEnvMap", &gEnvMapLocation, 2},
+		{"uInvViewRotation", &gInvViewRotationLocation, -1},
+		{"uEnvReflectionStrength", &gEnvReflectionStrengthLocation, -1},
+		{"uEnvMaxLod", &gEnvMaxLodLocation, -1},
+		{"uIrradianceMap", &gIrradianceMapLocation, 6},
+		{"uEnvDiffuseStrength", &gEnvDiffuseStrengthLocation, -1},
+		{"uPlaneReflectionStrength", &gPlaneReflectionStrengthLocation, -1},
+		{"uPlaneEnvStrength", &gPlaneEnvStrengthLocation, -1},
+		{"uPlaneReflectionBrightness", &gPlaneReflectionBrightnessLocation, -1},
+		{"uReflectionViewProj", &gReflectionViewProjLocation, -1},
+		{"uLightDirView", &gLightDirLocation, -1},
+		{"uLightViewProj", &gLightViewProjLocation, -1},
+		{"uShadowMap", &gShadowMapLocation, 3},
+		{"uShadowBias", &gShadowBiasLocation, -1},
+		{"uSpotCosInner", &gSpotCosInnerLocation, -1},
+		{"uSpotCosOuter", &gSpotCosOuterLocation, -1},
+		{"uMaterialTable", &gMaterialTableLocation, -1},
+		{"uDiffuseArray", &gDiffuseArrayLocation, 4},
+		{"uSpecularArray", &gSpecularArrayLocation, 5}
+	};
+	constexpr size_t kMainUniformCount = sizeof(kMainUniforms) / sizeof(kMainUniforms[0]);
+
+	struct ShaderVariant {
+		GLuint program = 0;
+		std::array<GLint, kMainUniformCount> locations{};
+		double buildMs = 0.0;
+		size_t binds = 0;
+	};
+	// Compiled lazily on first bind; a failed build stays cached with program 0 so it is reported once.
+	std::unordered_map<std::uint32_t, ShaderVariant> gShaderVariants;
+	std::string gMainVertexSource;
+	std::string gMainFragmentSource;
 	glm::mat4 gLightViewProjection(1.0f);
 	glm::vec3 gLightWorldPosition(0.0f, 0.0f, 0.0f);
 	glm::vec3 gLightWorldDirection(0.0f, -1.0f, 0.0f);
@@ -531,6 +1442,19 @@ void main() {
 	float gSpotInnerDeg = kSpotLightInnerDeg;
 	float gSpotOuterDeg = kSpotLightOuterDeg;
 	bool gUseVao = false;
+	// Set by RunSoftwareRenderer: no GL context exists, so the arena only hands out ranges and textures
+	// are decoded straight into gSoftwareTextures under synthetic ids.
+	bool gSoftwareOnly = false;
+	GLuint gNextSoftwareTextureId = 1;
+	std::unordered_map<GLuint, software::Texture> gSoftwareTextures;
+	software::CubeTexture gSoftwareEnvironment;
+	bool gSoftwareCaptureRequested = false;
+	std::string gSoftwareReferenceStatus;
+	gpurenderer::LoadTimings gLastLoadTimings;
+	// Running total of CreateTextureFromPixels time; LoadMesh diffs it to split texture decode from upload.
+	double gTextureUploadMs = 0.0;
+	// Non-null while MeasureFramePasses (or a timed software run) wants per-pass laps.
+	gpurenderer::PassTimings* gPassTimingSink = nullptr;
 
 	using GlGenVertexArraysProc = void (APIENTRYP)(GLsizei, GLuint*);
 	using GlBindVertexArrayProc = void (APIENTRYP)(GLuint);
@@ -573,6 +1497,29 @@ void main() {
 	using GlFramebufferRenderbufferProc = void (APIENTRYP)(GLenum, GLenum, GLenum, GLuint);
 	using GlDeleteRenderbuffersProc = void (APIENTRYP)(GLsizei, const GLuint*);
 	using GlGenerateMipmapProc = void (APIENTRYP)(GLenum);
+	using GlGetBufferSubDataProc = void (APIENTRYP)(GLenum, std::ptrdiff_t, std::ptrdiff_t, void*);
+	using GlBufferSubDataProc = void (APIENTRYP)(GLenum, std::ptrdiff_t, std::ptrdiff_t, const void*);
+	using GlCopyBufferSubDataProc = void (APIENTRYP)(GLenum, GLenum, std::ptrdiff_t, std::ptrdiff_t, std::ptrdiff_t);
+	using GlGetProgramBinaryProc = void (APIENTRYP)(GLuint, GLsizei, GLsizei*, GLenum*, void*);
+	using GlProgramBinaryProc = void (APIENTRYP)(GLuint, GLenum, const void*, GLsizei);
+	using GlProgramParameteriProc = void (APIENTRYP)(GLuint, GLenum, GLint);
+	using GlMaxShaderCompilerThreadsProc = void (APIENTRYP)(GLuint);
+	using GlMapBufferRangeProc = void* (APIENTRYP)(GLenum, std::ptrdiff_t, std::ptrdiff_t, GLbitfield);
+	using GlUnmapBufferProc = GLboolean (APIENTRYP)(GLenum);
+	using GlCompressedTexImage2DProc = void (APIENTRYP)(GLenum, GLint, GLenum, GLsizei, GLsizei, GLint, GLsizei, const void*);
+	using GlCompressedTexImage3DProc = void (APIENTRYP)(GLenum, GLint, GLenum, GLsizei, GLsizei, GLsizei, GLint, GLsizei, const void*);
+	using GlTexImage3DProc = void (APIENTRYP)(GLenum, GLint, GLint, GLsizei, GLsizei, GLsizei, GLint, GLenum, GLenum, const void*);
+	using GlTexSubImage3DProc = void (APIENTRYP)(GLenum, GLint, GLint, GLint, GLint, GLsizei, GLsizei, GLsizei, GLenum, GLenum, const void*);
+	using GlCopyImageSubDataProc = void (APIENTRYP)(GLuint, GLenum, GLint, GLint, GLint, GLint, GLuint, GLenum, GLint, GLint, GLint, GLint, GLsizei, GLsizei, GLsizei);
+	using GlUniform4fvProc = void (APIENTRYP)(GLint, GLsizei, const GLfloat*);
+	using GlDisableVertexAttribArrayProc = void (APIENTRYP)(GLuint);
+	using GlVertexAttrib3fvProc = void (APIENTRYP)(GLuint, const GLfloat*);
+	using GlVertexAttrib4fvProc = void (APIENTRYP)(GLuint, const GLfloat*);
+	using GlVertexAttribDivisorProc = void (APIENTRYP)(GLuint, GLuint);
+	using GlDrawElementsInstancedProc = void (APIENTRYP)(GLenum, GLsizei, GLenum, const void*, GLsizei);
+	using GlFenceSyncProc = GlSyncHandle (APIENTRYP)(GLenum, GLbitfield);
+	using GlClientWaitSyncProc = GLenum (APIENTRYP)(GlSyncHandle, GLbitfield, std::uint64_t);
+	using GlDeleteSyncProc = void (APIENTRYP)(GlSyncHandle);
 
 	GlGenVertexArraysProc pglGenVertexArrays = nullptr;
 	GlBindVertexArrayProc pglBindVertexArray = nullptr;
@@ -615,6 +1562,29 @@ void main() {
 	GlFramebufferRenderbufferProc pglFramebufferRenderbuffer = nullptr;
 	GlDeleteRenderbuffersProc pglDeleteRenderbuffers = nullptr;
 	GlGenerateMipmapProc pglGenerateMipmap = nullptr;
+	GlGetBufferSubDataProc pglGetBufferSubData = nullptr;
+	GlBufferSubDataProc pglBufferSubData = nullptr;
+	GlCopyBufferSubDataProc pglCopyBufferSubData = nullptr;
+	GlGetProgramBinaryProc pglGetProgramBinary = nullptr;
+	GlProgramBinaryProc pglProgramBinary = nullptr;
+	GlProgramParameteriProc pglProgramParameteri = nullptr;
+	GlMaxShaderCompilerThreadsProc pglMaxShaderCompilerThreads = nullptr;
+	GlCompressedTexImage2DProc pglCompressedTexImage2D = nullptr;
+	GlCompressedTexImage3DProc pglCompressedTexImage3D = nullptr;
+	GlTexImage3DProc pglTexImage3D = nullptr;
+	GlTexSubImage3DProc pglTexSubImage3D = nullptr;
+	GlCopyImageSubDataProc pglCopyImageSubData = nullptr;
+	GlUniform4fvProc pglUniform4fv = nullptr;
+	GlMapBufferRangeProc pglMapBufferRange = nullptr;
+	GlUnmapBufferProc pglUnmapBuffer = nullptr;
+	GlDisableVertexAttribArrayProc pglDisableVertexAttribArray = nullptr;
+	GlVertexAttrib3fvProc pglVertexAttrib3fv = nullptr;
+	GlVertexAttrib4fvProc pglVertexAttrib4fv = nullptr;
+	GlVertexAttribDivisorProc pglVertexAttribDivisor = nullptr;
+	GlDrawElementsInstancedProc pglDrawElementsInstanced = nullptr;
+	GlFenceSyncProc pglFenceSync = nullptr;
+	GlClientWaitSyncProc pglClientWaitSync = nullptr;
+	GlDeleteSyncProc pglDeleteSync = nullptr;
 
 	float DegreesToRadians(float degrees) {
 		return degrees * 3.14159265358979323846f / 180.0f;
@@ -671,8 +1641,12 @@ void main() {
 		ok &= LoadGlFunction(pglGenBuffers, "glGenBuffers", "glGenBuffersARB");
 		ok &= LoadGlFunction(pglBindBuffer, "glBindBuffer", "glBindBufferARB");
 		ok &= LoadGlFunction(pglBufferData, "glBufferData", "glBufferDataARB");
+		ok &= LoadGlFunction(pglBufferSubData, "glBufferSubData", "glBufferSubDataARB");
 		ok &= LoadGlFunction(pglEnableVertexAttribArray, "glEnableVertexAttribArray");
 		ok &= LoadGlFunction(pglVertexAttribPointer, "glVertexAttribPointer");
+		ok &= LoadGlFunction(pglDisableVertexAttribArray, "glDisableVertexAttribArray");
+		ok &= LoadGlFunction(pglVertexAttrib3fv, "glVertexAttrib3fv");
+		ok &= LoadGlFunction(pglVertexAttrib4fv, "glVertexAttrib4fv");
 		ok &= LoadGlFunction(pglCreateShader, "glCreateShader");
 		ok &= LoadGlFunction(pglShaderSource, "glShaderSource");
 		ok &= LoadGlFunction(pglCompileShader, "glCompileShader");
@@ -707,6 +1681,25 @@ void main() {
 		LoadOptionalGlFunction(pglDeleteVertexArrays, "glDeleteVertexArrays", "glDeleteVertexArraysARB");
 		LoadOptionalGlFunction(pglDeleteFramebuffers, "glDeleteFramebuffers", "glDeleteFramebuffersEXT");
 		LoadOptionalGlFunction(pglDeleteRenderbuffers, "glDeleteRenderbuffers", "glDeleteRenderbuffersEXT");
+		LoadOptionalGlFunction(pglGetBufferSubData, "glGetBufferSubData", "glGetBufferSubDataARB");
+		LoadOptionalGlFunction(pglVertexAttribDivisor, "glVertexAttribDivisor", "glVertexAttribDivisorARB");
+		LoadOptionalGlFunction(pglCopyBufferSubData, "glCopyBufferSubData");
+		LoadOptionalGlFunction(pglDrawElementsInstanced, "glDrawElementsInstanced", "glDrawElementsInstancedARB");
+		LoadOptionalGlFunction(pglFenceSync, "glFenceSync");
+		LoadOptionalGlFunction(pglClientWaitSync, "glClientWaitSync");
+		LoadOptionalGlFunction(pglDeleteSync, "glDeleteSync");
+		LoadOptionalGlFunction(pglGetProgramBinary, "glGetProgramBinary");
+		LoadOptionalGlFunction(pglProgramBinary, "glProgramBinary");
+		LoadOptionalGlFunction(pglProgramParameteri, "glProgramParameteri");
+		LoadOptionalGlFunction(pglMaxShaderCompilerThreads, "glMaxShaderCompilerThreadsKHR", "glMaxShaderCompilerThreadsARB");
+		LoadOptionalGlFunction(pglCompressedTexImage2D, "glCompressedTexImage2D", "glCompressedTexImage2DARB");
+		LoadOptionalGlFunction(pglMapBufferRange, "glMapBufferRange");
+		LoadOptionalGlFunction(pglUnmapBuffer, "glUnmapBuffer", "glUnmapBufferARB");
+		LoadOptionalGlFunction(pglCompressedTexImage3D, "glCompressedTexImage3D", "glCompressedTexImage3DARB");
+		LoadOptionalGlFunction(pglTexImage3D, "glTexImage3D", "glTexImage3DEXT");
+		LoadOptionalGlFunction(pglTexSubImage3D, "glTexSubImage3D", "glTexSubImage3DEXT");
+		LoadOptionalGlFunction(pglCopyImageSubData, "glCopyImageSubData");
+		LoadOptionalGlFunction(pglUniform4fv, "glUniform4fv", "glUniform4fvARB");
 		return ok;
 	}
 
@@ -733,6 +1726,34 @@ void main() {
 		return false;
 	}
 
+	bool IsGlVersionAtLeast(int major, int minor) {
+		const char* version = reinterpret_cast<const char*>(glGetString(GL_VERSION));
+		if (!version) {
+			return false;
+		}
+		int parsedMajor = 0;
+		int parsedMinor = 0;
+		if (std::sscanf(version, "%d.%d", &parsedMajor, &parsedMinor) != 2) {
+			return false;
+		}
+		return parsedMajor > major || (parsedMajor == major && parsedMinor >= minor);
+	}
+
+	void InitializeInstancing() {
+		const bool hasDrawInstanced = IsGlVersionAtLeast(3, 1) || IsExtensionSupported("GL_ARB_draw_instanced");
+		const bool hasInstancedArrays = IsGlVersionAtLeast(3, 3) || IsExtensionSupported("GL_ARB_instanced_arrays");
+		gHasInstancing = hasDrawInstanced &&
+			hasInstancedArrays &&
+			pglDrawElementsInstanced != nullptr &&
+			pglVertexAttribDivisor != nullptr;
+		gHasCopyBuffer = (IsGlVersionAtLeast(3, 1) || IsExtensionSupported("GL_ARB_copy_buffer")) &&
+			pglCopyBufferSubData != nullptr;
+		gHasFenceSync = (IsGlVersionAtLeast(3, 2) || IsExtensionSupported("GL_ARB_sync")) &&
+			pglFenceSync != nullptr &&
+			pglClientWaitSync != nullptr &&
+			pglDeleteSync != nullptr;
+	}
+
 	void InitializeAnisotropicFiltering() {
 		gHasAnisotropicFiltering = IsExtensionSupported("GL_EXT_texture_filter_anisotropic");
 		gMaxAnisotropy = 1.0f;
@@ -749,6 +1770,34 @@ void main() {
 		}
 	}
 
+	void InitializeTextureCompression() {
+		const bool canUpload = pglCompressedTexImage2D != nullptr;
+		gHasS3tc = canUpload && IsExtensionSupported("GL_EXT_texture_compression_s3tc");
+		gHasRgtc = canUpload && (IsGlVersionAtLeast(3, 0) || IsExtensionSupported("GL_ARB_texture_compression_rgtc") ||
+			IsExtensionSupported("GL_EXT_texture_compression_rgtc"));
+		gHasBptc = canUpload && (IsGlVersionAtLeast(4, 2) || IsExtensionSupported("GL_ARB_texture_compression_bptc"));
+		gHasTextureSwizzle = IsGlVersionAtLeast(3, 3) || IsExtensionSupported("GL_ARB_texture_swizzle") ||
+			IsExtensionSupported("GL_EXT_texture_swizzle");
+	}
+
+	// Texture arrays are sampled from the GLSL 1.20 shaders through GL_EXT_texture_array.
+	void InitializeMaterialBatching() {
+		MaterialBatching& batching = gMaterialBatching;
+		batching.supported = !gSoftwareOnly &&
+			IsExtensionSupported("GL_EXT_texture_array") &&
+			pglTexImage3D != nullptr &&
+			pglTexSubImage3D != nullptr &&
+			pglUniform4fv != nullptr &&
+			pglActiveTexture != nullptr;
+		batching.hasCopyImage = (IsGlVersionAtLeast(4, 3) || IsExtensionSupported("GL_ARB_copy_image")) &&
+			pglCopyImageSubData != nullptr;
+		batching.maxLayers = 0;
+		if (batching.supported) {
+			glGetIntegerv(GL_MAX_ARRAY_TEXTURE_LAYERS, &batching.maxLayers);
+			batching.supported = batching.maxLayers > 0;
+		}
+	}
+
 	void ConfigureRenderTextureSampling(GLuint texture) {
 		glBindTexture(GL_TEXTURE_2D, texture);
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
@@ -920,34 +1969,209 @@ void main() {
 		return true;
 	}
 
-	glm::vec3 ToVec3(const aiColor3D& color) {
-		return glm::vec3(color.r, color.g, color.b);
+	double ElapsedMilliseconds(std::chrono::steady_clock::time_point start) {
+		return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
 	}
 
-	void ComputeNormalsForMesh(std::vector<Vertex>& vertices,
-		const std::vector<unsigned int>& indices,
-		size_t vertexStart,
-		size_t vertexCount,
-		size_t indexOffset,
-		size_t indexCount) {
-		if (vertexCount == 0 || indexCount < 3) {
+	// Charges the time since lapStart to one PassTimings field and restarts the lap. No-op unless a
+	// timing sink is installed; GL work is drained first so it is not billed to the next pass.
+	void LapPassTimer(double gpurenderer::PassTimings::*slot, std::chrono::steady_clock::time_point& lapStart) {
+		if (gPassTimingSink == nullptr) {
 			return;
 		}
+		if (!gSoftwareOnly) {
+			glFinish();
+		}
+		gPassTimingSink->*slot += ElapsedMilliseconds(lapStart);
+		lapStart = std::chrono::steady_clock::now();
+	}
 
-		for (size_t i = 0; i < vertexCount; ++i) {
-			vertices[vertexStart + i].normal = glm::vec3(0.0f);
+	// The engine's CPU job system. The first call has to come from the context thread, which becomes the
+	// one that runs main thread jobs.
+	jobs::JobSystem& Jobs() {
+		if (!gJobSystem) {
+			gJobSystem = std::make_unique<jobs::JobSystem>();
 		}
+		return *gJobSystem;
+	}
 
-		for (size_t i = 0; i + 2 < indexCount; i += 3) {
-			const unsigned int i0 = indices[indexOffset + i + 0];
-			const unsigned int i1 = indices[indexOffset + i + 1];
-			const unsigned int i2 = indices[indexOffset + i + 2];
-			if (i0 < vertexStart || i1 < vertexStart || i2 < vertexStart) {
-				continue;
+	// Steps of Initialize's startup graph, with wall times relative to its start.
+	struct StartupStep {
+		std::string name;
+		bool worker = false;
+		double startMs = 0.0;
+		double endMs = 0.0;
+	};
+	struct StartupTimeline {
+		std::chrono::steady_clock::time_point origin = std::chrono::steady_clock::now();
+		std::mutex mutex;
+		std::vector<StartupStep> steps;
+	};
+	StartupTimeline gStartupTimeline;
+
+	void ResetStartupTimeline() {
+		std::lock_guard<std::mutex> lock(gStartupTimeline.mutex);
+		gStartupTimeline.origin = std::chrono::steady_clock::now();
+		gStartupTimeline.steps.clear();
+	}
+
+	// Runs body and records it on the timeline; callable from any thread.
+	template <typename Body>
+	void RunStartupStep(const char* name, const Body& body) {
+		const bool worker = !Jobs().IsMainThread();
+		const auto start = std::chrono::steady_clock::now();
+		body();
+		const auto end = std::chrono::steady_clock::now();
+		std::lock_guard<std::mutex> lock(gStartupTimeline.mutex);
+		const auto origin = gStartupTimeline.origin;
+		gStartupTimeline.steps.push_back(StartupStep{
+			name,
+			worker,
+			std::chrono::duration<double, std::milli>(start - origin).count(),
+			std::chrono::duration<double, std::milli>(end - origin).count()});
+	}
+
+	// One line per step in start order, with a bar placing it on the startup's time axis.
+	void PrintStartupTimeline() {
+		constexpr int kBarColumns = 40;
+		std::lock_guard<std::mutex> lock(gStartupTimeline.mutex);
+		std::vector<StartupStep> steps = gStartupTimeline.steps;
+		std::stable_sort(steps.begin(), steps.end(), [](const StartupStep& a, const StartupStep& b) {
+			return a.startMs < b.startMs;
+			});
+		const double totalMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - gStartupTimeline.origin).count();
+		std::printf("Startup timeline (%.1f ms):\n", totalMs);
+		for (const StartupStep& step : steps) {
+			char bar[kBarColumns + 1];
+			const int first = static_cast<int>(step.startMs / std::max(totalMs, 1e-3) * kBarColumns);
+			const int last = std::max(first, static_cast<int>(step.endMs / std::max(totalMs, 1e-3) * kBarColumns));
+			for (int i = 0; i < kBarColumns; ++i) {
+				bar[i] = i >= first && i <= last ? '#' : '.';
 			}
-			if (i0 >= vertexStart + vertexCount ||
-				i1 >= vertexStart + vertexCount ||
-				i2 >= vertexStart + vertexCount) {
+			bar[kBarColumns] = '\0';
+			std::printf("  %-6s %-22s %8.1f - %8.1f ms  |%s|\n",
+				step.worker ? "worker" : "GL",
+				step.name.c_str(),
+				step.startMs,
+				step.endMs,
+				bar);
+		}
+	}
+
+	// FNV-1a; stable across runs and platforms, which is all the on-disk cache keys need.
+	std::uint64_t HashBytes(const void* data, size_t size, std::uint64_t hash = 0xCBF29CE484222325ull) {
+		const unsigned char* bytes = static_cast<const unsigned char*>(data);
+		for (size_t i = 0; i < size; ++i) {
+			hash ^= bytes[i];
+			hash *= 0x100000001B3ull;
+		}
+		return hash;
+	}
+
+	std::uint64_t HashString(const std::string& text, std::uint64_t hash = 0xCBF29CE484222325ull) {
+		// Length first so ("ab", "c") and ("a", "bc") hash differently when chained.
+		const std::uint64_t length = text.size();
+		return HashBytes(text.data(), text.size(), HashBytes(&length, sizeof(length), hash));
+	}
+
+	std::string HashToHex(std::uint64_t hash) {
+		char text[17];
+		std::snprintf(text, sizeof(text), "%016llx", static_cast<unsigned long long>(hash));
+		return text;
+	}
+
+	// Root of the on-disk caches. GPURENDERER_CACHE_DIR overrides the per-user default.
+	std::filesystem::path ResolveCacheDirectory() {
+		const char* overrideDir = std::getenv("GPURENDERER_CACHE_DIR");
+		if (overrideDir && *overrideDir) {
+			return std::filesystem::path(overrideDir);
+		}
+#ifdef _WIN32
+		const char* localAppData = std::getenv("LOCALAPPDATA");
+		if (localAppData && *localAppData) {
+			return std::filesystem::path(localAppData) / "GPURenderer" / "cache";
+		}
+#else
+		const char* xdgCache = std::getenv("XDG_CACHE_HOME");
+		if (xdgCache && *xdgCache) {
+			return std::filesystem::path(xdgCache) / "gpurenderer";
+		}
+		const char* home = std::getenv("HOME");
+		if (home && *home) {
+			return std::filesystem::path(home) / ".cache" / "gpurenderer";
+		}
+#endif
+		std::error_code ec;
+		return std::filesystem::temp_directory_path(ec) / "gpurenderer-cache";
+	}
+
+	// Writes through a temporary file and renames it into place, so a crash or a concurrent instance
+	// never leaves a torn cache entry behind.
+	bool WriteCacheFile(const std::filesystem::path& path, const std::vector<unsigned char>& bytes) {
+		std::error_code ec;
+		std::filesystem::create_directories(path.parent_path(), ec);
+		std::filesystem::path temporary = path;
+		temporary += ".tmp";
+		{
+			std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+			if (!file) {
+				return false;
+			}
+			file.write(reinterpret_cast<const char*>(bytes.data()), static_cast<std::streamsize>(bytes.size()));
+			if (!file) {
+				return false;
+			}
+		}
+		std::filesystem::rename(temporary, path, ec);
+		if (ec) {
+			std::filesystem::remove(temporary, ec);
+			return false;
+		}
+		return true;
+	}
+
+	bool ReadCacheFile(const std::filesystem::path& path, std::vector<unsigned char>& bytes) {
+		std::ifstream file(path, std::ios::binary | std::ios::ate);
+		if (!file) {
+			return false;
+		}
+		const std::streamsize size = file.tellg();
+		if (size <= 0) {
+			return false;
+		}
+		bytes.resize(static_cast<size_t>(size));
+		file.seekg(0);
+		return static_cast<bool>(file.read(reinterpret_cast<char*>(bytes.data()), size));
+	}
+
+	glm::vec3 ToVec3(const aiColor3D& color) {
+		return glm::vec3(color.r, color.g, color.b);
+	}
+
+	void ComputeNormalsForMesh(std::vector<Vertex>& vertices,
+		const std::vector<unsigned int>& indices,
+		size_t vertexStart,
+		size_t vertexCount,
+		size_t indexOffset,
+		size_t indexCount) {
+		if (vertexCount == 0 || indexCount < 3) {
+			return;
+		}
+
+		for (size_t i = 0; i < vertexCount; ++i) {
+			vertices[vertexStart + i].normal = glm::vec3(0.0f);
+		}
+
+		for (size_t i = 0; i + 2 < indexCount; i += 3) {
+			const unsigned int i0 = indices[indexOffset + i + 0];
+			const unsigned int i1 = indices[indexOffset + i + 1];
+			const unsigned int i2 = indices[indexOffset + i + 2];
+			if (i0 < vertexStart || i1 < vertexStart || i2 < vertexStart) {
+				continue;
+			}
+			if (i0 >= vertexStart + vertexCount ||
+				i1 >= vertexStart + vertexCount ||
+				i2 >= vertexStart + vertexCount) {
 				continue;
 			}
 			const glm::vec3& p0 = vertices[i0].position;
@@ -985,11 +2209,24 @@ void main() {
 		}
 	}
 
-	GLuint CreateTextureFromPixels(const unsigned char* pixels, int width, int height, int channels) {
-		if (!pixels || width <= 0 || height <= 0) {
-			return 0;
+	// Swaps R and B of packed 8-bit BGRA texels; written on whole words so it vectorizes.
+	std::vector<unsigned char> SwizzleBgraToRgba(const unsigned char* pixels, size_t texelCount) {
+		std::vector<unsigned char> rgba(texelCount * 4u);
+		for (size_t i = 0; i < texelCount; ++i) {
+			std::uint32_t texel = 0;
+			std::memcpy(&texel, pixels + i * 4u, sizeof(texel));
+			texel = (texel & 0xFF00FF00u) | ((texel >> 16) & 0xFFu) | ((texel & 0xFFu) << 16);
+			std::memcpy(rgba.data() + i * 4u, &texel, sizeof(texel));
 		}
+		return rgba;
+	}
+
+	// Single-level linear texture on the current context; touches no renderer state, so the upload
+	// thread can call it too. bgra marks 4-channel pixels stored B,G,R,A (e.g. aiTexel), which GL
+	// swizzles during the upload.
+	GLuint CreateTextureObject(const unsigned char* pixels, int width, int height, int channels, bool bgra) {
 		const GLenum format = ChannelsToFormat(channels);
+		const GLenum sourceFormat = bgra && channels == 4 ? GL_BGRA : format;
 		GLuint tex = 0;
 		glGenTextures(1, &tex);
 		glBindTexture(GL_TEXTURE_2D, tex);
@@ -998,1043 +2235,3725 @@ void main() {
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
 		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
-		glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, pixels);
+		glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, sourceFormat, GL_UNSIGNED_BYTE, pixels);
 		glBindTexture(GL_TEXTURE_2D, 0);
 		return tex;
 	}
 
-	GLuint LoadTextureFromMemory(const aiTexture* texture) {
-		if (!texture) {
+	GLuint CreateTextureFromPixels(const unsigned char* pixels, int width, int height, int channels, bool bgra = false) {
+		if (!pixels || width <= 0 || height <= 0) {
 			return 0;
 		}
-		if (texture->mHeight == 0) {
-			int width = 0;
-			int height = 0;
-			int channels = 0;
-			const stbi_uc* data = reinterpret_cast<const stbi_uc*>(texture->pcData);
-			stbi_uc* pixels = stbi_load_from_memory(data, static_cast<int>(texture->mWidth), &width, &height, &channels, 0);
-			if (!pixels) {
+		bgra = bgra && channels == 4;
+		const auto uploadStart = std::chrono::steady_clock::now();
+		if (gSoftwareOnly) {
+			software::Texture texture;
+			std::vector<unsigned char> rgba;
+			if (bgra) {
+				rgba = SwizzleBgraToRgba(pixels, static_cast<size_t>(width) * static_cast<size_t>(height));
+				pixels = rgba.data();
+			}
+			if (!software::BuildTexture(pixels, width, height, channels, texture)) {
 				return 0;
 			}
-			GLuint tex = CreateTextureFromPixels(pixels, width, height, channels);
-			stbi_image_free(pixels);
-			return tex;
+			const GLuint id = gNextSoftwareTextureId++;
+			gSoftwareTextures.emplace(id, std::move(texture));
+			gTextureUploadMs += ElapsedMilliseconds(uploadStart);
+			return id;
 		}
+		const GLuint tex = CreateTextureObject(pixels, width, height, channels, bgra);
+		gTextureUploadMs += ElapsedMilliseconds(uploadStart);
+		return tex;
+	}
 
-		const int width = static_cast<int>(texture->mWidth);
-		const int height = static_cast<int>(texture->mHeight);
-		std::vector<unsigned char> pixels(static_cast<size_t>(width) * static_cast<size_t>(height) * 4u);
-		for (int y = 0; y < height; ++y) {
-			for (int x = 0; x < width; ++x) {
-				const aiTexel& texel = texture->pcData[y * width + x];
-				const size_t idx = static_cast<size_t>((y * width + x) * 4);
-				pixels[idx + 0] = texel.r;
-				pixels[idx + 1] = texel.g;
-				pixels[idx + 2] = texel.b;
-				pixels[idx + 3] = texel.a;
+	void RunStreamerTasks() {
+		TextureStreamer& streamer = gTextureStreamer;
+		std::unique_lock<std::mutex> lock(streamer.mutex);
+		while (true) {
+			streamer.wake.wait(lock, [&] {
+				return streamer.stopping || !streamer.tasks.empty();
+			});
+			if (streamer.tasks.empty()) {
+				return;
 			}
+			std::function<void()> task = std::move(streamer.tasks.front());
+			streamer.tasks.pop_front();
+			lock.unlock();
+			task();
+			lock.lock();
 		}
-		return CreateTextureFromPixels(pixels.data(), width, height, 4);
 	}
 
-	std::filesystem::path ResolveTexturePath(const std::filesystem::path& baseDir, const aiString& texturePath) {
-		if (texturePath.length == 0) {
-			return {};
+	void SubmitStreamerTask(std::function<void()> task) {
+		{
+			std::lock_guard<std::mutex> lock(gTextureStreamer.mutex);
+			gTextureStreamer.tasks.push_back(std::move(task));
 		}
-		std::filesystem::path rawPath(texturePath.C_Str());
-		if (rawPath.is_absolute()) {
-			return rawPath;
+		gTextureStreamer.wake.notify_one();
+	}
+
+	void InitializeTextureStreaming() {
+		TextureStreamer& streamer = gTextureStreamer;
+		const bool hasPixelBuffers = IsGlVersionAtLeast(2, 1) || IsExtensionSupported("GL_ARB_pixel_buffer_object");
+		const bool hasMapRange = (IsGlVersionAtLeast(3, 0) || IsExtensionSupported("GL_ARB_map_buffer_range")) &&
+			pglMapBufferRange != nullptr &&
+			pglUnmapBuffer != nullptr;
+		streamer.supported = hasPixelBuffers && hasMapRange && gHasFenceSync;
+		if (!streamer.supported) {
+			return;
 		}
-		std::filesystem::path candidate = baseDir / rawPath;
-		if (std::filesystem::exists(candidate)) {
-			return candidate;
+		for (UploadSlot& slot : streamer.slots) {
+			pglGenBuffers(1, &slot.buffer);
 		}
-		candidate = baseDir / rawPath.filename();
-		if (std::filesystem::exists(candidate)) {
-			return candidate;
+		streamer.stopping = false;
+		streamer.abandonChains = false;
+		const unsigned int hardwareThreads = std::max(std::thread::hardware_concurrency(), 2u);
+		const unsigned int workerCount = std::min(hardwareThreads - 1u, kMaxStreamerWorkers);
+		for (unsigned int i = 0; i < workerCount; ++i) {
+			streamer.workers.emplace_back(RunStreamerTasks);
 		}
-		return baseDir / rawPath;
 	}
 
-	GLuint LoadTextureFromFile(const std::filesystem::path& path) {
-		if (path.empty()) {
-			return 0;
+	bool IsTextureStreamingActive() {
+		return gTextureStreamer.supported && gTextureStreamer.enabled && !gSoftwareOnly;
+	}
+
+	// True while images are queued or a band is still being copied.
+	bool HasQueuedTextureImages() {
+		const TextureStreamer& streamer = gTextureStreamer;
+		if (!streamer.queue.empty()) {
+			return true;
 		}
-		const std::string key = path.lexically_normal().string();
-		auto it = gTextureCache.find(key);
-		if (it != gTextureCache.end()) {
-			return it->second;
+		for (const UploadSlot& slot : streamer.slots) {
+			if (slot.state == UploadSlot::State::Copying) {
+				return true;
+			}
 		}
+		return false;
+	}
 
-		if (!std::filesystem::exists(path)) {
-			std::fprintf(stderr, "Texture file not found: %s\n", key.c_str());
-			return 0;
+	bool HasPendingTextureUploads() {
+		return HasQueuedTextureImages() || gTextureStreamer.refinementPending;
+	}
+
+	// Coarsest-needed level: the first mip no larger than maxSize on either side.
+	int LevelAtMostSize(int width, int height, int maxSize) {
+		int level = 0;
+		while ((width >> level) > maxSize || (height >> level) > maxSize) {
+			++level;
 		}
+		return level;
+	}
 
-		int width = 0;
-		int height = 0;
-		int channels = 0;
-		stbi_uc* pixels = stbi_load(key.c_str(), &width, &height, &channels, 0);
-		if (!pixels) {
-			std::fprintf(stderr, "Failed to load texture: %s\n", key.c_str());
-			return 0;
+	int MipLevelCount(int width, int height) {
+		int levels = 1;
+		while ((width >> (levels - 1)) > 1 || (height >> (levels - 1)) > 1) {
+			++levels;
 		}
-		GLuint tex = CreateTextureFromPixels(pixels, width, height, channels);
-		stbi_image_free(pixels);
-		if (tex != 0) {
-			gTextureCache.emplace(key, tex);
+		return levels;
+	}
+
+	// Halves a level with a 2x2 box filter; the last row/column of an odd-sized level is dropped, as
+	// in GL's own level sizes.
+	MipLevel DownsampleLevel(const MipLevel& source, int channels) {
+		MipLevel level;
+		level.width = std::max(source.width / 2, 1);
+		level.height = std::max(source.height / 2, 1);
+		const size_t texelBytes = static_cast<size_t>(channels);
+		const size_t sourceRow = static_cast<size_t>(source.width) * texelBytes;
+		std::shared_ptr<unsigned char> pixels(
+			new unsigned char[static_cast<size_t>(level.width) * static_cast<size_t>(level.height) * texelBytes],
+			std::default_delete<unsigned char[]>());
+		const unsigned char* src = source.pixels.get();
+		unsigned char* dst = pixels.get();
+		for (int y = 0; y < level.height; ++y) {
+			const unsigned char* row0 = src + static_cast<size_t>(std::min(2 * y, source.height - 1)) * sourceRow;
+			const unsigned char* row1 = src + static_cast<size_t>(std::min(2 * y + 1, source.height - 1)) * sourceRow;
+			for (int x = 0; x < level.width; ++x) {
+				const size_t x0 = static_cast<size_t>(std::min(2 * x, source.width - 1)) * texelBytes;
+				const size_t x1 = static_cast<size_t>(std::min(2 * x + 1, source.width - 1)) * texelBytes;
+				for (size_t c = 0; c < texelBytes; ++c) {
+					const unsigned int sum = row0[x0 + c] + row0[x1 + c] + row1[x0 + c] + row1[x1 + c];
+					*dst++ = static_cast<unsigned char>((sum + 2u) / 4u);
+				}
+			}
 		}
-		return tex;
+		level.pixels = std::move(pixels);
+		return level;
 	}
 
-	std::vector<std::filesystem::path> BuildAssetRootCandidates() {
-		std::vector<std::filesystem::path> candidates;
-		auto addCandidate = [&](const std::filesystem::path& path) {
-			if (path.empty()) {
+	// Runs on a streamer worker.
+	void BuildMipChain(MipChain& chain, int channels) {
+		for (size_t level = 1; level < chain.levels.size(); ++level) {
+			if (gTextureStreamer.abandonChains.load(std::memory_order_relaxed)) {
 				return;
 			}
-			std::error_code ec;
-			std::filesystem::path normalized = std::filesystem::absolute(path, ec);
-			if (ec) {
-				normalized = path.lexically_normal();
-			} else {
-				normalized = normalized.lexically_normal();
-			}
-			if (std::find(candidates.begin(), candidates.end(), normalized) == candidates.end()) {
-				candidates.push_back(normalized);
-			}
-		};
+			chain.levels[level] = DownsampleLevel(chain.levels[level - 1], channels);
+		}
+		chain.ready.store(true, std::memory_order_release);
+	}
 
-		std::error_code ec;
-		const std::filesystem::path cwd = std::filesystem::current_path(ec);
-		if (!gObjPath.empty()) {
-			std::filesystem::path objPath(gObjPath);
-			if (objPath.is_relative() && !cwd.empty()) {
-				objPath = cwd / objPath;
+	// Approximates mip `level` from at most 4x4 samples per output texel, so a texture can show a
+	// preview right away without filtering all of level 0.
+	MipLevel SamplePreviewLevel(const unsigned char* pixels, int width, int height, int channels, int level) {
+		MipLevel preview;
+		preview.width = std::max(width >> level, 1);
+		preview.height = std::max(height >> level, 1);
+		const size_t texelBytes = static_cast<size_t>(channels);
+		std::shared_ptr<unsigned char> output(
+			new unsigned char[static_cast<size_t>(preview.width) * static_cast<size_t>(preview.height) * texelBytes],
+			std::default_delete<unsigned char[]>());
+		const int samples = std::min(1 << level, 4);
+		unsigned char* dst = output.get();
+		for (int y = 0; y < preview.height; ++y) {
+			const int y0 = y * height / preview.height;
+			const int y1 = (y + 1) * height / preview.height;
+			for (int x = 0; x < preview.width; ++x) {
+				const int x0 = x * width / preview.width;
+				const int x1 = (x + 1) * width / preview.width;
+				std::array<unsigned int, 4> sum{};
+				for (int sy = 0; sy < samples; ++sy) {
+					const int sourceY = y0 + (2 * sy + 1) * (y1 - y0) / (2 * samples);
+					for (int sx = 0; sx < samples; ++sx) {
+						const int sourceX = x0 + (2 * sx + 1) * (x1 - x0) / (2 * samples);
+						const unsigned char* texel = pixels + (static_cast<size_t>(sourceY) * static_cast<size_t>(width) + static_cast<size_t>(sourceX)) * texelBytes;
+						for (size_t c = 0; c < texelBytes; ++c) {
+							sum[c] += texel[c];
+						}
+					}
+				}
+				const unsigned int count = static_cast<unsigned int>(samples * samples);
+				for (size_t c = 0; c < texelBytes; ++c) {
+					*dst++ = static_cast<unsigned char>((sum[c] + count / 2u) / count);
+				}
 			}
-			addCandidate(objPath.parent_path());
 		}
+		preview.pixels = std::move(output);
+		return preview;
+	}
 
-		if (!ec) {
-			addCandidate(cwd);
-			addCandidate(cwd / "out/build/x64-release/GPURenderer");
-			addCandidate(cwd / "out/build/x64-debug/GPURenderer");
-			addCandidate(cwd / "out/x64-release");
-			addCandidate(cwd / "out/x64-debug");
+	// Allocates level 0 of target without data and fills `level` with a nearest-sampled reduction of
+	// pixels, so a cubemap face shows roughly the right colors while level 0 streams in.
+	void UploadPlaceholderLevel(GLenum target, int level, const unsigned char* pixels, int width, int height, int channels, GLenum format, GLenum sourceFormat) {
+		const int placeholderWidth = std::max(width >> level, 1);
+		const int placeholderHeight = std::max(height >> level, 1);
+		const size_t texelBytes = static_cast<size_t>(channels);
+		std::vector<unsigned char> placeholder(static_cast<size_t>(placeholderWidth) * static_cast<size_t>(placeholderHeight) * texelBytes);
+		for (int y = 0; y < placeholderHeight; ++y) {
+			const int sourceY = (2 * y + 1) * height / (2 * placeholderHeight);
+			for (int x = 0; x < placeholderWidth; ++x) {
+				const int sourceX = (2 * x + 1) * width / (2 * placeholderWidth);
+				const unsigned char* texel = pixels + (static_cast<size_t>(sourceY) * static_cast<size_t>(width) + static_cast<size_t>(sourceX)) * texelBytes;
+				std::memcpy(placeholder.data() + (static_cast<size_t>(y) * static_cast<size_t>(placeholderWidth) + static_cast<size_t>(x)) * texelBytes, texel, texelBytes);
+			}
 		}
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+		glTexImage2D(target, 0, format, width, height, 0, sourceFormat, GL_UNSIGNED_BYTE, nullptr);
+		glTexImage2D(target, level, format, placeholderWidth, placeholderHeight, 0, sourceFormat, GL_UNSIGNED_BYTE, placeholder.data());
+	}
 
-		return candidates;
+	void QueueStreamedImage(
+		GLuint texture,
+		GLenum target,
+		GLint level,
+		std::shared_ptr<const unsigned char> pixels,
+		int width,
+		int height,
+		int channels,
+		GLenum sourceFormat) {
+		StreamedTexture& streamed = gTextureStreamer.textures[texture];
+		++streamed.pendingImages;
+		PendingUpload upload;
+		upload.texture = texture;
+		upload.serial = streamed.serial;
+		upload.target = target;
+		upload.level = level;
+		upload.sourceFormat = sourceFormat;
+		upload.width = width;
+		upload.height = height;
+		upload.rowBytes = static_cast<size_t>(width) * static_cast<size_t>(channels);
+		upload.pixels = std::move(pixels);
+		gTextureStreamer.queue.push_back(std::move(upload));
 	}
 
-	std::filesystem::path ResolveCubeObjPath(const std::filesystem::path& root) {
-		const std::filesystem::path nested = root / "cube" / "cube.obj";
-		if (std::filesystem::exists(nested)) {
-			return nested;
-		}
-		const std::filesystem::path flat = root / "cube.obj";
-		if (std::filesystem::exists(flat)) {
-			return flat;
-		}
-		return {};
+	// Registers texture before its images are queued with QueueStreamedImage.
+	StreamedTexture& BeginStreamedTexture(GLuint texture, GLenum bindTarget, bool generateMipmaps) {
+		StreamedTexture& streamed = gTextureStreamer.textures[texture];
+		streamed = StreamedTexture{};
+		streamed.bindTarget = bindTarget;
+		streamed.serial = gTextureStreamer.nextSerial++;
+		streamed.generateMipmaps = generateMipmaps;
+		return streamed;
 	}
 
-	std::filesystem::path ResolveLightObjPath(const std::filesystem::path& root) {
-		const std::filesystem::path nested = root / "light" / "light.obj";
-		if (std::filesystem::exists(nested)) {
-			return nested;
-		}
-		const std::filesystem::path flat = root / "light.obj";
-		if (std::filesystem::exists(flat)) {
-			return flat;
+	// Bytes of one level of a progressive texture; RGB counts as RGBA like EstimateTextureBytes.
+	size_t StreamedLevelBytes(const StreamedTexture& streamed, int level) {
+		const size_t texelBytes = streamed.channels == 3 ? 4u : static_cast<size_t>(streamed.channels);
+		return static_cast<size_t>(std::max(streamed.width >> level, 1)) *
+			static_cast<size_t>(std::max(streamed.height >> level, 1)) *
+			texelBytes;
+	}
+
+	// Bytes of levels [firstLevel, levelCount).
+	size_t StreamedChainBytes(const StreamedTexture& streamed, int firstLevel) {
+		size_t bytes = 0;
+		for (int level = firstLevel; level < streamed.levelCount; ++level) {
+			bytes += StreamedLevelBytes(streamed, level);
 		}
-		return {};
+		return bytes;
 	}
 
-	std::array<std::filesystem::path, 6> BuildCubemapFacePaths(const std::filesystem::path& root) {
-		std::array<std::filesystem::path, 6> faces{};
-		for (size_t i = 0; i < faces.size(); ++i) {
-			faces[i] = root / "cubemap" / kCubemapFaceFiles[i];
+	// GPU bytes of a progressive texture's resident levels, or 0 for any other texture.
+	size_t StreamedTextureBytes(GLuint texture) {
+		auto it = gTextureStreamer.textures.find(texture);
+		if (it == gTextureStreamer.textures.end() || !it->second.chain) {
+			return 0;
 		}
-		return faces;
+		return StreamedChainBytes(it->second, it->second.residentLevel);
 	}
 
-	std::filesystem::path ResolveEnvironmentAssetRoot() {
-		const std::vector<std::filesystem::path> candidates = BuildAssetRootCandidates();
-		for (const std::filesystem::path& root : candidates) {
-			const std::filesystem::path cubePath = ResolveCubeObjPath(root);
-			if (cubePath.empty()) {
-				continue;
-			}
-			const auto cubemapFaces = BuildCubemapFacePaths(root);
-			bool allFacesFound = true;
-			for (const std::filesystem::path& face : cubemapFaces) {
-				if (!std::filesystem::exists(face)) {
-					allFacesFound = false;
-					break;
-				}
-			}
-			if (allFacesFound) {
-				return root;
+	// Like CreateTextureFromPixels, but progressive: the levels from the preview size (at most
+	// kPreviewTextureSize) down are uploaded now and the finer ones are streamed in later, as
+	// UpdateTextureResidency asks for them. Small textures are uploaded directly.
+	GLuint CreateStreamedTexture(std::shared_ptr<const unsigned char> pixels, int width, int height, int channels, bool bgra = false) {
+		const int previewLevel = LevelAtMostSize(width, height, kPreviewTextureSize);
+		if (!pixels || !IsTextureStreamingActive() || previewLevel == 0) {
+			return CreateTextureFromPixels(pixels.get(), width, height, channels, bgra);
+		}
+		bgra = bgra && channels == 4;
+		const auto uploadStart = std::chrono::steady_clock::now();
+		const GLenum format = ChannelsToFormat(channels);
+		const GLenum sourceFormat = bgra ? GL_BGRA : format;
+		const int levelCount = MipLevelCount(width, height);
+		auto chain = std::make_shared<MipChain>();
+		chain->levels.resize(static_cast<size_t>(levelCount));
+		chain->levels[0] = MipLevel{width, height, pixels};
+
+		GLuint tex = 0;
+		glGenTextures(1, &tex);
+		glBindTexture(GL_TEXTURE_2D, tex);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, previewLevel);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, levelCount - 1);
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+		MipLevel preview = SamplePreviewLevel(pixels.get(), width, height, channels, previewLevel);
+		for (int level = previewLevel; level < levelCount; ++level) {
+			if (level > previewLevel) {
+				preview = DownsampleLevel(preview, channels);
 			}
+			glTexImage2D(GL_TEXTURE_2D, level, format, preview.width, preview.height, 0, sourceFormat, GL_UNSIGNED_BYTE, preview.pixels.get());
 		}
-		return {};
+		glBindTexture(GL_TEXTURE_2D, 0);
+
+		StreamedTexture& streamed = BeginStreamedTexture(tex, GL_TEXTURE_2D, false);
+		streamed.chain = chain;
+		streamed.format = format;
+		streamed.sourceFormat = sourceFormat;
+		streamed.channels = channels;
+		streamed.width = width;
+		streamed.height = height;
+		streamed.levelCount = levelCount;
+		streamed.previewLevel = previewLevel;
+		streamed.residentLevel = previewLevel;
+		streamed.targetLevel = previewLevel;
+		SubmitStreamerTask([chain, channels] {
+			BuildMipChain(*chain, channels);
+		});
+		gTextureUploadMs += ElapsedMilliseconds(uploadStart);
+		return tex;
 	}
 
-	bool LoadCubemapTexture(const std::filesystem::path& root) {
-		const auto facePaths = BuildCubemapFacePaths(root);
-		for (const std::filesystem::path& face : facePaths) {
-			if (!std::filesystem::exists(face)) {
-				std::fprintf(stderr, "Cubemap face missing: %s\n", face.string().c_str());
-				return false;
-			}
+	// Drops the queued bands of texture before it is deleted. Bands already copying are still
+	// retired through the ring but no longer uploaded.
+	void CancelStreamedTexture(GLuint texture) {
+		TextureStreamer& streamer = gTextureStreamer;
+		if (streamer.textures.erase(texture) == 0) {
+			return;
 		}
+		streamer.queue.erase(
+			std::remove_if(streamer.queue.begin(), streamer.queue.end(), [texture](const PendingUpload& upload) {
+				return upload.texture == texture;
+			}),
+			streamer.queue.end());
+	}
 
-		GLuint cubemap = 0;
-		glGenTextures(1, &cubemap);
-		if (cubemap == 0) {
+	// Called with the texture bound once the last band of one of its images has been issued. Returns
+	// true when the texture is done streaming and can be forgotten.
+	bool FinishStreamedImage(StreamedTexture& streamed) {
+		if (--streamed.pendingImages > 0) {
 			return false;
 		}
+		if (streamed.chain) {
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, streamed.uploadingLevel);
+			streamed.residentLevel = streamed.uploadingLevel;
+			streamed.uploadingLevel = -1;
+			++gTextureStreamer.levelsRefined;
+			return false;
+		}
+		glTexParameteri(streamed.bindTarget, GL_TEXTURE_BASE_LEVEL, 0);
+		if (streamed.generateMipmaps && pglGenerateMipmap) {
+			glTexParameteri(streamed.bindTarget, GL_TEXTURE_MAX_LEVEL, kDefaultMaxTextureLevel);
+			pglGenerateMipmap(streamed.bindTarget);
+		} else {
+			glTexParameteri(streamed.bindTarget, GL_TEXTURE_MAX_LEVEL, streamed.maxLevel);
+		}
+		++gTextureStreamer.completedTextures;
+		return true;
+	}
 
-		glBindTexture(GL_TEXTURE_CUBE_MAP, cubemap);
-		stbi_set_flip_vertically_on_load(false);
-		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
-
-		bool success = true;
-		for (size_t i = 0; i < facePaths.size(); ++i) {
-			int width = 0;
-			int height = 0;
-			int channels = 0;
-			const std::string facePath = facePaths[i].string();
-			stbi_uc* pixels = stbi_load(facePath.c_str(), &width, &height, &channels, 0);
-			if (!pixels) {
-				std::fprintf(stderr, "Failed to load cubemap face: %s\n", facePath.c_str());
-				success = false;
-				break;
+	// Sources the slot's band from its buffer. The texture may have been deleted since the band was
+	// queued, in which case the buffer is only unmapped.
+	void IssueUploadBand(UploadSlot& slot) {
+		TextureStreamer& streamer = gTextureStreamer;
+		pglBindBuffer(GL_PIXEL_UNPACK_BUFFER, slot.buffer);
+		pglUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+		auto it = streamer.textures.find(slot.texture);
+		if (it != streamer.textures.end() && it->second.serial == slot.serial) {
+			const auto issueStart = std::chrono::steady_clock::now();
+			StreamedTexture& streamed = it->second;
+			glBindTexture(streamed.bindTarget, slot.texture);
+			glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+			glTexSubImage2D(slot.target, slot.level, 0, slot.firstRow, slot.width, slot.rows, slot.sourceFormat, GL_UNSIGNED_BYTE, nullptr);
+			const bool finished = slot.lastBand && FinishStreamedImage(streamed);
+			glBindTexture(streamed.bindTarget, 0);
+			if (finished) {
+				streamer.textures.erase(it);
 			}
+			streamer.maxIssueMs = std::max(streamer.maxIssueMs, ElapsedMilliseconds(issueStart));
+			streamer.uploadedBytes += slot.bytes;
+		}
+		pglBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+		slot.pixels.reset();
+		slot.fence = pglFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		slot.issued = std::chrono::steady_clock::now();
+		slot.state = UploadSlot::State::InFlight;
+	}
 
-			const GLenum format = ChannelsToFormat(channels);
-			glTexImage2D(
-				kCubemapFaceTargets[i],
-				0,
-				format,
-				width,
-				height,
-				0,
-				format,
-				GL_UNSIGNED_BYTE,
-				pixels);
-			stbi_image_free(pixels);
-		}
-		stbi_set_flip_vertically_on_load(true);
-
-		if (!success) {
-			glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
-			glDeleteTextures(1, &cubemap);
+	// Maps the slot's buffer for the next band of the queue's front image and hands the copy to a
+	// worker. Returns false when the buffer could not be mapped.
+	bool BeginUploadBand(UploadSlot& slot, size_t budgetBytes) {
+		TextureStreamer& streamer = gTextureStreamer;
+		PendingUpload& upload = streamer.queue.front();
+		const int rowsLeft = upload.height - upload.nextRow;
+		const int rows = static_cast<int>(std::clamp<size_t>(budgetBytes / upload.rowBytes, 1u, static_cast<size_t>(rowsLeft)));
+		const size_t bytes = static_cast<size_t>(rows) * upload.rowBytes;
+		pglBindBuffer(GL_PIXEL_UNPACK_BUFFER, slot.buffer);
+		if (slot.capacity < bytes) {
+			pglBufferData(GL_PIXEL_UNPACK_BUFFER, static_cast<std::ptrdiff_t>(bytes), nullptr, GL_STREAM_DRAW);
+			slot.capacity = bytes;
+		}
+		void* destination = pglMapBufferRange(
+			GL_PIXEL_UNPACK_BUFFER,
+			0,
+			static_cast<std::ptrdiff_t>(bytes),
+			GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+		pglBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+		if (!destination) {
 			return false;
 		}
 
-		glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-		glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-		glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-		glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-		glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
-		if (gHasAnisotropicFiltering) {
-			glTexParameterf(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAX_ANISOTROPY_EXT, gMaxAnisotropy);
-		}
-		if (pglGenerateMipmap) {
-			pglGenerateMipmap(GL_TEXTURE_CUBE_MAP);
+		slot.texture = upload.texture;
+		slot.serial = upload.serial;
+		slot.target = upload.target;
+		slot.level = upload.level;
+		slot.sourceFormat = upload.sourceFormat;
+		slot.width = upload.width;
+		slot.firstRow = upload.nextRow;
+		slot.rows = rows;
+		slot.bytes = bytes;
+		slot.pixels = upload.pixels;
+		slot.copied.store(false, std::memory_order_relaxed);
+		slot.state = UploadSlot::State::Copying;
+		upload.nextRow += rows;
+		slot.lastBand = upload.nextRow >= upload.height;
+		unsigned char* copyDestination = static_cast<unsigned char*>(destination);
+		const unsigned char* copySource = slot.pixels.get() + static_cast<size_t>(slot.firstRow) * upload.rowBytes;
+		std::atomic<bool>* copied = &slot.copied;
+		SubmitStreamerTask([copyDestination, copySource, bytes, copied] {
+			std::memcpy(copyDestination, copySource, bytes);
+			copied->store(true, std::memory_order_release);
+		});
+		if (slot.lastBand) {
+			streamer.queue.pop_front();
 		}
-		glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
+		return true;
+	}
 
-		if (gEnvironmentCubemap != 0) {
-			glDeleteTextures(1, &gEnvironmentCubemap);
+	// Fallback when a buffer cannot be mapped: uploads the rest of the front image from client memory.
+	void UploadFrontImageDirectly() {
+		TextureStreamer& streamer = gTextureStreamer;
+		PendingUpload upload = std::move(streamer.queue.front());
+		streamer.queue.pop_front();
+		auto it = streamer.textures.find(upload.texture);
+		if (it == streamer.textures.end() || it->second.serial != upload.serial) {
+			return;
+		}
+		StreamedTexture& streamed = it->second;
+		glBindTexture(streamed.bindTarget, upload.texture);
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+		glTexSubImage2D(
+			upload.target,
+			upload.level,
+			0,
+			upload.nextRow,
+			upload.width,
+			upload.height - upload.nextRow,
+			upload.sourceFormat,
+			GL_UNSIGNED_BYTE,
+			upload.pixels.get() + static_cast<size_t>(upload.nextRow) * upload.rowBytes);
+		const bool finished = FinishStreamedImage(streamed);
+		glBindTexture(streamed.bindTarget, 0);
+		if (finished) {
+			streamer.textures.erase(it);
 		}
-		gEnvironmentCubemap = cubemap;
-		return true;
 	}
 
-	bool LoadMesh(const std::string& path,
-		std::vector<Vertex>& vertices,
-		std::vector<unsigned int>& indices,
-		Bounds& bounds,
-		std::vector<Submesh>& submeshes,
-		std::vector<Material>& materials) {
-		Assimp::Importer importer;
-#ifdef AI_CONFIG_IMPORT_OBJ_FAST_VERTICES
-		importer.SetPropertyInteger(AI_CONFIG_IMPORT_OBJ_FAST_VERTICES, 1);
-#endif
-#ifdef AI_CONFIG_IMPORT_OBJ_FAST_MATERIAL
-		importer.SetPropertyInteger(AI_CONFIG_IMPORT_OBJ_FAST_MATERIAL, 1);
-#endif
-		const unsigned int flags =
-			aiProcess_Triangulate |
-			aiProcess_JoinIdenticalVertices;
-		const auto importStart = std::chrono::steady_clock::now();
-		std::printf("Assimp import starting...\n");
-		std::fflush(stdout);
-		const aiScene* scene = importer.ReadFile(
-			path,
-			flags);
-		const auto importEnd = std::chrono::steady_clock::now();
-		const double importSeconds = std::chrono::duration<double>(importEnd - importStart).count();
-		std::printf("Assimp import finished in %.2f seconds.\n", importSeconds);
-		std::fflush(stdout);
-
-		if (!scene || !scene->HasMeshes()) {
-			std::fprintf(stderr, "Assimp failed to load mesh: %s\n", importer.GetErrorString());
-			return false;
+	// Advances the upload ring by one step: retires slots whose fence has passed, uploads the bands
+	// the worker has finished copying, and starts copies for up to budgetBytes of new bands.
+	void UpdateTextureStreaming(size_t budgetBytes) {
+		TextureStreamer& streamer = gTextureStreamer;
+		if (!streamer.supported) {
+			return;
 		}
-
-		vertices.clear();
-		indices.clear();
-		submeshes.clear();
-		materials.clear();
-		bounds = Bounds{};
-
-		std::filesystem::path objPath(path);
-		if (objPath.is_relative()) {
-			objPath = std::filesystem::absolute(objPath);
+		for (UploadSlot& slot : streamer.slots) {
+			if (slot.state != UploadSlot::State::InFlight) {
+				continue;
+			}
+			const GLenum result = pglClientWaitSync(slot.fence, 0, 0);
+			if (result != GL_ALREADY_SIGNALED && result != GL_CONDITION_SATISFIED) {
+				continue;
+			}
+			const double latencyMs = ElapsedMilliseconds(slot.issued);
+			++streamer.fenceSamples;
+			streamer.fenceLatencyMs += latencyMs;
+			streamer.maxFenceLatencyMs = std::max(streamer.maxFenceLatencyMs, latencyMs);
+			pglDeleteSync(slot.fence);
+			slot.fence = nullptr;
+			slot.state = UploadSlot::State::Free;
+		}
+		// Oldest first, stopping at a copy still running, so an image's last band (which finishes the
+		// texture) never lands before the bands cut ahead of it.
+		for (size_t i = 0; i < kUploadRingSlots; ++i) {
+			UploadSlot& slot = streamer.slots[(streamer.nextSlot + i) % kUploadRingSlots];
+			if (slot.state != UploadSlot::State::Copying) {
+				continue;
+			}
+			if (!slot.copied.load(std::memory_order_acquire)) {
+				break;
+			}
+			IssueUploadBand(slot);
 		}
-		const std::filesystem::path baseDir = objPath.parent_path();
-
-		if (scene->mNumMaterials == 0) {
-			materials.emplace_back();
-			materials.front().name = "Default";
-		} else {
-			materials.resize(scene->mNumMaterials);
-			for (unsigned int matIndex = 0; matIndex < scene->mNumMaterials; ++matIndex) {
-				Material mat;
-				mat.name = "Material " + std::to_string(matIndex);
-				const aiMaterial* material = scene->mMaterials[matIndex];
-				if (!material) {
-					materials[matIndex] = mat;
-					continue;
-				}
-
-				auto loadTexture = [&](aiTextureType type, const char* label, GLuint& outTex, bool& hasTex) -> bool {
-					aiString texPath;
-					if (material->GetTextureCount(type) == 0 ||
-						material->GetTexture(type, 0, &texPath) != AI_SUCCESS) {
-						return false;
-					}
-
-					if (texPath.length > 0 && texPath.C_Str()[0] == '*') {
-						const int texIndex = std::atoi(texPath.C_Str() + 1);
-						if (texIndex >= 0 && static_cast<unsigned int>(texIndex) < scene->mNumTextures) {
-							const std::string key = "*" + std::to_string(texIndex);
-							auto it = gTextureCache.find(key);
-							if (it != gTextureCache.end()) {
-								outTex = it->second;
-							} else {
-								outTex = LoadTextureFromMemory(scene->mTextures[texIndex]);
-								if (outTex != 0) {
-									gTextureCache.emplace(key, outTex);
-								}
-							}
-						}
-					} else {
-						const std::filesystem::path resolved = ResolveTexturePath(baseDir, texPath);
-						outTex = LoadTextureFromFile(resolved);
-					}
-
-					hasTex = outTex != 0;
-					if (!hasTex) {
-						std::fprintf(stderr, "Material %u %s texture failed: %s\n",
-							matIndex,
-							label,
-							texPath.C_Str());
-					}
-					return hasTex;
-				};
-
-				aiString materialName;
-				if (material->Get(AI_MATKEY_NAME, materialName) == AI_SUCCESS && materialName.length > 0) {
-					mat.name = materialName.C_Str();
-				}
-				aiColor3D color(0.0f, 0.0f, 0.0f);
-				if (material->Get(AI_MATKEY_COLOR_AMBIENT, color) == AI_SUCCESS) {
-					mat.ambient = ToVec3(color);
-				}
-				if (material->Get(AI_MATKEY_COLOR_DIFFUSE, color) == AI_SUCCESS) {
-					mat.diffuse = ToVec3(color);
-				}
-				if (material->Get(AI_MATKEY_COLOR_SPECULAR, color) == AI_SUCCESS) {
-					mat.specular = ToVec3(color);
-				}
-				float shininess = 0.0f;
-				if (material->Get(AI_MATKEY_SHININESS, shininess) == AI_SUCCESS && shininess > 0.0f) {
-					mat.shininess = shininess;
-				}
-
-				if (!loadTexture(aiTextureType_DIFFUSE, "diffuse", mat.diffuseTexture, mat.hasDiffuseTexture)) {
-					if (!loadTexture(aiTextureType_BASE_COLOR, "base_color", mat.diffuseTexture, mat.hasDiffuseTexture)) {
-						loadTexture(aiTextureType_AMBIENT, "ambient", mat.diffuseTexture, mat.hasDiffuseTexture);
-					}
-				}
-
-				if (!loadTexture(aiTextureType_SPECULAR, "specular", mat.specularTexture, mat.hasSpecularTexture)) {
-					if (!loadTexture(aiTextureType_SHININESS, "shininess", mat.specularTexture, mat.hasSpecularTexture)) {
-						if (!loadTexture(aiTextureType_METALNESS, "metalness", mat.specularTexture, mat.hasSpecularTexture)) {
-							loadTexture(aiTextureType_REFLECTION, "reflection", mat.specularTexture, mat.hasSpecularTexture);
-						}
-					}
-				}
-				if (mat.hasSpecularTexture) {
-					const float maxSpec = std::max(mat.specular.x, std::max(mat.specular.y, mat.specular.z));
-					if (maxSpec <= 0.001f) {
-						mat.specular = glm::vec3(1.0f);
-					}
-				}
 
-				materials[matIndex] = mat;
+		size_t started = 0;
+		while (!streamer.queue.empty() && started < budgetBytes) {
+			UploadSlot& slot = streamer.slots[streamer.nextSlot];
+			if (slot.state == UploadSlot::State::InFlight) {
+				++streamer.fenceStalls;
+				break;
+			}
+			if (slot.state == UploadSlot::State::Copying) {
+				++streamer.copyStalls;
+				break;
 			}
+			if (!BeginUploadBand(slot, budgetBytes - started)) {
+				UploadFrontImageDirectly();
+				continue;
+			}
+			started += slot.bytes;
+			streamer.nextSlot = (streamer.nextSlot + 1) % kUploadRingSlots;
 		}
+	}
 
-		const auto buildStart = std::chrono::steady_clock::now();
-		for (unsigned int meshIndex = 0; meshIndex < scene->mNumMeshes; ++meshIndex) {
-			const aiMesh* mesh = scene->mMeshes[meshIndex];
-			if (!mesh || mesh->mNumVertices == 0) {
-				continue;
+	void ShutdownTextureStreaming() {
+		TextureStreamer& streamer = gTextureStreamer;
+		streamer.abandonChains = true;
+		{
+			std::lock_guard<std::mutex> lock(streamer.mutex);
+			streamer.stopping = true;
+		}
+		streamer.wake.notify_all();
+		// Workers drain the queued band copies before exiting, so the mapped buffers are quiet below.
+		for (std::thread& worker : streamer.workers) {
+			worker.join();
+		}
+		streamer.workers.clear();
+		for (UploadSlot& slot : streamer.slots) {
+			if (slot.state == UploadSlot::State::Copying) {
+				pglBindBuffer(GL_PIXEL_UNPACK_BUFFER, slot.buffer);
+				pglUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+				pglBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
 			}
-			if (!mesh->HasTextureCoords(0)) {
-				std::fprintf(stderr, "Mesh %u has no texture coordinates.\n", meshIndex);
+			if (slot.fence != nullptr) {
+				pglDeleteSync(slot.fence);
+				slot.fence = nullptr;
 			}
-			const bool hasNormals = mesh->HasNormals();
-
-			const unsigned int baseIndex = static_cast<unsigned int>(vertices.size());
-			vertices.reserve(vertices.size() + mesh->mNumVertices);
-
-			for (unsigned int i = 0; i < mesh->mNumVertices; ++i) {
-				const aiVector3D pos = mesh->mVertices[i];
-				aiVector3D normal(0.0f, 0.0f, 0.0f);
-				if (hasNormals) {
-					normal = mesh->mNormals[i];
-				}
-				aiVector3D uv(0.0f, 0.0f, 0.0f);
-				if (mesh->HasTextureCoords(0)) {
-					uv = mesh->mTextureCoords[0][i];
-				}
-				Vertex vertex;
-				vertex.position = glm::vec3(pos.x, pos.y, pos.z);
-				vertex.normal = glm::vec3(normal.x, normal.y, normal.z);
-				vertex.texcoord = glm::vec2(uv.x, uv.y);
-				vertices.push_back(vertex);
-				bounds.Expand(vertex.position);
+			if (slot.buffer != 0 && pglDeleteBuffers) {
+				pglDeleteBuffers(1, &slot.buffer);
 			}
+			slot.buffer = 0;
+			slot.capacity = 0;
+			slot.pixels.reset();
+			slot.state = UploadSlot::State::Free;
+		}
+		streamer.tasks.clear();
+		streamer.queue.clear();
+		streamer.textures.clear();
+		streamer.nextSlot = 0;
+		streamer.refinementPending = false;
+		streamer.supported = false;
+	}
 
-			const unsigned int indexOffset = static_cast<unsigned int>(indices.size());
-			for (unsigned int i = 0; i < mesh->mNumFaces; ++i) {
-				const aiFace& face = mesh->mFaces[i];
-				if (face.mNumIndices != 3) {
-					continue;
-				}
-				indices.push_back(baseIndex + face.mIndices[0]);
-				indices.push_back(baseIndex + face.mIndices[1]);
-				indices.push_back(baseIndex + face.mIndices[2]);
+	void RunUploadThread(GLFWwindow* window) {
+		glfwMakeContextCurrent(window);
+		UploadThread& uploads = gUploadThread;
+		for (;;) {
+			std::shared_ptr<UploadRequest> request;
+			uploads.requests.WaitPop(request);
+			if (!request) {
+				break;
 			}
-
-			const unsigned int indexCount = static_cast<unsigned int>(indices.size()) - indexOffset;
-			if (!hasNormals && indexCount > 0) {
-				ComputeNormalsForMesh(
-					vertices,
-					indices,
-					baseIndex,
-					mesh->mNumVertices,
-					indexOffset,
-					indexCount);
+			if (request->upload) {
+				request->upload();
 			}
-			if (indexCount > 0) {
-				Submesh submesh;
-				submesh.indexOffset = static_cast<int>(indexOffset);
-				submesh.indexCount = static_cast<int>(indexCount);
-				if (mesh->mMaterialIndex < materials.size()) {
-					submesh.materialIndex = static_cast<int>(mesh->mMaterialIndex);
-				} else {
-					submesh.materialIndex = 0;
-				}
-				submeshes.push_back(submesh);
+			request->fence = pglFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+			// The render thread waits on this fence from its own context, which cannot flush ours.
+			if (request->fence != nullptr) {
+				glFlush();
+			} else {
+				glFinish();
 			}
+			uploads.completed.Push(std::move(request));
+			// An idle on-demand loop has to wake up to publish it.
+			gpurenderer::RequestRedraw();
 		}
+		glFinish();
+		glfwMakeContextCurrent(nullptr);
+	}
 
-		if (!bounds.valid || vertices.empty() || indices.empty()) {
-			std::fprintf(stderr, "Mesh contained no valid triangles: %s\n", path.c_str());
+	// Starts the upload thread on a hidden 1x1 window sharing gWindow's objects. Needs fences to hand
+	// work back and glCopyBufferSubData to move staged geometry into the arena; without either, loads
+	// stay on the render thread.
+	bool InitializeUploadThread() {
+		if (gSoftwareOnly || !gHasFenceSync || !gHasCopyBuffer || gWindow == nullptr) {
 			return false;
 		}
-		const auto buildEnd = std::chrono::steady_clock::now();
-		const double buildSeconds = std::chrono::duration<double>(buildEnd - buildStart).count();
-		std::printf("Mesh build finished in %.2f seconds.\n", buildSeconds);
-		std::fflush(stdout);
-
+		glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+		GLFWwindow* window = glfwCreateWindow(1, 1, "GPURenderer Upload", nullptr, gWindow);
+		if (window == nullptr) {
+			std::fprintf(stderr, "Failed to create the upload context; loading on the render thread.\n");
+			return false;
+		}
+		// Creating the window can leave its context current on some platforms.
+		glfwMakeContextCurrent(gWindow);
+		gUploadThread.window = window;
+		gUploadThread.thread = std::thread(RunUploadThread, window);
 		return true;
 	}
 
-	void DestroyBackgroundBuffers() {
-		if (pglDeleteBuffers) {
-			if (gBackgroundEbo != 0) {
-				pglDeleteBuffers(1, &gBackgroundEbo);
-				gBackgroundEbo = 0;
+	bool IsUploadThreadActive() {
+		return gUploadThread.window != nullptr;
+	}
+
+	// Render thread: finished uploads still waiting for their fence to pass.
+	bool HasFencedUploads() {
+		return !gUploadThread.fenced.empty();
+	}
+
+	// Any thread. upload runs on the upload context; publish runs on the render thread from
+	// PollUploadThread once the GPU has finished the upload, in submission order.
+	void SubmitUpload(std::function<void()> upload, std::function<void()> publish) {
+		auto request = std::make_shared<UploadRequest>();
+		request->upload = std::move(upload);
+		request->publish = std::move(publish);
+		request->submitted = std::chrono::steady_clock::now();
+		gUploadThread.inFlight.fetch_add(1);
+		gUploadThread.requests.Push(std::move(request));
+	}
+
+	// Publishes finished uploads whose fence has passed. wait blocks until everything submitted so far
+	// is published.
+	void PollUploadThread(bool wait) {
+		UploadThread& uploads = gUploadThread;
+		for (;;) {
+			std::shared_ptr<UploadRequest> request;
+			while (uploads.completed.TryPop(request)) {
+				uploads.fenced.push_back(std::move(request));
 			}
-			if (gBackgroundVbo != 0) {
-				pglDeleteBuffers(1, &gBackgroundVbo);
-				gBackgroundVbo = 0;
+			while (!uploads.fenced.empty()) {
+				UploadRequest& front = *uploads.fenced.front();
+				if (front.fence != nullptr) {
+					const GLenum result = pglClientWaitSync(front.fence, 0, wait ? kFenceWaitTimeoutNs : 0);
+					if (result != GL_ALREADY_SIGNALED && result != GL_CONDITION_SATISFIED) {
+						break;
+					}
+					pglDeleteSync(front.fence);
+					front.fence = nullptr;
+				}
+				if (front.publish) {
+					front.publish();
+				}
+				const double latencyMs = ElapsedMilliseconds(front.submitted);
+				uploads.publishLatencyMs += latencyMs;
+				uploads.maxPublishLatencyMs = std::max(uploads.maxPublishLatencyMs, latencyMs);
+				uploads.fenced.pop_front();
+				++uploads.published;
+				uploads.inFlight.fetch_sub(1);
+			}
+			if (!wait || uploads.inFlight.load() == 0) {
+				return;
+			}
+			if (uploads.fenced.empty()) {
+				uploads.completed.WaitPop(request);
+				uploads.fenced.push_back(std::move(request));
 			}
 		}
-		if (gUseVao && pglDeleteVertexArrays && gBackgroundVao != 0) {
-			pglDeleteVertexArrays(1, &gBackgroundVao);
-			gBackgroundVao = 0;
-		}
-		gBackgroundIndexCount = 0;
 	}
 
-	void CreateBackgroundBuffers(const std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices) {
-		DestroyBackgroundBuffers();
+	void StartIoThread() {
+		gIoThread.thread = std::thread([] {
+			for (;;) {
+				std::function<void()> work;
+				gIoThread.work.WaitPop(work);
+				if (!work) {
+					break;
+				}
+				work();
+			}
+		});
+	}
 
-		if (gUseVao) {
-			pglGenVertexArrays(1, &gBackgroundVao);
-			pglBindVertexArray(gBackgroundVao);
+	void StopIoThread() {
+		if (gIoThread.thread.joinable()) {
+			gIoThread.work.Push(nullptr);
+			gIoThread.thread.join();
 		}
+	}
 
-		pglGenBuffers(1, &gBackgroundVbo);
-		pglBindBuffer(GL_ARRAY_BUFFER, gBackgroundVbo);
-		pglBufferData(
-			GL_ARRAY_BUFFER,
-			static_cast<std::ptrdiff_t>(vertices.size() * sizeof(Vertex)),
-			vertices.data(),
-			GL_STATIC_DRAW);
-
-		pglGenBuffers(1, &gBackgroundEbo);
-		pglBindBuffer(GL_ELEMENT_ARRAY_BUFFER, gBackgroundEbo);
-		pglBufferData(
-			GL_ELEMENT_ARRAY_BUFFER,
-			static_cast<std::ptrdiff_t>(indices.size() * sizeof(unsigned int)),
-			indices.data(),
-			GL_STATIC_DRAW);
+	// Call once nothing can submit any more: the queued uploads still run and publish.
+	void ShutdownUploadThread() {
+		UploadThread& uploads = gUploadThread;
+		if (!IsUploadThreadActive()) {
+			return;
+		}
+		uploads.requests.Push(nullptr);
+		uploads.thread.join();
+		PollUploadThread(true);
+		glfwDestroyWindow(uploads.window);
+		uploads.window = nullptr;
+	}
 
-		pglEnableVertexAttribArray(0);
-		pglVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), reinterpret_cast<void*>(offsetof(Vertex, position)));
-		pglEnableVertexAttribArray(1);
-		pglVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), reinterpret_cast<void*>(offsetof(Vertex, normal)));
-		pglEnableVertexAttribArray(2);
-		pglVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), reinterpret_cast<void*>(offsetof(Vertex, texcoord)));
+	// Bytes for width x height texels, plus about a third more when a full mip chain exists. RGB is
+	// counted as four bytes since drivers pad it to RGBA.
+	size_t EstimateTextureBytes(int width, int height, int channels, bool mipmapped) {
+		const size_t texelBytes = channels == 3 ? 4u : static_cast<size_t>(std::clamp(channels, 1, 4));
+		const size_t base = static_cast<size_t>(width) * static_cast<size_t>(height) * texelBytes;
+		return mipmapped ? base + base / 3u : base;
+	}
 
-		if (gUseVao) {
-			pglBindVertexArray(0);
-		}
-		gBackgroundIndexCount = static_cast<int>(indices.size());
+	bool IsTextureCached(const std::string& key) {
+		return gTextureCache.entries.count(key) != 0;
 	}
 
-	bool InitializeEnvironmentAssets() {
-		gAssetRoot = ResolveEnvironmentAssetRoot();
-		if (gAssetRoot.empty()) {
-			gEnvironmentLoadStatus = "Environment assets not found (expected cube/ and cubemap/ folders).";
-			return false;
+	// Returns the cached texture for key (0 on a miss) and counts the lookup.
+	GLuint FindCachedTexture(const std::string& key) {
+		auto it = gTextureCache.entries.find(key);
+		if (it == gTextureCache.entries.end()) {
+			++gTextureCache.misses;
+			return 0;
 		}
+		++gTextureCache.hits;
+		it->second.lastUse = ++gTextureCache.useClock;
+		return it->second.texture;
+	}
 
-		const std::filesystem::path cubePath = ResolveCubeObjPath(gAssetRoot);
-		if (cubePath.empty()) {
-			gEnvironmentLoadStatus = "Environment asset root found, but cube.obj is missing.";
-			return false;
+	void CacheTexture(const std::string& key, GLuint texture, size_t bytes) {
+		if (texture == 0) {
+			return;
 		}
-
-		std::vector<Vertex> backgroundVertices;
-		std::vector<unsigned int> backgroundIndices;
-		std::vector<Submesh> backgroundSubmeshes;
-		std::vector<Material> backgroundMaterials;
-		Bounds backgroundBounds;
-		if (!LoadMesh(
-			cubePath.string(),
-			backgroundVertices,
-			backgroundIndices,
-			backgroundBounds,
-			backgroundSubmeshes,
-			backgroundMaterials)) {
-			gEnvironmentLoadStatus = "Failed to load cube background mesh: " + cubePath.string();
-			return false;
+		// Progressive textures are charged for the levels actually on the GPU.
+		if (const size_t streamedBytes = StreamedTextureBytes(texture)) {
+			bytes = streamedBytes;
 		}
-		CreateBackgroundBuffers(backgroundVertices, backgroundIndices);
+		TextureCacheEntry& entry = gTextureCache.entries[key];
+		entry.texture = texture;
+		entry.bytes = bytes;
+		entry.lastUse = ++gTextureCache.useClock;
+		gTextureCache.keys[texture] = key;
+		gTextureCache.residentBytes += bytes;
+	}
 
-		if (!LoadCubemapTexture(gAssetRoot)) {
-			gEnvironmentLoadStatus = "Failed to load cubemap texture set from: " + (gAssetRoot / "cubemap").string();
-			return false;
+	void RetainTexture(GLuint texture) {
+		auto key = gTextureCache.keys.find(texture);
+		if (key != gTextureCache.keys.end()) {
+			++gTextureCache.entries[key->second].references;
 		}
-
-		gEnvironmentLoadStatus = "Loaded environment assets from: " + gAssetRoot.string();
-		return true;
 	}
 
-	GLuint CompileShader(GLenum type, const std::string& source, const char* label) {
-		const char* src = source.c_str();
-		GLuint shader = pglCreateShader(type);
-		pglShaderSource(shader, 1, &src, nullptr);
-		pglCompileShader(shader);
+	void RetainMaterialTextures(const Material& material) {
+		RetainTexture(material.diffuseTexture);
+		RetainTexture(material.specularTexture);
+	}
 
-		GLint status = 0;
-		pglGetShaderiv(shader, GL_COMPILE_STATUS, &status);
-		if (status == GL_TRUE) {
-			return shader;
+	// A texture was in use up to the moment its last material lets go, so eviction goes by release
+	// order rather than by when the texture was loaded.
+	void ReleaseMaterialTextures(const Material& material) {
+		for (GLuint texture : {material.diffuseTexture, material.specularTexture}) {
+			auto key = gTextureCache.keys.find(texture);
+			if (key != gTextureCache.keys.end()) {
+				TextureCacheEntry& entry = gTextureCache.entries[key->second];
+				entry.references = std::max(entry.references - 1, 0);
+				entry.lastUse = ++gTextureCache.useClock;
+			}
 		}
+	}
 
-		GLint logLength = 0;
-		pglGetShaderiv(shader, GL_INFO_LOG_LENGTH, &logLength);
-		std::string log(static_cast<size_t>(logLength), '\0');
-		if (logLength > 0) {
-			pglGetShaderInfoLog(shader, logLength, nullptr, log.data());
+	void DeleteCachedTexture(GLuint texture) {
+		if (!gSoftwareOnly) {
+			CancelStreamedTexture(texture);
+			glDeleteTextures(1, &texture);
 		}
-		std::fprintf(stderr, "Shader compile failed (%s):\n%s\n", label, log.c_str());
-		pglDeleteShader(shader);
-		return 0;
+		// With GL this drops the CPU readback; the id may be reused by the next texture.
+		gSoftwareTextures.erase(texture);
 	}
 
-	GLuint LinkProgram(GLuint vertexShader, GLuint fragmentShader) {
-		GLuint program = pglCreateProgram();
-		pglAttachShader(program, vertexShader);
-		pglAttachShader(program, fragmentShader);
-		pglBindAttribLocation(program, 0, "aPosition");
-		pglBindAttribLocation(program, 1, "aNormal");
-		pglBindAttribLocation(program, 2, "aTexCoord");
-		pglLinkProgram(program);
-
-		GLint status = 0;
-		pglGetProgramiv(program, GL_LINK_STATUS, &status);
-		if (status == GL_TRUE) {
-			return program;
+	// Drops unreferenced textures, oldest use first, until the resident total fits the budget. Call only
+	// once the materials of any in-progress load have been retained, or their textures could go.
+	void EvictTextures() {
+		const size_t budget = static_cast<size_t>(gTextureCache.budgetMb) * 1024u * 1024u;
+		if (gTextureCache.residentBytes <= budget) {
+			return;
+		}
+		std::vector<std::pair<std::uint64_t, std::string>> candidates;
+		for (const auto& [key, entry] : gTextureCache.entries) {
+			if (entry.references == 0) {
+				candidates.emplace_back(entry.lastUse, key);
+			}
+		}
+		std::sort(candidates.begin(), candidates.end());
+		for (const auto& candidate : candidates) {
+			if (gTextureCache.residentBytes <= budget) {
+				break;
+			}
+			auto it = gTextureCache.entries.find(candidate.second);
+			DeleteCachedTexture(it->second.texture);
+			gTextureCache.keys.erase(it->second.texture);
+			gTextureCache.residentBytes -= it->second.bytes;
+			gTextureCache.entries.erase(it);
+			++gTextureCache.evictions;
 		}
+	}
 
-		GLint logLength = 0;
-		pglGetProgramiv(program, GL_INFO_LOG_LENGTH, &logLength);
-		std::string log(static_cast<size_t>(logLength), '\0');
-		if (logLength > 0) {
-			pglGetProgramInfoLog(program, logLength, nullptr, log.data());
+	// Deletes every cached texture; the counters and budget survive.
+	void ClearTextureCache() {
+		for (const auto& entry : gTextureCache.entries) {
+			DeleteCachedTexture(entry.second.texture);
 		}
-		std::fprintf(stderr, "Program link failed:\n%s\n", log.c_str());
-		pglDeleteProgram(program);
-		return 0;
+		gTextureCache.entries.clear();
+		gTextureCache.keys.clear();
+		gTextureCache.residentBytes = 0;
 	}
 
-	bool ReloadShaders() {
-		std::string vertexSource = ReadFileText(gVertexShaderPath);
-		std::string fragmentSource = ReadFileText(gFragmentShaderPath);
+	// Layer of a material texture in the texture arrays, or null when it is not packed.
+	const PackedTextureLayer* FindPackedLayer(GLuint texture) {
+		auto it = gMaterialBatching.layers.find(texture);
+		return it != gMaterialBatching.layers.end() ? &it->second : nullptr;
+	}
 
-		if (vertexSource.empty()) {
-			std::fprintf(stderr, "Vertex shader missing, using fallback: %s\n", gVertexShaderPath.c_str());
-			vertexSource = kFallbackVertexShader;
+	// Arrays holding a material's diffuse and specular maps (-1 where it has none). Returns false when
+	// a map it has is not packed, so the material has to be drawn on its own.
+	bool FindMaterialArrays(const Material& material, int& diffuseArray, int& specularArray) {
+		diffuseArray = -1;
+		specularArray = -1;
+		if (material.hasDiffuseTexture) {
+			const PackedTextureLayer* layer = FindPackedLayer(material.diffuseTexture);
+			if (!layer) {
+				return false;
+			}
+			diffuseArray = layer->array;
 		}
-		if (fragmentSource.empty()) {
-			std::fprintf(stderr, "Fragment shader missing, using fallback: %s\n", gFragmentShaderPath.c_str());
-			fragmentSource = kFallbackFragmentShader;
+		if (material.hasSpecularTexture) {
+			const PackedTextureLayer* layer = FindPackedLayer(material.specularTexture);
+			if (!layer) {
+				return false;
+			}
+			specularArray = layer->array;
 		}
+		return true;
+	}
 
-		GLuint newVertex = CompileShader(GL_VERTEX_SHADER, vertexSource, "vertex");
-		if (!newVertex) {
-			return false;
-		}
-		GLuint newFragment = CompileShader(GL_FRAGMENT_SHADER, fragmentSource, "fragment");
-		if (!newFragment) {
-			pglDeleteShader(newVertex);
-			return false;
-		}
+	bool IsMaterialBatchingActive() {
+		const MaterialBatching& batching = gMaterialBatching;
+		return batching.supported && batching.enabled && batching.shaderReady && !batching.dirty;
+	}
 
-		GLuint newProgram = LinkProgram(newVertex, newFragment);
-		pglDeleteShader(newVertex);
-		pglDeleteShader(newFragment);
-		if (!newProgram) {
-			return false;
-		}
+	// True when model's submeshes of material are drawn through the material table rather than with
+	// their own texture binds.
+	bool UsesMaterialTable(const SceneModel& model, const Material& material) {
+		int diffuseArray = -1;
+		int specularArray = -1;
+		return IsMaterialBatchingActive() && model.materialSlots && FindMaterialArrays(material, diffuseArray, specularArray);
+	}
 
-		if (gProgram != 0) {
-			pglDeleteProgram(gProgram);
-		}
-		gProgram = newProgram;
-		gMvpLocation = pglGetUniformLocation(gProgram, "uMvp");
-		gModelLocation = pglGetUniformLocation(gProgram, "uModel");
-		gViewLocation = pglGetUniformLocation(gProgram, "uView");
-		gNormalMatrixLocation = pglGetUniformLocation(gProgram, "uNormalMatrix");
-		gWorldNormalMatrixLocation = pglGetUniformLocation(gProgram, "uWorldNormalMatrix");
-		gLightPosLocation = pglGetUniformLocation(gProgram, "uLightPosView");
-		gLightColorLocation = pglGetUniformLocation(gProgram, "uLightColor");
-		gAmbientLocation = pglGetUniformLocation(gProgram, "uAmbientColor");
-		gDiffuseLocation = pglGetUniformLocation(gProgram, "uDiffuseColor");
-		gSpecularLocation = pglGetUniformLocation(gProgram, "uSpecularColor");
-		gMarkerColorLocation = pglGetUniformLocation(gProgram, "uMarkerColor");
-		gShininessLocation = pglGetUniformLocation(gProgram, "uShininess");
-		gShadeModeLocation = pglGetUniformLocation(gProgram, "uShadeMode");
-		gDiffuseMapLocation = pglGetUniformLocation(gProgram, "uDiffuseMap");
-		gSpecularMapLocation = pglGetUniformLocation(gProgram, "uSpecularMap");
-		gUseDiffuseMapLocation = pglGetUniformLocation(gProgram, "uUseDiffuseMap");
-		gUseSpecularMapLocation = pglGetUniformLocation(gProgram, "uUseSpecularMap");
-		gPlaneColorBiasLocation = pglGetUniformLocation(gProgram, "uPlaneColorBias");
-		gEnvMapLocation = pglGetUniformLocation(gProgram, "uEnvMap");
-		gUseEnvMapLocation = pglGetUniformLocation(gProgram, "uUseEnvMap");
-		gInvViewRotationLocation = pglGetUniformLocation(gProgram, "uInvViewRotation");
-		gEnvReflectionStrengthLocation = pglGetUniformLocation(gProgram, "uEnvReflectionStrength");
-		gPlaneReflectionStrengthLocation = pglGetUniformLocation(gProgram, "uPlaneReflectionStrength");
-		gPlaneEnvStrengthLocation = pglGetUniformLocation(gProgram, "uPlaneEnvStrength");
-		gPlaneReflectionBrightnessLocation = pglGetUniformLocation(gProgram, "uPlaneReflectionBrightness");
-		gReflectionViewProjLocation = pglGetUniformLocation(gProgram, "uReflectionViewProj");
-		gLightDirLocation = pglGetUniformLocation(gProgram, "uLightDirView");
-		gLightViewProjLocation = pglGetUniformLocation(gProgram, "uLightViewProj");
-		gShadowMapLocation = pglGetUniformLocation(gProgram, "uShadowMap");
-		gReceiveShadowsLocation = pglGetUniformLocation(gProgram, "uReceiveShadows");
-		gShadowBiasLocation = pglGetUniformLocation(gProgram, "uShadowBias");
-		gUseSpotLightLocation = pglGetUniformLocation(gProgram, "uUseSpotLight");
-		gSpotCosInnerLocation = pglGetUniformLocation(gProgram, "uSpotCosInner");
-		gSpotCosOuterLocation = pglGetUniformLocation(gProgram, "uSpotCosOuter");
-
-		pglUseProgram(gProgram);
-		if (gDiffuseMapLocation >= 0) {
-			pglUniform1i(gDiffuseMapLocation, 0);
-		}
-		if (gSpecularMapLocation >= 0) {
-			pglUniform1i(gSpecularMapLocation, 1);
-		}
-		if (gEnvMapLocation >= 0) {
-			pglUniform1i(gEnvMapLocation, 2);
-		}
-		if (gShadowMapLocation >= 0) {
-			pglUniform1i(gShadowMapLocation, 3);
+	void DestroyTextureArrays() {
+		MaterialBatching& batching = gMaterialBatching;
+		for (const TextureArray& array : batching.arrays) {
+			glDeleteTextures(1, &array.texture);
 		}
-		pglUseProgram(0);
-		return true;
+		batching.arrays.clear();
+		batching.layers.clear();
+		batching.arrayBytes = 0;
 	}
 
-	bool ReloadDepthShader() {
-		GLuint depthVertex = CompileShader(GL_VERTEX_SHADER, kDepthVertexShader, "depth vertex");
-		if (!depthVertex) {
-			return false;
-		}
-		GLuint depthFragment = CompileShader(GL_FRAGMENT_SHADER, kDepthFragmentShader, "depth fragment");
-		if (!depthFragment) {
-			pglDeleteShader(depthVertex);
-			return false;
+	// Where the texels of one material texture come from when it is packed.
+	struct PackSource {
+		GLuint texture = 0;
+		GLint internalFormat = 0;
+		int width = 0;
+		int height = 0;
+		int levels = 1;
+		int channels = 4;
+		bool compressed = false;
+		GLint compressedBytes = 0;
+		std::array<GLint, 4> swizzle{GL_RED, GL_GREEN, GL_BLUE, GL_ALPHA};
+		// Progressive textures are packed from their CPU mip chain, since the GPU copy may be trimmed.
+		std::shared_ptr<MipChain> chain;
+		GLenum sourceFormat = GL_RGBA;
+
+		auto Key() const {
+			return std::tie(internalFormat, width, height, levels, compressed, swizzle);
 		}
+	};
 
-		GLuint newDepthProgram = LinkProgram(depthVertex, depthFragment);
-		pglDeleteShader(depthVertex);
-		pglDeleteShader(depthFragment);
-		if (!newDepthProgram) {
-			return false;
+	// Fills source for a material texture. Returns false when it cannot be packed; pending is set when
+	// it could be once its mip chain is built, unless wait is set, in which case this blocks until then.
+	bool DescribePackSource(GLuint texture, bool wait, PackSource& source, bool& pending) {
+		source.texture = texture;
+		auto streamed = gTextureStreamer.textures.find(texture);
+		if (streamed != gTextureStreamer.textures.end()) {
+			const StreamedTexture& entry = streamed->second;
+			if (!entry.chain || entry.bindTarget != GL_TEXTURE_2D) {
+				return false;
+			}
+			while (wait && !entry.chain->ready.load(std::memory_order_acquire)) {
+				std::this_thread::yield();
+			}
+			if (!entry.chain->ready.load(std::memory_order_acquire)) {
+				pending = true;
+				return false;
+			}
+			source.chain = entry.chain;
+			source.internalFormat = static_cast<GLint>(entry.format);
+			source.sourceFormat = entry.sourceFormat;
+			source.width = entry.width;
+			source.height = entry.height;
+			source.levels = entry.levelCount;
+			source.channels = entry.channels;
+			return true;
 		}
 
-		if (gDepthProgram != 0) {
-			pglDeleteProgram(gDepthProgram);
+		GLint compressed = GL_FALSE;
+		glBindTexture(GL_TEXTURE_2D, texture);
+		glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_WIDTH, &source.width);
+		glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_HEIGHT, &source.height);
+		glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_INTERNAL_FORMAT, &source.internalFormat);
+		glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_COMPRESSED, &compressed);
+		if (compressed == GL_TRUE) {
+			glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_COMPRESSED_IMAGE_SIZE, &source.compressedBytes);
 		}
-		gDepthProgram = newDepthProgram;
-		gDepthMvpLocation = pglGetUniformLocation(gDepthProgram, "uDepthMvp");
-		return true;
-	}
-
-	void CreateBuffers() {
-		if (gUseVao) {
-			pglGenVertexArrays(1, &gVao);
-			pglBindVertexArray(gVao);
+		if (gHasTextureSwizzle) {
+			glGetTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_RGBA, source.swizzle.data());
 		}
-
-		pglGenBuffers(1, &gVbo);
-		pglBindBuffer(GL_ARRAY_BUFFER, gVbo);
-		pglBufferData(
-			GL_ARRAY_BUFFER,
-			static_cast<std::ptrdiff_t>(gVertices.size() * sizeof(Vertex)),
-			gVertices.data(),
-			GL_STATIC_DRAW);
-
-		pglGenBuffers(1, &gEbo);
-		pglBindBuffer(GL_ELEMENT_ARRAY_BUFFER, gEbo);
-		pglBufferData(
-			GL_ELEMENT_ARRAY_BUFFER,
-			static_cast<std::ptrdiff_t>(gIndices.size() * sizeof(unsigned int)),
-			gIndices.data(),
-			GL_STATIC_DRAW);
-
-		pglEnableVertexAttribArray(0);
-		pglVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), reinterpret_cast<void*>(offsetof(Vertex, position)));
-		pglEnableVertexAttribArray(1);
-		pglVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), reinterpret_cast<void*>(offsetof(Vertex, normal)));
-		pglEnableVertexAttribArray(2);
-		pglVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), reinterpret_cast<void*>(offsetof(Vertex, texcoord)));
-
-		if (gUseVao) {
-			pglBindVertexArray(0);
+		glBindTexture(GL_TEXTURE_2D, 0);
+		source.compressed = compressed == GL_TRUE;
+		if (source.width <= 0 || source.height <= 0) {
+			return false;
 		}
+		// Without a GPU copy the texels are read back, which only works for uncompressed formats.
+		return source.compressed ? gMaterialBatching.hasCopyImage && pglCompressedTexImage3D != nullptr : true;
 	}
 
-	void CreatePlaneBuffers() {
-		const std::array<Vertex, 4> planeVertices{
-			Vertex{glm::vec3(-1.0f, 0.0f, -1.0f), glm::vec3(0.0f, 1.0f, 0.0f), glm::vec2(0.0f, 0.0f)},
-			Vertex{glm::vec3( 1.0f, 0.0f, -1.0f), glm::vec3(0.0f, 1.0f, 0.0f), glm::vec2(1.0f, 0.0f)},
-			Vertex{glm::vec3( 1.0f, 0.0f,  1.0f), glm::vec3(0.0f, 1.0f, 0.0f), glm::vec2(1.0f, 1.0f)},
-			Vertex{glm::vec3(-1.0f, 0.0f,  1.0f), glm::vec3(0.0f, 1.0f, 0.0f), glm::vec2(0.0f, 1.0f)}
-		};
-		const std::array<unsigned int, 6> planeIndices{0, 1, 2, 0, 2, 3};
-		gPlaneIndexCount = static_cast<int>(planeIndices.size());
-
-		if (gUseVao) {
-			pglGenVertexArrays(1, &gPlaneVao);
-			pglBindVertexArray(gPlaneVao);
-		}
-
-		pglGenBuffers(1, &gPlaneVbo);
-		pglBindBuffer(GL_ARRAY_BUFFER, gPlaneVbo);
-		pglBufferData(
-			GL_ARRAY_BUFFER,
-			static_cast<std::ptrdiff_t>(planeVertices.size() * sizeof(Vertex)),
-			planeVertices.data(),
-			GL_STATIC_DRAW);
-
-		pglGenBuffers(1, &gPlaneEbo);
-		pglBindBuffer(GL_ELEMENT_ARRAY_BUFFER, gPlaneEbo);
-		pglBufferData(
-			GL_ELEMENT_ARRAY_BUFFER,
-			static_cast<std::ptrdiff_t>(planeIndices.size() * sizeof(unsigned int)),
-			planeIndices.data(),
-			GL_STATIC_DRAW);
-
-		pglEnableVertexAttribArray(0);
-		pglVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), reinterpret_cast<void*>(offsetof(Vertex, position)));
-		pglEnableVertexAttribArray(1);
-		pglVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), reinterpret_cast<void*>(offsetof(Vertex, normal)));
-		pglEnableVertexAttribArray(2);
-		pglVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), reinterpret_cast<void*>(offsetof(Vertex, texcoord)));
-
-		if (gUseVao) {
-			pglBindVertexArray(0);
+	// Allocates one array layer per member (all alike) and fills it level by level. Returns 0 when the
+	// driver rejects the format, leaving those textures to per-material draws.
+	GLuint CreateTextureArray(const std::vector<const PackSource*>& members, size_t& bytes) {
+		const PackSource& first = *members.front();
+		const GLsizei layers = static_cast<GLsizei>(members.size());
+		while (glGetError() != GL_NO_ERROR) {
+		}
+		GLuint array = 0;
+		glGenTextures(1, &array);
+		glBindTexture(GL_TEXTURE_2D_ARRAY, array);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, first.levels > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, first.levels - 1);
+		if (gHasTextureSwizzle) {
+			glTexParameteriv(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_SWIZZLE_RGBA, first.swizzle.data());
+		}
+		for (int level = 0; level < first.levels; ++level) {
+			const GLsizei width = std::max(first.width >> level, 1);
+			const GLsizei height = std::max(first.height >> level, 1);
+			if (first.compressed) {
+				pglCompressedTexImage3D(GL_TEXTURE_2D_ARRAY, level, static_cast<GLenum>(first.internalFormat), width, height, layers, 0, first.compressedBytes * layers, nullptr);
+			} else {
+				pglTexImage3D(GL_TEXTURE_2D_ARRAY, level, first.internalFormat, width, height, layers, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+			}
 		}
-	}
 
-	void DestroyMeshBuffers(GLMeshBuffers& mesh) {
-		if (pglDeleteBuffers) {
-			if (mesh.ebo != 0) {
-				pglDeleteBuffers(1, &mesh.ebo);
-				mesh.ebo = 0;
-			}
-			if (mesh.vbo != 0) {
-				pglDeleteBuffers(1, &mesh.vbo);
-				mesh.vbo = 0;
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+		glPixelStorei(GL_PACK_ALIGNMENT, 1);
+		std::vector<unsigned char> readback;
+		for (GLint layer = 0; layer < layers; ++layer) {
+			const PackSource& member = *members[static_cast<size_t>(layer)];
+			if (member.chain) {
+				for (int level = 0; level < member.levels; ++level) {
+					const MipLevel& source = member.chain->levels[static_cast<size_t>(level)];
+					pglTexSubImage3D(GL_TEXTURE_2D_ARRAY, level, 0, 0, layer, source.width, source.height, 1, member.sourceFormat, GL_UNSIGNED_BYTE, source.pixels.get());
+				}
+			} else if (gMaterialBatching.hasCopyImage) {
+				pglCopyImageSubData(member.texture, GL_TEXTURE_2D, 0, 0, 0, 0, array, GL_TEXTURE_2D_ARRAY, 0, 0, 0, layer, member.width, member.height, 1);
+			} else {
+				// GL_TEXTURE_2D and GL_TEXTURE_2D_ARRAY bindings coexist on a unit, so the array stays bound.
+				readback.resize(static_cast<size_t>(member.width) * static_cast<size_t>(member.height) * 4u);
+				glBindTexture(GL_TEXTURE_2D, member.texture);
+				glGetTexImage(GL_TEXTURE_2D, 0, GL_RGBA, GL_UNSIGNED_BYTE, readback.data());
+				glBindTexture(GL_TEXTURE_2D, 0);
+				pglTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, layer, member.width, member.height, 1, GL_RGBA, GL_UNSIGNED_BYTE, readback.data());
 			}
 		}
-		if (gUseVao && pglDeleteVertexArrays && mesh.vao != 0) {
-			pglDeleteVertexArrays(1, &mesh.vao);
-			mesh.vao = 0;
+		glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+		if (glGetError() != GL_NO_ERROR) {
+			glDeleteTextures(1, &array);
+			return 0;
 		}
-		mesh.indexCount = 0;
+		bytes = first.compressed
+			? static_cast<size_t>(first.compressedBytes) * members.size()
+			: EstimateTextureBytes(first.width, first.height, first.channels, first.levels > 1) * members.size();
+		return array;
 	}
 
-	void CreateMeshBuffers(const std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices, GLMeshBuffers& mesh) {
-		DestroyMeshBuffers(mesh);
-		if (vertices.empty() || indices.empty()) {
+	// Import-time stage behind merged draws: the diffuse and specular maps of every material are
+	// grouped by size, format and mip count, and each group is packed into texture arrays. Draw
+	// records are then rebuilt so RebuildDrawRecords can merge submeshes whose materials share arrays.
+	// Runs when the scene's materials change, and waits for progressive textures' mip chains (without
+	// blocking unless wait is set); until it has packed, every material is drawn on its own.
+	void UpdateMaterialBatches(bool wait = false) {
+		MaterialBatching& batching = gMaterialBatching;
+		if (!batching.supported || !batching.dirty) {
 			return;
 		}
-
-		if (gUseVao) {
-			pglGenVertexArrays(1, &mesh.vao);
-			pglBindVertexArray(mesh.vao);
+		if (!batching.arrays.empty()) {
+			// Texture names of deleted materials may be reused, so stale layers must not survive.
+			DestroyTextureArrays();
+			gDrawRecordsDirty = true;
 		}
-
-		pglGenBuffers(1, &mesh.vbo);
-		pglBindBuffer(GL_ARRAY_BUFFER, mesh.vbo);
-		pglBufferData(
-			GL_ARRAY_BUFFER,
-			static_cast<std::ptrdiff_t>(vertices.size() * sizeof(Vertex)),
-			vertices.data(),
-			GL_STATIC_DRAW);
-
-		pglGenBuffers(1, &mesh.ebo);
-		pglBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh.ebo);
-		pglBufferData(
-			GL_ELEMENT_ARRAY_BUFFER,
-			static_cast<std::ptrdiff_t>(indices.size() * sizeof(unsigned int)),
-			indices.data(),
-			GL_STATIC_DRAW);
-
-		pglEnableVertexAttribArray(0);
-		pglVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), reinterpret_cast<void*>(offsetof(Vertex, position)));
-		pglEnableVertexAttribArray(1);
-		pglVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), reinterpret_cast<void*>(offsetof(Vertex, normal)));
-		pglEnableVertexAttribArray(2);
-		pglVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), reinterpret_cast<void*>(offsetof(Vertex, texcoord)));
-
-		if (gUseVao) {
-			pglBindVertexArray(0);
+		if (!batching.enabled) {
+			batching.dirty = false;
+			return;
 		}
-		mesh.indexCount = static_cast<int>(indices.size());
-	}
 
-	void BindMeshBuffers(const GLMeshBuffers& mesh) {
-		if (gUseVao && mesh.vao != 0) {
-			pglBindVertexArray(mesh.vao);
+		const auto packStart = std::chrono::steady_clock::now();
+		std::vector<PackSource> sources;
+		std::unordered_map<GLuint, bool> seen;
+		bool pending = false;
+		for (const Material& material : gMaterials) {
+			const std::pair<bool, GLuint> maps[] = {
+				{material.hasDiffuseTexture, material.diffuseTexture},
+				{material.hasSpecularTexture, material.specularTexture}
+			};
+			for (const auto& [hasMap, texture] : maps) {
+				if (!hasMap || texture == 0 || !seen.emplace(texture, true).second) {
+					continue;
+				}
+				PackSource source;
+				if (DescribePackSource(texture, wait, source, pending)) {
+					sources.push_back(std::move(source));
+				}
+			}
+		}
+		if (pending) {
 			return;
 		}
-		pglBindBuffer(GL_ARRAY_BUFFER, mesh.vbo);
-		pglBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh.ebo);
-		pglEnableVertexAttribArray(0);
-		pglVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), reinterpret_cast<void*>(offsetof(Vertex, position)));
-		pglEnableVertexAttribArray(1);
-		pglVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), reinterpret_cast<void*>(offsetof(Vertex, normal)));
-		pglEnableVertexAttribArray(2);
-		pglVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), reinterpret_cast<void*>(offsetof(Vertex, texcoord)));
+
+		std::sort(sources.begin(), sources.end(), [](const PackSource& a, const PackSource& b) {
+			return a.Key() < b.Key();
+		});
+		const size_t maxLayers = static_cast<size_t>(std::max(batching.maxLayers, 1));
+		std::vector<const PackSource*> members;
+		for (size_t begin = 0; begin < sources.size();) {
+			size_t end = begin + 1;
+			while (end < sources.size() && end - begin < maxLayers && sources[end].Key() == sources[begin].Key()) {
+				++end;
+			}
+			members.clear();
+			for (size_t i = begin; i < end; ++i) {
+				members.push_back(&sources[i]);
+			}
+			size_t bytes = 0;
+			if (const GLuint texture = CreateTextureArray(members, bytes)) {
+				const int arrayIndex = static_cast<int>(batching.arrays.size());
+				batching.arrays.push_back(TextureArray{texture, static_cast<int>(members.size()), bytes});
+				batching.arrayBytes += bytes;
+				for (size_t i = 0; i < members.size(); ++i) {
+					batching.layers[members[i]->texture] = PackedTextureLayer{arrayIndex, static_cast<int>(i)};
+				}
+			}
+			begin = end;
+		}
+		batching.dirty = false;
+		batching.packMs = ElapsedMilliseconds(packStart);
+		gDrawRecordsDirty = true;
 	}
 
-	void BuildLightCube(std::vector<Vertex>& vertices, std::vector<unsigned int>& indices) {
-		vertices = {
-			{{-0.5f, -0.5f, -0.5f}, {0.0f, 1.0f, 0.0f}, {0.0f, 0.0f}},
-			{{ 0.5f, -0.5f, -0.5f}, {0.0f, 1.0f, 0.0f}, {1.0f, 0.0f}},
-			{{ 0.5f,  0.5f, -0.5f}, {0.0f, 1.0f, 0.0f}, {1.0f, 1.0f}},
-			{{-0.5f,  0.5f, -0.5f}, {0.0f, 1.0f, 0.0f}, {0.0f, 1.0f}},
-			{{-0.5f, -0.5f,  0.5f}, {0.0f, 1.0f, 0.0f}, {0.0f, 0.0f}},
-			{{ 0.5f, -0.5f,  0.5f}, {0.0f, 1.0f, 0.0f}, {1.0f, 0.0f}},
-			{{ 0.5f,  0.5f,  0.5f}, {0.0f, 1.0f, 0.0f}, {1.0f, 1.0f}},
-			{{-0.5f,  0.5f,  0.5f}, {0.0f, 1.0f, 0.0f}, {0.0f, 1.0f}}
-		};
-		indices = {
-			0, 1, 2, 0, 2, 3,
-			4, 6, 5, 4, 7, 6,
-			4, 5, 1, 4, 1, 0,
-			3, 2, 6, 3, 6, 7,
-			1, 5, 6, 1, 6, 2,
-			4, 0, 3, 4, 3, 7
+	// Rows of the material table for one model's materials: ambient + shininess, diffuse + diffuse
+	// layer, specular + specular layer. A layer of -1 leaves the color untextured.
+	void UploadMaterialTable(const SceneModel& model) {
+		std::array<glm::vec4, kMaterialTableSize * 3> rows{};
+		const int count = std::min(model.materialCount, kMaterialTableSize);
+		auto layerOf = [](bool hasMap, GLuint texture) {
+			const PackedTextureLayer* layer = hasMap ? FindPackedLayer(texture) : nullptr;
+			return layer ? static_cast<float>(layer->layer) : -1.0f;
 		};
+		for (int i = 0; i < count; ++i) {
+			const Material& material = gMaterials[static_cast<size_t>(model.materialBase + i)];
+			const size_t row = static_cast<size_t>(i) * 3u;
+			rows[row] = glm::vec4(material.ambient, material.shininess);
+			rows[row + 1] = glm::vec4(material.diffuse, layerOf(material.hasDiffuseTexture, material.diffuseTexture));
+			rows[row + 2] = glm::vec4(material.specular, layerOf(material.hasSpecularTexture, material.specularTexture));
+		}
+		pglUniform4fv(gMaterialTableLocation, count * 3, glm::value_ptr(rows[0]));
 	}
 
-	void BuildLightSphere(std::vector<Vertex>& vertices, std::vector<unsigned int>& indices) {
-		const int latSegments = 14;
-		const int lonSegments = 20;
-		vertices.clear();
-		indices.clear();
-		vertices.reserve(static_cast<size_t>((latSegments + 1) * (lonSegments + 1)));
-		for (int lat = 0; lat <= latSegments; ++lat) {
-			const float v = static_cast<float>(lat) / static_cast<float>(latSegments);
-			const float theta = v * 3.14159265358979323846f;
-			const float y = std::cos(theta);
-			const float r = std::sin(theta);
-			for (int lon = 0; lon <= lonSegments; ++lon) {
-				const float u = static_cast<float>(lon) / static_cast<float>(lonSegments);
-				const float phi = u * (2.0f * 3.14159265358979323846f);
-				const float x = r * std::cos(phi);
-				const float z = r * std::sin(phi);
-				const glm::vec3 normal = glm::normalize(glm::vec3(x, y, z));
-				vertices.push_back(Vertex{normal * 0.5f, normal, glm::vec2(u, v)});
-			}
+	void SetCachedTextureBytes(GLuint texture, size_t bytes) {
+		auto key = gTextureCache.keys.find(texture);
+		if (key == gTextureCache.keys.end()) {
+			return;
 		}
+		TextureCacheEntry& entry = gTextureCache.entries[key->second];
+		gTextureCache.residentBytes = gTextureCache.residentBytes - entry.bytes + bytes;
+		entry.bytes = bytes;
+	}
 
-		for (int lat = 0; lat < latSegments; ++lat) {
-			for (int lon = 0; lon < lonSegments; ++lon) {
-				const int row0 = lat * (lonSegments + 1);
-				const int row1 = (lat + 1) * (lonSegments + 1);
-				const unsigned int a = static_cast<unsigned int>(row0 + lon);
-				const unsigned int b = static_cast<unsigned int>(row1 + lon);
-				const unsigned int c = static_cast<unsigned int>(row1 + lon + 1);
-				const unsigned int d = static_cast<unsigned int>(row0 + lon + 1);
-				indices.push_back(a);
-				indices.push_back(b);
-				indices.push_back(c);
-				indices.push_back(a);
-				indices.push_back(c);
-				indices.push_back(d);
+	// Pixels inside the screen rectangle around bounds; the whole viewport once a corner is behind
+	// the eye.
+	float ProjectedBoundsArea(const glm::mat4& clipFromScene, const Bounds& bounds) {
+		const float viewportWidth = static_cast<float>(gWindowWidth);
+		const float viewportHeight = static_cast<float>(gWindowHeight);
+		if (!bounds.valid) {
+			return 0.0f;
+		}
+		float lowX = 1.0f;
+		float lowY = 1.0f;
+		float highX = -1.0f;
+		float highY = -1.0f;
+		for (int corner = 0; corner < 8; ++corner) {
+			const glm::vec3 point(
+				(corner & 1) != 0 ? bounds.max.x : bounds.min.x,
+				(corner & 2) != 0 ? bounds.max.y : bounds.min.y,
+				(corner & 4) != 0 ? bounds.max.z : bounds.min.z);
+			const glm::vec4 clip = clipFromScene * glm::vec4(point, 1.0f);
+			if (clip.w <= 0.0f) {
+				return viewportWidth * viewportHeight;
 			}
-		}
+			const float x = clip.x / clip.w;
+			const float y = clip.y / clip.w;
+			lowX = std::min(lowX, x);
+			lowY = std::min(lowY, y);
+			highX = std::max(highX, x);
+			highY = std::max(highY, y);
+		}
+		lowX = std::max(lowX, -1.0f);
+		lowY = std::max(lowY, -1.0f);
+		highX = std::min(highX, 1.0f);
+		highY = std::min(highY, 1.0f);
+		if (highX <= lowX || highY <= lowY) {
+			return 0.0f;
+		}
+		return (highX - lowX) * 0.5f * viewportWidth * (highY - lowY) * 0.5f * viewportHeight;
 	}
 
-	bool LoadLightObjectMesh() {
-		DestroyMeshBuffers(gLightObjectMesh);
-		gHasLightObjectMesh = false;
-
-		std::filesystem::path lightPath;
-		if (!gAssetRoot.empty()) {
-			lightPath = ResolveLightObjPath(gAssetRoot);
-		}
-		if (lightPath.empty()) {
-			for (const std::filesystem::path& root : BuildAssetRootCandidates()) {
-				lightPath = ResolveLightObjPath(root);
-				if (!lightPath.empty()) {
-					break;
+	// Screen pixels covered by each progressive texture in the main view: the projected bounds of
+	// every visible instance, split between a model's submeshes by index count.
+	void AccumulateTextureCoverage(const FramePlan& plan) {
+		TextureStreamer& streamer = gTextureStreamer;
+		for (auto& entry : streamer.textures) {
+			entry.second.coverage = 0.0f;
+		}
+		auto addCoverage = [&streamer](GLuint texture, float pixels) {
+			auto it = texture != 0 ? streamer.textures.find(texture) : streamer.textures.end();
+			if (it != streamer.textures.end() && it->second.chain) {
+				it->second.coverage += pixels;
+			}
+		};
+		const glm::mat4 clipFromScene = plan.projection * plan.view * plan.model;
+		const size_t modelCount = std::min(plan.mainRuns.modelRunSpans.size(), gSceneModels.size());
+		for (size_t m = 0; m < modelCount; ++m) {
+			const SceneModel& model = gSceneModels[m];
+			const ArenaRange& span = plan.mainRuns.modelRunSpans[m];
+			if (model.indexCount == 0) {
+				continue;
+			}
+			for (size_t r = span.offset; r < span.offset + span.count; ++r) {
+				const InstanceRun& run = plan.mainRuns.runs[r];
+				for (int i = run.first; i < run.first + run.count; ++i) {
+					const float pixels = ProjectedBoundsArea(clipFromScene, gInstanceBounds[static_cast<size_t>(i)]);
+					if (pixels <= 0.0f) {
+						continue;
+					}
+					for (const Submesh& submesh : model.submeshes) {
+						const int materialIndex = run.materialOverride >= 0 ? run.materialOverride : model.materialBase + submesh.materialIndex;
+						if (materialIndex < 0 || materialIndex >= static_cast<int>(gMaterials.size())) {
+							continue;
+						}
+						const Material& material = gMaterials[static_cast<size_t>(materialIndex)];
+						// Table draws sample the packed copies, so the 2D textures only matter to overrides.
+						if (run.materialOverride < 0 && UsesMaterialTable(model, material)) {
+							continue;
+						}
+						const float share = pixels * static_cast<float>(submesh.indexCount) / static_cast<float>(model.indexCount);
+						addCoverage(material.diffuseTexture, share);
+						addCoverage(material.specularTexture, share);
+					}
 				}
 			}
 		}
-		if (lightPath.empty()) {
-			gLightObjectStatus = "Light object not found (expected light/light.obj).";
-			return false;
-		}
+	}
 
-		std::vector<Vertex> vertices;
-		std::vector<unsigned int> indices;
-		std::vector<Submesh> submeshes;
-		std::vector<Material> materials;
-		Bounds bounds;
-		if (!LoadMesh(lightPath.string(), vertices, indices, bounds, submeshes, materials)) {
-			gLightObjectStatus = "Failed to load light object: " + lightPath.string();
-			return false;
+	// Finest level worth having: about one texel per covered pixel, for a texture mapped once across
+	// its submeshes' screen footprint. Textures off screen ask for nothing beyond their preview.
+	int CoverageLevel(const StreamedTexture& streamed) {
+		if (streamed.coverage <= 0.0f) {
+			return streamed.previewLevel;
 		}
+		const float texelsAcross = static_cast<float>(std::max(streamed.width, streamed.height));
+		const float pixelsAcross = std::sqrt(streamed.coverage);
+		const int level = static_cast<int>(std::floor(std::log2(std::max(texelsAcross / pixelsAcross, 1.0f))));
+		return std::clamp(level, 0, streamed.previewLevel);
+	}
 
-		CreateMeshBuffers(vertices, indices, gLightObjectMesh);
-		if (gLightObjectMesh.indexCount <= 0) {
-			gLightObjectStatus = "Light object has no drawable triangles: " + lightPath.string();
-			return false;
+	// Replaces the sampled preview levels with the box-filtered ones once a worker has built them.
+	void ApplyMipChain(GLuint texture, StreamedTexture& streamed) {
+		glBindTexture(GL_TEXTURE_2D, texture);
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+		for (int level = streamed.previewLevel; level < streamed.levelCount; ++level) {
+			const MipLevel& source = streamed.chain->levels[static_cast<size_t>(level)];
+			glTexSubImage2D(GL_TEXTURE_2D, level, 0, 0, source.width, source.height, streamed.sourceFormat, GL_UNSIGNED_BYTE, source.pixels.get());
 		}
-
-		gHasLightObjectMesh = true;
-		gLightObjectStatus = "Loaded light object: " + lightPath.string();
-		return true;
+		glBindTexture(GL_TEXTURE_2D, 0);
+		streamed.chainApplied = true;
 	}
 
-	void DestroyLightBuffers() {
-		if (pglDeleteBuffers && gLightVbo != 0) {
-			pglDeleteBuffers(1, &gLightVbo);
-			gLightVbo = 0;
-		}
-		if (gUseVao && pglDeleteVertexArrays && gLightVao != 0) {
-			pglDeleteVertexArrays(1, &gLightVao);
-			gLightVao = 0;
+	// Raises the base level to targetLevel and releases the finer levels.
+	void TrimStreamedTexture(GLuint texture, StreamedTexture& streamed) {
+		glBindTexture(GL_TEXTURE_2D, texture);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, streamed.targetLevel);
+		for (int level = streamed.residentLevel; level < streamed.targetLevel; ++level) {
+			// A zero-sized image gives the level's storage back.
+			glTexImage2D(GL_TEXTURE_2D, level, streamed.format, 0, 0, 0, streamed.sourceFormat, GL_UNSIGNED_BYTE, nullptr);
 		}
-		DestroyMeshBuffers(gLightCubeMesh);
-		DestroyMeshBuffers(gLightSphereMesh);
-		DestroyMeshBuffers(gLightObjectMesh);
-		gHasLightObjectMesh = false;
+		glBindTexture(GL_TEXTURE_2D, 0);
+		gTextureStreamer.levelsTrimmed += static_cast<size_t>(streamed.targetLevel - streamed.residentLevel);
+		streamed.residentLevel = streamed.targetLevel;
 	}
 
-	void CreateLightBuffers() {
-		DestroyLightBuffers();
+	// Allocates the next finer level and queues its texels for the upload ring.
+	void RefineStreamedTexture(GLuint texture, StreamedTexture& streamed) {
+		const int level = streamed.residentLevel - 1;
+		const MipLevel& source = streamed.chain->levels[static_cast<size_t>(level)];
+		glBindTexture(GL_TEXTURE_2D, texture);
+		glTexImage2D(GL_TEXTURE_2D, level, streamed.format, source.width, source.height, 0, streamed.sourceFormat, GL_UNSIGNED_BYTE, nullptr);
+		glBindTexture(GL_TEXTURE_2D, 0);
+		streamed.uploadingLevel = level;
+		QueueStreamedImage(texture, GL_TEXTURE_2D, level, source.pixels, source.width, source.height, streamed.channels, streamed.sourceFormat);
+	}
 
-		const Vertex lightVertex{
-			glm::vec3(0.0f, 0.0f, 0.0f),
-			glm::vec3(0.0f, 1.0f, 0.0f),
-			glm::vec2(0.0f, 0.0f)
+	// Decides which levels each progressive texture should have on the GPU and moves residency toward
+	// that. The cap is the texture cache budget less every texture that is not progressive and the
+	// packed texture arrays. Textures
+	// are served best covered first: each gets the level its coverage asks for while the cap has room,
+	// then keeps finer levels it already has while room remains. Over the cap the least covered
+	// textures are trimmed first, never below their preview.
+	void UpdateTextureResidency(const FramePlan& plan) {
+		TextureStreamer& streamer = gTextureStreamer;
+		streamer.refinementPending = false;
+		if (!streamer.supported) {
+			return;
+		}
+		AccumulateTextureCoverage(plan);
+		std::vector<std::pair<GLuint, StreamedTexture*>> progressive;
+		size_t residentBytes = 0;
+		size_t previewBytes = 0;
+		for (auto& [texture, streamed] : streamer.textures) {
+			if (!streamed.chain) {
+				continue;
+			}
+			progressive.emplace_back(texture, &streamed);
+			residentBytes += StreamedChainBytes(streamed, streamed.residentLevel);
+			previewBytes += StreamedChainBytes(streamed, streamed.previewLevel);
+		}
+		streamer.progressiveTextures = progressive.size();
+		if (progressive.empty()) {
+			streamer.progressiveBytes = 0;
+			return;
+		}
+		std::sort(progressive.begin(), progressive.end(), [](const auto& a, const auto& b) {
+			if (a.second->coverage != b.second->coverage) {
+				return a.second->coverage > b.second->coverage;
+			}
+			return a.first < b.first;
+		});
+
+		// Progressive textures are all cached, with their entries kept at their resident size.
+		const size_t otherBytes = (gTextureCache.residentBytes > residentBytes ? gTextureCache.residentBytes - residentBytes : 0) +
+			gMaterialBatching.arrayBytes;
+		const size_t cap = static_cast<size_t>(gTextureCache.budgetMb) * 1024u * 1024u;
+		size_t remaining = cap > otherBytes + previewBytes ? cap - otherBytes - previewBytes : 0;
+		auto extraBytes = [](const StreamedTexture& streamed, int level) {
+			return StreamedChainBytes(streamed, level) - StreamedChainBytes(streamed, streamed.previewLevel);
 		};
-
-		if (gUseVao) {
-			pglGenVertexArrays(1, &gLightVao);
-			pglBindVertexArray(gLightVao);
+		for (auto& [texture, streamed] : progressive) {
+			int level = CoverageLevel(*streamed);
+			while (level < streamed->previewLevel && extraBytes(*streamed, level) > remaining) {
+				++level;
+			}
+			streamed->targetLevel = level;
+			remaining -= extraBytes(*streamed, level);
+		}
+		for (auto& [texture, streamed] : progressive) {
+			if (streamed->residentLevel >= streamed->targetLevel) {
+				continue;
+			}
+			const size_t keep = extraBytes(*streamed, streamed->residentLevel) - extraBytes(*streamed, streamed->targetLevel);
+			if (keep <= remaining) {
+				remaining -= keep;
+				streamed->targetLevel = streamed->residentLevel;
+			}
 		}
 
-		pglGenBuffers(1, &gLightVbo);
-		pglBindBuffer(GL_ARRAY_BUFFER, gLightVbo);
-		pglBufferData(GL_ARRAY_BUFFER, static_cast<std::ptrdiff_t>(sizeof(Vertex)), &lightVertex, GL_STATIC_DRAW);
-
-		pglEnableVertexAttribArray(0);
-		pglVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), reinterpret_cast<void*>(offsetof(Vertex, position)));
-		pglEnableVertexAttribArray(1);
-		pglVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), reinterpret_cast<void*>(offsetof(Vertex, normal)));
-		pglEnableVertexAttribArray(2);
-		pglVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), reinterpret_cast<void*>(offsetof(Vertex, texcoord)));
-
-		if (gUseVao) {
-			pglBindVertexArray(0);
+		streamer.progressiveBytes = 0;
+		for (auto& [texture, streamed] : progressive) {
+			if (!streamed->chainApplied && streamed->chain->ready.load(std::memory_order_acquire)) {
+				ApplyMipChain(texture, *streamed);
+			}
+			if (streamed->uploadingLevel >= 0) {
+				streamer.refinementPending = true;
+			} else if (streamed->residentLevel < streamed->targetLevel) {
+				TrimStreamedTexture(texture, *streamed);
+			} else if (streamed->residentLevel > streamed->targetLevel) {
+				streamer.refinementPending = true;
+				if (streamed->chainApplied) {
+					RefineStreamedTexture(texture, *streamed);
+				}
+			}
+			const size_t bytes = StreamedChainBytes(*streamed, streamed->residentLevel);
+			SetCachedTextureBytes(texture, bytes);
+			streamer.progressiveBytes += bytes;
 		}
+	}
 
-		std::vector<Vertex> primitiveVertices;
-		std::vector<unsigned int> primitiveIndices;
+	// Completes every queued upload, e.g. before reading textures back. With a plan, also streams in
+	// every level that view asks for, so timed frames see settled residency.
+	void FlushTextureUploads(const FramePlan* plan = nullptr) {
+		while (true) {
+			if (plan) {
+				UpdateTextureResidency(*plan);
+			}
+			if (plan ? !HasPendingTextureUploads() : !HasQueuedTextureImages()) {
+				break;
+			}
+			UpdateTextureStreaming(std::numeric_limits<size_t>::max());
+			glFlush();
+			std::this_thread::yield();
+		}
+	}
 
-		BuildLightCube(primitiveVertices, primitiveIndices);
-		CreateMeshBuffers(primitiveVertices, primitiveIndices, gLightCubeMesh);
+	// A compressed embedded texture decoded ahead of its upload, which has to stay on the GL thread.
+	struct DecodedImage {
+		std::unique_ptr<stbi_uc, void (*)(void*)> pixels{nullptr, stbi_image_free};
+		int width = 0;
+		int height = 0;
+		int channels = 0;
+	};
 
-		BuildLightSphere(primitiveVertices, primitiveIndices);
-		CreateMeshBuffers(primitiveVertices, primitiveIndices, gLightSphereMesh);
+	// Cache key of embedded texture `index` of the scene loaded from scenePath. "*N" alone names a
+	// different texture in every file, so it has to be qualified.
+	std::string EmbeddedTextureKey(const std::string& scenePath, unsigned int index) {
+		return scenePath + "*" + std::to_string(index);
+	}
 
-		if (!LoadLightObjectMesh()) {
-			std::fprintf(stderr, "%s\n", gLightObjectStatus.c_str());
+	// Decodes every compressed embedded texture that is not cached yet, one job per texture.
+	std::vector<DecodedImage> DecodeEmbeddedTextures(const aiScene* scene, const std::string& scenePath) {
+		std::vector<DecodedImage> images(scene->mNumTextures);
+		std::vector<unsigned int> pending;
+		for (unsigned int i = 0; i < scene->mNumTextures; ++i) {
+			const aiTexture* texture = scene->mTextures[i];
+			if (texture && texture->mHeight == 0 && !IsTextureCached(EmbeddedTextureKey(scenePath, i))) {
+				pending.push_back(i);
+			}
 		}
+
+		Jobs().ParallelFor(pending.size(), 1, [&](size_t begin, size_t end) {
+			for (size_t job = begin; job < end; ++job) {
+				const aiTexture* texture = scene->mTextures[pending[job]];
+				DecodedImage& image = images[pending[job]];
+				image.pixels.reset(stbi_load_from_memory(
+					reinterpret_cast<const stbi_uc*>(texture->pcData),
+					static_cast<int>(texture->mWidth),
+					&image.width,
+					&image.height,
+					&image.channels,
+					0));
+			}
+		});
+		return images;
 	}
 
-	glm::mat4 BuildObjectModelMatrix(const OrbitCamera& camera) {
-		glm::mat4 model(1.0f);
+	// Block format for a texture with `channels` channels, chosen among what the driver decodes. One and
+	// two channel textures keep their luminance look through a swizzle when stored as BC4/BC5.
+	bool ChooseBlockFormat(int channels, compression::BlockFormat& format) {
+		const bool rgtc = gHasRgtc && gHasTextureSwizzle;
+		switch (channels) {
+		case 1:
+			if (rgtc) {
+				format = compression::BlockFormat::BC4;
+				return true;
+			}
+			if (gHasS3tc) {
+				format = compression::BlockFormat::BC1;
+				return true;
+			}
+			return false;
+		case 2:
+			if (rgtc) {
+				format = compression::BlockFormat::BC5;
+				return true;
+			}
+			if (gHasS3tc) {
+				format = compression::BlockFormat::BC3;
+				return true;
+			}
+			return false;
+		case 3:
+			if (gHasS3tc) {
+				format = compression::BlockFormat::BC1;
+				return true;
+			}
+			if (gHasBptc) {
+				format = compression::BlockFormat::BC7;
+				return true;
+			}
+			return false;
+		case 4:
+			if (gHasBptc) {
+				format = compression::BlockFormat::BC7;
+				return true;
+			}
+			if (gHasS3tc) {
+				format = compression::BlockFormat::BC3;
+				return true;
+			}
+			return false;
+		default:
+			return false;
+		}
+	}
+
+	GLenum CompressedInternalFormat(compression::BlockFormat format) {
+		switch (format) {
+		case compression::BlockFormat::BC1:
+			return GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+		case compression::BlockFormat::BC3:
+			return GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+		case compression::BlockFormat::BC4:
+			return GL_COMPRESSED_RED_RGTC1;
+		case compression::BlockFormat::BC5:
+			return GL_COMPRESSED_RG_RGTC2;
+		case compression::BlockFormat::BC7:
+			return GL_COMPRESSED_RGBA_BPTC_UNORM;
+		}
+		return GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+	}
+
+	// Keys the compressed-block cache by the source's identity, the chosen format and the cache version.
+	std::uint64_t CompressedTextureKey(std::uint64_t sourceHash, compression::BlockFormat format) {
+		const std::uint32_t formatValue = static_cast<std::uint32_t>(format);
+		std::uint64_t key = HashBytes(&kTextureCacheVersion, sizeof(kTextureCacheVersion));
+		key = HashBytes(&formatValue, sizeof(formatValue), key);
+		return HashBytes(&sourceHash, sizeof(sourceHash), key);
+	}
+
+	// Path, size and modification time, so an edited file misses the cache without being read.
+	std::uint64_t HashTextureFile(const std::filesystem::path& path) {
+		std::error_code ec;
+		const std::uint64_t size = std::filesystem::file_size(path, ec);
+		const std::int64_t mtime = static_cast<std::int64_t>(std::filesystem::last_write_time(path, ec).time_since_epoch().count());
+		std::uint64_t hash = HashString(path.string());
+		hash = HashBytes(&size, sizeof(size), hash);
+		return HashBytes(&mtime, sizeof(mtime), hash);
+	}
+
+	std::filesystem::path CompressedTexturePath(std::uint64_t key) {
+		return ResolveCacheDirectory() / "textures" / (HashToHex(key) + ".bin");
+	}
+
+	// Cache entry layout: magic, cache version, key, block format, width, height, block length, blocks.
+	bool LoadCompressedImage(std::uint64_t key, compression::BlockFormat format, compression::CompressedImage& image) {
+		std::vector<unsigned char> bytes;
+		if (!ReadCacheFile(CompressedTexturePath(key), bytes)) {
+			return false;
+		}
+		constexpr size_t kHeaderSize = sizeof(kTextureCacheMagic) + sizeof(std::uint32_t) + sizeof(std::uint64_t) + 4 * sizeof(std::uint32_t);
+		if (bytes.size() <= kHeaderSize || std::memcmp(bytes.data(), kTextureCacheMagic, sizeof(kTextureCacheMagic)) != 0) {
+			return false;
+		}
+		std::uint32_t version = 0;
+		std::uint64_t storedKey = 0;
+		std::uint32_t storedFormat = 0;
+		std::uint32_t width = 0;
+		std::uint32_t height = 0;
+		std::uint32_t length = 0;
+		size_t offset = sizeof(kTextureCacheMagic);
+		auto read = [&](void* value, size_t size) {
+			std::memcpy(value, bytes.data() + offset, size);
+			offset += size;
+		};
+		read(&version, sizeof(version));
+		read(&storedKey, sizeof(storedKey));
+		read(&storedFormat, sizeof(storedFormat));
+		read(&width, sizeof(width));
+		read(&height, sizeof(height));
+		read(&length, sizeof(length));
+		if (version != kTextureCacheVersion || storedKey != key || storedFormat != static_cast<std::uint32_t>(format) ||
+			bytes.size() - offset != length ||
+			length != compression::CompressedSize(format, static_cast<int>(width), static_cast<int>(height))) {
+			return false;
+		}
+		image.format = format;
+		image.width = static_cast<int>(width);
+		image.height = static_cast<int>(height);
+		image.blocks.assign(bytes.begin() + static_cast<std::ptrdiff_t>(offset), bytes.end());
+		return true;
+	}
+
+	void StoreCompressedImage(std::uint64_t key, const compression::CompressedImage& image) {
+		const std::uint32_t version = kTextureCacheVersion;
+		const std::uint32_t format = static_cast<std::uint32_t>(image.format);
+		const std::uint32_t width = static_cast<std::uint32_t>(image.width);
+		const std::uint32_t height = static_cast<std::uint32_t>(image.height);
+		const std::uint32_t length = static_cast<std::uint32_t>(image.blocks.size());
+		std::vector<unsigned char> bytes(kTextureCacheMagic, kTextureCacheMagic + sizeof(kTextureCacheMagic));
+		auto append = [&](const void* data, size_t size) {
+			const unsigned char* begin = static_cast<const unsigned char*>(data);
+			bytes.insert(bytes.end(), begin, begin + size);
+		};
+		append(&version, sizeof(version));
+		append(&key, sizeof(key));
+		append(&format, sizeof(format));
+		append(&width, sizeof(width));
+		append(&height, sizeof(height));
+		append(&length, sizeof(length));
+		append(image.blocks.data(), image.blocks.size());
+		WriteCacheFile(CompressedTexturePath(key), bytes);
+	}
+
+	// Single-level upload of image into a new texture on the current context; returns 0 when the
+	// driver rejects the format. Touches no renderer state, so the upload thread can call it too.
+	GLuint CreateCompressedTextureObject(const compression::CompressedImage& image) {
+		if (!pglCompressedTexImage2D || image.blocks.empty()) {
+			return 0;
+		}
+		while (glGetError() != GL_NO_ERROR) {
+		}
+		GLuint tex = 0;
+		glGenTextures(1, &tex);
+		glBindTexture(GL_TEXTURE_2D, tex);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+		pglCompressedTexImage2D(
+			GL_TEXTURE_2D,
+			0,
+			CompressedInternalFormat(image.format),
+			image.width,
+			image.height,
+			0,
+			static_cast<GLsizei>(image.blocks.size()),
+			image.blocks.data());
+		// Match the GL_LUMINANCE / GL_LUMINANCE_ALPHA uploads these formats replace.
+		if (image.format == compression::BlockFormat::BC4) {
+			const GLint swizzle[4] = {GL_RED, GL_RED, GL_RED, GL_ONE};
+			glTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_RGBA, swizzle);
+		} else if (image.format == compression::BlockFormat::BC5) {
+			const GLint swizzle[4] = {GL_RED, GL_RED, GL_RED, GL_GREEN};
+			glTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_RGBA, swizzle);
+		}
+		glBindTexture(GL_TEXTURE_2D, 0);
+		if (glGetError() != GL_NO_ERROR) {
+			glDeleteTextures(1, &tex);
+			return 0;
+		}
+		return tex;
+	}
+
+	GLuint CreateCompressedTexture(const compression::CompressedImage& image) {
+		const auto uploadStart = std::chrono::steady_clock::now();
+		const GLuint tex = CreateCompressedTextureObject(image);
+		if (tex != 0) {
+			gTextureUploadMs += ElapsedMilliseconds(uploadStart);
+		}
+		return tex;
+	}
+
+	// Uploads the cached blocks for key, if any; bytes receives the texture's GPU size.
+	GLuint LoadCachedCompressedTexture(std::uint64_t key, compression::BlockFormat format, size_t& bytes) {
+		compression::CompressedImage image;
+		if (!LoadCompressedImage(key, format, image)) {
+			return 0;
+		}
+		const GLuint tex = CreateCompressedTexture(image);
+		if (tex != 0) {
+			bytes = image.blocks.size();
+			++gTextureCompressionStats.loadedFromDisk;
+		}
+		return tex;
+	}
+
+	// Encodes R,G,B(,A) pixels to format and stores the blocks under key in the disk cache. Touches no
+	// GL or renderer state, so load workers call it too; threadCount is passed on to compression::Encode.
+	compression::CompressedImage EncodeTexturePixels(
+		const unsigned char* pixels,
+		int width,
+		int height,
+		int channels,
+		compression::BlockFormat format,
+		std::uint64_t key,
+		const std::string& label,
+		int threadCount,
+		double& encodeMs) {
+		const auto encodeStart = std::chrono::steady_clock::now();
+		compression::CompressedImage image = compression::Encode(pixels, width, height, channels, format, threadCount);
+		encodeMs = ElapsedMilliseconds(encodeStart);
+		StoreCompressedImage(key, image);
+		const size_t sourceBytes = EstimateTextureBytes(width, height, channels, false);
+		std::printf("Compressed %s %dx%d to %s in %.1f ms: %.2f MB -> %.2f MB, PSNR %.1f dB\n",
+			label.c_str(),
+			width,
+			height,
+			compression::FormatName(format),
+			encodeMs,
+			static_cast<double>(sourceBytes) / (1024.0 * 1024.0),
+			static_cast<double>(image.blocks.size()) / (1024.0 * 1024.0),
+			compression::ComputePsnr(pixels, channels, image));
+		return image;
+	}
+
+	// Render thread: counts a texture encoded by EncodeTexturePixels once it is uploaded.
+	void RecordEncodedTexture(double encodeMs, size_t sourceBytes, size_t compressedBytes) {
+		++gTextureCompressionStats.encoded;
+		gTextureCompressionStats.encodeMs += encodeMs;
+		gTextureCompressionStats.sourceBytes += sourceBytes;
+		gTextureCompressionStats.compressedBytes += compressedBytes;
+	}
+
+	// Encodes pixels to format, stores the blocks under key and uploads them. Falls back to an
+	// uncompressed texture when the upload fails. bytes receives the texture's GPU size.
+	GLuint CreateCompressedTextureFromPixels(
+		const unsigned char* pixels,
+		int width,
+		int height,
+		int channels,
+		bool bgra,
+		compression::BlockFormat format,
+		std::uint64_t key,
+		const std::string& label,
+		size_t& bytes) {
+		bytes = EstimateTextureBytes(width, height, channels, false);
+		std::vector<unsigned char> rgba;
+		if (bgra && channels == 4) {
+			rgba = SwizzleBgraToRgba(pixels, static_cast<size_t>(width) * static_cast<size_t>(height));
+			pixels = rgba.data();
+		}
+		double encodeMs = 0.0;
+		const compression::CompressedImage image = EncodeTexturePixels(pixels, width, height, channels, format, key, label, 0, encodeMs);
+		const GLuint tex = CreateCompressedTexture(image);
+		if (tex == 0) {
+			std::fprintf(stderr, "Compressed upload of %s as %s failed; uploading uncompressed.\n", label.c_str(), compression::FormatName(format));
+			return CreateTextureFromPixels(pixels, width, height, channels);
+		}
+		RecordEncodedTexture(encodeMs, bytes, image.blocks.size());
+		bytes = image.blocks.size();
+		return tex;
+	}
+
+	bool ShouldCompressTextures() {
+		return gCompressTextures && !gSoftwareOnly;
+	}
+
+	// bytes receives the texture's GPU size.
+	GLuint LoadTextureFromMemory(const aiTexture* texture, DecodedImage& decoded, const std::string& key, size_t& bytes) {
+		if (!texture) {
+			return 0;
+		}
+		const bool raw = texture->mHeight != 0;
+		// aiTexel is packed B,G,R,A, so Assimp's buffer is uploaded as is.
+		const unsigned char* pixels = raw ? reinterpret_cast<const unsigned char*>(texture->pcData) : decoded.pixels.get();
+		const int width = raw ? static_cast<int>(texture->mWidth) : decoded.width;
+		const int height = raw ? static_cast<int>(texture->mHeight) : decoded.height;
+		const int channels = raw ? 4 : decoded.channels;
+		compression::BlockFormat format = compression::BlockFormat::BC1;
+		if (pixels && ShouldCompressTextures() && ChooseBlockFormat(channels, format)) {
+			const size_t sourceSize = raw
+				? static_cast<size_t>(texture->mWidth) * static_cast<size_t>(texture->mHeight) * sizeof(aiTexel)
+				: static_cast<size_t>(texture->mWidth);
+			const std::uint64_t compressedKey = CompressedTextureKey(HashBytes(texture->pcData, sourceSize), format);
+			if (const GLuint cached = LoadCachedCompressedTexture(compressedKey, format, bytes)) {
+				return cached;
+			}
+			return CreateCompressedTextureFromPixels(pixels, width, height, channels, raw, format, compressedKey, key, bytes);
+		}
+		bytes = EstimateTextureBytes(width, height, channels, false);
+		if (!raw) {
+			return CreateStreamedTexture(std::shared_ptr<const unsigned char>(std::move(decoded.pixels)), width, height, channels);
+		}
+		if (!IsTextureStreamingActive()) {
+			return CreateTextureFromPixels(pixels, width, height, channels, true);
+		}
+		// Assimp's buffer goes away with the scene, so a streamed upload needs its own copy.
+		const size_t size = static_cast<size_t>(width) * static_cast<size_t>(height) * 4u;
+		std::shared_ptr<unsigned char> copy(new unsigned char[size], std::default_delete<unsigned char[]>());
+		std::memcpy(copy.get(), pixels, size);
+		return CreateStreamedTexture(std::move(copy), width, height, channels, true);
+	}
+
+	std::filesystem::path ResolveTexturePath(const std::filesystem::path& baseDir, const aiString& texturePath) {
+		if (texturePath.length == 0) {
+			return {};
+		}
+		std::filesystem::path rawPath(texturePath.C_Str());
+		if (rawPath.is_absolute()) {
+			const std::filesystem::path resolved = gPathCache.Resolve(rawPath);
+			return resolved.empty() ? rawPath : resolved;
+		}
+		std::filesystem::path candidate = gPathCache.Resolve(baseDir / rawPath);
+		if (!candidate.empty()) {
+			return candidate;
+		}
+		candidate = gPathCache.Resolve(baseDir / rawPath.filename());
+		if (!candidate.empty()) {
+			return candidate;
+		}
+		return baseDir / rawPath;
+	}
+
+	GLuint LoadTextureFromFile(const std::filesystem::path& path) {
+		if (path.empty()) {
+			return 0;
+		}
+		const std::filesystem::path resolved = gPathCache.Resolve(path);
+		if (resolved.empty()) {
+			std::fprintf(stderr, "Texture file not found: %s\n", path.lexically_normal().string().c_str());
+			return 0;
+		}
+		const std::string key = resolved.string();
+		if (const GLuint cached = FindCachedTexture(key)) {
+			return cached;
+		}
+
+		int width = 0;
+		int height = 0;
+		int channels = 0;
+		// The header is enough to pick a block format, so a compressed cache hit skips decoding entirely.
+		compression::BlockFormat format = compression::BlockFormat::BC1;
+		std::uint64_t compressedKey = 0;
+		const bool compress = ShouldCompressTextures() && stbi_info(key.c_str(), &width, &height, &channels) &&
+			ChooseBlockFormat(channels, format);
+		size_t bytes = 0;
+		if (compress) {
+			compressedKey = CompressedTextureKey(HashTextureFile(resolved), format);
+			if (const GLuint cached = LoadCachedCompressedTexture(compressedKey, format, bytes)) {
+				CacheTexture(key, cached, bytes);
+				return cached;
+			}
+		}
+
+		stbi_uc* pixels = stbi_load(key.c_str(), &width, &height, &channels, 0);
+		if (!pixels) {
+			std::fprintf(stderr, "Failed to load texture: %s\n", key.c_str());
+			return 0;
+		}
+		GLuint tex = 0;
+		if (compress) {
+			tex = CreateCompressedTextureFromPixels(pixels, width, height, channels, false, format, compressedKey, key, bytes);
+			stbi_image_free(pixels);
+		} else {
+			bytes = EstimateTextureBytes(width, height, channels, false);
+			tex = CreateStreamedTexture(std::shared_ptr<const unsigned char>(pixels, stbi_image_free), width, height, channels);
+		}
+		CacheTexture(key, tex, bytes);
+		return tex;
+	}
+
+	std::vector<std::filesystem::path> BuildAssetRootCandidates() {
+		std::vector<std::filesystem::path> candidates;
+		auto addCandidate = [&](const std::filesystem::path& path) {
+			if (path.empty()) {
+				return;
+			}
+			std::error_code ec;
+			std::filesystem::path normalized = std::filesystem::absolute(path, ec);
+			if (ec) {
+				normalized = path.lexically_normal();
+			} else {
+				normalized = normalized.lexically_normal();
+			}
+			if (std::find(candidates.begin(), candidates.end(), normalized) == candidates.end()) {
+				candidates.push_back(normalized);
+			}
+		};
+
+		std::error_code ec;
+		const std::filesystem::path cwd = std::filesystem::current_path(ec);
+		if (!gObjPath.empty()) {
+			std::filesystem::path objPath(gObjPath);
+			if (objPath.is_relative() && !cwd.empty()) {
+				objPath = cwd / objPath;
+			}
+			addCandidate(objPath.parent_path());
+		}
+
+		if (!ec) {
+			addCandidate(cwd);
+			addCandidate(cwd / "out/build/x64-release/GPURenderer");
+			addCandidate(cwd / "out/build/x64-debug/GPURenderer");
+			addCandidate(cwd / "out/x64-release");
+			addCandidate(cwd / "out/x64-debug");
+		}
+
+		return candidates;
+	}
+
+	std::filesystem::path ResolveCubeObjPath(const std::filesystem::path& root) {
+		const std::filesystem::path nested = gPathCache.Resolve(root / "cube" / "cube.obj");
+		if (!nested.empty()) {
+			return nested;
+		}
+		return gPathCache.Resolve(root / "cube.obj");
+	}
+
+	std::filesystem::path ResolveLightObjPath(const std::filesystem::path& root) {
+		const std::filesystem::path nested = gPathCache.Resolve(root / "light" / "light.obj");
+		if (!nested.empty()) {
+			return nested;
+		}
+		return gPathCache.Resolve(root / "light.obj");
+	}
+
+	// Missing faces keep their expected path so callers can report them.
+	std::array<std::filesystem::path, 6> BuildCubemapFacePaths(const std::filesystem::path& root) {
+		std::array<std::filesystem::path, 6> faces{};
+		for (size_t i = 0; i < faces.size(); ++i) {
+			const std::filesystem::path expected = root / "cubemap" / kCubemapFaceFiles[i];
+			const std::filesystem::path resolved = gPathCache.Resolve(expected);
+			faces[i] = resolved.empty() ? expected : resolved;
+		}
+		return faces;
+	}
+
+	std::filesystem::path ResolveEnvironmentAssetRoot() {
+		const std::vector<std::filesystem::path> candidates = BuildAssetRootCandidates();
+		for (const std::filesystem::path& root : candidates) {
+			const std::filesystem::path cubePath = ResolveCubeObjPath(root);
+			if (cubePath.empty()) {
+				continue;
+			}
+			const auto cubemapFaces = BuildCubemapFacePaths(root);
+			bool allFacesFound = true;
+			for (const std::filesystem::path& face : cubemapFaces) {
+				if (!gPathCache.Exists(face)) {
+					allFacesFound = false;
+					break;
+				}
+			}
+			if (allFacesFound) {
+				return root;
+			}
+		}
+		return {};
+	}
+
+	// Decodes the six faces as a job each. Faces are not flipped, so each job overrides stb_image's
+	// flip flag for its thread and then puts back the flipped setting every other load runs with.
+	bool DecodeCubemapFaces(const std::array<std::filesystem::path, 6>& facePaths, std::array<DecodedImage, 6>& faces) {
+		Jobs().ParallelFor(facePaths.size(), 1, [&](size_t begin, size_t end) {
+			stbi_set_flip_vertically_on_load_thread(0);
+			for (size_t i = begin; i < end; ++i) {
+				DecodedImage& face = faces[i];
+				face.pixels.reset(stbi_load(facePaths[i].string().c_str(), &face.width, &face.height, &face.channels, 0));
+			}
+			stbi_set_flip_vertically_on_load_thread(1);
+		});
+		bool success = true;
+		for (size_t i = 0; i < faces.size(); ++i) {
+			if (!faces[i].pixels) {
+				std::fprintf(stderr, "Failed to load cubemap face: %s\n", facePaths[i].string().c_str());
+				success = false;
+			}
+		}
+		return success;
+	}
+
+	bool LoadSoftwareCubemap(const std::array<DecodedImage, 6>& faces) {
+		software::CubeTexture environment;
+		for (size_t i = 0; i < faces.size(); ++i) {
+			software::BuildTexture(faces[i].pixels.get(), faces[i].width, faces[i].height, faces[i].channels, environment.faces[i]);
+		}
+		gSoftwareEnvironment = std::move(environment);
+		gEnvironmentCubemap = gNextSoftwareTextureId++;
+		return true;
+	}
+
+	// Keys the prefiltered environment cache by the faces' identities and the filter settings.
+	std::uint64_t EnvironmentCacheKey(const std::array<std::filesystem::path, 6>& facePaths, const environment::FilterSettings& settings) {
+		std::uint64_t key = HashBytes(&kEnvironmentCacheVersion, sizeof(kEnvironmentCacheVersion));
+		const std::int32_t values[3] = {settings.levelCount, settings.sampleCount, settings.irradianceSize};
+		key = HashBytes(values, sizeof(values), key);
+		for (const std::filesystem::path& face : facePaths) {
+			const std::uint64_t faceHash = HashTextureFile(face);
+			key = HashBytes(&faceHash, sizeof(faceHash), key);
+		}
+		return key;
+	}
+
+	std::filesystem::path EnvironmentCachePath(std::uint64_t key) {
+		return ResolveCacheDirectory() / "environment" / (HashToHex(key) + ".bin");
+	}
+
+	size_t CubeLevelBytes(int size) {
+		return 6 * static_cast<size_t>(size) * static_cast<size_t>(size) * 3;
+	}
+
+	// Cache entry layout: magic, cache version, key, face size, level count, irradiance size, then the
+	// RGB8 faces of every level followed by those of the irradiance cube.
+	bool LoadPrefilteredEnvironment(std::uint64_t key, environment::PrefilteredCube& cube) {
+		std::vector<unsigned char> bytes;
+		if (!ReadCacheFile(EnvironmentCachePath(key), bytes)) {
+			return false;
+		}
+		constexpr size_t kHeaderSize = sizeof(kEnvironmentCacheMagic) + sizeof(std::uint32_t) + sizeof(std::uint64_t) + 3 * sizeof(std::uint32_t);
+		if (bytes.size() <= kHeaderSize || std::memcmp(bytes.data(), kEnvironmentCacheMagic, sizeof(kEnvironmentCacheMagic)) != 0) {
+			return false;
+		}
+		std::uint32_t version = 0;
+		std::uint64_t storedKey = 0;
+		std::uint32_t size = 0;
+		std::uint32_t levelCount = 0;
+		std::uint32_t irradianceSize = 0;
+		size_t offset = sizeof(kEnvironmentCacheMagic);
+		auto read = [&](void* value, size_t length) {
+			std::memcpy(value, bytes.data() + offset, length);
+			offset += length;
+		};
+		read(&version, sizeof(version));
+		read(&storedKey, sizeof(storedKey));
+		read(&size, sizeof(size));
+		read(&levelCount, sizeof(levelCount));
+		read(&irradianceSize, sizeof(irradianceSize));
+		if (version != kEnvironmentCacheVersion || storedKey != key || size == 0 || levelCount == 0 ||
+			levelCount > static_cast<std::uint32_t>(MipLevelCount(static_cast<int>(size), static_cast<int>(size))) || irradianceSize == 0) {
+			return false;
+		}
+		size_t expected = CubeLevelBytes(static_cast<int>(irradianceSize));
+		for (std::uint32_t level = 0; level < levelCount; ++level) {
+			expected += CubeLevelBytes(std::max(static_cast<int>(size >> level), 1));
+		}
+		if (bytes.size() - offset != expected) {
+			return false;
+		}
+		auto readLevel = [&](int levelSize, environment::CubeLevel& level) {
+			level.size = levelSize;
+			const size_t faceBytes = CubeLevelBytes(levelSize) / 6;
+			for (std::vector<std::uint8_t>& face : level.faces) {
+				face.assign(bytes.begin() + static_cast<std::ptrdiff_t>(offset), bytes.begin() + static_cast<std::ptrdiff_t>(offset + faceBytes));
+				offset += faceBytes;
+			}
+		};
+		cube.levels.resize(levelCount);
+		for (std::uint32_t level = 0; level < levelCount; ++level) {
+			readLevel(std::max(static_cast<int>(size >> level), 1), cube.levels[level]);
+		}
+		readLevel(static_cast<int>(irradianceSize), cube.irradiance);
+		return true;
+	}
+
+	void StorePrefilteredEnvironment(std::uint64_t key, const environment::PrefilteredCube& cube) {
+		const std::uint32_t version = kEnvironmentCacheVersion;
+		const std::uint32_t size = static_cast<std::uint32_t>(cube.levels.front().size);
+		const std::uint32_t levelCount = static_cast<std::uint32_t>(cube.levels.size());
+		const std::uint32_t irradianceSize = static_cast<std::uint32_t>(cube.irradiance.size);
+		std::vector<unsigned char> bytes(kEnvironmentCacheMagic, kEnvironmentCacheMagic + sizeof(kEnvironmentCacheMagic));
+		auto append = [&](const void* data, size_t length) {
+			const unsigned char* begin = static_cast<const unsigned char*>(data);
+			bytes.insert(bytes.end(), begin, begin + length);
+		};
+		append(&version, sizeof(version));
+		append(&key, sizeof(key));
+		append(&size, sizeof(size));
+		append(&levelCount, sizeof(levelCount));
+		append(&irradianceSize, sizeof(irradianceSize));
+		for (const environment::CubeLevel& level : cube.levels) {
+			for (const std::vector<std::uint8_t>& face : level.faces) {
+				append(face.data(), face.size());
+			}
+		}
+		for (const std::vector<std::uint8_t>& face : cube.irradiance.faces) {
+			append(face.data(), face.size());
+		}
+		WriteCacheFile(EnvironmentCachePath(key), bytes);
+	}
+
+	// RGB8 copy of decoded faces for the prefilter; false when they are not equal squares.
+	bool BuildFilterSource(const std::array<DecodedImage, 6>& faces, environment::CubeLevel& source) {
+		source.size = faces[0].width;
+		for (size_t i = 0; i < faces.size(); ++i) {
+			const DecodedImage& face = faces[i];
+			if (face.width != source.size || face.height != source.size || face.channels < 1 || face.channels > 4) {
+				return false;
+			}
+			const size_t texels = static_cast<size_t>(face.width) * static_cast<size_t>(face.height);
+			const size_t channels = static_cast<size_t>(face.channels);
+			std::vector<std::uint8_t>& rgb = source.faces[i];
+			rgb.resize(texels * 3);
+			for (size_t t = 0; t < texels; ++t) {
+				const stbi_uc* texel = face.pixels.get() + t * channels;
+				// One and two channel faces are luminance, as ChannelsToFormat uploads them.
+				rgb[t * 3 + 0] = texel[0];
+				rgb[t * 3 + 1] = channels >= 3 ? texel[1] : texel[0];
+				rgb[t * 3 + 2] = channels >= 3 ? texel[2] : texel[0];
+			}
+		}
+		return true;
+	}
+
+	// Uploads every level of the prefiltered chain. With streaming, level 0 goes through the upload
+	// ring and level 1 stands in for it meanwhile.
+	void UploadPrefilteredCubemap(GLuint cubemap, environment::PrefilteredCube& cube, bool stream) {
+		const int levelCount = static_cast<int>(cube.levels.size());
+		const bool streamBase = stream && levelCount > 1;
+		glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAX_LEVEL, levelCount - 1);
+		if (streamBase) {
+			BeginStreamedTexture(cubemap, GL_TEXTURE_CUBE_MAP, false).maxLevel = levelCount - 1;
+			glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_BASE_LEVEL, 1);
+		}
+		for (int level = 0; level < levelCount; ++level) {
+			environment::CubeLevel& cubeLevel = cube.levels[static_cast<size_t>(level)];
+			for (size_t i = 0; i < kCubemapFaceTargets.size(); ++i) {
+				if (level == 0 && streamBase) {
+					glTexImage2D(kCubemapFaceTargets[i], 0, GL_RGB, cubeLevel.size, cubeLevel.size, 0, GL_RGB, GL_UNSIGNED_BYTE, nullptr);
+					auto owner = std::make_shared<std::vector<std::uint8_t>>(std::move(cubeLevel.faces[i]));
+					QueueStreamedImage(
+						cubemap,
+						kCubemapFaceTargets[i],
+						0,
+						std::shared_ptr<const unsigned char>(owner, owner->data()),
+						cubeLevel.size,
+						cubeLevel.size,
+						3,
+						GL_RGB);
+					continue;
+				}
+				glTexImage2D(kCubemapFaceTargets[i], level, GL_RGB, cubeLevel.size, cubeLevel.size, 0, GL_RGB, GL_UNSIGNED_BYTE, cubeLevel.faces[i].data());
+			}
+		}
+	}
+
+	GLuint CreateIrradianceCubemap(const environment::CubeLevel& irradiance) {
+		GLuint cubemap = 0;
+		glGenTextures(1, &cubemap);
+		if (cubemap == 0) {
+			return 0;
+		}
+		glBindTexture(GL_TEXTURE_CUBE_MAP, cubemap);
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+		for (size_t i = 0; i < kCubemapFaceTargets.size(); ++i) {
+			glTexImage2D(kCubemapFaceTargets[i], 0, GL_RGB, irradiance.size, irradiance.size, 0, GL_RGB, GL_UNSIGNED_BYTE, irradiance.faces[i].data());
+		}
+		glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAX_LEVEL, 0);
+		glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
+		return cubemap;
+	}
+
+	// CPU half of loading the environment cube, safe to run on a worker: faces decoded or, when
+	// prefiltering, the cached or freshly filtered chain.
+	struct PreparedCubemap {
+		std::array<DecodedImage, 6> faces;
+		environment::PrefilteredCube prefiltered;
+		EnvironmentLoadStats stats;
+	};
+
+	// When prefiltering, a cached chain skips both decoding and filtering; otherwise the faces are
+	// decoded in parallel and filtered on the CPU, and the result cached. Faces that cannot be
+	// prefiltered (not equal squares) fall back to box-filtered mips.
+	bool PrepareCubemap(const std::filesystem::path& root, PreparedCubemap& cubemap) {
+		const auto facePaths = BuildCubemapFacePaths(root);
+		for (const std::filesystem::path& face : facePaths) {
+			if (!gPathCache.Exists(face)) {
+				std::fprintf(stderr, "Cubemap face missing: %s\n", face.string().c_str());
+				return false;
+			}
+		}
+
+		const bool prefilter = gPrefilterEnvironment && !gSoftwareOnly;
+		environment::FilterSettings settings;
+		EnvironmentLoadStats& stats = cubemap.stats;
+		const std::uint64_t cacheKey = prefilter ? EnvironmentCacheKey(facePaths, settings) : 0;
+		stats.fromCache = prefilter && LoadPrefilteredEnvironment(cacheKey, cubemap.prefiltered);
+		if (stats.fromCache) {
+			return true;
+		}
+		const auto decodeStart = std::chrono::steady_clock::now();
+		if (!DecodeCubemapFaces(facePaths, cubemap.faces)) {
+			return false;
+		}
+		stats.decodeMs = ElapsedMilliseconds(decodeStart);
+		environment::CubeLevel source;
+		if (prefilter && BuildFilterSource(cubemap.faces, source)) {
+			// Usually called from a startup job; rows go to the job pool rather than to threads of their own.
+			settings.parallelFor = [](size_t count, const std::function<void(size_t, size_t)>& body) {
+				Jobs().ParallelFor(count, 1, body);
+			};
+			const auto filterStart = std::chrono::steady_clock::now();
+			cubemap.prefiltered = environment::Prefilter(source, settings);
+			stats.prefilterMs = ElapsedMilliseconds(filterStart);
+			if (!cubemap.prefiltered.levels.empty()) {
+				StorePrefilteredEnvironment(cacheKey, cubemap.prefiltered);
+			}
+		}
+		return true;
+	}
+
+	// GL half: uploads a prepared cube and makes it the environment.
+	bool UploadCubemapTexture(PreparedCubemap& prepared) {
+		if (gSoftwareOnly) {
+			return LoadSoftwareCubemap(prepared.faces);
+		}
+		gSoftwareEnvironment = software::CubeTexture{};
+		EnvironmentLoadStats stats = prepared.stats;
+		environment::PrefilteredCube& prefiltered = prepared.prefiltered;
+		std::array<DecodedImage, 6>& faces = prepared.faces;
+
+		GLuint cubemap = 0;
+		glGenTextures(1, &cubemap);
+		if (cubemap == 0) {
+			return false;
+		}
+
+		glBindTexture(GL_TEXTURE_CUBE_MAP, cubemap);
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+		const bool stream = IsTextureStreamingActive();
+		int placeholderLevel = 0;
+		if (!prefiltered.levels.empty()) {
+			stats.faceSize = prefiltered.levels.front().size;
+			stats.levels = static_cast<int>(prefiltered.levels.size());
+			UploadPrefilteredCubemap(cubemap, prefiltered, stream);
+		} else {
+			stats.faceSize = faces[0].width;
+			if (stream) {
+				BeginStreamedTexture(cubemap, GL_TEXTURE_CUBE_MAP, true);
+			}
+			for (size_t i = 0; i < faces.size(); ++i) {
+				DecodedImage& face = faces[i];
+				const GLenum format = ChannelsToFormat(face.channels);
+				const int level = stream ? LevelAtMostSize(face.width, face.height, kPlaceholderMaxSize) : 0;
+				if (level > 0) {
+					UploadPlaceholderLevel(kCubemapFaceTargets[i], level, face.pixels.get(), face.width, face.height, face.channels, format, format);
+					QueueStreamedImage(
+						cubemap,
+						kCubemapFaceTargets[i],
+						0,
+						std::shared_ptr<const unsigned char>(face.pixels.release(), stbi_image_free),
+						face.width,
+						face.height,
+						face.channels,
+						format);
+					placeholderLevel = level;
+					continue;
+				}
+				glTexImage2D(
+					kCubemapFaceTargets[i],
+					0,
+					format,
+					face.width,
+					face.height,
+					0,
+					format,
+					GL_UNSIGNED_BYTE,
+					face.pixels.get());
+			}
+			if (placeholderLevel == 0) {
+				CancelStreamedTexture(cubemap);
+			}
+		}
+
+		glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+		glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+		if (gHasAnisotropicFiltering) {
+			glTexParameterf(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAX_ANISOTROPY_EXT, gMaxAnisotropy);
+		}
+		if (placeholderLevel > 0) {
+			// Mips are generated once the faces' level 0 has streamed in.
+			glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_BASE_LEVEL, placeholderLevel);
+			glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAX_LEVEL, placeholderLevel);
+		} else if (prefiltered.levels.empty() && pglGenerateMipmap) {
+			pglGenerateMipmap(GL_TEXTURE_CUBE_MAP);
+		}
+		glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
+
+		if (gEnvironmentCubemap != 0) {
+			CancelStreamedTexture(gEnvironmentCubemap);
+			glDeleteTextures(1, &gEnvironmentCubemap);
+		}
+		if (gIrradianceCubemap != 0) {
+			glDeleteTextures(1, &gIrradianceCubemap);
+			gIrradianceCubemap = 0;
+		}
+		gEnvironmentCubemap = cubemap;
+		if (!prefiltered.levels.empty()) {
+			gIrradianceCubemap = CreateIrradianceCubemap(prefiltered.irradiance);
+		}
+		gEnvironmentStats = stats;
+		return true;
+	}
+
+	bool LoadCubemapTexture(const std::filesystem::path& root) {
+		PreparedCubemap prepared;
+		return PrepareCubemap(root, prepared) && UploadCubemapTexture(prepared);
+	}
+
+	// Routes Assimp's own file probes, e.g. the OBJ importer looking for its .mtl, through gPathCache so
+	// they share its listings and its case-insensitive matching.
+	class CachedIOSystem : public Assimp::DefaultIOSystem {
+	public:
+		bool Exists(const char* file) const override {
+			return gPathCache.Exists(file);
+		}
+		Assimp::IOStream* Open(const char* file, const char* mode = "rb") override {
+			const std::filesystem::path resolved = gPathCache.Resolve(file);
+			return DefaultIOSystem::Open(resolved.empty() ? file : resolved.string().c_str(), mode);
+		}
+	};
+
+	// Lets a cancelled import stop at Assimp's next progress report.
+	class ImportCancellation : public Assimp::ProgressHandler {
+	public:
+		explicit ImportCancellation(std::function<bool()> cancelled) : mCancelled(std::move(cancelled)) {}
+
+		bool Update(float) override {
+			return !mCancelled();
+		}
+
+	private:
+		std::function<bool()> mCancelled;
+	};
+
+	// CPU half of a mesh load: the Assimp import and the vertex/index build. It touches no GL state, so
+	// several imports can run on worker threads at once. The scene stays with its importer until
+	// LoadMeshMaterials has read the materials.
+	struct ImportedMesh {
+		std::string path;
+		std::unique_ptr<Assimp::Importer> importer;
+		const aiScene* scene = nullptr;
+		std::vector<Vertex> vertices;
+		std::vector<unsigned int> indices;
+		Bounds bounds;
+		std::vector<Submesh> submeshes;
+		// Path statistics are differences of gPathCache's totals, so they include lookups made by
+		// concurrent imports.
+		gpurenderer::LoadTimings timings;
+	};
+
+	// cancelled, when set, is polled during the import; a cancelled import fails without a message.
+	bool ImportMesh(const std::string& path, ImportedMesh& imported, std::function<bool()> cancelled = {}) {
+		imported = ImportedMesh{};
+		imported.path = path;
+		const gpurenderer::assets::PathCacheStats pathStatsBefore = gPathCache.Stats();
+		imported.importer = std::make_unique<Assimp::Importer>();
+		Assimp::Importer& importer = *imported.importer;
+		importer.SetIOHandler(new CachedIOSystem());
+		if (cancelled) {
+			importer.SetProgressHandler(new ImportCancellation(cancelled));
+		}
+#ifdef AI_CONFIG_IMPORT_OBJ_FAST_VERTICES
+		importer.SetPropertyInteger(AI_CONFIG_IMPORT_OBJ_FAST_VERTICES, 1);
+#endif
+#ifdef AI_CONFIG_IMPORT_OBJ_FAST_MATERIAL
+		importer.SetPropertyInteger(AI_CONFIG_IMPORT_OBJ_FAST_MATERIAL, 1);
+#endif
+		const unsigned int flags =
+			aiProcess_Triangulate |
+			aiProcess_JoinIdenticalVertices;
+		const auto importStart = std::chrono::steady_clock::now();
+		std::printf("Assimp import starting: %s\n", path.c_str());
+		std::fflush(stdout);
+		const aiScene* scene = importer.ReadFile(
+			path,
+			flags);
+		const auto importEnd = std::chrono::steady_clock::now();
+		const double importSeconds = std::chrono::duration<double>(importEnd - importStart).count();
+		std::printf("Assimp import finished in %.2f seconds: %s\n", importSeconds, path.c_str());
+		std::fflush(stdout);
+		imported.timings.importMs = importSeconds * 1000.0;
+		const gpurenderer::assets::PathCacheStats pathStats = gPathCache.Stats();
+		imported.timings.pathLookups = pathStats.lookups - pathStatsBefore.lookups;
+		imported.timings.directoryReads = pathStats.directoryReads - pathStatsBefore.directoryReads;
+		imported.timings.statCalls = pathStats.statCalls - pathStatsBefore.statCalls;
+
+		if (cancelled && cancelled()) {
+			return false;
+		}
+		if (!scene || !scene->HasMeshes()) {
+			std::fprintf(stderr, "Assimp failed to load mesh: %s\n", importer.GetErrorString());
+			return false;
+		}
+		imported.scene = scene;
+
+		std::vector<Vertex>& vertices = imported.vertices;
+		std::vector<unsigned int>& indices = imported.indices;
+		Bounds& bounds = imported.bounds;
+		std::vector<Submesh>& submeshes = imported.submeshes;
+		// LoadMeshMaterials makes one default material for a scene without any.
+		const unsigned int materialCount = std::max(scene->mNumMaterials, 1u);
+		const auto buildStart = std::chrono::steady_clock::now();
+		// Sizes every mesh's slice of the shared arrays first, so the meshes can be filled in parallel:
+		// vertices in fixed-size ranges that may span meshes, indices and normals one mesh per job.
+		struct MeshSlice {
+			const aiMesh* mesh = nullptr;
+			size_t vertexOffset = 0;
+			size_t indexOffset = 0;
+			size_t indexCount = 0;
+		};
+		std::vector<MeshSlice> slices;
+		size_t vertexTotal = 0;
+		size_t indexTotal = 0;
+		for (unsigned int meshIndex = 0; meshIndex < scene->mNumMeshes; ++meshIndex) {
+			const aiMesh* mesh = scene->mMeshes[meshIndex];
+			if (!mesh || mesh->mNumVertices == 0) {
+				continue;
+			}
+			if (!mesh->HasTextureCoords(0)) {
+				std::fprintf(stderr, "Mesh %u has no texture coordinates.\n", meshIndex);
+			}
+			MeshSlice slice;
+			slice.mesh = mesh;
+			slice.vertexOffset = vertexTotal;
+			slice.indexOffset = indexTotal;
+			for (unsigned int i = 0; i < mesh->mNumFaces; ++i) {
+				slice.indexCount += mesh->mFaces[i].mNumIndices == 3 ? 3u : 0u;
+			}
+			vertexTotal += mesh->mNumVertices;
+			indexTotal += slice.indexCount;
+			slices.push_back(slice);
+		}
+		vertices.resize(vertexTotal);
+		indices.resize(indexTotal);
+
+		jobs::JobSystem& jobSystem = Jobs();
+		std::vector<Bounds> rangeBounds((vertexTotal + kMeshBuildGrain - 1) / kMeshBuildGrain);
+		jobSystem.ParallelFor(vertexTotal, kMeshBuildGrain, [&](size_t begin, size_t end) {
+			Bounds& localBounds = rangeBounds[begin / kMeshBuildGrain];
+			auto slice = std::upper_bound(slices.begin(), slices.end(), begin, [](size_t vertex, const MeshSlice& s) {
+				return vertex < s.vertexOffset;
+			}) - 1;
+			for (size_t v = begin; v < end; ++v) {
+				while (v >= slice->vertexOffset + slice->mesh->mNumVertices) {
+					++slice;
+				}
+				const aiMesh* mesh = slice->mesh;
+				const size_t i = v - slice->vertexOffset;
+				const aiVector3D pos = mesh->mVertices[i];
+				aiVector3D normal(0.0f, 0.0f, 0.0f);
+				if (mesh->HasNormals()) {
+					normal = mesh->mNormals[i];
+				}
+				aiVector3D uv(0.0f, 0.0f, 0.0f);
+				if (mesh->HasTextureCoords(0)) {
+					uv = mesh->mTextureCoords[0][i];
+				}
+				Vertex& vertex = vertices[v];
+				vertex.position = glm::vec3(pos.x, pos.y, pos.z);
+				vertex.normal = glm::vec3(normal.x, normal.y, normal.z);
+				vertex.texcoord = glm::vec2(uv.x, uv.y);
+				localBounds.Expand(vertex.position);
+			}
+		});
+		for (const Bounds& localBounds : rangeBounds) {
+			if (localBounds.valid) {
+				bounds.Expand(localBounds.min);
+				bounds.Expand(localBounds.max);
+			}
+		}
+		jobSystem.ParallelFor(slices.size(), 1, [&](size_t begin, size_t end) {
+			for (size_t s = begin; s < end; ++s) {
+				const MeshSlice& slice = slices[s];
+				const unsigned int baseIndex = static_cast<unsigned int>(slice.vertexOffset);
+				unsigned int* out = indices.data() + slice.indexOffset;
+				for (unsigned int i = 0; i < slice.mesh->mNumFaces; ++i) {
+					const aiFace& face = slice.mesh->mFaces[i];
+					if (face.mNumIndices != 3) {
+						continue;
+					}
+					*out++ = baseIndex + face.mIndices[0];
+					*out++ = baseIndex + face.mIndices[1];
+					*out++ = baseIndex + face.mIndices[2];
+				}
+			}
+		});
+
+		const auto normalsStart = std::chrono::steady_clock::now();
+		jobSystem.ParallelFor(slices.size(), 1, [&](size_t begin, size_t end) {
+			for (size_t s = begin; s < end; ++s) {
+				const MeshSlice& slice = slices[s];
+				if (!slice.mesh->HasNormals() && slice.indexCount > 0) {
+					ComputeNormalsForMesh(
+						vertices,
+						indices,
+						slice.vertexOffset,
+						slice.mesh->mNumVertices,
+						slice.indexOffset,
+						slice.indexCount);
+				}
+			}
+		});
+		imported.timings.normalsMs += ElapsedMilliseconds(normalsStart);
+
+		for (const MeshSlice& slice : slices) {
+			if (slice.indexCount > 0) {
+				Submesh submesh;
+				submesh.indexOffset = static_cast<int>(slice.indexOffset);
+				submesh.indexCount = static_cast<int>(slice.indexCount);
+				if (slice.mesh->mMaterialIndex < materialCount) {
+					submesh.materialIndex = static_cast<int>(slice.mesh->mMaterialIndex);
+				} else {
+					submesh.materialIndex = 0;
+				}
+				submeshes.push_back(submesh);
+			}
+		}
+
+		if (!bounds.valid || vertices.empty() || indices.empty()) {
+			std::fprintf(stderr, "Mesh contained no valid triangles: %s\n", imported.path.c_str());
+			return false;
+		}
+		const auto buildEnd = std::chrono::steady_clock::now();
+		const double buildSeconds = std::chrono::duration<double>(buildEnd - buildStart).count();
+		std::printf("Mesh build finished in %.2f seconds.\n", buildSeconds);
+		std::fflush(stdout);
+
+		imported.timings.meshBuildMs = std::max(0.0, buildSeconds * 1000.0 - imported.timings.normalsMs);
+		imported.timings.vertices = vertices.size();
+		imported.timings.triangles = indices.size() / 3u;
+		return true;
+	}
+
+	// GL half of a mesh load: decodes and uploads the scene's textures and builds its materials. Releases
+	// the imported scene afterwards.
+	// Name, colors and shininess of an imported material.
+	void ReadMaterialConstants(const aiMaterial* material, Material& mat) {
+		aiString materialName;
+		if (material->Get(AI_MATKEY_NAME, materialName) == AI_SUCCESS && materialName.length > 0) {
+			mat.name = materialName.C_Str();
+		}
+		aiColor3D color(0.0f, 0.0f, 0.0f);
+		if (material->Get(AI_MATKEY_COLOR_AMBIENT, color) == AI_SUCCESS) {
+			mat.ambient = ToVec3(color);
+		}
+		if (material->Get(AI_MATKEY_COLOR_DIFFUSE, color) == AI_SUCCESS) {
+			mat.diffuse = ToVec3(color);
+		}
+		if (material->Get(AI_MATKEY_COLOR_SPECULAR, color) == AI_SUCCESS) {
+			mat.specular = ToVec3(color);
+		}
+		float shininess = 0.0f;
+		if (material->Get(AI_MATKEY_SHININESS, shininess) == AI_SUCCESS && shininess > 0.0f) {
+			mat.shininess = shininess;
+		}
+	}
+
+	// A specular map on a material without specular color would never show.
+	void ApplySpecularMapDefault(Material& mat) {
+		if (mat.hasSpecularTexture) {
+			const float maxSpec = std::max(mat.specular.x, std::max(mat.specular.y, mat.specular.z));
+			if (maxSpec <= 0.001f) {
+				mat.specular = glm::vec3(1.0f);
+			}
+		}
+	}
+
+	void LoadMeshMaterials(ImportedMesh& mesh, std::vector<Material>& materials) {
+		const aiScene* scene = mesh.scene;
+		gpurenderer::LoadTimings& stageTimings = mesh.timings;
+		const gpurenderer::assets::PathCacheStats pathStatsBefore = gPathCache.Stats();
+		materials.clear();
+
+		std::filesystem::path objPath(mesh.path);
+		if (objPath.is_relative()) {
+			objPath = std::filesystem::absolute(objPath);
+		}
+		const std::filesystem::path baseDir = objPath.parent_path();
+
+		const auto texturesStart = std::chrono::steady_clock::now();
+		const double textureUploadBefore = gTextureUploadMs;
+		const std::string scenePath = objPath.lexically_normal().string();
+		std::vector<DecodedImage> embeddedImages = DecodeEmbeddedTextures(scene, scenePath);
+		if (scene->mNumMaterials == 0) {
+			materials.emplace_back();
+			materials.front().name = "Default";
+		} else {
+			materials.resize(scene->mNumMaterials);
+			for (unsigned int matIndex = 0; matIndex < scene->mNumMaterials; ++matIndex) {
+				Material mat;
+				mat.name = "Material " + std::to_string(matIndex);
+				const aiMaterial* material = scene->mMaterials[matIndex];
+				if (!material) {
+					materials[matIndex] = mat;
+					continue;
+				}
+
+				auto loadTexture = [&](aiTextureType type, const char* label, GLuint& outTex, bool& hasTex) -> bool {
+					aiString texPath;
+					if (material->GetTextureCount(type) == 0 ||
+						material->GetTexture(type, 0, &texPath) != AI_SUCCESS) {
+						return false;
+					}
+
+					if (texPath.length > 0 && texPath.C_Str()[0] == '*') {
+						const int texIndex = std::atoi(texPath.C_Str() + 1);
+						if (texIndex >= 0 && static_cast<unsigned int>(texIndex) < scene->mNumTextures) {
+							const std::string key = EmbeddedTextureKey(scenePath, static_cast<unsigned int>(texIndex));
+							outTex = FindCachedTexture(key);
+							if (outTex == 0) {
+								const aiTexture* texture = scene->mTextures[texIndex];
+								DecodedImage& decoded = embeddedImages[texIndex];
+								size_t bytes = 0;
+								outTex = LoadTextureFromMemory(texture, decoded, key, bytes);
+								CacheTexture(key, outTex, bytes);
+							}
+						}
+					} else {
+						const std::filesystem::path resolved = ResolveTexturePath(baseDir, texPath);
+						outTex = LoadTextureFromFile(resolved);
+					}
+
+					hasTex = outTex != 0;
+					stageTimings.textures += hasTex ? 1u : 0u;
+					if (!hasTex) {
+						std::fprintf(stderr, "Material %u %s texture failed: %s\n",
+							matIndex,
+							label,
+							texPath.C_Str());
+					}
+					return hasTex;
+				};
+
+				ReadMaterialConstants(material, mat);
+
+				if (!loadTexture(aiTextureType_DIFFUSE, "diffuse", mat.diffuseTexture, mat.hasDiffuseTexture)) {
+					if (!loadTexture(aiTextureType_BASE_COLOR, "base_color", mat.diffuseTexture, mat.hasDiffuseTexture)) {
+						loadTexture(aiTextureType_AMBIENT, "ambient", mat.diffuseTexture, mat.hasDiffuseTexture);
+					}
+				}
+
+				if (!loadTexture(aiTextureType_SPECULAR, "specular", mat.specularTexture, mat.hasSpecularTexture)) {
+					if (!loadTexture(aiTextureType_SHININESS, "shininess", mat.specularTexture, mat.hasSpecularTexture)) {
+						if (!loadTexture(aiTextureType_METALNESS, "metalness", mat.specularTexture, mat.hasSpecularTexture)) {
+							loadTexture(aiTextureType_REFLECTION, "reflection", mat.specularTexture, mat.hasSpecularTexture);
+						}
+					}
+				}
+				ApplySpecularMapDefault(mat);
+
+				materials[matIndex] = mat;
+			}
+		}
+		stageTimings.textureUploadMs = gTextureUploadMs - textureUploadBefore;
+		stageTimings.textureDecodeMs = std::max(0.0, ElapsedMilliseconds(texturesStart) - stageTimings.textureUploadMs);
+		const gpurenderer::assets::PathCacheStats pathStats = gPathCache.Stats();
+		stageTimings.pathLookups += pathStats.lookups - pathStatsBefore.lookups;
+		stageTimings.directoryReads += pathStats.directoryReads - pathStatsBefore.directoryReads;
+		stageTimings.statCalls += pathStats.statCalls - pathStatsBefore.statCalls;
+		std::printf("Resolved %zu asset paths with %zu directory reads and %zu stats.\n",
+			stageTimings.pathLookups,
+			stageTimings.directoryReads,
+			stageTimings.statCalls);
+		stageTimings.materials = materials.size();
+		mesh.importer.reset();
+		mesh.scene = nullptr;
+	}
+
+	bool LoadMesh(const std::string& path,
+		std::vector<Vertex>& vertices,
+		std::vector<unsigned int>& indices,
+		Bounds& bounds,
+		std::vector<Submesh>& submeshes,
+		std::vector<Material>& materials,
+		gpurenderer::LoadTimings* timings = nullptr) {
+		ImportedMesh mesh;
+		if (!ImportMesh(path, mesh)) {
+			return false;
+		}
+		LoadMeshMaterials(mesh, materials);
+		vertices = std::move(mesh.vertices);
+		indices = std::move(mesh.indices);
+		bounds = mesh.bounds;
+		submeshes = std::move(mesh.submeshes);
+		if (timings != nullptr) {
+			*timings = mesh.timings;
+		}
+		return true;
+	}
+
+	// Replaces a shared buffer with a larger one, carrying the old contents over on the GPU when
+	// glCopyBufferSubData is available and through a CPU staging copy otherwise.
+	bool ResizeArenaBuffer(GLenum target, GLuint& buffer, size_t oldBytes, size_t newBytes) {
+		if (buffer != 0 && oldBytes > 0 && !gHasCopyBuffer && !pglGetBufferSubData) {
+			return false;
+		}
+		GLuint newBuffer = 0;
+		pglGenBuffers(1, &newBuffer);
+		if (newBuffer == 0) {
+			return false;
+		}
+		pglBindBuffer(target, newBuffer);
+		pglBufferData(target, static_cast<std::ptrdiff_t>(newBytes), nullptr, GL_STATIC_DRAW);
+		if (buffer != 0 && oldBytes > 0) {
+			if (gHasCopyBuffer) {
+				pglBindBuffer(GL_COPY_READ_BUFFER, buffer);
+				pglBindBuffer(GL_COPY_WRITE_BUFFER, newBuffer);
+				pglCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, static_cast<std::ptrdiff_t>(oldBytes));
+				pglBindBuffer(GL_COPY_READ_BUFFER, 0);
+				pglBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+			} else {
+				std::vector<unsigned char> staging(oldBytes);
+				pglBindBuffer(target, buffer);
+				pglGetBufferSubData(target, 0, static_cast<std::ptrdiff_t>(oldBytes), staging.data());
+				pglBindBuffer(target, newBuffer);
+				pglBufferSubData(target, 0, static_cast<std::ptrdiff_t>(oldBytes), staging.data());
+			}
+		}
+		pglBindBuffer(target, 0);
+		if (buffer != 0 && pglDeleteBuffers) {
+			pglDeleteBuffers(1, &buffer);
+		}
+		buffer = newBuffer;
+		return true;
+	}
+
+	void ConfigureArenaVertexArray(GeometryArena& arena) {
+		if (!gUseVao) {
+			return;
+		}
+		if (arena.vao == 0) {
+			pglGenVertexArrays(1, &arena.vao);
+		}
+		pglBindVertexArray(arena.vao);
+		if (arena.materialVbo != 0) {
+			pglBindBuffer(GL_ARRAY_BUFFER, arena.materialVbo);
+			pglEnableVertexAttribArray(kMaterialSlotLocation);
+			pglVertexAttribPointer(kMaterialSlotLocation, 1, GL_FLOAT, GL_FALSE, sizeof(float), nullptr);
+		}
+		pglBindBuffer(GL_ARRAY_BUFFER, arena.vbo);
+		pglBindBuffer(GL_ELEMENT_ARRAY_BUFFER, arena.ebo);
+		pglEnableVertexAttribArray(0);
+		pglVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), reinterpret_cast<void*>(offsetof(Vertex, position)));
+		pglEnableVertexAttribArray(1);
+		pglVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), reinterpret_cast<void*>(offsetof(Vertex, normal)));
+		pglEnableVertexAttribArray(2);
+		pglVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), reinterpret_cast<void*>(offsetof(Vertex, texcoord)));
+		pglBindVertexArray(0);
+	}
+
+	// Carves vertex and index ranges out of the arena, doubling whichever buffer is too fragmented
+	// or too small. Existing ranges keep their offsets across growth.
+	bool AllocateArenaRanges(GeometryArena& arena, size_t vertexCount, size_t indexCount, ArenaRange& vertexRange, ArenaRange& indexRange) {
+		const bool growVertices = arena.vertices.LargestFreeRange() < vertexCount;
+		const bool growIndices = arena.indices.LargestFreeRange() < indexCount;
+		if ((growVertices || growIndices) && gSoftwareOnly) {
+			if (growVertices) {
+				arena.vertices.Grow(std::max({kArenaMinVertices, arena.vertices.capacity * 2, arena.vertices.capacity + vertexCount}));
+			}
+			if (growIndices) {
+				arena.indices.Grow(std::max({kArenaMinIndices, arena.indices.capacity * 2, arena.indices.capacity + indexCount}));
+			}
+		} else if (growVertices || growIndices) {
+			if (gUseVao) {
+				pglBindVertexArray(0);
+			}
+			if (growVertices) {
+				const size_t capacity = std::max({kArenaMinVertices, arena.vertices.capacity * 2, arena.vertices.capacity + vertexCount});
+				if (!ResizeArenaBuffer(GL_ARRAY_BUFFER, arena.vbo, arena.vertices.capacity * sizeof(Vertex), capacity * sizeof(Vertex))) {
+					return false;
+				}
+				if (gMaterialBatching.supported &&
+					!ResizeArenaBuffer(GL_ARRAY_BUFFER, arena.materialVbo, arena.vertices.capacity * sizeof(float), capacity * sizeof(float))) {
+					return false;
+				}
+				arena.vertices.Grow(capacity);
+			}
+			if (growIndices) {
+				const size_t capacity = std::max({kArenaMinIndices, arena.indices.capacity * 2, arena.indices.capacity + indexCount});
+				if (!ResizeArenaBuffer(GL_ELEMENT_ARRAY_BUFFER, arena.ebo, arena.indices.capacity * sizeof(unsigned int), capacity * sizeof(unsigned int))) {
+					return false;
+				}
+				arena.indices.Grow(capacity);
+			}
+			ConfigureArenaVertexArray(arena);
+		}
+		if (!arena.vertices.Allocate(vertexCount, vertexRange)) {
+			return false;
+		}
+		if (!arena.indices.Allocate(indexCount, indexRange)) {
+			arena.vertices.Free(vertexRange);
+			return false;
+		}
+		return true;
+	}
+
+	void DestroyGeometryArena(GeometryArena& arena) {
+		if (pglDeleteBuffers) {
+			if (arena.ebo != 0) {
+				pglDeleteBuffers(1, &arena.ebo);
+			}
+			if (arena.vbo != 0) {
+				pglDeleteBuffers(1, &arena.vbo);
+			}
+			if (arena.materialVbo != 0) {
+				pglDeleteBuffers(1, &arena.materialVbo);
+			}
+		}
+		if (gUseVao && pglDeleteVertexArrays && arena.vao != 0) {
+			pglDeleteVertexArrays(1, &arena.vao);
+		}
+		arena = GeometryArena{};
+	}
+
+	// Uploads geometry into previously allocated arena ranges. Indices are rebased onto the first vertex of
+	// the range so every draw addresses the shared vertex buffer directly, without base-vertex draw calls.
+	void UploadArenaGeometry(const std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices, const ArenaRange& vertexRange, const ArenaRange& indexRange) {
+		if (gSoftwareOnly) {
+			return;
+		}
+		if (gUseVao) {
+			pglBindVertexArray(0);
+		}
+		pglBindBuffer(GL_ARRAY_BUFFER, gGeometryArena.vbo);
+		pglBufferSubData(
+			GL_ARRAY_BUFFER,
+			static_cast<std::ptrdiff_t>(vertexRange.offset * sizeof(Vertex)),
+			static_cast<std::ptrdiff_t>(vertices.size() * sizeof(Vertex)),
+			vertices.data());
+		pglBindBuffer(GL_ARRAY_BUFFER, 0);
+		if (indices.empty()) {
+			return;
+		}
+
+		pglBindBuffer(GL_ELEMENT_ARRAY_BUFFER, gGeometryArena.ebo);
+		const unsigned int baseVertex = static_cast<unsigned int>(vertexRange.offset);
+		std::vector<unsigned int> chunk;
+		chunk.reserve(std::min(kIndexUploadChunk, indices.size()));
+		for (size_t start = 0; start < indices.size(); start += kIndexUploadChunk) {
+			const size_t count = std::min(kIndexUploadChunk, indices.size() - start);
+			chunk.assign(indices.begin() + static_cast<std::ptrdiff_t>(start), indices.begin() + static_cast<std::ptrdiff_t>(start + count));
+			for (unsigned int& index : chunk) {
+				index += baseVertex;
+			}
+			pglBufferSubData(
+				GL_ELEMENT_ARRAY_BUFFER,
+				static_cast<std::ptrdiff_t>((indexRange.offset + start) * sizeof(unsigned int)),
+				static_cast<std::ptrdiff_t>(count * sizeof(unsigned int)),
+				chunk.data());
+		}
+		pglBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+	}
+
+	bool UploadArenaMesh(const std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices, ArenaMesh& mesh) {
+		if (vertices.empty()) {
+			return false;
+		}
+		if (!AllocateArenaRanges(gGeometryArena, vertices.size(), indices.size(), mesh.vertexRange, mesh.indexRange)) {
+			mesh = ArenaMesh{};
+			return false;
+		}
+		UploadArenaGeometry(vertices, indices, mesh.vertexRange, mesh.indexRange);
+		return true;
+	}
+
+	void ReleaseArenaMesh(ArenaMesh& mesh) {
+		gGeometryArena.vertices.Free(mesh.vertexRange);
+		gGeometryArena.indices.Free(mesh.indexRange);
+		mesh = ArenaMesh{};
+	}
+
+	void DrawArenaMesh(const ArenaMesh& mesh) {
+		glDrawElements(GL_TRIANGLES, mesh.IndexCount(), GL_UNSIGNED_INT, mesh.IndexOffset());
+	}
+
+	void DestroyBackgroundBuffers() {
+		ReleaseArenaMesh(gBackgroundMesh);
+	}
+
+	void CreateBackgroundBuffers(const std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices) {
+		DestroyBackgroundBuffers();
+		if (!UploadArenaMesh(vertices, indices, gBackgroundMesh)) {
+			std::fprintf(stderr, "Failed to allocate geometry arena space for the background cube.\n");
+		}
+		gBackgroundCpuMesh = CpuMesh{vertices, indices};
+	}
+
+	// The environment's background cube import and cube map preparation, which Initialize runs on
+	// separate workers and FinishEnvironmentAssets uploads.
+	struct EnvironmentImport {
+		std::filesystem::path cubePath;
+		ImportedMesh cube;
+		bool cubeImported = false;
+		PreparedCubemap cubemap;
+		bool cubemapPrepared = false;
+	};
+
+	void ImportEnvironmentCube(const std::filesystem::path& root, EnvironmentImport& import) {
+		import.cubePath = root.empty() ? std::filesystem::path() : ResolveCubeObjPath(root);
+		import.cubeImported = !import.cubePath.empty() && ImportMesh(import.cubePath.string(), import.cube);
+	}
+
+	void PrepareEnvironmentCubemap(const std::filesystem::path& root, EnvironmentImport& import) {
+		import.cubemapPrepared = !root.empty() && PrepareCubemap(root, import.cubemap);
+	}
+
+	bool FinishEnvironmentAssets(const std::filesystem::path& root, EnvironmentImport& import) {
+		gAssetRoot = root;
+		if (gAssetRoot.empty()) {
+			gEnvironmentLoadStatus = "Environment assets not found (expected cube/ and cubemap/ folders).";
+			return false;
+		}
+		if (import.cubePath.empty()) {
+			gEnvironmentLoadStatus = "Environment asset root found, but cube.obj is missing.";
+			return false;
+		}
+		if (!import.cubeImported) {
+			gEnvironmentLoadStatus = "Failed to load cube background mesh: " + import.cubePath.string();
+			return false;
+		}
+		std::vector<Material> backgroundMaterials;
+		LoadMeshMaterials(import.cube, backgroundMaterials);
+		CreateBackgroundBuffers(import.cube.vertices, import.cube.indices);
+
+		if (!import.cubemapPrepared || !UploadCubemapTexture(import.cubemap)) {
+			gEnvironmentLoadStatus = "Failed to load cubemap texture set from: " + (gAssetRoot / "cubemap").string();
+			return false;
+		}
+
+		gEnvironmentLoadStatus = "Loaded environment assets from: " + gAssetRoot.string();
+		return true;
+	}
+
+	bool InitializeEnvironmentAssets() {
+		const std::filesystem::path root = ResolveEnvironmentAssetRoot();
+		EnvironmentImport import;
+		ImportEnvironmentCube(root, import);
+		PrepareEnvironmentCubemap(root, import);
+		return FinishEnvironmentAssets(root, import);
+	}
+
+	void InitializeProgramBinaryCache() {
+		GLint formatCount = 0;
+		if ((IsGlVersionAtLeast(4, 1) || IsExtensionSupported("GL_ARB_get_program_binary")) &&
+			pglGetProgramBinary != nullptr &&
+			pglProgramBinary != nullptr &&
+			pglProgramParameteri != nullptr) {
+			glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formatCount);
+		}
+		gHasProgramBinary = formatCount > 0;
+		gProgramCacheStats = ProgramCacheStats{};
+		gProgramCacheDir = ResolveCacheDirectory() / "programs";
+		auto glString = [](GLenum name) {
+			const char* value = reinterpret_cast<const char*>(glGetString(name));
+			return std::string(value ? value : "");
+		};
+		gProgramCacheDriverKey = glString(GL_VENDOR) + "\n" + glString(GL_RENDERER) + "\n" + glString(GL_VERSION);
+	}
+
+	void InitializeParallelShaderCompile() {
+		gHasParallelShaderCompile =
+			(IsExtensionSupported("GL_KHR_parallel_shader_compile") || IsExtensionSupported("GL_ARB_parallel_shader_compile")) &&
+			pglMaxShaderCompilerThreads != nullptr;
+		if (gHasParallelShaderCompile) {
+			// 0xFFFFFFFF lets the driver pick its own thread count.
+			pglMaxShaderCompilerThreads(0xFFFFFFFFu);
+		}
+	}
+
+	std::filesystem::path ProgramCachePath(std::uint64_t key, const char* label) {
+		return gProgramCacheDir / (std::string(label) + "-" + HashToHex(key) + ".bin");
+	}
+
+	// Cache entry layout: magic, cache version, key, binary format, binary length, binary.
+	GLuint LoadCachedProgram(const std::filesystem::path& path, std::uint64_t key) {
+		std::vector<unsigned char> bytes;
+		if (!ReadCacheFile(path, bytes)) {
+			return 0;
+		}
+		constexpr size_t kHeaderSize = sizeof(kProgramCacheMagic) + sizeof(std::uint32_t) + sizeof(std::uint64_t) + 2 * sizeof(std::uint32_t);
+		if (bytes.size() <= kHeaderSize || std::memcmp(bytes.data(), kProgramCacheMagic, sizeof(kProgramCacheMagic)) != 0) {
+			return 0;
+		}
+		std::uint32_t version = 0;
+		std::uint64_t storedKey = 0;
+		std::uint32_t format = 0;
+		std::uint32_t length = 0;
+		size_t offset = sizeof(kProgramCacheMagic);
+		std::memcpy(&version, bytes.data() + offset, sizeof(version));
+		offset += sizeof(version);
+		std::memcpy(&storedKey, bytes.data() + offset, sizeof(storedKey));
+		offset += sizeof(storedKey);
+		std::memcpy(&format, bytes.data() + offset, sizeof(format));
+		offset += sizeof(format);
+		std::memcpy(&length, bytes.data() + offset, sizeof(length));
+		offset += sizeof(length);
+		if (version != kProgramCacheVersion || storedKey != key || bytes.size() - offset != length) {
+			return 0;
+		}
+
+		GLuint program = pglCreateProgram();
+		pglProgramBinary(program, static_cast<GLenum>(format), bytes.data() + offset, static_cast<GLsizei>(length));
+		GLint status = 0;
+		pglGetProgramiv(program, GL_LINK_STATUS, &status);
+		if (status != GL_TRUE) {
+			// The driver changed underneath an identical version string; recompile and overwrite.
+			pglDeleteProgram(program);
+			++gProgramCacheStats.rejected;
+			return 0;
+		}
+		return program;
+	}
+
+	void StoreCachedProgram(GLuint program, const std::filesystem::path& path, std::uint64_t key) {
+		GLint length = 0;
+		pglGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+		if (length <= 0) {
+			return;
+		}
+		std::vector<unsigned char> binary(static_cast<size_t>(length));
+		GLenum format = 0;
+		GLsizei written = 0;
+		pglGetProgramBinary(program, length, &written, &format, binary.data());
+		if (written <= 0) {
+			return;
+		}
+
+		const std::uint32_t version = kProgramCacheVersion;
+		const std::uint32_t storedFormat = static_cast<std::uint32_t>(format);
+		const std::uint32_t storedLength = static_cast<std::uint32_t>(written);
+		std::vector<unsigned char> bytes(kProgramCacheMagic, kProgramCacheMagic + sizeof(kProgramCacheMagic));
+		auto append = [&](const void* data, size_t size) {
+			const unsigned char* begin = static_cast<const unsigned char*>(data);
+			bytes.insert(bytes.end(), begin, begin + size);
+		};
+		append(&version, sizeof(version));
+		append(&key, sizeof(key));
+		append(&storedFormat, sizeof(storedFormat));
+		append(&storedLength, sizeof(storedLength));
+		append(binary.data(), static_cast<size_t>(written));
+		if (WriteCacheFile(path, bytes)) {
+			++gProgramCacheStats.stored;
+		}
+	}
+
+	struct ShaderBuildError {
+		// GL_VERTEX_SHADER, GL_FRAGMENT_SHADER, or 0 for a link error.
+		GLenum stage = 0;
+		std::string log;
+	};
+
+	// A program whose compile and link may still be running on driver threads.
+	struct ProgramBuild {
+		GLuint program = 0;
+		GLuint vertexShader = 0;
+		GLuint fragmentShader = 0;
+		std::string label;
+		std::uint64_t cacheKey = 0;
+		std::filesystem::path cachePath;
+		bool fromCache = false;
+	};
+
+	std::string ReadShaderInfoLog(GLuint shader) {
+		GLint logLength = 0;
+		pglGetShaderiv(shader, GL_INFO_LOG_LENGTH, &logLength);
+		std::string log(static_cast<size_t>(std::max(logLength, 0)), '\0');
+		if (logLength > 0) {
+			pglGetShaderInfoLog(shader, logLength, nullptr, log.data());
+		}
+		return log;
+	}
+
+	std::string ReadProgramInfoLog(GLuint program) {
+		GLint logLength = 0;
+		pglGetProgramiv(program, GL_INFO_LOG_LENGTH, &logLength);
+		std::string log(static_cast<size_t>(std::max(logLength, 0)), '\0');
+		if (logLength > 0) {
+			pglGetProgramInfoLog(program, logLength, nullptr, log.data());
+		}
+		return log;
+	}
+
+	// Starts compiling and linking without reading any status back, so with parallel shader compile
+	// the work stays on driver threads until FinishProgramBuild. A binary cache hit completes at once.
+	// Keys cover both sources, the label and the driver strings.
+	ProgramBuild BeginProgramBuild(const std::string& vertexSource, const std::string& fragmentSource, const char* label) {
+		ProgramBuild build;
+		build.label = label;
+		if (gHasProgramBinary) {
+			std::uint64_t key = HashString(label, HashBytes(&kProgramCacheVersion, sizeof(kProgramCacheVersion)));
+			key = HashString(gProgramCacheDriverKey, key);
+			key = HashString(fragmentSource, HashString(vertexSource, key));
+			build.cacheKey = key;
+			build.cachePath = ProgramCachePath(key, label);
+			if (GLuint cached = LoadCachedProgram(build.cachePath, key)) {
+				++gProgramCacheStats.hits;
+				build.program = cached;
+				build.fromCache = true;
+				return build;
+			}
+			++gProgramCacheStats.misses;
+		}
+
+		auto startCompile = [](GLenum type, const std::string& source) {
+			const char* src = source.c_str();
+			GLuint shader = pglCreateShader(type);
+			pglShaderSource(shader, 1, &src, nullptr);
+			pglCompileShader(shader);
+			return shader;
+		};
+		build.vertexShader = startCompile(GL_VERTEX_SHADER, vertexSource);
+		build.fragmentShader = startCompile(GL_FRAGMENT_SHADER, fragmentSource);
+		build.program = pglCreateProgram();
+		pglAttachShader(build.program, build.vertexShader);
+		pglAttachShader(build.program, build.fragmentShader);
+		pglBindAttribLocation(build.program, 0, "aPosition");
+		pglBindAttribLocation(build.program, 1, "aNormal");
+		pglBindAttribLocation(build.program, 2, "aTexCoord");
+		pglBindAttribLocation(build.program, kInstanceModelLocation, "aInstanceModel");
+		pglBindAttribLocation(build.program, kInstanceNormalLocation, "aInstanceNormal");
+		pglBindAttribLocation(build.program, kMaterialSlotLocation, "aMaterialSlot");
+		if (gHasProgramBinary) {
+			pglProgramParameteri(build.program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+		}
+		pglLinkProgram(build.program);
+		return build;
+	}
+
+	bool IsProgramBuildReady(const ProgramBuild& build) {
+		if (build.fromCache || !gHasParallelShaderCompile || build.program == 0) {
+			return true;
+		}
+		GLint done = GL_FALSE;
+		pglGetProgramiv(build.program, GL_COMPLETION_STATUS_KHR, &done);
+		return done == GL_TRUE;
+	}
+
+	void CancelProgramBuild(ProgramBuild& build) {
+		if (build.vertexShader != 0) {
+			pglDeleteShader(build.vertexShader);
+		}
+		if (build.fragmentShader != 0) {
+			pglDeleteShader(build.fragmentShader);
+		}
+		if (build.program != 0) {
+			pglDeleteProgram(build.program);
+		}
+		build = ProgramBuild{};
+	}
+
+	// Blocks until the build is done (immediately if IsProgramBuildReady) and returns the program, or 0
+	// with the logs printed and, when errors is given, collected there.
+	GLuint FinishProgramBuild(ProgramBuild& build, std::vector<ShaderBuildError>* errors = nullptr) {
+		if (build.fromCache) {
+			const GLuint program = build.program;
+			build = ProgramBuild{};
+			return program;
+		}
+
+		bool ok = true;
+		const std::pair<GLuint, GLenum> shaders[] = {
+			{build.vertexShader, GL_VERTEX_SHADER},
+			{build.fragmentShader, GL_FRAGMENT_SHADER}
+		};
+		for (const auto& [shader, stage] : shaders) {
+			GLint status = 0;
+			pglGetShaderiv(shader, GL_COMPILE_STATUS, &status);
+			if (status == GL_TRUE) {
+				continue;
+			}
+			const std::string log = ReadShaderInfoLog(shader);
+			std::fprintf(stderr, "Shader compile failed (%s %s):\n%s\n",
+				build.label.c_str(),
+				stage == GL_VERTEX_SHADER ? "vertex" : "fragment",
+				log.c_str());
+			if (errors != nullptr) {
+				errors->push_back(ShaderBuildError{stage, log});
+			}
+			ok = false;
+		}
+		if (ok) {
+			GLint status = 0;
+			pglGetProgramiv(build.program, GL_LINK_STATUS, &status);
+			if (status != GL_TRUE) {
+				const std::string log = ReadProgramInfoLog(build.program);
+				std::fprintf(stderr, "Program link failed (%s):\n%s\n", build.label.c_str(), log.c_str());
+				if (errors != nullptr) {
+					errors->push_back(ShaderBuildError{0, log});
+				}
+				ok = false;
+			}
+		}
+
+		const GLuint program = build.program;
+		build.program = 0;
+		if (ok && gHasProgramBinary) {
+			StoreCachedProgram(program, build.cachePath, build.cacheKey);
+		}
+		CancelProgramBuild(build);
+		if (!ok) {
+			pglDeleteProgram(program);
+			return 0;
+		}
+		return program;
+	}
+
+	GLuint BuildProgram(const std::string& vertexSource, const std::string& fragmentSource, const char* label) {
+		ProgramBuild build = BeginProgramBuild(vertexSource, fragmentSource, label);
+		return FinishProgramBuild(build);
+	}
+
+	// Inserts the permutation #defines right after the #version line, followed by a #line directive so
+	// compile errors keep pointing at the lines of the file on disk.
+	std::string InjectShaderDefines(const std::string& source, const std::string& defines) {
+		size_t insertAt = 0;
+		int versionLine = 0;
+		if (source.compare(0, 8, "#version") == 0) {
+			const size_t newline = source.find('\n');
+			insertAt = (newline == std::string::npos) ? source.size() : newline + 1;
+			versionLine = 1;
+		}
+		std::string result = source.substr(0, insertAt);
+		if (insertAt == source.size() && insertAt > 0 && source.back() != '\n') {
+			result += '\n';
+		}
+		result += defines;
+		result += "#line " + std::to_string(versionLine + 1) + "\n";
+		result.append(source, insertAt, std::string::npos);
+		return result;
+	}
+
+	std::string ShaderVariantDefines(std::uint32_t key) {
+		std::string defines = "#define SHADE_MODE " + std::to_string(key & kShadeModeMask) + "\n";
+		for (const ShaderFeatureDefine& feature : kShaderFeatureDefines) {
+			defines += std::string("#define ") + feature.name + ((key & feature.bit) != 0 ? " 1\n" : " 0\n");
+		}
+		defines += "#define MATERIAL_TABLE_SIZE " + std::to_string(kMaterialTableSize) + "\n";
+		return defines;
+	}
+
+	std::string DescribeShaderVariant(std::uint32_t key) {
+		static const char* const kModeNames[] = {"blinn", "normals", "plane"};
+		const std::uint32_t mode = key & kShadeModeMask;
+		std::string description = mode < sizeof(kModeNames) / sizeof(kModeNames[0]) ? kModeNames[mode] : "mode" + std::to_string(mode);
+		for (const ShaderFeatureDefine& feature : kShaderFeatureDefines) {
+			if ((key & feature.bit) != 0) {
+				description += std::string(" +") + feature.label;
+			}
+		}
+		return description;
+	}
+
+	ProgramBuild BeginShaderVariant(const std::string& vertexSource, const std::string& fragmentSource, std::uint32_t key) {
+		const std::string defines = ShaderVariantDefines(key);
+		char label[32];
+		std::snprintf(label, sizeof(label), "main-%02x", static_cast<unsigned>(key));
+		return BeginProgramBuild(InjectShaderDefines(vertexSource, defines), InjectShaderDefines(fragmentSource, defines), label);
+	}
+
+	ShaderVariant FinishShaderVariant(ProgramBuild& build, std::vector<ShaderBuildError>* errors = nullptr) {
+		ShaderVariant variant;
+		variant.program = FinishProgramBuild(build, errors);
+		if (variant.program != 0) {
+			pglUseProgram(variant.program);
+			for (size_t i = 0; i < kMainUniformCount; ++i) {
+				variant.locations[i] = pglGetUniformLocation(variant.program, kMainUniforms[i].name);
+				if (kMainUniforms[i].textureUnit >= 0 && variant.locations[i] >= 0) {
+					pglUniform1i(variant.locations[i], kMainUniforms[i].textureUnit);
+				}
+			}
+			pglUseProgram(0);
+		}
+		return variant;
+	}
+
+	ShaderVariant BuildShaderVariant(const std::string& vertexSource, const std::string& fragmentSource, std::uint32_t key) {
+		const auto start = std::chrono::steady_clock::now();
+		ProgramBuild build = BeginShaderVariant(vertexSource, fragmentSource, key);
+		ShaderVariant variant = FinishShaderVariant(build);
+		variant.buildMs = ElapsedMilliseconds(start);
+		return variant;
+	}
+
+	// Binds the variant for key, compiling it on first use, and points the g*Location globals at it.
+	bool UseShaderVariant(std::uint32_t key) {
+		auto it = gShaderVariants.find(key);
+		if (it == gShaderVariants.end()) {
+			it = gShaderVariants.emplace(key, BuildShaderVariant(gMainVertexSource, gMainFragmentSource, key)).first;
+			if (it->second.program == 0) {
+				std::fprintf(stderr, "Shader variant [%s] failed to build; its draws are skipped.\n", DescribeShaderVariant(key).c_str());
+			}
+		}
+		ShaderVariant& variant = it->second;
+		if (variant.program == 0) {
+			return false;
+		}
+		pglUseProgram(variant.program);
+		for (size_t i = 0; i < kMainUniformCount; ++i) {
+			*kMainUniforms[i].location = variant.locations[i];
+		}
+		++variant.binds;
+		return true;
+	}
+
+	void DestroyShaderVariants() {
+		for (const auto& entry : gShaderVariants) {
+			if (entry.second.program != 0) {
+				pglDeleteProgram(entry.second.program);
+			}
+		}
+		gShaderVariants.clear();
+		gProgram = 0;
+		// New shaders get another chance at the material table.
+		gMaterialBatching.shaderReady = true;
+		gDrawRecordsDirty = true;
+	}
+
+	bool ReloadShaders() {
+		std::string vertexSource = ReadFileText(gVertexShaderPath);
+		std::string fragmentSource = ReadFileText(gFragmentShaderPath);
+
+		if (vertexSource.empty()) {
+			std::fprintf(stderr, "Vertex shader missing, using fallback: %s\n", gVertexShaderPath.c_str());
+			vertexSource = kFallbackVertexShader;
+		}
+		if (fragmentSource.empty()) {
+			std::fprintf(stderr, "Fragment shader missing, using fallback: %s\n", gFragmentShaderPath.c_str());
+			fragmentSource = kFallbackFragmentShader;
+		}
+
+		// The remaining variants are rebuilt lazily from the new sources. If this one fails the old
+		// variants keep rendering.
+		ShaderVariant defaultVariant = BuildShaderVariant(vertexSource, fragmentSource, kDefaultShaderVariant);
+		if (defaultVariant.program == 0) {
+			return false;
+		}
+
+		DestroyShaderVariants();
+		gMainVertexSource = std::move(vertexSource);
+		gMainFragmentSource = std::move(fragmentSource);
+		gProgram = defaultVariant.program;
+		gShaderVariants.emplace(kDefaultShaderVariant, defaultVariant);
+		return true;
+	}
+
+	bool ReplaceProgram(GLuint& program, const char* vertexSource, const char* fragmentSource, const char* label) {
+		GLuint newProgram = BuildProgram(vertexSource, fragmentSource, label);
+		if (!newProgram) {
+			return false;
+		}
+
+		if (program != 0) {
+			pglDeleteProgram(program);
+		}
+		program = newProgram;
+		return true;
+	}
+
+	// Depth, skybox and marker programs, which are small enough to live in the binary.
+	bool ReloadBuiltinShaders() {
+		if (!ReplaceProgram(gDepthProgram, kDepthVertexShader, kDepthFragmentShader, "depth") ||
+			!ReplaceProgram(gSkyboxProgram, kSkyboxVertexShader, kSkyboxFragmentShader, "skybox") ||
+			!ReplaceProgram(gUnlitProgram, kUnlitVertexShader, kUnlitFragmentShader, "unlit")) {
+			return false;
+		}
+		gDepthMvpLocation = pglGetUniformLocation(gDepthProgram, "uDepthMvp");
+		gSkyboxMvpLocation = pglGetUniformLocation(gSkyboxProgram, "uSkyboxMvp");
+		gUnlitMvpLocation = pglGetUniformLocation(gUnlitProgram, "uUnlitMvp");
+		gUnlitColorLocation = pglGetUniformLocation(gUnlitProgram, "uUnlitColor");
+
+		pglUseProgram(gSkyboxProgram);
+		const GLint envMapLocation = pglGetUniformLocation(gSkyboxProgram, "uEnvMap");
+		if (envMapLocation >= 0) {
+			pglUniform1i(envMapLocation, 2);
+		}
+		pglUseProgram(0);
+		return true;
+	}
+
+	// Driver logs start with the location in one of three shapes: "0:12(3): ..." (Mesa), "0(12) : ..."
+	// (NVIDIA) or "ERROR: 0:12: ..." (AMD, Intel). Returns the line, or 0 when there is none.
+	int ParseShaderLogLine(const std::string& line) {
+		size_t pos = 0;
+		for (const char* prefix : {"ERROR: ", "WARNING: "}) {
+			const size_t length = std::strlen(prefix);
+			if (line.compare(0, length, prefix) == 0) {
+				pos = length;
+				break;
+			}
+		}
+		const size_t sourceStart = pos;
+		while (pos < line.size() && std::isdigit(static_cast<unsigned char>(line[pos]))) {
+			++pos;
+		}
+		if (pos == sourceStart || pos >= line.size() || (line[pos] != ':' && line[pos] != '(')) {
+			return 0;
+		}
+		++pos;
+		int lineNumber = 0;
+		while (pos < line.size() && std::isdigit(static_cast<unsigned char>(line[pos]))) {
+			lineNumber = lineNumber * 10 + (line[pos] - '0');
+			++pos;
+		}
+		return lineNumber;
+	}
+
+	std::vector<std::string> SplitLines(const std::string& text) {
+		std::vector<std::string> lines;
+		std::istringstream stream(text);
+		std::string line;
+		while (std::getline(stream, line)) {
+			if (!line.empty() && line.back() == '\r') {
+				line.pop_back();
+			}
+			lines.push_back(line);
+		}
+		return lines;
+	}
+
+	// Quotes the offending source line under every log line that carries a location. Injected defines are
+	// followed by a #line directive, so log line numbers already match the files on disk.
+	std::string FormatShaderBuildErrors(
+		const std::vector<ShaderBuildError>& errors,
+		const std::string& vertexSource,
+		const std::string& fragmentSource) {
+		const std::vector<std::string> vertexLines = SplitLines(vertexSource);
+		const std::vector<std::string> fragmentLines = SplitLines(fragmentSource);
+		std::string text;
+		for (const ShaderBuildError& error : errors) {
+			const std::vector<std::string>* sourceLines = nullptr;
+			if (error.stage == GL_VERTEX_SHADER) {
+				text += std::filesystem::path(gVertexShaderPath).filename().string() + ":\n";
+				sourceLines = &vertexLines;
+			} else if (error.stage == GL_FRAGMENT_SHADER) {
+				text += std::filesystem::path(gFragmentShaderPath).filename().string() + ":\n";
+				sourceLines = &fragmentLines;
+			} else {
+				text += "link:\n";
+			}
+			for (const std::string& logLine : SplitLines(error.log)) {
+				if (logLine.empty()) {
+					continue;
+				}
+				text += "  " + logLine + "\n";
+				const int lineNumber = sourceLines != nullptr ? ParseShaderLogLine(logLine) : 0;
+				if (lineNumber > 0 && static_cast<size_t>(lineNumber) <= sourceLines->size()) {
+					text += "    " + std::to_string(lineNumber) + " | " + (*sourceLines)[static_cast<size_t>(lineNumber - 1)] + "\n";
+				}
+			}
+		}
+		return text;
+	}
+
+	// Rebuild of every cached variant from new sources. The cache is swapped only when all of them
+	// compile, so a bad edit never leaves a mix of old and new variants behind.
+	struct ShaderReload {
+		bool active = false;
+		std::string vertexSource;
+		std::string fragmentSource;
+		std::vector<std::pair<std::uint32_t, ProgramBuild>> builds;
+		std::chrono::steady_clock::time_point start;
+	};
+	ShaderReload gShaderReload;
+	// Mapped compile errors of the last failed reload; shown in an overlay until a reload succeeds.
+	std::string gShaderErrorText;
+	std::string gShaderReloadStatus;
+
+	void CancelShaderReload() {
+		for (auto& entry : gShaderReload.builds) {
+			CancelProgramBuild(entry.second);
+		}
+		gShaderReload = ShaderReload{};
+	}
+
+	void StartShaderReload() {
+		CancelShaderReload();
+		std::string vertexSource = ReadFileText(gVertexShaderPath);
+		std::string fragmentSource = ReadFileText(gFragmentShaderPath);
+		if (vertexSource.empty() || fragmentSource.empty()) {
+			// Usually an editor in the middle of a save; its next write triggers another reload.
+			gShaderReloadStatus = "Shader source missing or empty; keeping the current shaders.";
+			return;
+		}
+
+		std::vector<std::uint32_t> keys = {kDefaultShaderVariant};
+		for (const auto& entry : gShaderVariants) {
+			if (entry.first != kDefaultShaderVariant) {
+				keys.push_back(entry.first);
+			}
+		}
+		ShaderReload& reload = gShaderReload;
+		reload.start = std::chrono::steady_clock::now();
+		for (std::uint32_t key : keys) {
+			reload.builds.emplace_back(key, BeginShaderVariant(vertexSource, fragmentSource, key));
+		}
+		reload.vertexSource = std::move(vertexSource);
+		reload.fragmentSource = std::move(fragmentSource);
+		reload.active = true;
+		gShaderReloadStatus = "Compiling " + std::to_string(keys.size()) + " variant(s)...";
+	}
+
+	// Finishes a reload once the driver reports every build complete; never blocks with parallel compile.
+	void UpdateShaderReload() {
+		ShaderReload& reload = gShaderReload;
+		if (!reload.active) {
+			return;
+		}
+		for (const auto& entry : reload.builds) {
+			if (!IsProgramBuildReady(entry.second)) {
+				return;
+			}
+		}
+
+		std::vector<std::pair<std::uint32_t, ShaderVariant>> built;
+		std::vector<ShaderBuildError> firstErrors;
+		std::uint32_t failedKey = 0;
+		size_t failures = 0;
+		for (auto& entry : reload.builds) {
+			std::vector<ShaderBuildError> errors;
+			ShaderVariant variant = FinishShaderVariant(entry.second, &errors);
+			if (variant.program != 0) {
+				built.emplace_back(entry.first, variant);
+			} else if (failures++ == 0) {
+				firstErrors = std::move(errors);
+				failedKey = entry.first;
+			}
+		}
+		const double elapsedMs = ElapsedMilliseconds(reload.start);
+
+		char summary[160];
+		if (failures > 0) {
+			for (const auto& entry : built) {
+				pglDeleteProgram(entry.second.program);
+			}
+			std::snprintf(summary, sizeof(summary), "Shader reload failed: %zu of %zu variant(s), first [%s]. Still using the previous shaders.",
+				failures,
+				reload.builds.size(),
+				DescribeShaderVariant(failedKey).c_str());
+			gShaderErrorText = std::string(summary) + "\n\n" + FormatShaderBuildErrors(firstErrors, reload.vertexSource, reload.fragmentSource);
+			std::fprintf(stderr, "%s\n", summary);
+		} else {
+			DestroyShaderVariants();
+			for (auto& entry : built) {
+				entry.second.buildMs = elapsedMs;
+				gShaderVariants.emplace(entry.first, entry.second);
+			}
+			gProgram = gShaderVariants[kDefaultShaderVariant].program;
+			gMainVertexSource = std::move(reload.vertexSource);
+			gMainFragmentSource = std::move(reload.fragmentSource);
+			gShaderErrorText.clear();
+			std::snprintf(summary, sizeof(summary), "Shaders reloaded: %zu variant(s) in %.1f ms%s.",
+				built.size(),
+				elapsedMs,
+				gHasParallelShaderCompile ? " (parallel compile)" : "");
+			std::printf("%s\n", summary);
+		}
+		gShaderReloadStatus = summary;
+		gShaderReload = ShaderReload{};
+	}
+
+	// Watches shader.vert/shader.frag. Linux uses inotify on the shader directory, since editors often
+	// save by renaming a temp file over the original; elsewhere modification times are polled.
+	struct ShaderFileWatcher {
+		int inotifyFd = -1;
+		std::string vertexName;
+		std::string fragmentName;
+		std::filesystem::file_time_type vertexWriteTime{};
+		std::filesystem::file_time_type fragmentWriteTime{};
+		std::chrono::steady_clock::time_point nextPoll{};
+	};
+	ShaderFileWatcher gShaderWatcher;
+
+	std::filesystem::file_time_type ShaderWriteTime(const std::string& path) {
+		std::error_code error;
+		const std::filesystem::file_time_type time = std::filesystem::last_write_time(path, error);
+		return error ? std::filesystem::file_time_type{} : time;
+	}
+
+	void StartShaderWatcher() {
+		ShaderFileWatcher& watcher = gShaderWatcher;
+		watcher.vertexName = std::filesystem::path(gVertexShaderPath).filename().string();
+		watcher.fragmentName = std::filesystem::path(gFragmentShaderPath).filename().string();
+		watcher.vertexWriteTime = ShaderWriteTime(gVertexShaderPath);
+		watcher.fragmentWriteTime = ShaderWriteTime(gFragmentShaderPath);
+#ifdef __linux__
+		if (watcher.inotifyFd < 0) {
+			watcher.inotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+			std::string directory = std::filesystem::path(gFragmentShaderPath).parent_path().string();
+			if (directory.empty()) {
+				directory = ".";
+			}
+			if (watcher.inotifyFd >= 0 && inotify_add_watch(watcher.inotifyFd, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO) < 0) {
+				close(watcher.inotifyFd);
+				watcher.inotifyFd = -1;
+			}
+		}
+#endif
+	}
+
+	void StopShaderWatcher() {
+#ifdef __linux__
+		if (gShaderWatcher.inotifyFd >= 0) {
+			close(gShaderWatcher.inotifyFd);
+		}
+#endif
+		gShaderWatcher = ShaderFileWatcher{};
+	}
+
+	// True when either shader file changed since the last call.
+	bool PollShaderFiles() {
+		ShaderFileWatcher& watcher = gShaderWatcher;
+#ifdef __linux__
+		if (watcher.inotifyFd >= 0) {
+			bool changed = false;
+			alignas(inotify_event) char buffer[4096];
+			for (;;) {
+				const ssize_t length = read(watcher.inotifyFd, buffer, sizeof(buffer));
+				if (length <= 0) {
+					break;
+				}
+				for (ssize_t offset = 0; offset < length;) {
+					const inotify_event* event = reinterpret_cast<const inotify_event*>(buffer + offset);
+					if (event->len > 0 && (watcher.vertexName == event->name || watcher.fragmentName == event->name)) {
+						changed = true;
+					}
+					offset += static_cast<ssize_t>(sizeof(inotify_event) + event->len);
+				}
+			}
+			return changed;
+		}
+#endif
+		const auto now = std::chrono::steady_clock::now();
+		if (now < watcher.nextPoll) {
+			return false;
+		}
+		watcher.nextPoll = now + kShaderPollInterval;
+		const std::filesystem::file_time_type vertexTime = ShaderWriteTime(gVertexShaderPath);
+		const std::filesystem::file_time_type fragmentTime = ShaderWriteTime(gFragmentShaderPath);
+		const bool changed = vertexTime != watcher.vertexWriteTime || fragmentTime != watcher.fragmentWriteTime;
+		watcher.vertexWriteTime = vertexTime;
+		watcher.fragmentWriteTime = fragmentTime;
+		return changed;
+	}
+
+	// Runs once per loop iteration. Returns true while a reload is in flight or has just been applied,
+	// i.e. when frames are needed to show its result.
+	bool UpdateShaderHotReload() {
+		if (gProgram == 0) {
+			return false;
+		}
+		const bool wasActive = gShaderReload.active;
+		if (PollShaderFiles()) {
+			StartShaderReload();
+		}
+		UpdateShaderReload();
+		return wasActive || gShaderReload.active;
+	}
+
+	void CreatePlaneBuffers() {
+		gPlaneCpuMesh.vertices = {
+			Vertex{glm::vec3(-1.0f, 0.0f, -1.0f), glm::vec3(0.0f, 1.0f, 0.0f), glm::vec2(0.0f, 0.0f)},
+			Vertex{glm::vec3( 1.0f, 0.0f, -1.0f), glm::vec3(0.0f, 1.0f, 0.0f), glm::vec2(1.0f, 0.0f)},
+			Vertex{glm::vec3( 1.0f, 0.0f,  1.0f), glm::vec3(0.0f, 1.0f, 0.0f), glm::vec2(1.0f, 1.0f)},
+			Vertex{glm::vec3(-1.0f, 0.0f,  1.0f), glm::vec3(0.0f, 1.0f, 0.0f), glm::vec2(0.0f, 1.0f)}
+		};
+		gPlaneCpuMesh.indices = {0, 1, 2, 0, 2, 3};
+		ReleaseArenaMesh(gPlaneMesh);
+		if (!UploadArenaMesh(gPlaneCpuMesh.vertices, gPlaneCpuMesh.indices, gPlaneMesh)) {
+			std::fprintf(stderr, "Failed to allocate geometry arena space for the plane.\n");
+		}
+	}
+
+	void BuildLightCube(std::vector<Vertex>& vertices, std::vector<unsigned int>& indices) {
+		vertices = {
+			{{-0.5f, -0.5f, -0.5f}, {0.0f, 1.0f, 0.0f}, {0.0f, 0.0f}},
+			{{ 0.5f, -0.5f, -0.5f}, {0.0f, 1.0f, 0.0f}, {1.0f, 0.0f}},
+			{{ 0.5f,  0.5f, -0.5f}, {0.0f, 1.0f, 0.0f}, {1.0f, 1.0f}},
+			{{-0.5f,  0.5f, -0.5f}, {0.0f, 1.0f, 0.0f}, {0.0f, 1.0f}},
+			{{-0.5f, -0.5f,  0.5f}, {0.0f, 1.0f, 0.0f}, {0.0f, 0.0f}},
+			{{ 0.5f, -0.5f,  0.5f}, {0.0f, 1.0f, 0.0f}, {1.0f, 0.0f}},
+			{{ 0.5f,  0.5f,  0.5f}, {0.0f, 1.0f, 0.0f}, {1.0f, 1.0f}},
+			{{-0.5f,  0.5f,  0.5f}, {0.0f, 1.0f, 0.0f}, {0.0f, 1.0f}}
+		};
+		indices = {
+			0, 1, 2, 0, 2, 3,
+			4, 6, 5, 4, 7, 6,
+			4, 5, 1, 4, 1, 0,
+			3, 2, 6, 3, 6, 7,
+			1, 5, 6, 1, 6, 2,
+			4, 0, 3, 4, 3, 7
+		};
+	}
+
+	void BuildLightSphere(std::vector<Vertex>& vertices, std::vector<unsigned int>& indices) {
+		const int latSegments = 14;
+		const int lonSegments = 20;
+		vertices.clear();
+		indices.clear();
+		vertices.reserve(static_cast<size_t>((latSegments + 1) * (lonSegments + 1)));
+		for (int lat = 0; lat <= latSegments; ++lat) {
+			const float v = static_cast<float>(lat) / static_cast<float>(latSegments);
+			const float theta = v * 3.14159265358979323846f;
+			const float y = std::cos(theta);
+			const float r = std::sin(theta);
+			for (int lon = 0; lon <= lonSegments; ++lon) {
+				const float u = static_cast<float>(lon) / static_cast<float>(lonSegments);
+				const float phi = u * (2.0f * 3.14159265358979323846f);
+				const float x = r * std::cos(phi);
+				const float z = r * std::sin(phi);
+				const glm::vec3 normal = glm::normalize(glm::vec3(x, y, z));
+				vertices.push_back(Vertex{normal * 0.5f, normal, glm::vec2(u, v)});
+			}
+		}
+
+		for (int lat = 0; lat < latSegments; ++lat) {
+			for (int lon = 0; lon < lonSegments; ++lon) {
+				const int row0 = lat * (lonSegments + 1);
+				const int row1 = (lat + 1) * (lonSegments + 1);
+				const unsigned int a = static_cast<unsigned int>(row0 + lon);
+				const unsigned int b = static_cast<unsigned int>(row1 + lon);
+				const unsigned int c = static_cast<unsigned int>(row1 + lon + 1);
+				const unsigned int d = static_cast<unsigned int>(row0 + lon + 1);
+				indices.push_back(a);
+				indices.push_back(b);
+				indices.push_back(c);
+				indices.push_back(a);
+				indices.push_back(c);
+				indices.push_back(d);
+			}
+		}
+	}
+
+	struct LightObjectImport {
+		std::filesystem::path path;
+		ImportedMesh mesh;
+		bool imported = false;
+	};
+
+	// CPU half of loading the light object; assetRoot is searched first, then the usual candidates.
+	LightObjectImport ImportLightObject(const std::filesystem::path& assetRoot) {
+		LightObjectImport import;
+		if (!assetRoot.empty()) {
+			import.path = ResolveLightObjPath(assetRoot);
+		}
+		if (import.path.empty()) {
+			for (const std::filesystem::path& root : BuildAssetRootCandidates()) {
+				import.path = ResolveLightObjPath(root);
+				if (!import.path.empty()) {
+					break;
+				}
+			}
+		}
+		import.imported = !import.path.empty() && ImportMesh(import.path.string(), import.mesh);
+		return import;
+	}
+
+	bool LoadLightObjectMesh(LightObjectImport& import) {
+		ReleaseArenaMesh(gLightObjectMesh);
+		gHasLightObjectMesh = false;
+		gLightObjectCpuMesh = CpuMesh{};
+
+		if (import.path.empty()) {
+			gLightObjectStatus = "Light object not found (expected light/light.obj).";
+			return false;
+		}
+		if (!import.imported) {
+			gLightObjectStatus = "Failed to load light object: " + import.path.string();
+			return false;
+		}
+		std::vector<Material> materials;
+		LoadMeshMaterials(import.mesh, materials);
+
+		if (!UploadArenaMesh(import.mesh.vertices, import.mesh.indices, gLightObjectMesh) || gLightObjectMesh.IndexCount() <= 0) {
+			gLightObjectStatus = "Light object has no drawable triangles: " + import.path.string();
+			return false;
+		}
+		gLightObjectCpuMesh = CpuMesh{std::move(import.mesh.vertices), std::move(import.mesh.indices)};
+
+		gHasLightObjectMesh = true;
+		gLightObjectStatus = "Loaded light object: " + import.path.string();
+		return true;
+	}
+
+	void DestroyLightBuffers() {
+		ReleaseArenaMesh(gLightPointMesh);
+		ReleaseArenaMesh(gLightCubeMesh);
+		ReleaseArenaMesh(gLightSphereMesh);
+		ReleaseArenaMesh(gLightObjectMesh);
+		gHasLightObjectMesh = false;
+		gLightObjectCpuMesh = CpuMesh{};
+	}
+
+	// lightObject comes from ImportLightObject, which Initialize runs on a worker.
+	void CreateLightBuffers(LightObjectImport lightObject) {
+		DestroyLightBuffers();
+
+		const Vertex lightVertex{
+			glm::vec3(0.0f, 0.0f, 0.0f),
+			glm::vec3(0.0f, 1.0f, 0.0f),
+			glm::vec2(0.0f, 0.0f)
+		};
+		UploadArenaMesh(std::vector<Vertex>{lightVertex}, std::vector<unsigned int>{}, gLightPointMesh);
+
+		std::vector<Vertex> primitiveVertices;
+		std::vector<unsigned int> primitiveIndices;
+
+		BuildLightCube(primitiveVertices, primitiveIndices);
+		UploadArenaMesh(primitiveVertices, primitiveIndices, gLightCubeMesh);
+		gLightCubeCpuMesh = CpuMesh{primitiveVertices, primitiveIndices};
+
+		BuildLightSphere(primitiveVertices, primitiveIndices);
+		UploadArenaMesh(primitiveVertices, primitiveIndices, gLightSphereMesh);
+		gLightSphereCpuMesh = CpuMesh{primitiveVertices, primitiveIndices};
+
+		if (!LoadLightObjectMesh(lightObject)) {
+			std::fprintf(stderr, "%s\n", gLightObjectStatus.c_str());
+		}
+	}
+
+	glm::mat4 BuildObjectModelMatrix(const OrbitCamera& camera) {
+		glm::mat4 model(1.0f);
 		model = glm::translate(model, -gCenter);
 		if (!gUsePerspective) {
 			const float scale = 1.0f / std::max(camera.distance, kMinCameraDistance);
@@ -2075,43 +5994,18 @@ void main() {
 		return glm::vec3(model * glm::vec4(lightModel, 1.0f));
 	}
 
-	void BindModelBuffers() {
-		if (gUseVao && gVao != 0) {
-			pglBindVertexArray(gVao);
-			return;
-		}
-		pglBindBuffer(GL_ARRAY_BUFFER, gVbo);
-		pglBindBuffer(GL_ELEMENT_ARRAY_BUFFER, gEbo);
-		pglEnableVertexAttribArray(0);
-		pglVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), reinterpret_cast<void*>(offsetof(Vertex, position)));
-		pglEnableVertexAttribArray(1);
-		pglVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), reinterpret_cast<void*>(offsetof(Vertex, normal)));
-		pglEnableVertexAttribArray(2);
-		pglVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), reinterpret_cast<void*>(offsetof(Vertex, texcoord)));
-	}
-
-	void BindPlaneBuffers() {
-		if (gUseVao && gPlaneVao != 0) {
-			pglBindVertexArray(gPlaneVao);
+	void BindGeometryArena() {
+		if (gUseVao && gGeometryArena.vao != 0) {
+			pglBindVertexArray(gGeometryArena.vao);
 			return;
 		}
-		pglBindBuffer(GL_ARRAY_BUFFER, gPlaneVbo);
-		pglBindBuffer(GL_ELEMENT_ARRAY_BUFFER, gPlaneEbo);
-		pglEnableVertexAttribArray(0);
-		pglVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), reinterpret_cast<void*>(offsetof(Vertex, position)));
-		pglEnableVertexAttribArray(1);
-		pglVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), reinterpret_cast<void*>(offsetof(Vertex, normal)));
-		pglEnableVertexAttribArray(2);
-		pglVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), reinterpret_cast<void*>(offsetof(Vertex, texcoord)));
-	}
-
-	void BindBackgroundBuffers() {
-		if (gUseVao && gBackgroundVao != 0) {
-			pglBindVertexArray(gBackgroundVao);
-			return;
+		if (gGeometryArena.materialVbo != 0) {
+			pglBindBuffer(GL_ARRAY_BUFFER, gGeometryArena.materialVbo);
+			pglEnableVertexAttribArray(kMaterialSlotLocation);
+			pglVertexAttribPointer(kMaterialSlotLocation, 1, GL_FLOAT, GL_FALSE, sizeof(float), nullptr);
 		}
-		pglBindBuffer(GL_ARRAY_BUFFER, gBackgroundVbo);
-		pglBindBuffer(GL_ELEMENT_ARRAY_BUFFER, gBackgroundEbo);
+		pglBindBuffer(GL_ARRAY_BUFFER, gGeometryArena.vbo);
+		pglBindBuffer(GL_ELEMENT_ARRAY_BUFFER, gGeometryArena.ebo);
 		pglEnableVertexAttribArray(0);
 		pglVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), reinterpret_cast<void*>(offsetof(Vertex, position)));
 		pglEnableVertexAttribArray(1);
@@ -2162,17 +6056,361 @@ void main() {
 		return orientation;
 	}
 
-	void DrawModelGeometry() {
-		if (gSubmeshes.empty()) {
-			glDrawElements(GL_TRIANGLES, gIndexCount, GL_UNSIGNED_INT, nullptr);
+	glm::mat4 BuildPivotTransform(const glm::vec3& pivot, const glm::vec3& translation, const glm::vec3& rotationDeg, const glm::vec3& scale) {
+		glm::mat4 matrix = glm::translate(glm::mat4(1.0f), pivot + translation);
+		matrix = glm::rotate(matrix, glm::radians(rotationDeg.y), glm::vec3(0.0f, 1.0f, 0.0f));
+		matrix = glm::rotate(matrix, glm::radians(rotationDeg.x), glm::vec3(1.0f, 0.0f, 0.0f));
+		matrix = glm::rotate(matrix, glm::radians(rotationDeg.z), glm::vec3(0.0f, 0.0f, 1.0f));
+		matrix = glm::scale(matrix, scale);
+		return glm::translate(matrix, -pivot);
+	}
+
+	glm::mat4 BuildSceneModelMatrix(const SceneModel& model) {
+		return BuildPivotTransform(model.bounds.Center(), model.translation, model.rotationDeg, model.scale);
+	}
+
+	glm::mat4 BuildInstanceMatrix(const SceneModel& model, const SceneInstance& instance) {
+		const glm::mat4 instanceMatrix = BuildPivotTransform(model.bounds.Center(), instance.translation, instance.rotationDeg, instance.scale);
+		return BuildSceneModelMatrix(model) * instanceMatrix * glm::scale(glm::mat4(1.0f), gObjectScale);
+	}
+
+	Bounds TransformBounds(const Bounds& bounds, const glm::mat4& matrix) {
+		Bounds result;
+		if (!bounds.valid) {
+			return result;
+		}
+		for (int corner = 0; corner < 8; ++corner) {
+			const glm::vec3 point(
+				(corner & 1) ? bounds.max.x : bounds.min.x,
+				(corner & 2) ? bounds.max.y : bounds.min.y,
+				(corner & 4) ? bounds.max.z : bounds.min.z);
+			result.Expand(glm::vec3(matrix * glm::vec4(point, 1.0f)));
+		}
+		return result;
+	}
+
+	FrustumPlanes ExtractFrustumPlanes(const glm::mat4& clipFromLocal) {
+		auto row = [&](int index) {
+			return glm::vec4(clipFromLocal[0][index], clipFromLocal[1][index], clipFromLocal[2][index], clipFromLocal[3][index]);
+		};
+		const glm::vec4 r0 = row(0);
+		const glm::vec4 r1 = row(1);
+		const glm::vec4 r2 = row(2);
+		const glm::vec4 r3 = row(3);
+		FrustumPlanes frustum;
+		frustum.planes = {r3 + r0, r3 - r0, r3 + r1, r3 - r1, r3 + r2, r3 - r2};
+		return frustum;
+	}
+
+	bool IsBoundsInFrustum(const FrustumPlanes& frustum, const Bounds& bounds) {
+		if (!bounds.valid) {
+			return false;
+		}
+		for (const glm::vec4& plane : frustum.planes) {
+			const glm::vec3 positiveCorner(
+				plane.x >= 0.0f ? bounds.max.x : bounds.min.x,
+				plane.y >= 0.0f ? bounds.max.y : bounds.min.y,
+				plane.z >= 0.0f ? bounds.max.z : bounds.min.z);
+			if (glm::dot(glm::vec3(plane), positiveCorner) + plane.w < 0.0f) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	int LocalMaterialIndex(const SceneModel& model, const Submesh& submesh) {
+		return (submesh.materialIndex >= 0 && submesh.materialIndex < model.materialCount) ? submesh.materialIndex : 0;
+	}
+
+	// Widens a merged record's array to cover another submesh's; -1 (no map) fits any array.
+	bool CombineTextureArray(int& merged, int array) {
+		if (array < 0 || merged == array) {
+			return true;
+		}
+		if (merged < 0) {
+			merged = array;
+			return true;
+		}
+		return false;
+	}
+
+	// Replaces the records from first on (one model's, in submesh order) with table records: every run
+	// of index-contiguous submeshes whose maps all sit in the same arrays becomes a single record.
+	void MergeDrawRecords(size_t first) {
+		const std::vector<DrawRecord> submeshRecords(gDrawRecords.begin() + static_cast<std::ptrdiff_t>(first), gDrawRecords.end());
+		gDrawRecords.resize(first);
+		for (size_t begin = 0; begin < submeshRecords.size();) {
+			DrawRecord merged = submeshRecords[begin];
+			if (!FindMaterialArrays(gMaterials[static_cast<size_t>(merged.materialIndex)], merged.diffuseArray, merged.specularArray)) {
+				gDrawRecords.push_back(merged);
+				++begin;
+				continue;
+			}
+			merged.parts.offset = gDrawRecordParts.size();
+			gDrawRecordParts.push_back(submeshRecords[begin]);
+			size_t end = begin + 1;
+			for (; end < submeshRecords.size(); ++end) {
+				const DrawRecord& part = submeshRecords[end];
+				int diffuseArray = -1;
+				int specularArray = -1;
+				int combinedDiffuse = merged.diffuseArray;
+				int combinedSpecular = merged.specularArray;
+				if (part.indexOffset != merged.indexOffset + merged.indexCount ||
+					!FindMaterialArrays(gMaterials[static_cast<size_t>(part.materialIndex)], diffuseArray, specularArray) ||
+					!CombineTextureArray(combinedDiffuse, diffuseArray) ||
+					!CombineTextureArray(combinedSpecular, specularArray)) {
+					break;
+				}
+				merged.diffuseArray = combinedDiffuse;
+				merged.specularArray = combinedSpecular;
+				merged.indexCount += part.indexCount;
+				gDrawRecordParts.push_back(part);
+			}
+			merged.parts.count = end - begin;
+			gDrawRecords.push_back(merged);
+			++gMaterialBatching.mergedRecords;
+			gMaterialBatching.mergedSubmeshes += merged.parts.count;
+			begin = end;
+		}
+	}
+
+	// Flattens every model's submeshes into gDrawRecords, sorted by shared material index so passes
+	// walk one array and only rebind material state when it actually changes. With material batching
+	// the submeshes whose maps are packed are merged into table records, which sort last, by arrays.
+	void RebuildDrawRecords() {
+		gDrawRecords.clear();
+		gDrawRecordParts.clear();
+		gMaterialBatching.mergedRecords = 0;
+		gMaterialBatching.mergedSubmeshes = 0;
+		for (size_t m = 0; m < gSceneModels.size(); ++m) {
+			const SceneModel& model = gSceneModels[m];
+			const int modelIndex = static_cast<int>(m);
+			const int indexBase = static_cast<int>(model.indexRange.offset);
+			if (model.submeshes.empty()) {
+				gDrawRecords.push_back(DrawRecord{
+					.modelIndex = modelIndex,
+					.materialIndex = model.materialBase,
+					.indexOffset = indexBase,
+					.indexCount = static_cast<int>(model.indexCount)});
+				continue;
+			}
+			const size_t firstRecord = gDrawRecords.size();
+			for (const Submesh& submesh : model.submeshes) {
+				gDrawRecords.push_back(DrawRecord{
+					.modelIndex = modelIndex,
+					.materialIndex = model.materialBase + LocalMaterialIndex(model, submesh),
+					.indexOffset = indexBase + submesh.indexOffset,
+					.indexCount = submesh.indexCount});
+			}
+			if (IsMaterialBatchingActive() && model.materialSlots) {
+				MergeDrawRecords(firstRecord);
+			}
+		}
+		std::stable_sort(gDrawRecords.begin(), gDrawRecords.end(), [](const DrawRecord& a, const DrawRecord& b) {
+			if (a.UsesTable() != b.UsesTable()) {
+				return !a.UsesTable();
+			}
+			if (a.UsesTable()) {
+				return std::tie(a.diffuseArray, a.specularArray, a.modelIndex) < std::tie(b.diffuseArray, b.specularArray, b.modelIndex);
+			}
+			return a.materialIndex < b.materialIndex;
+			});
+		gDrawRecordsDirty = false;
+	}
+
+	// Rebuilds the per-instance attributes once per frame. Instances are laid out model by model
+	// (gInstanceModelSpans), and within a model grouped by material override so each group is a
+	// contiguous range that every pass can cull and draw from.
+	void BuildInstanceAttributes() {
+		gInstanceAttributes.clear();
+		gInstanceBounds.clear();
+		gInstanceMaterialOverrides.clear();
+		gInstanceModelSpans.assign(gSceneModels.size(), ArenaRange{});
+		std::vector<int> order;
+		for (size_t m = 0; m < gSceneModels.size(); ++m) {
+			const SceneModel& model = gSceneModels[m];
+			gInstanceModelSpans[m].offset = gInstanceAttributes.size();
+			if (!model.visible) {
+				continue;
+			}
+			order.clear();
+			for (size_t i = 0; i < model.instances.size(); ++i) {
+				if (model.instances[i].visible) {
+					order.push_back(static_cast<int>(i));
+				}
+			}
+			std::stable_sort(order.begin(), order.end(), [&](int a, int b) {
+				return model.instances[a].materialOverride < model.instances[b].materialOverride;
+				});
+			for (const int index : order) {
+				const SceneInstance& instance = model.instances[static_cast<size_t>(index)];
+				InstanceAttributes attributes;
+				attributes.model = BuildInstanceMatrix(model, instance);
+				attributes.normal = glm::transpose(glm::inverse(glm::mat3(attributes.model)));
+				gInstanceAttributes.push_back(attributes);
+				gInstanceBounds.push_back(TransformBounds(model.bounds, attributes.model));
+				const bool hasOverride = instance.materialOverride >= 0 && instance.materialOverride < model.materialCount;
+				gInstanceMaterialOverrides.push_back(hasOverride ? model.materialBase + instance.materialOverride : -1);
+			}
+			gInstanceModelSpans[m].count = gInstanceAttributes.size() - gInstanceModelSpans[m].offset;
+		}
+	}
+
+	// Writes this frame's instance attributes into the current slot's buffer. With fences the slot's last
+	// reader has already finished, so a plain sub-data update cannot stall; without them the buffer is
+	// respecified every frame and the driver renames it.
+	void UploadInstanceBuffer() {
+		if (!gHasInstancing || gInstanceAttributes.empty()) {
+			return;
+		}
+		const size_t slot = gHasFenceSync ? gFrameScheduler.CurrentSlot() : 0;
+		GLuint& buffer = gInstanceVboRing[slot];
+		if (buffer == 0) {
+			pglGenBuffers(1, &buffer);
+		}
+		const size_t bytes = gInstanceAttributes.size() * sizeof(InstanceAttributes);
+		pglBindBuffer(GL_ARRAY_BUFFER, buffer);
+		if (!gHasFenceSync || bytes > gInstanceVboCapacity[slot]) {
+			pglBufferData(GL_ARRAY_BUFFER, static_cast<std::ptrdiff_t>(bytes), gInstanceAttributes.data(), GL_DYNAMIC_DRAW);
+			gInstanceVboCapacity[slot] = bytes;
+		} else {
+			pglBufferSubData(GL_ARRAY_BUFFER, 0, static_cast<std::ptrdiff_t>(bytes), gInstanceAttributes.data());
+		}
+		pglBindBuffer(GL_ARRAY_BUFFER, 0);
+		gInstanceVbo = buffer;
+	}
+
+	void PrepareSceneDrawData() {
+		if (gDrawRecordsDirty) {
+			RebuildDrawRecords();
+		}
+		BuildInstanceAttributes();
+	}
+
+	void DestroyInstanceBuffer() {
+		for (size_t slot = 0; slot < gInstanceVboRing.size(); ++slot) {
+			if (pglDeleteBuffers && gInstanceVboRing[slot] != 0) {
+				pglDeleteBuffers(1, &gInstanceVboRing[slot]);
+			}
+			gInstanceVboRing[slot] = 0;
+			gInstanceVboCapacity[slot] = 0;
+		}
+		gInstanceVbo = 0;
+	}
+
+	PassInstanceRuns BuildVisibleInstanceRuns(const glm::mat4& clipFromScene) {
+		const FrustumPlanes frustum = ExtractFrustumPlanes(clipFromScene);
+		// Large instance counts are tested on the job system first; the runs are then merged in order here.
+		std::vector<unsigned char> visible;
+		if (gInstanceBounds.size() >= kParallelCullMinInstances) {
+			visible.resize(gInstanceBounds.size());
+			Jobs().ParallelFor(gInstanceBounds.size(), kCullGrain, [&](size_t begin, size_t end) {
+				for (size_t i = begin; i < end; ++i) {
+					visible[i] = IsBoundsInFrustum(frustum, gInstanceBounds[i]) ? 1 : 0;
+				}
+			});
+		}
+		PassInstanceRuns pass;
+		pass.modelRunSpans.assign(gInstanceModelSpans.size(), ArenaRange{});
+		for (size_t m = 0; m < gInstanceModelSpans.size(); ++m) {
+			const ArenaRange& span = gInstanceModelSpans[m];
+			const size_t firstRun = pass.runs.size();
+			for (size_t i = span.offset; i < span.offset + span.count; ++i) {
+				if (visible.empty() ? !IsBoundsInFrustum(frustum, gInstanceBounds[i]) : visible[i] == 0) {
+					continue;
+				}
+				++pass.visibleCount;
+				const int index = static_cast<int>(i);
+				const int materialOverride = gInstanceMaterialOverrides[i];
+				if (pass.runs.size() > firstRun &&
+					pass.runs.back().first + pass.runs.back().count == index &&
+					pass.runs.back().materialOverride == materialOverride) {
+					++pass.runs.back().count;
+					continue;
+				}
+				pass.runs.push_back(InstanceRun{index, 1, materialOverride});
+			}
+			pass.modelRunSpans[m] = ArenaRange{firstRun, pass.runs.size() - firstRun};
+		}
+		return pass;
+	}
+
+	void SetInstanceAttributeConstants(const InstanceAttributes& attributes) {
+		for (GLuint column = 0; column < 4; ++column) {
+			pglVertexAttrib4fv(kInstanceModelLocation + column, glm::value_ptr(attributes.model[static_cast<int>(column)]));
+		}
+		for (GLuint column = 0; column < 3; ++column) {
+			pglVertexAttrib3fv(kInstanceNormalLocation + column, glm::value_ptr(attributes.normal[static_cast<int>(column)]));
+		}
+	}
+
+	// Non-instanced draws (plane, skybox, light marker) read the instance attributes as constants, so
+	// they are kept at identity whenever the instance arrays are not bound.
+	void ResetInstanceAttributes() {
+		SetInstanceAttributeConstants(InstanceAttributes{});
+	}
+
+	void BindInstanceAttributeArrays(int firstInstance) {
+		const GLsizei stride = static_cast<GLsizei>(sizeof(InstanceAttributes));
+		const size_t base = static_cast<size_t>(firstInstance) * sizeof(InstanceAttributes);
+		pglBindBuffer(GL_ARRAY_BUFFER, gInstanceVbo);
+		for (GLuint column = 0; column < 4; ++column) {
+			const size_t offset = base + offsetof(InstanceAttributes, model) + column * sizeof(glm::vec4);
+			pglEnableVertexAttribArray(kInstanceModelLocation + column);
+			pglVertexAttribPointer(kInstanceModelLocation + column, 4, GL_FLOAT, GL_FALSE, stride, reinterpret_cast<void*>(offset));
+			pglVertexAttribDivisor(kInstanceModelLocation + column, 1);
+		}
+		for (GLuint column = 0; column < 3; ++column) {
+			const size_t offset = base + offsetof(InstanceAttributes, normal) + column * sizeof(glm::vec3);
+			pglEnableVertexAttribArray(kInstanceNormalLocation + column);
+			pglVertexAttribPointer(kInstanceNormalLocation + column, 3, GL_FLOAT, GL_FALSE, stride, reinterpret_cast<void*>(offset));
+			pglVertexAttribDivisor(kInstanceNormalLocation + column, 1);
+		}
+	}
+
+	void FinishInstanceDraws() {
+		if (gHasInstancing) {
+			for (GLuint location = kInstanceModelLocation; location < kInstanceNormalLocation + 3; ++location) {
+				pglVertexAttribDivisor(location, 0);
+				pglDisableVertexAttribArray(location);
+			}
+		}
+		ResetInstanceAttributes();
+	}
+
+	// Draws one index range for every instance in the run: a single instanced draw when the driver
+	// supports it, otherwise a loop that feeds each instance through constant vertex attributes.
+	void DrawInstanceRun(int indexCount, int indexOffset, const InstanceRun& run) {
+		const void* offset = reinterpret_cast<const void*>(static_cast<size_t>(indexOffset) * sizeof(unsigned int));
+		if (gHasInstancing && gInstanceVbo != 0) {
+			BindInstanceAttributeArrays(run.first);
+			pglDrawElementsInstanced(GL_TRIANGLES, indexCount, GL_UNSIGNED_INT, offset, run.count);
 			return;
 		}
-		for (const Submesh& submesh : gSubmeshes) {
-			const void* offset = reinterpret_cast<const void*>(static_cast<size_t>(submesh.indexOffset) * sizeof(unsigned int));
-			glDrawElements(GL_TRIANGLES, submesh.indexCount, GL_UNSIGNED_INT, offset);
+		for (int i = run.first; i < run.first + run.count; ++i) {
+			SetInstanceAttributeConstants(gInstanceAttributes[static_cast<size_t>(i)]);
+			glDrawElements(GL_TRIANGLES, indexCount, GL_UNSIGNED_INT, offset);
 		}
 	}
 
+	int ResolveMaterialIndex(int recordMaterial, int materialOverride) {
+		const int materialCount = static_cast<int>(gMaterials.size());
+		if (materialOverride >= 0 && materialOverride < materialCount) {
+			return materialOverride;
+		}
+		return (recordMaterial >= 0 && recordMaterial < materialCount) ? recordMaterial : 0;
+	}
+
+	void DrawModelGeometry(const PassInstanceRuns& pass) {
+		for (const DrawRecord& record : gDrawRecords) {
+			const ArenaRange& span = pass.modelRunSpans[static_cast<size_t>(record.modelIndex)];
+			for (size_t r = span.offset; r < span.offset + span.count; ++r) {
+				DrawInstanceRun(record.indexCount, record.indexOffset, pass.runs[r]);
+			}
+		}
+		FinishInstanceDraws();
+	}
+
 	void UpdateLightShadowState(const glm::mat4& model) {
 		gLightWorldPosition = ComputeLightPosition(model);
 		glm::vec3 lightTarget(0.0f, std::min(0.0f, gPlaneHeight * 0.5f), 0.0f);
@@ -2191,10 +6429,18 @@ void main() {
 		const float objectScaleMax = std::max(gObjectScale.x, std::max(gObjectScale.y, gObjectScale.z));
 		const float planeHalfWidth = 0.5f * gPlaneWidth * gPlaneScale;
 		const float planeHalfLength = 0.5f * gPlaneLength * gPlaneScale;
+		Bounds instanceBounds;
+		for (const Bounds& bounds : gInstanceBounds) {
+			instanceBounds.Expand(bounds.min);
+			instanceBounds.Expand(bounds.max);
+		}
+		const float objectRadius = instanceBounds.valid
+			? std::max(instanceBounds.MaxExtent(), 1.0f) * 1.6f + glm::length(instanceBounds.Center() - gCenter)
+			: std::max(gBounds.MaxExtent(), 1.0f) * objectScaleMax * 1.6f;
 
 		const float sceneRadius =
 			std::max(
-				std::max(gBounds.MaxExtent(), 1.0f) * objectScaleMax * 1.6f,
+				objectRadius,
 				std::max(planeHalfWidth, planeHalfLength) * 1.3f) +
 			std::abs(gPlaneHeight) +
 			1.0f;
@@ -2208,8 +6454,8 @@ void main() {
 		gLightViewProjection = lightProjection * lightView;
 	}
 
-	void RenderShadowDepthPass(const glm::mat4& model) {
-		if (gDepthProgram == 0 || gShadowMap.framebuffer == 0 || gVbo == 0 || gEbo == 0) {
+	void RenderShadowDepthPass(const glm::mat4& model, const PassInstanceRuns& pass) {
+		if (gDepthProgram == 0 || gShadowMap.framebuffer == 0 || gGeometryArena.vbo == 0 || gGeometryArena.ebo == 0) {
 			return;
 		}
 
@@ -2221,15 +6467,15 @@ void main() {
 		glPolygonOffset(2.0f, 4.0f);
 
 		pglUseProgram(gDepthProgram);
-		const glm::mat4 objectModel = model * glm::scale(glm::mat4(1.0f), gObjectScale);
-		const glm::mat4 depthMvp = gLightViewProjection * objectModel;
+		const glm::mat4 depthMvp = gLightViewProjection * model;
 		if (gDepthMvpLocation >= 0) {
 			pglUniformMatrix4fv(gDepthMvpLocation, 1, GL_FALSE, glm::value_ptr(depthMvp));
 		}
-		BindModelBuffers();
-		DrawModelGeometry();
+		gLastShadowInstances = pass.visibleCount;
+		BindGeometryArena();
+		DrawModelGeometry(pass);
 
-		if (gUseVao && gVao != 0) {
+		if (gUseVao && gGeometryArena.vao != 0) {
 			pglBindVertexArray(0);
 		}
 		pglUseProgram(0);
@@ -2238,7 +6484,7 @@ void main() {
 		pglBindFramebuffer(GL_FRAMEBUFFER, 0);
 	}
 
-	void RenderObjectToCurrentTarget(
+	int RenderObjectToCurrentTarget(
 		const glm::mat4& model,
 		const glm::mat4& view,
 		const glm::mat4& projection,
@@ -2246,106 +6492,99 @@ void main() {
 		bool forceBlinn,
 		bool enableEnvReflection,
 		float envReflectionStrength,
-		const glm::mat4* lightViewOverride) {
-		if (gProgram == 0 || gVbo == 0 || gEbo == 0) {
-			return;
+		const glm::mat4* lightViewOverride,
+		const PassInstanceRuns& pass) {
+		if (gProgram == 0 || gGeometryArena.vbo == 0 || gGeometryArena.ebo == 0) {
+			return 0;
 		}
 
-		pglUseProgram(gProgram);
-
-		const glm::mat4 objectModel = model * glm::scale(glm::mat4(1.0f), gObjectScale);
-		const glm::mat4 mvp = projection * view * objectModel;
-		glm::mat3 normalMatrix = glm::transpose(glm::inverse(glm::mat3(view * objectModel)));
-		glm::mat3 worldNormalMatrix = glm::transpose(glm::inverse(glm::mat3(objectModel)));
+		// Per-instance transforms (including gObjectScale) come from the instance attributes.
+		const glm::mat4 mvp = projection * view * model;
+		glm::mat3 normalMatrix = glm::transpose(glm::inverse(glm::mat3(view * model)));
+		glm::mat3 worldNormalMatrix = glm::transpose(glm::inverse(glm::mat3(model)));
 		const glm::mat3 invViewRotation = glm::transpose(glm::mat3(view));
 		const glm::mat4 identity(1.0f);
-		const float handedness = glm::determinant(glm::mat3(view * objectModel));
+		const float handedness = glm::determinant(glm::mat3(view * model));
 		if (handedness < 0.0f) {
 			normalMatrix = -normalMatrix;
 			worldNormalMatrix = -worldNormalMatrix;
 		}
 
-		if (gMvpLocation >= 0) {
-			pglUniformMatrix4fv(gMvpLocation, 1, GL_FALSE, glm::value_ptr(mvp));
-		}
-		if (gModelLocation >= 0) {
-			pglUniformMatrix4fv(gModelLocation, 1, GL_FALSE, glm::value_ptr(objectModel));
-		}
-		if (gViewLocation >= 0) {
-			pglUniformMatrix4fv(gViewLocation, 1, GL_FALSE, glm::value_ptr(view));
-		}
-		if (gNormalMatrixLocation >= 0) {
-			pglUniformMatrix3fv(gNormalMatrixLocation, 1, GL_FALSE, glm::value_ptr(normalMatrix));
-		}
-		if (gWorldNormalMatrixLocation >= 0) {
-			pglUniformMatrix3fv(gWorldNormalMatrixLocation, 1, GL_FALSE, glm::value_ptr(worldNormalMatrix));
-		}
-		if (gInvViewRotationLocation >= 0) {
-			pglUniformMatrix3fv(gInvViewRotationLocation, 1, GL_FALSE, glm::value_ptr(invViewRotation));
-		}
-		if (gReflectionViewProjLocation >= 0) {
-			pglUniformMatrix4fv(gReflectionViewProjLocation, 1, GL_FALSE, glm::value_ptr(identity));
-		}
-		if (gUseEnvMapLocation >= 0) {
-			pglUniform1i(gUseEnvMapLocation, (enableEnvReflection && gEnvironmentCubemap != 0) ? 1 : 0);
-		}
-		if (gEnvReflectionStrengthLocation >= 0) {
-			pglUniform1f(gEnvReflectionStrengthLocation, enableEnvReflection ? envReflectionStrength : 0.0f);
-		}
-		if (gPlaneReflectionStrengthLocation >= 0) {
-			pglUniform1f(gPlaneReflectionStrengthLocation, 0.0f);
-		}
-		if (gPlaneEnvStrengthLocation >= 0) {
-			pglUniform1f(gPlaneEnvStrengthLocation, 0.0f);
-		}
-		if (gPlaneReflectionBrightnessLocation >= 0) {
-			pglUniform1f(gPlaneReflectionBrightnessLocation, 1.0f);
-		}
-		if (gPlaneColorBiasLocation >= 0) {
-			const glm::vec3 zeroBias(0.0f);
-			pglUniform3fv(gPlaneColorBiasLocation, 1, glm::value_ptr(zeroBias));
-		}
-
 		const glm::mat4& lightView = (lightViewOverride != nullptr) ? *lightViewOverride : view;
 		const glm::vec3 lightPosWorld = gLightWorldPosition;
 		const glm::vec3 lightPosView = glm::vec3(lightView * glm::vec4(lightPosWorld, 1.0f));
 		const glm::vec3 lightDirView = glm::normalize(glm::mat3(lightView) * gLightWorldDirection);
 		const glm::vec3 lightColor = gLightColor * gLightIntensity;
-		if (gLightPosLocation >= 0) {
-			pglUniform3fv(gLightPosLocation, 1, glm::value_ptr(lightPosView));
-		}
-		if (gLightDirLocation >= 0) {
-			pglUniform3fv(gLightDirLocation, 1, glm::value_ptr(lightDirView));
-		}
-		if (gLightColorLocation >= 0) {
-			pglUniform3fv(gLightColorLocation, 1, glm::value_ptr(lightColor));
-		}
-		if (gLightViewProjLocation >= 0) {
-			pglUniformMatrix4fv(gLightViewProjLocation, 1, GL_FALSE, glm::value_ptr(gLightViewProjection));
-		}
-		if (gReceiveShadowsLocation >= 0) {
-			pglUniform1i(gReceiveShadowsLocation, gShadowMap.depthTexture != 0 ? 1 : 0);
-		}
-		if (gShadowBiasLocation >= 0) {
-			pglUniform1f(gShadowBiasLocation, gShadowBias);
-		}
-		if (gUseSpotLightLocation >= 0) {
-			pglUniform1i(gUseSpotLightLocation, 1);
-		}
 		const float clampedInner = std::clamp(gSpotInnerDeg, 1.0f, 89.0f);
 		const float clampedOuter = std::clamp(gSpotOuterDeg, clampedInner + 1.0f, 89.9f);
 		const float spotInnerCos = std::cos(glm::radians(clampedInner));
 		const float spotOuterCos = std::cos(glm::radians(clampedOuter));
-		if (gSpotCosInnerLocation >= 0) {
-			pglUniform1f(gSpotCosInnerLocation, spotInnerCos);
-		}
-		if (gSpotCosOuterLocation >= 0) {
-			pglUniform1f(gSpotCosOuterLocation, spotOuterCos);
+
+		const bool showNormals = !forceBlinn && gShowNormals;
+		const bool useEnvMap = enableEnvReflection && envReflectionStrength > 0.0f && gEnvironmentCubemap != 0;
+		std::uint32_t passFeatures = kVariantSpotLight;
+		if (useEnvMap) {
+			passFeatures |= kVariantEnvMap;
 		}
-		if (gShadeModeLocation >= 0) {
-			pglUniform1i(gShadeModeLocation, (!forceBlinn && gShowNormals) ? 1 : 0);
+		if (gShadowMap.depthTexture != 0) {
+			passFeatures |= kVariantShadows;
 		}
 
+		// Uniforms shared by every draw of the pass, re-sent whenever a material needs another variant.
+		auto applyPassUniforms = [&]() {
+			if (gMvpLocation >= 0) {
+				pglUniformMatrix4fv(gMvpLocation, 1, GL_FALSE, glm::value_ptr(mvp));
+			}
+			if (gModelLocation >= 0) {
+				pglUniformMatrix4fv(gModelLocation, 1, GL_FALSE, glm::value_ptr(model));
+			}
+			if (gViewLocation >= 0) {
+				pglUniformMatrix4fv(gViewLocation, 1, GL_FALSE, glm::value_ptr(view));
+			}
+			if (gNormalMatrixLocation >= 0) {
+				pglUniformMatrix3fv(gNormalMatrixLocation, 1, GL_FALSE, glm::value_ptr(normalMatrix));
+			}
+			if (gWorldNormalMatrixLocation >= 0) {
+				pglUniformMatrix3fv(gWorldNormalMatrixLocation, 1, GL_FALSE, glm::value_ptr(worldNormalMatrix));
+			}
+			if (gInvViewRotationLocation >= 0) {
+				pglUniformMatrix3fv(gInvViewRotationLocation, 1, GL_FALSE, glm::value_ptr(invViewRotation));
+			}
+			if (gReflectionViewProjLocation >= 0) {
+				pglUniformMatrix4fv(gReflectionViewProjLocation, 1, GL_FALSE, glm::value_ptr(identity));
+			}
+			if (gEnvReflectionStrengthLocation >= 0) {
+				pglUniform1f(gEnvReflectionStrengthLocation, useEnvMap ? envReflectionStrength : 0.0f);
+			}
+			if (gEnvMaxLodLocation >= 0) {
+				pglUniform1f(gEnvMaxLodLocation, useEnvMap ? static_cast<float>(gEnvironmentStats.levels - 1) : 0.0f);
+			}
+			if (gEnvDiffuseStrengthLocation >= 0) {
+				pglUniform1f(gEnvDiffuseStrengthLocation, useEnvMap && gIrradianceCubemap != 0 && pglActiveTexture ? gEnvDiffuseStrength : 0.0f);
+			}
+			if (gLightPosLocation >= 0) {
+				pglUniform3fv(gLightPosLocation, 1, glm::value_ptr(lightPosView));
+			}
+			if (gLightDirLocation >= 0) {
+				pglUniform3fv(gLightDirLocation, 1, glm::value_ptr(lightDirView));
+			}
+			if (gLightColorLocation >= 0) {
+				pglUniform3fv(gLightColorLocation, 1, glm::value_ptr(lightColor));
+			}
+			if (gLightViewProjLocation >= 0) {
+				pglUniformMatrix4fv(gLightViewProjLocation, 1, GL_FALSE, glm::value_ptr(gLightViewProjection));
+			}
+			if (gShadowBiasLocation >= 0) {
+				pglUniform1f(gShadowBiasLocation, gShadowBias);
+			}
+			if (gSpotCosInnerLocation >= 0) {
+				pglUniform1f(gSpotCosInnerLocation, spotInnerCos);
+			}
+			if (gSpotCosOuterLocation >= 0) {
+				pglUniform1f(gSpotCosOuterLocation, spotOuterCos);
+			}
+		};
+
 		if (pglActiveTexture) {
 			pglActiveTexture(GL_TEXTURE3);
 		}
@@ -2353,8 +6592,12 @@ void main() {
 		if (pglActiveTexture) {
 			pglActiveTexture(GL_TEXTURE2);
 		}
-		glBindTexture(GL_TEXTURE_CUBE_MAP, enableEnvReflection ? gEnvironmentCubemap : 0);
-		BindModelBuffers();
+		glBindTexture(GL_TEXTURE_CUBE_MAP, useEnvMap ? gEnvironmentCubemap : 0);
+		if (pglActiveTexture) {
+			pglActiveTexture(GL_TEXTURE6);
+			glBindTexture(GL_TEXTURE_CUBE_MAP, useEnvMap ? gIrradianceCubemap : 0);
+		}
+		BindGeometryArena();
 
 		auto applyMaterial = [&](const Material& material) {
 			if (gAmbientLocation >= 0) {
@@ -2369,12 +6612,6 @@ void main() {
 			if (gShininessLocation >= 0) {
 				pglUniform1f(gShininessLocation, material.shininess);
 			}
-			if (gUseDiffuseMapLocation >= 0) {
-				pglUniform1i(gUseDiffuseMapLocation, material.hasDiffuseTexture ? 1 : 0);
-			}
-			if (gUseSpecularMapLocation >= 0) {
-				pglUniform1i(gUseSpecularMapLocation, material.hasSpecularTexture ? 1 : 0);
-			}
 			if (pglActiveTexture) {
 				pglActiveTexture(GL_TEXTURE0);
 			}
@@ -2385,31 +6622,104 @@ void main() {
 			glBindTexture(GL_TEXTURE_2D, material.hasSpecularTexture ? material.specularTexture : 0);
 		};
 
+		std::uint32_t boundVariant = ~0u;
+		auto bindVariantFor = [&](const Material& material) {
+			std::uint32_t key = kShadeModeNormals;
+			if (!showNormals) {
+				key = kShadeModeBlinn | passFeatures;
+				if (material.hasDiffuseTexture) {
+					key |= kVariantDiffuseMap;
+				}
+				if (material.hasSpecularTexture) {
+					key |= kVariantSpecularMap;
+				}
+			}
+			if (key == boundVariant) {
+				return true;
+			}
+			if (!UseShaderVariant(key)) {
+				return false;
+			}
+			boundVariant = key;
+			applyPassUniforms();
+			return true;
+		};
+
+		// Table records: one program for the pass, the table re-sent per model and the arrays per record.
+		int tableModel = -1;
+		std::pair<int, int> boundArrays{-2, -2};
+		auto applyTableRecord = [&](const DrawRecord& record) {
+			const std::uint32_t key = showNormals ? kShadeModeNormals : (kShadeModeBlinn | passFeatures | kVariantMaterialTable);
+			if (key != boundVariant) {
+				const bool ready = UseShaderVariant(key) && (showNormals || gMaterialTableLocation >= 0);
+				boundVariant = ready ? key : ~0u;
+				if (!ready) {
+					// E.g. the built-in fallback shaders, which have no table: draw per material from now on.
+					gMaterialBatching.shaderReady = false;
+					gDrawRecordsDirty = true;
+					return false;
+				}
+				applyPassUniforms();
+				tableModel = -1;
+			}
+			if (showNormals) {
+				return true;
+			}
+			if (record.modelIndex != tableModel) {
+				UploadMaterialTable(gSceneModels[static_cast<size_t>(record.modelIndex)]);
+				tableModel = record.modelIndex;
+			}
+			if (boundArrays != std::make_pair(record.diffuseArray, record.specularArray)) {
+				const std::vector<TextureArray>& arrays = gMaterialBatching.arrays;
+				pglActiveTexture(GL_TEXTURE4);
+				glBindTexture(GL_TEXTURE_2D_ARRAY, record.diffuseArray >= 0 ? arrays[static_cast<size_t>(record.diffuseArray)].texture : 0);
+				pglActiveTexture(GL_TEXTURE5);
+				glBindTexture(GL_TEXTURE_2D_ARRAY, record.specularArray >= 0 ? arrays[static_cast<size_t>(record.specularArray)].texture : 0);
+				boundArrays = std::make_pair(record.diffuseArray, record.specularArray);
+			}
+			return true;
+		};
+
+		const Material fallbackMaterial;
 		int lastMaterial = -1;
-		if (gSubmeshes.empty()) {
-			const Material& fallback = gMaterials.empty() ? Material{} : gMaterials.front();
-			applyMaterial(fallback);
-			glDrawElements(GL_TRIANGLES, gIndexCount, GL_UNSIGNED_INT, nullptr);
-		} else {
-			for (const Submesh& submesh : gSubmeshes) {
-				const int matIndex = (submesh.materialIndex >= 0 && submesh.materialIndex < static_cast<int>(gMaterials.size()))
-					? submesh.materialIndex
-					: 0;
-				if (matIndex != lastMaterial) {
-					const Material& material = gMaterials.empty() ? Material{} : gMaterials[matIndex];
-					applyMaterial(material);
-					lastMaterial = matIndex;
+		bool materialReady = false;
+		auto applyMaterialFor = [&](int recordMaterial, int materialOverride) {
+			const int matIndex = ResolveMaterialIndex(recordMaterial, materialOverride);
+			if (matIndex == lastMaterial) {
+				return materialReady;
+			}
+			const Material& material = gMaterials.empty() ? fallbackMaterial : gMaterials[static_cast<size_t>(matIndex)];
+			lastMaterial = matIndex;
+			materialReady = bindVariantFor(material);
+			if (materialReady) {
+				applyMaterial(material);
+			}
+			return materialReady;
+		};
+		for (const DrawRecord& record : gDrawRecords) {
+			const ArenaRange& span = pass.modelRunSpans[static_cast<size_t>(record.modelIndex)];
+			for (size_t r = span.offset; r < span.offset + span.count; ++r) {
+				const InstanceRun& run = pass.runs[r];
+				// An override gives every submesh the same material, so the merged range still draws at once.
+				bool ready = false;
+				if (record.UsesTable() && run.materialOverride < 0) {
+					ready = applyTableRecord(record);
+					lastMaterial = -1;
+				} else {
+					ready = applyMaterialFor(record.materialIndex, run.materialOverride);
+				}
+				if (ready) {
+					DrawInstanceRun(record.indexCount, record.indexOffset, run);
 				}
-				const void* offset = reinterpret_cast<const void*>(static_cast<size_t>(submesh.indexOffset) * sizeof(unsigned int));
-				glDrawElements(GL_TRIANGLES, submesh.indexCount, GL_UNSIGNED_INT, offset);
 			}
 		}
+		FinishInstanceDraws();
 
-		if (drawLightMarker && gShowLightMarker && gLightVbo != 0) {
+		if (drawLightMarker && gShowLightMarker && gLightPointMesh.vertexRange.count > 0) {
 			const LightMarkerShape selectedShape = static_cast<LightMarkerShape>(
 				std::clamp(gLightMarkerShape, 0, static_cast<int>(LightMarkerShape::LightObject)));
 
-			const GLMeshBuffers* selectedMesh = nullptr;
+			const ArenaMesh* selectedMesh = nullptr;
 			switch (selectedShape) {
 			case LightMarkerShape::Cube:
 				selectedMesh = &gLightCubeMesh;
@@ -2427,62 +6737,34 @@ void main() {
 			}
 
 			glm::mat4 modelLight = glm::translate(glm::mat4(1.0f), lightPosWorld);
-			if (selectedShape == LightMarkerShape::LightObject) {
-				modelLight = modelLight * BuildOrientationFromForward(gLightWorldDirection);
-			}
-			if (selectedMesh != nullptr && selectedMesh->indexCount > 0) {
-				const float markerScale = std::max(
-					kLightMarkerMeshScaleMin,
-					gBounds.MaxExtent() * kLightMarkerMeshScaleRatio * gLightMarkerScale);
-				modelLight = modelLight * glm::scale(glm::mat4(1.0f), glm::vec3(markerScale));
-			}
-
-			const glm::mat4 mvpLight = projection * view * modelLight;
-			const glm::mat3 normalMatrixLight = glm::transpose(glm::inverse(glm::mat3(view * modelLight)));
-			const glm::mat3 worldNormalMatrixLight = glm::transpose(glm::inverse(glm::mat3(modelLight)));
-			if (gMvpLocation >= 0) {
-				pglUniformMatrix4fv(gMvpLocation, 1, GL_FALSE, glm::value_ptr(mvpLight));
-			}
-			if (gModelLocation >= 0) {
-				pglUniformMatrix4fv(gModelLocation, 1, GL_FALSE, glm::value_ptr(modelLight));
-			}
-			if (gNormalMatrixLocation >= 0) {
-				pglUniformMatrix3fv(gNormalMatrixLocation, 1, GL_FALSE, glm::value_ptr(normalMatrixLight));
-			}
-			if (gWorldNormalMatrixLocation >= 0) {
-				pglUniformMatrix3fv(gWorldNormalMatrixLocation, 1, GL_FALSE, glm::value_ptr(worldNormalMatrixLight));
-			}
-			if (gShadeModeLocation >= 0) {
-				pglUniform1i(gShadeModeLocation, 2);
+			if (selectedShape == LightMarkerShape::LightObject) {
+				modelLight = modelLight * BuildOrientationFromForward(gLightWorldDirection);
 			}
-			if (gMarkerColorLocation >= 0) {
-				pglUniform3fv(gMarkerColorLocation, 1, glm::value_ptr(gLightMarkerColor));
+			if (selectedMesh != nullptr && selectedMesh->IndexCount() > 0) {
+				const float markerScale = std::max(
+					kLightMarkerMeshScaleMin,
+					gBounds.MaxExtent() * kLightMarkerMeshScaleRatio * gLightMarkerScale);
+				modelLight = modelLight * glm::scale(glm::mat4(1.0f), glm::vec3(markerScale));
 			}
 
-			if (selectedMesh != nullptr && selectedMesh->indexCount > 0) {
-				BindMeshBuffers(*selectedMesh);
-				glDrawElements(GL_TRIANGLES, selectedMesh->indexCount, GL_UNSIGNED_INT, nullptr);
-				if (gUseVao && selectedMesh->vao != 0) {
-					pglBindVertexArray(0);
+			const glm::mat4 mvpLight = projection * view * modelLight;
+			if (gUnlitProgram != 0) {
+				pglUseProgram(gUnlitProgram);
+				if (gUnlitMvpLocation >= 0) {
+					pglUniformMatrix4fv(gUnlitMvpLocation, 1, GL_FALSE, glm::value_ptr(mvpLight));
 				}
-			} else {
-				glPointSize(kLightMarkerPointSize * std::max(0.1f, gLightMarkerScale));
-				if (gUseVao && gLightVao != 0) {
-					pglBindVertexArray(gLightVao);
-				} else {
-					pglBindBuffer(GL_ARRAY_BUFFER, gLightVbo);
-					pglEnableVertexAttribArray(0);
-					pglVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), reinterpret_cast<void*>(offsetof(Vertex, position)));
-					pglEnableVertexAttribArray(1);
-					pglVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), reinterpret_cast<void*>(offsetof(Vertex, normal)));
-					pglEnableVertexAttribArray(2);
-					pglVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), reinterpret_cast<void*>(offsetof(Vertex, texcoord)));
+				if (gUnlitColorLocation >= 0) {
+					pglUniform3fv(gUnlitColorLocation, 1, glm::value_ptr(gLightMarkerColor));
 				}
-				glDrawArrays(GL_POINTS, 0, 1);
-				if (gUseVao && gLightVao != 0) {
-					pglBindVertexArray(0);
+
+				// The marker meshes share the arena with the model, so no rebind is needed here.
+				if (selectedMesh != nullptr && selectedMesh->IndexCount() > 0) {
+					DrawArenaMesh(*selectedMesh);
+				} else {
+					glPointSize(kLightMarkerPointSize * std::max(0.1f, gLightMarkerScale));
+					glDrawArrays(GL_POINTS, static_cast<GLint>(gLightPointMesh.vertexRange.offset), 1);
+					glPointSize(1.0f);
 				}
-				glPointSize(1.0f);
 			}
 		}
 
@@ -2503,26 +6785,82 @@ void main() {
 		}
 		glBindTexture(GL_TEXTURE_2D, 0);
 
-		if (gUseVao && gVao != 0) {
+		if (gUseVao && gGeometryArena.vao != 0) {
 			pglBindVertexArray(0);
 		}
 		pglUseProgram(0);
+		return pass.visibleCount;
 	}
 
+	// Call after the opaque passes: the skybox is drawn at the far plane, so covered pixels are
+	// rejected by the depth test before any shading.
 	void RenderBackgroundToCurrentTarget(const glm::mat4& view, const glm::mat4& projection) {
-		if (gProgram == 0 || gBackgroundVbo == 0 || gBackgroundEbo == 0 || gBackgroundIndexCount <= 0 || gEnvironmentCubemap == 0) {
+		if (gSkyboxProgram == 0 || gBackgroundMesh.IndexCount() <= 0 || gEnvironmentCubemap == 0) {
 			return;
 		}
 
-		pglUseProgram(gProgram);
+		pglUseProgram(gSkyboxProgram);
 
 		const glm::mat4 model = glm::scale(glm::mat4(1.0f), glm::vec3(kSkyboxDepth));
 		const glm::mat4 skyboxView = glm::mat4(glm::mat3(view));
 		const glm::mat4 mvp = projection * skyboxView * model;
-		const glm::mat3 normalMatrix = glm::transpose(glm::inverse(glm::mat3(skyboxView * model)));
+		if (gSkyboxMvpLocation >= 0) {
+			pglUniformMatrix4fv(gSkyboxMvpLocation, 1, GL_FALSE, glm::value_ptr(mvp));
+		}
+
+		if (pglActiveTexture) {
+			pglActiveTexture(GL_TEXTURE2);
+		}
+		glBindTexture(GL_TEXTURE_CUBE_MAP, gEnvironmentCubemap);
+
+		glDepthMask(GL_FALSE);
+		glDepthFunc(GL_LEQUAL);
+		BindGeometryArena();
+		DrawArenaMesh(gBackgroundMesh);
+		glDepthFunc(GL_LESS);
+		glDepthMask(GL_TRUE);
+
+		if (gUseVao && gGeometryArena.vao != 0) {
+			pglBindVertexArray(0);
+		}
+		glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
+		if (pglActiveTexture) {
+			pglActiveTexture(GL_TEXTURE0);
+		}
+		pglUseProgram(0);
+	}
+
+	void RenderPlaneToCurrentTarget(
+		const glm::mat4& view,
+		const glm::mat4& projection,
+		const glm::mat4& reflectionViewProj) {
+		if (gProgram == 0 || gPlaneMesh.IndexCount() <= 0) {
+			return;
+		}
+
+		const bool useReflectionTexture = gRenderToPlane && gRenderTexture.colorTexture != 0;
+		std::uint32_t variant = kShadeModePlane | kVariantSpotLight;
+		if (useReflectionTexture) {
+			variant |= kVariantDiffuseMap;
+		}
+		if (gEnvironmentCubemap != 0) {
+			variant |= kVariantEnvMap;
+		}
+		if (gShadowMap.depthTexture != 0) {
+			variant |= kVariantShadows;
+		}
+		if (!UseShaderVariant(variant)) {
+			return;
+		}
+
+		const glm::mat4 model = BuildPlaneModelMatrix();
+		const glm::mat4 mvp = projection * view * model;
+		const glm::mat3 normalMatrix = glm::transpose(glm::inverse(glm::mat3(view * model)));
 		const glm::mat3 worldNormalMatrix = glm::transpose(glm::inverse(glm::mat3(model)));
 		const glm::mat3 invViewRotation = glm::transpose(glm::mat3(view));
-		const glm::mat4 identity(1.0f);
+		const glm::vec3 lightPosView = glm::vec3(view * glm::vec4(gLightWorldPosition, 1.0f));
+		const glm::vec3 lightDirView = glm::normalize(glm::mat3(view) * gLightWorldDirection);
+		const glm::vec3 lightColor = gLightColor * gLightIntensity;
 
 		if (gMvpLocation >= 0) {
 			pglUniformMatrix4fv(gMvpLocation, 1, GL_FALSE, glm::value_ptr(mvp));
@@ -2531,7 +6869,7 @@ void main() {
 			pglUniformMatrix4fv(gModelLocation, 1, GL_FALSE, glm::value_ptr(model));
 		}
 		if (gViewLocation >= 0) {
-			pglUniformMatrix4fv(gViewLocation, 1, GL_FALSE, glm::value_ptr(skyboxView));
+			pglUniformMatrix4fv(gViewLocation, 1, GL_FALSE, glm::value_ptr(view));
 		}
 		if (gNormalMatrixLocation >= 0) {
 			pglUniformMatrix3fv(gNormalMatrixLocation, 1, GL_FALSE, glm::value_ptr(normalMatrix));
@@ -2543,42 +6881,62 @@ void main() {
 			pglUniformMatrix3fv(gInvViewRotationLocation, 1, GL_FALSE, glm::value_ptr(invViewRotation));
 		}
 		if (gReflectionViewProjLocation >= 0) {
-			pglUniformMatrix4fv(gReflectionViewProjLocation, 1, GL_FALSE, glm::value_ptr(identity));
+			pglUniformMatrix4fv(gReflectionViewProjLocation, 1, GL_FALSE, glm::value_ptr(reflectionViewProj));
+		}
+		if (gLightPosLocation >= 0) {
+			pglUniform3fv(gLightPosLocation, 1, glm::value_ptr(lightPosView));
+		}
+		if (gLightDirLocation >= 0) {
+			pglUniform3fv(gLightDirLocation, 1, glm::value_ptr(lightDirView));
+		}
+		if (gLightColorLocation >= 0) {
+			pglUniform3fv(gLightColorLocation, 1, glm::value_ptr(lightColor));
 		}
 		if (gLightViewProjLocation >= 0) {
-			pglUniformMatrix4fv(gLightViewProjLocation, 1, GL_FALSE, glm::value_ptr(identity));
+			pglUniformMatrix4fv(gLightViewProjLocation, 1, GL_FALSE, glm::value_ptr(gLightViewProjection));
+		}
+		if (gShadowBiasLocation >= 0) {
+			pglUniform1f(gShadowBiasLocation, gShadowBias);
 		}
-		if (gReceiveShadowsLocation >= 0) {
-			pglUniform1i(gReceiveShadowsLocation, 0);
+		const float clampedInner = std::clamp(gSpotInnerDeg, 1.0f, 89.0f);
+		const float clampedOuter = std::clamp(gSpotOuterDeg, clampedInner + 1.0f, 89.9f);
+		const float spotInnerCos = std::cos(glm::radians(clampedInner));
+		const float spotOuterCos = std::cos(glm::radians(clampedOuter));
+		if (gSpotCosInnerLocation >= 0) {
+			pglUniform1f(gSpotCosInnerLocation, spotInnerCos);
 		}
-		if (gUseSpotLightLocation >= 0) {
-			pglUniform1i(gUseSpotLightLocation, 0);
+		if (gSpotCosOuterLocation >= 0) {
+			pglUniform1f(gSpotCosOuterLocation, spotOuterCos);
 		}
-		if (gShadeModeLocation >= 0) {
-			pglUniform1i(gShadeModeLocation, 4);
+		if (gAmbientLocation >= 0) {
+			pglUniform3fv(gAmbientLocation, 1, glm::value_ptr(gPlaneAmbientColor));
 		}
-		if (gUseEnvMapLocation >= 0) {
-			pglUniform1i(gUseEnvMapLocation, 1);
+		if (gDiffuseLocation >= 0) {
+			pglUniform3fv(gDiffuseLocation, 1, glm::value_ptr(gPlaneDiffuseColor));
 		}
-		if (gUseDiffuseMapLocation >= 0) {
-			pglUniform1i(gUseDiffuseMapLocation, 0);
+		if (gSpecularLocation >= 0) {
+			pglUniform3fv(gSpecularLocation, 1, glm::value_ptr(gPlaneSpecularColor));
 		}
-		if (gUseSpecularMapLocation >= 0) {
-			pglUniform1i(gUseSpecularMapLocation, 0);
+		if (gShininessLocation >= 0) {
+			pglUniform1f(gShininessLocation, gPlaneShininess);
 		}
 		if (gPlaneColorBiasLocation >= 0) {
-			const glm::vec3 zeroBias(0.0f);
-			pglUniform3fv(gPlaneColorBiasLocation, 1, glm::value_ptr(zeroBias));
+			pglUniform3fv(gPlaneColorBiasLocation, 1, glm::value_ptr(gPlaneColorBias));
 		}
-
-		if (pglActiveTexture) {
-			pglActiveTexture(GL_TEXTURE3);
+		if (gPlaneReflectionStrengthLocation >= 0) {
+			pglUniform1f(gPlaneReflectionStrengthLocation, gPlaneRttReflectionStrength);
 		}
-		glBindTexture(GL_TEXTURE_2D, 0);
+		if (gPlaneEnvStrengthLocation >= 0) {
+			pglUniform1f(gPlaneEnvStrengthLocation, gPlaneEnvReflectionStrength);
+		}
+		if (gPlaneReflectionBrightnessLocation >= 0) {
+			pglUniform1f(gPlaneReflectionBrightnessLocation, gPlaneRttReflectionBrightness);
+		}
+
 		if (pglActiveTexture) {
 			pglActiveTexture(GL_TEXTURE0);
 		}
-		glBindTexture(GL_TEXTURE_2D, 0);
+		glBindTexture(GL_TEXTURE_2D, useReflectionTexture ? gRenderTexture.colorTexture : 0);
 		if (pglActiveTexture) {
 			pglActiveTexture(GL_TEXTURE1);
 		}
@@ -2587,15 +6945,15 @@ void main() {
 			pglActiveTexture(GL_TEXTURE2);
 		}
 		glBindTexture(GL_TEXTURE_CUBE_MAP, gEnvironmentCubemap);
+		if (pglActiveTexture) {
+			pglActiveTexture(GL_TEXTURE3);
+		}
+		glBindTexture(GL_TEXTURE_2D, gShadowMap.depthTexture);
 
-		glDepthMask(GL_FALSE);
-		glDepthFunc(GL_LEQUAL);
-		BindBackgroundBuffers();
-		glDrawElements(GL_TRIANGLES, gBackgroundIndexCount, GL_UNSIGNED_INT, nullptr);
-		glDepthFunc(GL_LESS);
-		glDepthMask(GL_TRUE);
+		BindGeometryArena();
+		DrawArenaMesh(gPlaneMesh);
 
-		if (gUseVao && gBackgroundVao != 0) {
+		if (gUseVao && gGeometryArena.vao != 0) {
 			pglBindVertexArray(0);
 		}
 		if (pglActiveTexture) {
@@ -2609,448 +6967,1806 @@ void main() {
 		if (pglActiveTexture) {
 			pglActiveTexture(GL_TEXTURE1);
 		}
-		glBindTexture(GL_TEXTURE_2D, 0);
-		if (pglActiveTexture) {
-			pglActiveTexture(GL_TEXTURE0);
+		glBindTexture(GL_TEXTURE_2D, 0);
+		if (pglActiveTexture) {
+			pglActiveTexture(GL_TEXTURE0);
+		}
+		glBindTexture(GL_TEXTURE_2D, 0);
+		pglUseProgram(0);
+	}
+
+	void UpdateWindowTitle() {
+		if (!gWindow) {
+			return;
+		}
+		const char* mode = gUsePerspective ? "Perspective" : "Orthographic";
+		const char* shade = gShowNormals ? "Normals" : "Blinn+Env";
+		char title[160];
+		std::snprintf(title, sizeof(title), "%s | %s | %s", gpurenderer::config::kWindowTitleBase, mode, shade);
+		glfwSetWindowTitle(gWindow, title);
+	}
+
+	bool CanRenderScene() {
+		return gProgram != 0 && gGeometryArena.vbo != 0 && gGeometryArena.ebo != 0;
+	}
+
+	FramePlan PrepareFramePlan() {
+		FramePlan plan;
+		plan.model = BuildObjectModelMatrix(gObjectCamera);
+		plan.view = BuildViewMatrix(gObjectCamera);
+		plan.projection = BuildProjectionMatrix(gWindowWidth, gWindowHeight, gNearPlane, gFarPlane);
+		plan.reflectionView = plan.view * BuildPlanarReflectionMatrix(gPlaneHeight);
+		plan.reflectionViewProj = plan.projection * plan.reflectionView;
+		PrepareSceneDrawData();
+		UpdateLightShadowState(plan.model);
+		plan.shadowRuns = BuildVisibleInstanceRuns(gLightViewProjection * plan.model);
+		plan.drawReflection = gRenderToPlane && gPlaneMesh.IndexCount() > 0;
+		if (plan.drawReflection) {
+			plan.reflectionRuns = BuildVisibleInstanceRuns(plan.reflectionViewProj * plan.model);
+		}
+		plan.mainRuns = BuildVisibleInstanceRuns(plan.projection * plan.view * plan.model);
+		return plan;
+	}
+
+	void SubmitFramePlan(const FramePlan& plan) {
+		auto lapStart = std::chrono::steady_clock::now();
+		UploadInstanceBuffer();
+		if (CreateOrResizeShadowMap(kShadowMapResolution, kShadowMapResolution)) {
+			RenderShadowDepthPass(plan.model, plan.shadowRuns);
+		}
+		LapPassTimer(&gpurenderer::PassTimings::shadowMs, lapStart);
+
+		if (plan.drawReflection) {
+			if (CreateOrResizeRenderTexture(gWindowWidth, gWindowHeight)) {
+				pglBindFramebuffer(GL_FRAMEBUFFER, gRenderTexture.framebuffer);
+				glViewport(0, 0, gRenderTexture.width, gRenderTexture.height);
+				glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+				glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+				gLastReflectionInstances = RenderObjectToCurrentTarget(
+					plan.model,
+					plan.reflectionView,
+					plan.projection,
+					false,
+					true,
+					true,
+					kObjectEnvReflectionStrength,
+					&plan.view,
+					plan.reflectionRuns);
+				pglBindFramebuffer(GL_FRAMEBUFFER, 0);
+				GenerateRenderTextureMipmaps();
+			}
+		}
+		LapPassTimer(&gpurenderer::PassTimings::reflectionMs, lapStart);
+
+		pglBindFramebuffer(GL_FRAMEBUFFER, 0);
+		glViewport(0, 0, gWindowWidth, gWindowHeight);
+		glClearColor(gSceneBackgroundColor.x, gSceneBackgroundColor.y, gSceneBackgroundColor.z, 1.0f);
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+		if (gPlaneMesh.IndexCount() > 0) {
+			RenderPlaneToCurrentTarget(plan.view, plan.projection, plan.reflectionViewProj);
+		}
+		gLastMainInstances = RenderObjectToCurrentTarget(
+			plan.model,
+			plan.view,
+			plan.projection,
+			true,
+			false,
+			true,
+			kObjectEnvReflectionStrength,
+			nullptr,
+			plan.mainRuns);
+		RenderBackgroundToCurrentTarget(plan.view, plan.projection);
+		LapPassTimer(&gpurenderer::PassTimings::mainMs, lapStart);
+	}
+
+	void Display() {
+		if (!CanRenderScene()) {
+			return;
+		}
+		SubmitFramePlan(PrepareFramePlan());
+	}
+
+	// Blocks until the frame that last used the current slot's budget (framesInFlight frames ago) has
+	// finished on the GPU.
+	void WaitForFrameSlot() {
+		const auto waitStart = std::chrono::steady_clock::now();
+		FrameScheduler& scheduler = gFrameScheduler;
+		const size_t framesInFlight = static_cast<size_t>(std::clamp(scheduler.framesInFlight, 1, kMaxFramesInFlight));
+		if (gHasFenceSync && scheduler.submittedFrames >= framesInFlight) {
+			const size_t slot = (scheduler.submittedFrames - framesInFlight) % kMaxFramesInFlight;
+			if (scheduler.fences[slot] != nullptr) {
+				const GLenum result = pglClientWaitSync(scheduler.fences[slot], GL_SYNC_FLUSH_COMMANDS_BIT, kFenceWaitTimeoutNs);
+				if (result == GL_TIMEOUT_EXPIRED || result == GL_WAIT_FAILED) {
+					++scheduler.fenceTimeouts;
+				}
+			}
+		}
+		scheduler.fenceWaitMs = static_cast<float>(ElapsedMilliseconds(waitStart));
+	}
+
+	void EndFrameSubmission() {
+		FrameScheduler& scheduler = gFrameScheduler;
+		if (gHasFenceSync) {
+			GlSyncHandle& fence = scheduler.fences[scheduler.CurrentSlot()];
+			if (fence != nullptr) {
+				pglDeleteSync(fence);
+			}
+			fence = pglFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		}
+		++scheduler.submittedFrames;
+	}
+
+	void DestroyFrameFences() {
+		for (GlSyncHandle& fence : gFrameScheduler.fences) {
+			if (fence != nullptr && pglDeleteSync) {
+				pglDeleteSync(fence);
+			}
+			fence = nullptr;
+		}
+		gFrameScheduler.submittedFrames = 0;
+	}
+
+	void ApplySwapInterval() {
+		const int interval = gFrameScheduler.pacing == gpurenderer::FramePacing::VSync ? 1 : 0;
+		if (gWindow != nullptr && interval != gFrameScheduler.appliedSwapInterval) {
+			glfwSwapInterval(interval);
+			gFrameScheduler.appliedSwapInterval = interval;
+		}
+	}
+
+	void Reshape(GLFWwindow*, int width, int height) {
+		gWindowWidth = width > 0 ? width : 1;
+		gWindowHeight = height > 0 ? height : 1;
+		glViewport(0, 0, gWindowWidth, gWindowHeight);
+		CreateOrResizeRenderTexture(gWindowWidth, gWindowHeight);
+		CreateOrResizeShadowMap(kShadowMapResolution, kShadowMapResolution);
+	}
+
+	bool IsCtrlDown(GLFWwindow* window) {
+		return glfwGetKey(window, GLFW_KEY_LEFT_CONTROL) == GLFW_PRESS ||
+			glfwGetKey(window, GLFW_KEY_RIGHT_CONTROL) == GLFW_PRESS;
+	}
+
+	bool IsGuiCapturingMouse() {
+		return gGuiInitialized && ImGui::GetCurrentContext() != nullptr && ImGui::GetIO().WantCaptureMouse;
+	}
+
+	bool IsGuiCapturingKeyboard() {
+		return gGuiInitialized && ImGui::GetCurrentContext() != nullptr && ImGui::GetIO().WantCaptureKeyboard;
+	}
+
+	void MarkSceneDirty() {
+		gPendingRedrawFrames = kRedrawSettleFrames;
+	}
+
+	void MouseButton(GLFWwindow* window, int button, int action, int mods) {
+		MarkSceneDirty();
+		if (gGuiInitialized) {
+			ImGui_ImplGlfw_MouseButtonCallback(window, button, action, mods);
+		}
+		const bool captured = IsGuiCapturingMouse();
+		const bool pressed = (action == GLFW_PRESS);
+
+		if (button == GLFW_MOUSE_BUTTON_LEFT) {
+			gLeftDown = !captured && pressed;
+		} else if (button == GLFW_MOUSE_BUTTON_RIGHT) {
+			gRightDown = !captured && pressed;
+		} else if (button == GLFW_MOUSE_BUTTON_MIDDLE) {
+			gMiddleDown = !captured && pressed;
+		}
+		glfwGetCursorPos(window, &gLastMouseX, &gLastMouseY);
+		if (captured) {
+			return;
+		}
+	}
+
+	void MouseMotion(GLFWwindow* window, double x, double y) {
+		// Hovering the scene with no button held changes nothing; over the GUI it moves hover highlights.
+		if (gLeftDown || gRightDown || gMiddleDown || IsGuiCapturingMouse()) {
+			MarkSceneDirty();
+		}
+		if (gGuiInitialized) {
+			ImGui_ImplGlfw_CursorPosCallback(window, x, y);
+		}
+		if (IsGuiCapturingMouse()) {
+			gLastMouseX = x;
+			gLastMouseY = y;
+			return;
+		}
+
+		const float dx = static_cast<float>(x - gLastMouseX);
+		const float dy = static_cast<float>(y - gLastMouseY);
+		OrbitCamera& targetCamera = gObjectCamera;
+		const float viewHeight = gUsePerspective
+			? (2.0f * targetCamera.distance * std::tan(0.5f * DegreesToRadians(kDefaultFovDeg)))
+			: 2.0f;
+		const float panScale = (gWindowHeight > 0) ? (viewHeight / static_cast<float>(gWindowHeight)) : 0.0f;
+
+		if (gLeftDown) {
+			if (IsCtrlDown(window)) {
+				gLightYawDeg += dx * kLightRotationSpeedDegPerPixel;
+				gLightPitchDeg += dy * kLightRotationSpeedDegPerPixel;
+				gLightPitchDeg = std::clamp(gLightPitchDeg, -89.0f, 89.0f);
+			} else {
+				targetCamera.yawDeg += dx * kRotationSpeedDegPerPixel;
+				targetCamera.pitchDeg += dy * kRotationSpeedDegPerPixel;
+				targetCamera.pitchDeg = std::clamp(targetCamera.pitchDeg, -89.0f, 89.0f);
+			}
+		}
+		if (gRightDown) {
+			targetCamera.distance += dy * kZoomSpeed;
+			targetCamera.distance = std::max(targetCamera.distance, kMinCameraDistance);
 		}
-		glBindTexture(GL_TEXTURE_2D, 0);
-		pglUseProgram(0);
+		if (gMiddleDown) {
+			targetCamera.panX += dx * panScale;
+			targetCamera.panY -= dy * panScale;
+		}
+
+		gLastMouseX = x;
+		gLastMouseY = y;
 	}
 
-	void RenderPlaneToCurrentTarget(
-		const glm::mat4& view,
-		const glm::mat4& projection,
-		const glm::mat4& reflectionViewProj) {
-		if (gProgram == 0 || gPlaneVbo == 0 || gPlaneEbo == 0) {
+	void Scroll(GLFWwindow* window, double xoffset, double yoffset) {
+		MarkSceneDirty();
+		if (gGuiInitialized) {
+			ImGui_ImplGlfw_ScrollCallback(window, xoffset, yoffset);
+		}
+		if (IsGuiCapturingMouse()) {
 			return;
 		}
 
-		pglUseProgram(gProgram);
-
-		const glm::mat4 model = BuildPlaneModelMatrix();
-		const glm::mat4 mvp = projection * view * model;
-		const glm::mat3 normalMatrix = glm::transpose(glm::inverse(glm::mat3(view * model)));
-		const glm::mat3 worldNormalMatrix = glm::transpose(glm::inverse(glm::mat3(model)));
-		const glm::mat3 invViewRotation = glm::transpose(glm::mat3(view));
-		const glm::vec3 lightPosView = glm::vec3(view * glm::vec4(gLightWorldPosition, 1.0f));
-		const glm::vec3 lightDirView = glm::normalize(glm::mat3(view) * gLightWorldDirection);
-		const glm::vec3 lightColor = gLightColor * gLightIntensity;
-		const bool useReflectionTexture = gRenderToPlane && gRenderTexture.colorTexture != 0;
+		if (yoffset != 0.0) {
+			OrbitCamera& targetCamera = gObjectCamera;
+			targetCamera.distance -= static_cast<float>(yoffset) * 0.2f;
+			targetCamera.distance = std::max(targetCamera.distance, kMinCameraDistance);
+		}
+	}
 
-		if (gMvpLocation >= 0) {
-			pglUniformMatrix4fv(gMvpLocation, 1, GL_FALSE, glm::value_ptr(mvp));
+	void KeyCallback(GLFWwindow* window, int key, int scancode, int action, int mods) {
+		MarkSceneDirty();
+		if (gGuiInitialized) {
+			ImGui_ImplGlfw_KeyCallback(window, key, scancode, action, mods);
 		}
-		if (gModelLocation >= 0) {
-			pglUniformMatrix4fv(gModelLocation, 1, GL_FALSE, glm::value_ptr(model));
+		if (IsGuiCapturingKeyboard() && key != GLFW_KEY_ESCAPE) {
+			return;
 		}
-		if (gViewLocation >= 0) {
-			pglUniformMatrix4fv(gViewLocation, 1, GL_FALSE, glm::value_ptr(view));
+
+		if (action != GLFW_PRESS && action != GLFW_REPEAT) {
+			return;
 		}
-		if (gNormalMatrixLocation >= 0) {
-			pglUniformMatrix3fv(gNormalMatrixLocation, 1, GL_FALSE, glm::value_ptr(normalMatrix));
+		if (key == GLFW_KEY_ESCAPE) {
+			glfwSetWindowShouldClose(window, GLFW_TRUE);
+			return;
 		}
-		if (gWorldNormalMatrixLocation >= 0) {
-			pglUniformMatrix3fv(gWorldNormalMatrixLocation, 1, GL_FALSE, glm::value_ptr(worldNormalMatrix));
+		if (key == GLFW_KEY_P) {
+			gUsePerspective = !gUsePerspective;
+			UpdateWindowTitle();
+			return;
 		}
-		if (gInvViewRotationLocation >= 0) {
-			pglUniformMatrix3fv(gInvViewRotationLocation, 1, GL_FALSE, glm::value_ptr(invViewRotation));
+		if (key == GLFW_KEY_R) {
+			gObjectCamera.yawDeg = 0.0f;
+			gObjectCamera.pitchDeg = 0.0f;
+			gObjectCamera.panX = 0.0f;
+			gObjectCamera.panY = 0.0f;
+			return;
 		}
-		if (gReflectionViewProjLocation >= 0) {
-			pglUniformMatrix4fv(gReflectionViewProjLocation, 1, GL_FALSE, glm::value_ptr(reflectionViewProj));
+		if (key == GLFW_KEY_N) {
+			gShowNormals = !gShowNormals;
+			UpdateWindowTitle();
+			return;
 		}
-		if (gLightPosLocation >= 0) {
-			pglUniform3fv(gLightPosLocation, 1, glm::value_ptr(lightPosView));
+		if (key == GLFW_KEY_F6) {
+			// Finishes in UpdateShaderHotReload; the current shaders stay bound until then.
+			StartShaderReload();
+			if (!ReloadBuiltinShaders()) {
+				std::fprintf(stderr, "F6 built-in shader reload failed.\n");
+			}
+			return;
 		}
-		if (gLightDirLocation >= 0) {
-			pglUniform3fv(gLightDirLocation, 1, glm::value_ptr(lightDirView));
+	}
+
+	void CharCallback(GLFWwindow* window, unsigned int codepoint) {
+		MarkSceneDirty();
+		if (gGuiInitialized) {
+			ImGui_ImplGlfw_CharCallback(window, codepoint);
 		}
-		if (gLightColorLocation >= 0) {
-			pglUniform3fv(gLightColorLocation, 1, glm::value_ptr(lightColor));
+	}
+
+	void CopyObjPathToInput(const std::string& path) {
+		std::snprintf(gObjPathInput, sizeof(gObjPathInput), "%s", path.c_str());
+	}
+
+	// Every extension the linked Assimp can import, lower-cased with the leading dot.
+	gpurenderer::assets::ExtensionSet SupportedModelExtensions() {
+		std::string list;
+		Assimp::Importer().GetExtensionList(list);
+		gpurenderer::assets::ExtensionSet extensions;
+		std::stringstream stream(list);
+		std::string pattern;
+		while (std::getline(stream, pattern, ';')) {
+			const size_t dot = pattern.find('.');
+			if (dot == std::string::npos || dot + 1 >= pattern.size()) {
+				continue;
+			}
+			std::string extension = pattern.substr(dot);
+			std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c) {
+				return static_cast<char>(std::tolower(c));
+				});
+			extensions.insert(std::move(extension));
 		}
-		if (gLightViewProjLocation >= 0) {
-			pglUniformMatrix4fv(gLightViewProjLocation, 1, GL_FALSE, glm::value_ptr(gLightViewProjection));
+		extensions.insert(".obj");
+		return extensions;
+	}
+
+	// The form the asset index lists paths in, so the loaded model can be highlighted.
+	std::string IndexedModelPath(const std::string& path) {
+		std::error_code ec;
+		const std::filesystem::path absolute = std::filesystem::absolute(path, ec);
+		return ec ? path : absolute.lexically_normal().string();
+	}
+
+	void StartAssetIndex() {
+		std::error_code ec;
+		const std::filesystem::path root = std::filesystem::current_path(ec);
+		if (ec) {
+			return;
 		}
-		if (gReceiveShadowsLocation >= 0) {
-			pglUniform1i(gReceiveShadowsLocation, gShadowMap.depthTexture != 0 ? 1 : 0);
+		const std::filesystem::path indexFile =
+			ResolveCacheDirectory() / "asset-index" / (HashToHex(HashString(root.string())) + ".txt");
+		gAssetIndexer.Start(root, SupportedModelExtensions(), indexFile, [] {
+			gpurenderer::RequestRedraw();
+			});
+	}
+
+	bool MatchesModelFilter(const std::string& path, const std::string& filter) {
+		std::string lowerPath = path;
+		std::transform(lowerPath.begin(), lowerPath.end(), lowerPath.begin(), [](unsigned char c) {
+			return static_cast<char>(std::tolower(c));
+			});
+		std::stringstream tokens(filter);
+		std::string token;
+		while (tokens >> token) {
+			if (lowerPath.find(token) == std::string::npos) {
+				return false;
+			}
 		}
-		if (gShadowBiasLocation >= 0) {
-			pglUniform1f(gShadowBiasLocation, gShadowBias);
+		return true;
+	}
+
+	void UpdateModelList() {
+		std::string filter = gModelFilterInput;
+		std::transform(filter.begin(), filter.end(), filter.begin(), [](unsigned char c) {
+			return static_cast<char>(std::tolower(c));
+			});
+		const std::uint64_t version = gAssetIndexer.Version();
+		if (version == gModelList.version && filter == gModelList.filter) {
+			return;
 		}
-		if (gUseSpotLightLocation >= 0) {
-			pglUniform1i(gUseSpotLightLocation, 1);
+		if (version != gModelList.version) {
+			gModelList.files = gAssetIndexer.Files();
+			gModelList.version = version;
 		}
-		const float clampedInner = std::clamp(gSpotInnerDeg, 1.0f, 89.0f);
-		const float clampedOuter = std::clamp(gSpotOuterDeg, clampedInner + 1.0f, 89.9f);
-		const float spotInnerCos = std::cos(glm::radians(clampedInner));
-		const float spotOuterCos = std::cos(glm::radians(clampedOuter));
-		if (gSpotCosInnerLocation >= 0) {
-			pglUniform1f(gSpotCosInnerLocation, spotInnerCos);
+		gModelList.filter = std::move(filter);
+		gModelList.matches.clear();
+		for (size_t i = 0; i < gModelList.files.size(); ++i) {
+			if (MatchesModelFilter(gModelList.files[i], gModelList.filter)) {
+				gModelList.matches.push_back(i);
+			}
 		}
-		if (gSpotCosOuterLocation >= 0) {
-			pglUniform1f(gSpotCosOuterLocation, spotOuterCos);
+	}
+
+	void AppendVarint(std::vector<std::uint8_t>& out, std::uint32_t value) {
+		while (value >= 0x80u) {
+			out.push_back(static_cast<std::uint8_t>(value | 0x80u));
+			value >>= 7;
 		}
-		if (gShadeModeLocation >= 0) {
-			pglUniform1i(gShadeModeLocation, 3);
+		out.push_back(static_cast<std::uint8_t>(value));
+	}
+
+	bool ReadVarint(const std::vector<std::uint8_t>& in, size_t& cursor, std::uint32_t& value) {
+		value = 0;
+		for (int shift = 0; shift < 35; shift += 7) {
+			if (cursor >= in.size()) {
+				return false;
+			}
+			const std::uint8_t byte = in[cursor++];
+			value |= static_cast<std::uint32_t>(byte & 0x7Fu) << shift;
+			if ((byte & 0x80u) == 0) {
+				return true;
+			}
 		}
-		if (gUseDiffuseMapLocation >= 0) {
-			pglUniform1i(gUseDiffuseMapLocation, useReflectionTexture ? 1 : 0);
+		return false;
+	}
+
+	constexpr size_t kVertexFloatCount = sizeof(Vertex) / sizeof(float);
+	static_assert(sizeof(Vertex) == kVertexFloatCount * sizeof(std::uint32_t), "Vertex must be tightly packed floats.");
+
+	CompressedMesh CompressMesh(const std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices) {
+		CompressedMesh compressed;
+		compressed.vertexCount = vertices.size();
+		compressed.indexCount = indices.size();
+		compressed.vertexStream.reserve(vertices.size() * sizeof(Vertex) / 2);
+		compressed.indexStream.reserve(indices.size() * 2);
+
+		std::array<std::uint32_t, kVertexFloatCount> previousBits{};
+		for (const Vertex& vertex : vertices) {
+			std::array<std::uint32_t, kVertexFloatCount> bits{};
+			std::memcpy(bits.data(), &vertex, sizeof(Vertex));
+			for (size_t i = 0; i < kVertexFloatCount; ++i) {
+				AppendVarint(compressed.vertexStream, bits[i] ^ previousBits[i]);
+			}
+			previousBits = bits;
 		}
-		if (gUseSpecularMapLocation >= 0) {
-			pglUniform1i(gUseSpecularMapLocation, 0);
+
+		std::uint32_t previousIndex = 0;
+		for (const unsigned int index : indices) {
+			const std::int32_t delta = static_cast<std::int32_t>(static_cast<std::uint32_t>(index) - previousIndex);
+			const std::uint32_t zigzag = (static_cast<std::uint32_t>(delta) << 1) ^ static_cast<std::uint32_t>(delta >> 31);
+			AppendVarint(compressed.indexStream, zigzag);
+			previousIndex = static_cast<std::uint32_t>(index);
 		}
-		if (gUseEnvMapLocation >= 0) {
-			pglUniform1i(gUseEnvMapLocation, gEnvironmentCubemap != 0 ? 1 : 0);
+
+		compressed.vertexStream.shrink_to_fit();
+		compressed.indexStream.shrink_to_fit();
+		return compressed;
+	}
+
+	bool DecompressMesh(const CompressedMesh& compressed, std::vector<Vertex>& vertices, std::vector<unsigned int>& indices) {
+		std::vector<Vertex> decodedVertices(compressed.vertexCount);
+		std::vector<unsigned int> decodedIndices(compressed.indexCount);
+
+		size_t cursor = 0;
+		std::array<std::uint32_t, kVertexFloatCount> bits{};
+		for (Vertex& vertex : decodedVertices) {
+			for (size_t i = 0; i < kVertexFloatCount; ++i) {
+				std::uint32_t value = 0;
+				if (!ReadVarint(compressed.vertexStream, cursor, value)) {
+					return false;
+				}
+				bits[i] ^= value;
+			}
+			std::memcpy(&vertex, bits.data(), sizeof(Vertex));
 		}
-		if (gAmbientLocation >= 0) {
-			pglUniform3fv(gAmbientLocation, 1, glm::value_ptr(gPlaneAmbientColor));
+
+		cursor = 0;
+		std::uint32_t previousIndex = 0;
+		for (unsigned int& index : decodedIndices) {
+			std::uint32_t zigzag = 0;
+			if (!ReadVarint(compressed.indexStream, cursor, zigzag)) {
+				return false;
+			}
+			const std::uint32_t delta = (zigzag >> 1) ^ (0u - (zigzag & 1u));
+			previousIndex += delta;
+			index = static_cast<unsigned int>(previousIndex);
 		}
-		if (gDiffuseLocation >= 0) {
-			pglUniform3fv(gDiffuseLocation, 1, glm::value_ptr(gPlaneDiffuseColor));
+
+		vertices = std::move(decodedVertices);
+		indices = std::move(decodedIndices);
+		return true;
+	}
+
+	bool ReadBackModelGeometry(const SceneModel& model, std::vector<Vertex>& vertices, std::vector<unsigned int>& indices) {
+		if (!pglGetBufferSubData || gGeometryArena.vbo == 0 || gGeometryArena.ebo == 0) {
+			return false;
 		}
-		if (gSpecularLocation >= 0) {
-			pglUniform3fv(gSpecularLocation, 1, glm::value_ptr(gPlaneSpecularColor));
+		std::vector<Vertex> readVertices(model.vertexCount);
+		std::vector<unsigned int> readIndices(model.indexCount);
+		while (glGetError() != GL_NO_ERROR) {
 		}
-		if (gShininessLocation >= 0) {
-			pglUniform1f(gShininessLocation, gPlaneShininess);
+		if (gUseVao) {
+			pglBindVertexArray(0);
 		}
-		if (gPlaneColorBiasLocation >= 0) {
-			pglUniform3fv(gPlaneColorBiasLocation, 1, glm::value_ptr(gPlaneColorBias));
+		pglBindBuffer(GL_ARRAY_BUFFER, gGeometryArena.vbo);
+		pglGetBufferSubData(
+			GL_ARRAY_BUFFER,
+			static_cast<std::ptrdiff_t>(model.vertexRange.offset * sizeof(Vertex)),
+			static_cast<std::ptrdiff_t>(readVertices.size() * sizeof(Vertex)),
+			readVertices.data());
+		pglBindBuffer(GL_ELEMENT_ARRAY_BUFFER, gGeometryArena.ebo);
+		pglGetBufferSubData(
+			GL_ELEMENT_ARRAY_BUFFER,
+			static_cast<std::ptrdiff_t>(model.indexRange.offset * sizeof(unsigned int)),
+			static_cast<std::ptrdiff_t>(readIndices.size() * sizeof(unsigned int)),
+			readIndices.data());
+		pglBindBuffer(GL_ARRAY_BUFFER, 0);
+		pglBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+		if (glGetError() != GL_NO_ERROR) {
+			return false;
 		}
-		if (gEnvReflectionStrengthLocation >= 0) {
-			pglUniform1f(gEnvReflectionStrengthLocation, 0.0f);
+		const unsigned int baseVertex = static_cast<unsigned int>(model.vertexRange.offset);
+		for (unsigned int& index : readIndices) {
+			index -= baseVertex;
 		}
-		if (gPlaneReflectionStrengthLocation >= 0) {
-			pglUniform1f(gPlaneReflectionStrengthLocation, gPlaneRttReflectionStrength);
+		vertices = std::move(readVertices);
+		indices = std::move(readIndices);
+		return true;
+	}
+
+	bool IsCpuMeshResident(const SceneModel& model) {
+		return model.vertices.size() == model.vertexCount &&
+			model.indices.size() == model.indexCount;
+	}
+
+	// Re-materializes a model's vertices/indices for CPU-side consumers (picking, re-export). Sources are
+	// tried cheapest first: the compressed copy, a read-back of its arena ranges, then a re-import from disk.
+	bool EnsureCpuMeshResident(SceneModel& model) {
+		if (IsCpuMeshResident(model)) {
+			return true;
 		}
-		if (gPlaneEnvStrengthLocation >= 0) {
-			pglUniform1f(gPlaneEnvStrengthLocation, gPlaneEnvReflectionStrength);
+		if (!model.compressedMesh.Empty() && DecompressMesh(model.compressedMesh, model.vertices, model.indices)) {
+			return true;
 		}
-		if (gPlaneReflectionBrightnessLocation >= 0) {
-			pglUniform1f(gPlaneReflectionBrightnessLocation, gPlaneRttReflectionBrightness);
+		if (ReadBackModelGeometry(model, model.vertices, model.indices)) {
+			return true;
 		}
 
-		if (pglActiveTexture) {
-			pglActiveTexture(GL_TEXTURE0);
-		}
-		glBindTexture(GL_TEXTURE_2D, useReflectionTexture ? gRenderTexture.colorTexture : 0);
-		if (pglActiveTexture) {
-			pglActiveTexture(GL_TEXTURE1);
+		// Geometry only: the model's materials and textures are already loaded.
+		ImportedMesh imported;
+		if (model.path.empty() || !ImportMesh(model.path, imported)) {
+			std::fprintf(stderr, "Failed to re-materialize CPU mesh copy for: %s\n", model.path.c_str());
+			return false;
 		}
-		glBindTexture(GL_TEXTURE_2D, 0);
-		if (pglActiveTexture) {
-			pglActiveTexture(GL_TEXTURE2);
+		model.vertices = std::move(imported.vertices);
+		model.indices = std::move(imported.indices);
+		return true;
+	}
+
+	void ReleaseCpuMeshCopy(SceneModel& model) {
+		std::vector<Vertex>().swap(model.vertices);
+		std::vector<unsigned int>().swap(model.indices);
+	}
+
+	size_t CpuMeshBytes() {
+		size_t bytes = 0;
+		for (const SceneModel& model : gSceneModels) {
+			bytes += model.vertices.capacity() * sizeof(Vertex) +
+				model.indices.capacity() * sizeof(unsigned int) +
+				model.compressedMesh.ByteSize();
 		}
-		glBindTexture(GL_TEXTURE_CUBE_MAP, gEnvironmentCubemap);
-		if (pglActiveTexture) {
-			pglActiveTexture(GL_TEXTURE3);
+		return bytes;
+	}
+
+	void ApplyMeshRetentionPolicy(SceneModel& model) {
+		const MeshRetentionPolicy policy = static_cast<MeshRetentionPolicy>(
+			std::clamp(gMeshRetentionPolicy, 0, static_cast<int>(MeshRetentionPolicy::KeepCompressed)));
+		switch (policy) {
+		case MeshRetentionPolicy::Drop:
+			ReleaseCpuMeshCopy(model);
+			model.compressedMesh = CompressedMesh{};
+			break;
+		case MeshRetentionPolicy::KeepCompressed:
+			if (model.compressedMesh.Empty() && EnsureCpuMeshResident(model)) {
+				const size_t rawBytes = model.vertices.size() * sizeof(Vertex) + model.indices.size() * sizeof(unsigned int);
+				model.compressedMesh = CompressMesh(model.vertices, model.indices);
+				std::printf("CPU mesh copy compressed: %.2f MB -> %.2f MB.\n",
+					static_cast<double>(rawBytes) / (1024.0 * 1024.0),
+					static_cast<double>(model.compressedMesh.ByteSize()) / (1024.0 * 1024.0));
+			}
+			ReleaseCpuMeshCopy(model);
+			break;
+		case MeshRetentionPolicy::Keep:
+		default:
+			EnsureCpuMeshResident(model);
+			model.compressedMesh = CompressedMesh{};
+			break;
 		}
-		glBindTexture(GL_TEXTURE_2D, gShadowMap.depthTexture);
+	}
 
-		BindPlaneBuffers();
-		glDrawElements(GL_TRIANGLES, gPlaneIndexCount, GL_UNSIGNED_INT, nullptr);
+	void ApplyMeshRetentionPolicy() {
+		for (SceneModel& model : gSceneModels) {
+			ApplyMeshRetentionPolicy(model);
+		}
+	}
 
-		if (gUseVao && gPlaneVao != 0) {
-			pglBindVertexArray(0);
+	// Software rendering of the same scene. Textures come from gSoftwareTextures; with a GL context they are
+	// read back on first use and dropped again after each capture, so the GL objects stay authoritative.
+	const software::Texture* ResolveSoftwareTexture(GLuint texture) {
+		if (texture == 0) {
+			return nullptr;
 		}
-		if (pglActiveTexture) {
-			pglActiveTexture(GL_TEXTURE3);
+		auto it = gSoftwareTextures.find(texture);
+		if (it == gSoftwareTextures.end()) {
+			if (gSoftwareOnly) {
+				return nullptr;
+			}
+			software::Texture image;
+			GLint width = 0;
+			GLint height = 0;
+			GLint internalFormat = 0;
+			// Progressive textures may not have level 0 resident; read the finest level they do have.
+			GLint baseLevel = 0;
+			glBindTexture(GL_TEXTURE_2D, texture);
+			glGetTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, &baseLevel);
+			glGetTexLevelParameteriv(GL_TEXTURE_2D, baseLevel, GL_TEXTURE_WIDTH, &width);
+			glGetTexLevelParameteriv(GL_TEXTURE_2D, baseLevel, GL_TEXTURE_HEIGHT, &height);
+			glGetTexLevelParameteriv(GL_TEXTURE_2D, baseLevel, GL_TEXTURE_INTERNAL_FORMAT, &internalFormat);
+			if (width > 0 && height > 0) {
+				image.width = width;
+				image.height = height;
+				image.rgba.resize(static_cast<size_t>(width) * static_cast<size_t>(height) * 4u);
+				glPixelStorei(GL_PACK_ALIGNMENT, 1);
+				glGetTexImage(GL_TEXTURE_2D, baseLevel, GL_RGBA, GL_UNSIGNED_BYTE, image.rgba.data());
+				// Luminance reads back as (L, 0, 0); the shader sees (L, L, L).
+				if (internalFormat == GL_LUMINANCE || internalFormat == GL_LUMINANCE_ALPHA) {
+					for (size_t i = 0; i < image.rgba.size(); i += 4) {
+						image.rgba[i + 1] = image.rgba[i];
+						image.rgba[i + 2] = image.rgba[i];
+					}
+				}
+			}
+			glBindTexture(GL_TEXTURE_2D, 0);
+			it = gSoftwareTextures.emplace(texture, std::move(image)).first;
 		}
-		glBindTexture(GL_TEXTURE_2D, 0);
-		if (pglActiveTexture) {
-			pglActiveTexture(GL_TEXTURE2);
+		return it->second.Empty() ? nullptr : &it->second;
+	}
+
+	const software::CubeTexture* ResolveSoftwareEnvironment() {
+		if (gEnvironmentCubemap == 0) {
+			return nullptr;
+		}
+		if (gSoftwareEnvironment.Empty() && !gSoftwareOnly) {
+			glBindTexture(GL_TEXTURE_CUBE_MAP, gEnvironmentCubemap);
+			glPixelStorei(GL_PACK_ALIGNMENT, 1);
+			for (size_t i = 0; i < kCubemapFaceTargets.size(); ++i) {
+				software::Texture& face = gSoftwareEnvironment.faces[i];
+				GLint width = 0;
+				GLint height = 0;
+				glGetTexLevelParameteriv(kCubemapFaceTargets[i], 0, GL_TEXTURE_WIDTH, &width);
+				glGetTexLevelParameteriv(kCubemapFaceTargets[i], 0, GL_TEXTURE_HEIGHT, &height);
+				if (width <= 0 || height <= 0) {
+					continue;
+				}
+				face.width = width;
+				face.height = height;
+				face.rgba.resize(static_cast<size_t>(width) * static_cast<size_t>(height) * 4u);
+				glGetTexImage(kCubemapFaceTargets[i], 0, GL_RGBA, GL_UNSIGNED_BYTE, face.rgba.data());
+			}
+			glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
 		}
-		glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
-		if (pglActiveTexture) {
-			pglActiveTexture(GL_TEXTURE1);
+		return gSoftwareEnvironment.Empty() ? nullptr : &gSoftwareEnvironment;
+	}
+
+	void DropSoftwareReadbacks() {
+		if (gSoftwareOnly) {
+			return;
 		}
-		glBindTexture(GL_TEXTURE_2D, 0);
-		if (pglActiveTexture) {
-			pglActiveTexture(GL_TEXTURE0);
+		gSoftwareTextures.clear();
+		gSoftwareEnvironment = software::CubeTexture{};
+	}
+
+	software::ShaderUniforms BuildSoftwareUniforms(const glm::mat4& model, const glm::mat4& view, const glm::mat4& projection) {
+		software::ShaderUniforms uniforms;
+		uniforms.mvp = projection * view * model;
+		uniforms.model = model;
+		uniforms.view = view;
+		uniforms.normalMatrix = glm::transpose(glm::inverse(glm::mat3(view * model)));
+		uniforms.worldNormalMatrix = glm::transpose(glm::inverse(glm::mat3(model)));
+		uniforms.invViewRotation = glm::transpose(glm::mat3(view));
+		return uniforms;
+	}
+
+	void ApplySoftwareLight(software::ShaderUniforms& uniforms, const glm::mat4& lightView, const software::DepthTarget* shadowMap) {
+		uniforms.lightPosView = glm::vec3(lightView * glm::vec4(gLightWorldPosition, 1.0f));
+		uniforms.lightDirView = glm::normalize(glm::mat3(lightView) * gLightWorldDirection);
+		uniforms.lightColor = gLightColor * gLightIntensity;
+		uniforms.lightViewProj = gLightViewProjection;
+		uniforms.shadowMap = shadowMap;
+		uniforms.shadowBias = gShadowBias;
+		uniforms.useSpotLight = true;
+		const float clampedInner = std::clamp(gSpotInnerDeg, 1.0f, 89.0f);
+		const float clampedOuter = std::clamp(gSpotOuterDeg, clampedInner + 1.0f, 89.9f);
+		uniforms.spotCosInner = std::cos(glm::radians(clampedInner));
+		uniforms.spotCosOuter = std::cos(glm::radians(clampedOuter));
+	}
+
+	software::DrawCall MakeSoftwareDraw(const CpuMesh& mesh, const software::ShaderUniforms& uniforms) {
+		software::DrawCall draw;
+		draw.vertices = mesh.vertices.data();
+		draw.vertexCount = mesh.vertices.size();
+		draw.indices = mesh.indices.data();
+		draw.indexCount = mesh.indices.size();
+		draw.uniforms = uniforms;
+		return draw;
+	}
+
+	// Emits one draw per visible instance of every draw record, in the order DrawModelGeometry() uses.
+	// configure(draw, materialIndex) fills in the per-material state.
+	template <typename ConfigureFn>
+	void AppendSoftwareModelDraws(std::vector<software::DrawCall>& draws, const glm::mat4& clipFromScene, const software::ShaderUniforms& base, ConfigureFn&& configure) {
+		const PassInstanceRuns pass = BuildVisibleInstanceRuns(clipFromScene);
+		for (const DrawRecord& record : gDrawRecords) {
+			const SceneModel& sceneModel = gSceneModels[static_cast<size_t>(record.modelIndex)];
+			if (!IsCpuMeshResident(sceneModel)) {
+				continue;
+			}
+			const ArenaRange& span = pass.modelRunSpans[static_cast<size_t>(record.modelIndex)];
+			// Table records are split back into their submeshes, each with its own material.
+			const DrawRecord* parts = record.UsesTable() ? &gDrawRecordParts[record.parts.offset] : &record;
+			const size_t partCount = record.UsesTable() ? record.parts.count : 1u;
+			for (size_t r = span.offset; r < span.offset + span.count; ++r) {
+				const InstanceRun& run = pass.runs[r];
+				for (size_t p = 0; p < partCount; ++p) {
+					const DrawRecord& part = parts[p];
+					software::DrawCall draw;
+					draw.vertices = sceneModel.vertices.data();
+					draw.vertexCount = sceneModel.vertices.size();
+					draw.indices = sceneModel.indices.data() + (static_cast<size_t>(part.indexOffset) - sceneModel.indexRange.offset);
+					draw.indexCount = static_cast<size_t>(part.indexCount);
+					draw.uniforms = base;
+					configure(draw, ResolveMaterialIndex(part.materialIndex, run.materialOverride));
+					for (int i = run.first; i < run.first + run.count; ++i) {
+						draw.instanceModel = gInstanceAttributes[static_cast<size_t>(i)].model;
+						draw.instanceNormal = gInstanceAttributes[static_cast<size_t>(i)].normal;
+						draws.push_back(draw);
+					}
+				}
+			}
 		}
-		glBindTexture(GL_TEXTURE_2D, 0);
-		pglUseProgram(0);
 	}
 
-	void UpdateWindowTitle() {
-		if (!gWindow) {
+	// Software counterpart of RenderObjectToCurrentTarget().
+	void AppendSoftwareObjectDraws(
+		std::vector<software::DrawCall>& draws,
+		const glm::mat4& model,
+		const glm::mat4& view,
+		const glm::mat4& projection,
+		bool drawLightMarker,
+		bool forceBlinn,
+		bool enableEnvReflection,
+		float envReflectionStrength,
+		const glm::mat4* lightViewOverride,
+		const software::DepthTarget* shadowMap) {
+		software::ShaderUniforms base = BuildSoftwareUniforms(model, view, projection);
+		if (glm::determinant(glm::mat3(view * model)) < 0.0f) {
+			base.normalMatrix = -base.normalMatrix;
+			base.worldNormalMatrix = -base.worldNormalMatrix;
+		}
+		base.envMap = enableEnvReflection ? ResolveSoftwareEnvironment() : nullptr;
+		base.envReflectionStrength = enableEnvReflection ? envReflectionStrength : 0.0f;
+		ApplySoftwareLight(base, (lightViewOverride != nullptr) ? *lightViewOverride : view, shadowMap);
+		base.shadeMode = (!forceBlinn && gShowNormals) ? software::ShadeMode::Normals : software::ShadeMode::BlinnPhong;
+
+		const Material fallbackMaterial;
+		AppendSoftwareModelDraws(draws, base.mvp, base, [&](software::DrawCall& draw, int materialIndex) {
+			const Material& material = gMaterials.empty() ? fallbackMaterial : gMaterials[static_cast<size_t>(materialIndex)];
+			draw.uniforms.ambient = material.ambient;
+			draw.uniforms.diffuse = material.diffuse;
+			draw.uniforms.specular = material.specular;
+			draw.uniforms.shininess = material.shininess;
+			draw.uniforms.diffuseMap = material.hasDiffuseTexture ? ResolveSoftwareTexture(material.diffuseTexture) : nullptr;
+			draw.uniforms.specularMap = material.hasSpecularTexture ? ResolveSoftwareTexture(material.specularTexture) : nullptr;
+			});
+
+		if (!drawLightMarker || !gShowLightMarker) {
 			return;
 		}
-		const char* mode = gUsePerspective ? "Perspective" : "Orthographic";
-		const char* shade = gShowNormals ? "Normals" : "Blinn+Env";
-		char title[160];
-		std::snprintf(title, sizeof(title), "%s | %s | %s", gpurenderer::config::kWindowTitleBase, mode, shade);
-		glfwSetWindowTitle(gWindow, title);
-	}
-
-	void Display() {
-		if (gProgram == 0 || gVbo == 0 || gEbo == 0) {
+		const LightMarkerShape selectedShape = static_cast<LightMarkerShape>(
+			std::clamp(gLightMarkerShape, 0, static_cast<int>(LightMarkerShape::LightObject)));
+		const CpuMesh* selectedMesh = nullptr;
+		switch (selectedShape) {
+		case LightMarkerShape::Cube:
+			selectedMesh = &gLightCubeCpuMesh;
+			break;
+		case LightMarkerShape::Sphere:
+			selectedMesh = &gLightSphereCpuMesh;
+			break;
+		case LightMarkerShape::LightObject:
+			selectedMesh = gHasLightObjectMesh ? &gLightObjectCpuMesh : &gLightSphereCpuMesh;
+			break;
+		case LightMarkerShape::Point:
+		default:
+			selectedMesh = nullptr;
+			break;
+		}
+		if (selectedMesh != nullptr && selectedMesh->indices.empty()) {
+			selectedMesh = nullptr;
+		}
+
+		glm::mat4 modelLight = glm::translate(glm::mat4(1.0f), gLightWorldPosition);
+		if (selectedShape == LightMarkerShape::LightObject) {
+			modelLight = modelLight * BuildOrientationFromForward(gLightWorldDirection);
+		}
+		if (selectedMesh != nullptr) {
+			const float markerScale = std::max(
+				kLightMarkerMeshScaleMin,
+				gBounds.MaxExtent() * kLightMarkerMeshScaleRatio * gLightMarkerScale);
+			modelLight = modelLight * glm::scale(glm::mat4(1.0f), glm::vec3(markerScale));
+		}
+		software::ShaderUniforms marker = base;
+		marker.mvp = projection * view * modelLight;
+		marker.model = modelLight;
+		marker.shadeMode = software::ShadeMode::Marker;
+		marker.markerColor = gLightMarkerColor;
+		if (selectedMesh != nullptr) {
+			draws.push_back(MakeSoftwareDraw(*selectedMesh, marker));
 			return;
 		}
+		static const Vertex kLightPoint{glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f), glm::vec2(0.0f)};
+		software::DrawCall point;
+		point.primitive = software::PrimitiveType::Points;
+		point.vertices = &kLightPoint;
+		point.vertexCount = 1;
+		point.pointSize = kLightMarkerPointSize * std::max(0.1f, gLightMarkerScale);
+		point.uniforms = marker;
+		draws.push_back(point);
+	}
 
+	// Renders Display()'s passes (shadow map, planar reflection, skybox, plane, objects, light marker) with
+	// the software rasterizer. Model geometry must be CPU-resident.
+	software::RasterStats RenderSoftwareFrame(int width, int height, software::ColorTarget& target) {
 		const glm::mat4 model = BuildObjectModelMatrix(gObjectCamera);
 		const glm::mat4 view = BuildViewMatrix(gObjectCamera);
-		const glm::mat4 projection = BuildProjectionMatrix(gWindowWidth, gWindowHeight, gNearPlane, gFarPlane);
+		const glm::mat4 projection = BuildProjectionMatrix(width, height, gNearPlane, gFarPlane);
 		const glm::mat4 reflectionView = view * BuildPlanarReflectionMatrix(gPlaneHeight);
 		const glm::mat4 reflectionViewProj = projection * reflectionView;
+		auto lapStart = std::chrono::steady_clock::now();
+		PrepareSceneDrawData();
 		UpdateLightShadowState(model);
-		if (CreateOrResizeShadowMap(kShadowMapResolution, kShadowMapResolution)) {
-			RenderShadowDepthPass(model);
-		}
 
-		if (gRenderToPlane && gPlaneVbo != 0 && gPlaneEbo != 0) {
-			if (CreateOrResizeRenderTexture(gWindowWidth, gWindowHeight)) {
-				pglBindFramebuffer(GL_FRAMEBUFFER, gRenderTexture.framebuffer);
-				glViewport(0, 0, gRenderTexture.width, gRenderTexture.height);
-				glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
-				glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-				RenderObjectToCurrentTarget(
-					model,
-					reflectionView,
-					projection,
-					false,
-					true,
-					true,
-					kObjectEnvReflectionStrength,
-					&view);
-				pglBindFramebuffer(GL_FRAMEBUFFER, 0);
-				GenerateRenderTextureMipmaps();
-			}
-		}
+		std::vector<software::DrawCall> draws;
+		software::DepthTarget shadowMap;
+		const bool hasShadowMap = gSoftwareOnly || gShadowMap.depthTexture != 0;
+		if (hasShadowMap) {
+			shadowMap.Resize(kShadowMapResolution, kShadowMapResolution);
+			software::ShaderUniforms depthUniforms;
+			depthUniforms.mvp = gLightViewProjection * model;
+			AppendSoftwareModelDraws(draws, depthUniforms.mvp, depthUniforms, [](software::DrawCall&, int) {});
+			software::DrawDepth(shadowMap, draws, 2.0f, 4.0f);
+		}
+		const software::DepthTarget* shadowTexture = hasShadowMap ? &shadowMap : nullptr;
+		LapPassTimer(&gpurenderer::PassTimings::shadowMs, lapStart);
+
+		software::Texture reflectionTexture;
+		if (gRenderToPlane && !gPlaneCpuMesh.indices.empty()) {
+			software::ColorTarget reflection;
+			reflection.Resize(width, height);
+			reflection.Clear(glm::vec3(0.0f));
+			draws.clear();
+			AppendSoftwareObjectDraws(draws, model, reflectionView, projection, false, true, true, kObjectEnvReflectionStrength, &view, shadowTexture);
+			software::DrawColor(reflection, draws);
+			reflectionTexture = reflection.ToTexture();
+		}
+		LapPassTimer(&gpurenderer::PassTimings::reflectionMs, lapStart);
+
+		target.Resize(width, height);
+		target.Clear(gSceneBackgroundColor);
+		draws.clear();
+
+		const software::CubeTexture* environment = ResolveSoftwareEnvironment();
+		if (environment != nullptr && !gBackgroundCpuMesh.indices.empty()) {
+			const glm::mat4 skyboxView = glm::mat4(glm::mat3(view));
+			software::ShaderUniforms skybox = BuildSoftwareUniforms(glm::scale(glm::mat4(1.0f), glm::vec3(kSkyboxDepth)), skyboxView, projection);
+			skybox.invViewRotation = glm::transpose(glm::mat3(view));
+			skybox.shadeMode = software::ShadeMode::Skybox;
+			skybox.envMap = environment;
+			software::DrawCall draw = MakeSoftwareDraw(gBackgroundCpuMesh, skybox);
+			draw.depthWrite = false;
+			draw.depthLessEqual = true;
+			draws.push_back(draw);
+		}
+
+		if (!gPlaneCpuMesh.indices.empty()) {
+			software::ShaderUniforms plane = BuildSoftwareUniforms(BuildPlaneModelMatrix(), view, projection);
+			plane.reflectionViewProj = reflectionViewProj;
+			ApplySoftwareLight(plane, view, shadowTexture);
+			plane.shadeMode = software::ShadeMode::Plane;
+			plane.diffuseMap = (gRenderToPlane && !reflectionTexture.Empty()) ? &reflectionTexture : nullptr;
+			plane.envMap = environment;
+			plane.ambient = gPlaneAmbientColor;
+			plane.diffuse = gPlaneDiffuseColor;
+			plane.specular = gPlaneSpecularColor;
+			plane.shininess = gPlaneShininess;
+			plane.planeColorBias = gPlaneColorBias;
+			plane.planeReflectionStrength = gPlaneRttReflectionStrength;
+			plane.planeEnvStrength = gPlaneEnvReflectionStrength;
+			plane.planeReflectionBrightness = gPlaneRttReflectionBrightness;
+			draws.push_back(MakeSoftwareDraw(gPlaneCpuMesh, plane));
+		}
+
+		AppendSoftwareObjectDraws(draws, model, view, projection, true, false, true, kObjectEnvReflectionStrength, nullptr, shadowTexture);
+		const software::RasterStats stats = software::DrawColor(target, draws);
+		LapPassTimer(&gpurenderer::PassTimings::mainMs, lapStart);
+		return stats;
+	}
 
+	bool ReadGlFrame(software::ColorTarget& image) {
+		image.Resize(gWindowWidth, gWindowHeight);
+		std::vector<unsigned char> pixels(static_cast<size_t>(image.width) * static_cast<size_t>(image.height) * 3u);
 		pglBindFramebuffer(GL_FRAMEBUFFER, 0);
-		glViewport(0, 0, gWindowWidth, gWindowHeight);
-		glClearColor(gSceneBackgroundColor.x, gSceneBackgroundColor.y, gSceneBackgroundColor.z, 1.0f);
-		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-
-		RenderBackgroundToCurrentTarget(view, projection);
-		if (gPlaneVbo != 0 && gPlaneEbo != 0) {
-			RenderPlaneToCurrentTarget(view, projection, reflectionViewProj);
+		glPixelStorei(GL_PACK_ALIGNMENT, 1);
+		glReadPixels(0, 0, image.width, image.height, GL_RGB, GL_UNSIGNED_BYTE, pixels.data());
+		if (glGetError() != GL_NO_ERROR) {
+			return false;
 		}
-		RenderObjectToCurrentTarget(
-			model,
-			view,
-			projection,
-			true,
-			false,
-			true,
-			kObjectEnvReflectionStrength,
-			nullptr);
+		for (size_t i = 0; i < image.color.size(); ++i) {
+			image.color[i] = glm::vec3(pixels[i * 3u + 0], pixels[i * 3u + 1], pixels[i * 3u + 2]) * (1.0f / 255.0f);
+		}
+		return true;
 	}
 
-	void Reshape(GLFWwindow*, int width, int height) {
-		gWindowWidth = width > 0 ? width : 1;
-		gWindowHeight = height > 0 ? height : 1;
-		glViewport(0, 0, gWindowWidth, gWindowHeight);
-		CreateOrResizeRenderTexture(gWindowWidth, gWindowHeight);
-		CreateOrResizeShadowMap(kShadowMapResolution, kShadowMapResolution);
-	}
+	// Renders the current view on the CPU and compares it with the frame Display() just drew.
+	void CaptureSoftwareReference() {
+		// Readbacks of textures still streaming would see their unfilled level 0.
+		FlushTextureUploads();
+		while (glGetError() != GL_NO_ERROR) {
+		}
+		software::ColorTarget gpuImage;
+		if (!ReadGlFrame(gpuImage)) {
+			gSoftwareReferenceStatus = "Software reference failed: could not read back the GL frame.";
+			return;
+		}
 
-	bool IsCtrlDown(GLFWwindow* window) {
-		return glfwGetKey(window, GLFW_KEY_LEFT_CONTROL) == GLFW_PRESS ||
-			glfwGetKey(window, GLFW_KEY_RIGHT_CONTROL) == GLFW_PRESS;
+		std::vector<size_t> rematerialized;
+		for (size_t m = 0; m < gSceneModels.size(); ++m) {
+			if (!IsCpuMeshResident(gSceneModels[m]) && EnsureCpuMeshResident(gSceneModels[m])) {
+				rematerialized.push_back(m);
+			}
+		}
+		software::ColorTarget softwareImage;
+		const software::RasterStats stats = RenderSoftwareFrame(gWindowWidth, gWindowHeight, softwareImage);
+		for (const size_t m : rematerialized) {
+			ApplyMeshRetentionPolicy(gSceneModels[m]);
+		}
+		DropSoftwareReadbacks();
+
+		software::WritePpm(gpuImage, kGpuCaptureFile);
+		software::WritePpm(softwareImage, kSoftwareReferenceFile);
+		const software::ImageComparison comparison = software::CompareImages(gpuImage, softwareImage, kSoftwareComparePixelThreshold);
+		char status[256];
+		std::snprintf(
+			status,
+			sizeof(status),
+			"Software reference: %.1f ms, %zu triangles. RMSE %.2f, max error %.0f, %zu pixels off by > %.0f. Wrote %s and %s.",
+			stats.milliseconds,
+			stats.trianglesRasterized,
+			comparison.rmse,
+			comparison.maxError,
+			comparison.differingPixels,
+			kSoftwareComparePixelThreshold,
+			kGpuCaptureFile,
+			kSoftwareReferenceFile);
+		gSoftwareReferenceStatus = status;
+		std::printf("%s\n", status);
 	}
 
-	bool IsGuiCapturingMouse() {
-		return gGuiInitialized && ImGui::GetCurrentContext() != nullptr && ImGui::GetIO().WantCaptureMouse;
+	// Builds the materials of a model imported by ImportMesh and moves its geometry into model.
+	void FinishSceneModel(ImportedMesh& imported, SceneModel& model, std::vector<Material>& materials) {
+		model = SceneModel{};
+		LoadMeshMaterials(imported, materials);
+		model.path = imported.path;
+		model.vertices = std::move(imported.vertices);
+		model.indices = std::move(imported.indices);
+		model.bounds = imported.bounds;
+		model.submeshes = std::move(imported.submeshes);
+		model.vertexCount = model.vertices.size();
+		model.indexCount = model.indices.size();
+		gLastLoadTimings = imported.timings;
 	}
 
-	bool IsGuiCapturingKeyboard() {
-		return gGuiInitialized && ImGui::GetCurrentContext() != nullptr && ImGui::GetIO().WantCaptureKeyboard;
+	// Called as a user-requested load starts: fresh listings, so files added since the previous load
+	// are found.
+	void RefreshPathCacheForLoad() {
+		gPathCache.Clear();
 	}
 
-	void MouseButton(GLFWwindow* window, int button, int action, int mods) {
-		if (gGuiInitialized) {
-			ImGui_ImplGlfw_MouseButtonCallback(window, button, action, mods);
+	bool LoadSceneModel(const std::string& path, SceneModel& model, std::vector<Material>& materials) {
+		model = SceneModel{};
+		materials.clear();
+		RefreshPathCacheForLoad();
+		ImportedMesh imported;
+		if (!ImportMesh(path, imported)) {
+			return false;
 		}
-		const bool captured = IsGuiCapturingMouse();
-		const bool pressed = (action == GLFW_PRESS);
+		FinishSceneModel(imported, model, materials);
+		return true;
+	}
 
-		if (button == GLFW_MOUSE_BUTTON_LEFT) {
-			gLeftDown = !captured && pressed;
-		} else if (button == GLFW_MOUSE_BUTTON_RIGHT) {
-			gRightDown = !captured && pressed;
-		} else if (button == GLFW_MOUSE_BUTTON_MIDDLE) {
-			gMiddleDown = !captured && pressed;
+	// Writes each vertex's model-local material index into the arena's material stream, which table
+	// draws read. Models with more materials than the table holds, or with a vertex shared by
+	// submeshes of different materials, keep drawing one material at a time.
+	bool BuildMaterialSlots(const SceneModel& model, std::vector<float>& slots) {
+		if (model.materialCount > kMaterialTableSize || model.indices.empty()) {
+			return false;
 		}
-		glfwGetCursorPos(window, &gLastMouseX, &gLastMouseY);
-		if (captured) {
+		slots.assign(model.vertexCount, -1.0f);
+		for (const Submesh& submesh : model.submeshes) {
+			const float slot = static_cast<float>(LocalMaterialIndex(model, submesh));
+			for (int i = submesh.indexOffset; i < submesh.indexOffset + submesh.indexCount; ++i) {
+				float& vertexSlot = slots[model.indices[static_cast<size_t>(i)]];
+				if (vertexSlot >= 0.0f && vertexSlot != slot) {
+					return false;
+				}
+				vertexSlot = slot;
+			}
+		}
+		return true;
+	}
+
+	void UploadMaterialSlots(SceneModel& model) {
+		model.materialSlots = false;
+		std::vector<float> slots;
+		if (gGeometryArena.materialVbo == 0 || !BuildMaterialSlots(model, slots)) {
 			return;
 		}
+		pglBindBuffer(GL_ARRAY_BUFFER, gGeometryArena.materialVbo);
+		pglBufferSubData(
+			GL_ARRAY_BUFFER,
+			static_cast<std::ptrdiff_t>(model.vertexRange.offset * sizeof(float)),
+			static_cast<std::ptrdiff_t>(slots.size() * sizeof(float)),
+			slots.data());
+		pglBindBuffer(GL_ARRAY_BUFFER, 0);
+		model.materialSlots = true;
 	}
 
-	void MouseMotion(GLFWwindow* window, double x, double y) {
-		if (gGuiInitialized) {
-			ImGui_ImplGlfw_CursorPosCallback(window, x, y);
+	// Appends a model whose geometry is already in its arena ranges, and its materials.
+	void RegisterSceneModel(SceneModel&& model, std::vector<Material>&& materials) {
+		model.materialBase = static_cast<int>(gMaterials.size());
+		model.materialCount = static_cast<int>(materials.size());
+		for (const Material& material : materials) {
+			RetainMaterialTextures(material);
+		}
+		gMaterials.insert(gMaterials.end(), std::make_move_iterator(materials.begin()), std::make_move_iterator(materials.end()));
+		gSceneModels.push_back(std::move(model));
+		// Textures released by a preceding ClearScene/RemoveSceneModel can go now that these are held.
+		EvictTextures();
+		if (!gSoftwareOnly) {
+			// Without GL the CPU copy is the only copy, so the retention policy does not apply.
+			ApplyMeshRetentionPolicy(gSceneModels.back());
+		}
+		gDrawRecordsDirty = true;
+		gMaterialBatching.dirty = true;
+	}
+
+	// Puts a loaded model's geometry and material slots into their own arena ranges. The scene is left
+	// alone until RegisterSceneModel, so a failure here costs the caller nothing it already had.
+	bool UploadSceneModel(SceneModel& model, size_t materialCount) {
+		if (!AllocateArenaRanges(gGeometryArena, model.vertexCount, model.indexCount, model.vertexRange, model.indexRange)) {
+			std::fprintf(stderr, "Failed to allocate geometry arena space for: %s\n", model.path.c_str());
+			return false;
 		}
-		if (IsGuiCapturingMouse()) {
-			gLastMouseX = x;
-			gLastMouseY = y;
+		const auto uploadStart = std::chrono::steady_clock::now();
+		UploadArenaGeometry(model.vertices, model.indices, model.vertexRange, model.indexRange);
+		model.materialCount = static_cast<int>(materialCount);
+		UploadMaterialSlots(model);
+		gLastLoadTimings.geometryUploadMs = ElapsedMilliseconds(uploadStart);
+		return true;
+	}
+
+	// Uploads a loaded model into the shared arena and appends its materials to the shared pool.
+	// Textures are shared through gTextureCache, so a repeated file costs no extra texture memory; the
+	// model's materials hold references that keep them resident.
+	bool AddSceneModel(SceneModel&& model, std::vector<Material>&& materials) {
+		if (!UploadSceneModel(model, materials.size())) {
+			return false;
+		}
+		RegisterSceneModel(std::move(model), std::move(materials));
+		return true;
+	}
+
+	void RemoveSceneModel(size_t index) {
+		if (index >= gSceneModels.size()) {
 			return;
 		}
+		const SceneModel& model = gSceneModels[index];
+		gGeometryArena.vertices.Free(model.vertexRange);
+		gGeometryArena.indices.Free(model.indexRange);
+		const auto materialBegin = gMaterials.begin() + model.materialBase;
+		for (auto it = materialBegin; it != materialBegin + model.materialCount; ++it) {
+			ReleaseMaterialTextures(*it);
+		}
+		gMaterials.erase(materialBegin, materialBegin + model.materialCount);
+		for (SceneModel& other : gSceneModels) {
+			if (other.materialBase > model.materialBase) {
+				other.materialBase -= model.materialCount;
+			}
+		}
+		gSceneModels.erase(gSceneModels.begin() + static_cast<std::ptrdiff_t>(index));
+		gDrawRecordsDirty = true;
+		gMaterialBatching.dirty = true;
+		EvictTextures();
+	}
 
-		const float dx = static_cast<float>(x - gLastMouseX);
-		const float dy = static_cast<float>(y - gLastMouseY);
-		OrbitCamera& targetCamera = gObjectCamera;
-		const float viewHeight = gUsePerspective
-			? (2.0f * targetCamera.distance * std::tan(0.5f * DegreesToRadians(kDefaultFovDeg)))
-			: 2.0f;
-		const float panScale = (gWindowHeight > 0) ? (viewHeight / static_cast<float>(gWindowHeight)) : 0.0f;
+	void ClearScene() {
+		for (const SceneModel& model : gSceneModels) {
+			gGeometryArena.vertices.Free(model.vertexRange);
+			gGeometryArena.indices.Free(model.indexRange);
+		}
+		gSceneModels.clear();
+		// Released but not evicted: the caller is usually about to add a model that may reuse them.
+		for (const Material& material : gMaterials) {
+			ReleaseMaterialTextures(material);
+		}
+		gMaterials.clear();
+		gDrawRecords.clear();
+		gDrawRecordParts.clear();
+		gDrawRecordsDirty = true;
+		gMaterialBatching.dirty = true;
+		gSelectedModelIndex = 0;
+		gSelectedInstanceIndex = 0;
+		gSelectedMaterialIndex = 0;
+	}
 
-		if (gLeftDown) {
-			if (IsCtrlDown(window)) {
-				gLightYawDeg += dx * kLightRotationSpeedDegPerPixel;
-				gLightPitchDeg += dy * kLightRotationSpeedDegPerPixel;
-				gLightPitchDeg = std::clamp(gLightPitchDeg, -89.0f, 89.0f);
-			} else {
-				targetCamera.yawDeg += dx * kRotationSpeedDegPerPixel;
-				targetCamera.pitchDeg += dy * kRotationSpeedDegPerPixel;
-				targetCamera.pitchDeg = std::clamp(targetCamera.pitchDeg, -89.0f, 89.0f);
+	void UpdateSceneBounds() {
+		gBounds = Bounds{};
+		for (const SceneModel& model : gSceneModels) {
+			const Bounds modelBounds = TransformBounds(model.bounds, BuildSceneModelMatrix(model));
+			if (modelBounds.valid) {
+				gBounds.Expand(modelBounds.min);
+				gBounds.Expand(modelBounds.max);
 			}
 		}
-		if (gRightDown) {
-			targetCamera.distance += dy * kZoomSpeed;
-			targetCamera.distance = std::max(targetCamera.distance, kMinCameraDistance);
+	}
+
+	void FrameSceneBounds() {
+		gCenter = gBounds.Center();
+		const float extent = std::max(gBounds.MaxExtent(), 1.0f);
+		gObjectCamera.distance = extent * 2.5f;
+		gObjectCamera.panX = 0.0f;
+		gObjectCamera.panY = 0.0f;
+		gPlaneHeight = (gBounds.min.y - gCenter.y) - (extent * kPlanePaddingRatio);
+		gPlaneWidth = 2.0f * extent * kPlaneSizeMultiplier;
+		gPlaneLength = 2.0f * extent * kPlaneSizeMultiplier;
+		gPlaneScale = 1.0f;
+		gObjectScale = glm::vec3(1.0f);
+		gLightMarkerScale = 1.0f;
+		gLightDistance = extent * 1.8f;
+		gNearPlane = std::max(0.1f, extent * 0.001f);
+		gFarPlane = std::max(kFarPlane, gObjectCamera.distance + extent * 3.0f);
+	}
+
+	// A texture named by the materials of an async model load, once per cache key.
+	struct PendingTexture {
+		std::string key;
+		std::filesystem::path file;
+		// Embedded texture index, or -1 for a file.
+		int embeddedIndex = -1;
+		// Set while the load holds a reference on the cached texture, until its materials retain it.
+		bool pinned = false;
+		// Set by the I/O stage: the file's bytes, the block format when the texture is compressed, and
+		// the blocks when the disk cache had them.
+		std::vector<unsigned char> fileBytes;
+		bool compress = false;
+		compression::BlockFormat format = compression::BlockFormat::BC1;
+		std::uint64_t compressedKey = 0;
+		compression::CompressedImage compressed;
+		bool fromDisk = false;
+		// Set by the decode stage: the pixels to upload, which may be Assimp's B,G,R,A texels.
+		DecodedImage decoded;
+		std::vector<unsigned char> rgba;
+		const unsigned char* pixels = nullptr;
+		int width = 0;
+		int height = 0;
+		int channels = 0;
+		bool bgra = false;
+		double encodeMs = 0.0;
+		size_t sourceBytes = 0;
+		size_t bytes = 0;
+		// Set by the decode stage for an uncompressed texture while streaming is on: pixels the render
+		// thread hands to CreateStreamedTexture when it publishes the textures.
+		std::shared_ptr<const unsigned char> streamPixels;
+		// The cached texture, or the one the upload or render thread created.
+		GLuint texture = 0;
+		bool created = false;
+	};
+
+	// State of one LoadModelAsync, owned by its coroutine frame.
+	struct ModelLoad {
+		std::uint64_t generation = 0;
+		std::string path;
+		ImportedMesh imported;
+		SceneModel model;
+		std::vector<Material> materials;
+		// Per material, the index in textures of its diffuse and specular texture, or -1.
+		std::vector<std::array<int, 2>> materialTextures;
+		std::vector<PendingTexture> textures;
+		// Snapshots of render thread state taken by PrepareModelLoad.
+		bool compress = false;
+		bool stream = false;
+		bool wantMaterialSlots = false;
+		// Arena ranges are held from PrepareModelLoad until the geometry is published or given back.
+		bool reserved = false;
+		std::vector<unsigned int> rebasedIndices;
+		std::vector<float> slots;
+		bool hasSlots = false;
+		GLuint stagingVertices = 0;
+		GLuint stagingIndices = 0;
+		GLuint stagingSlots = 0;
+		double decodeMs = 0.0;
+		double uploadMs = 0.0;
+	};
+
+	// Bumped by every async load; a load whose generation is behind has been cancelled.
+	std::atomic<std::uint64_t> gModelLoadGeneration{0};
+	// Async loads not finished yet; render thread only.
+	size_t gModelLoadsInFlight = 0;
+
+	bool IsCurrentModelLoad(const ModelLoad& load) {
+		return load.generation == gModelLoadGeneration.load();
+	}
+
+	// Awaitables that move a load coroutine to the thread for its next stage.
+	struct ResumeOnWorker {
+		bool await_ready() const noexcept {
+			return false;
 		}
-		if (gMiddleDown) {
-			targetCamera.panX += dx * panScale;
-			targetCamera.panY -= dy * panScale;
+		void await_suspend(std::coroutine_handle<> handle) const {
+			Jobs().Submit([handle] {
+				handle.resume();
+			});
 		}
+		void await_resume() const noexcept {}
+	};
 
-		gLastMouseX = x;
-		gLastMouseY = y;
-	}
+	struct ResumeOnIoThread {
+		bool await_ready() const noexcept {
+			return false;
+		}
+		void await_suspend(std::coroutine_handle<> handle) const {
+			gIoThread.work.Push([handle] {
+				handle.resume();
+			});
+		}
+		void await_resume() const noexcept {}
+	};
 
-	void Scroll(GLFWwindow* window, double xoffset, double yoffset) {
-		if (gGuiInitialized) {
-			ImGui_ImplGlfw_ScrollCallback(window, xoffset, yoffset);
+	// Resumes at the start of the next frame, where scene and arena changes are safe.
+	struct ResumeOnRenderThread {
+		bool await_ready() const noexcept {
+			return false;
 		}
-		if (IsGuiCapturingMouse()) {
-			return;
+		void await_suspend(std::coroutine_handle<> handle) const {
+			gRenderThreadWork.Push([handle] {
+				handle.resume();
+			});
+			gpurenderer::RequestRedraw();
 		}
+		void await_resume() const noexcept {}
+	};
 
-		if (yoffset != 0.0) {
-			OrbitCamera& targetCamera = gObjectCamera;
-			targetCamera.distance -= static_cast<float>(yoffset) * 0.2f;
-			targetCamera.distance = std::max(targetCamera.distance, kMinCameraDistance);
+	// Runs upload on the upload thread and resumes on the render thread once the GPU has finished it.
+	struct ResumeAfterUpload {
+		std::function<void()> upload;
+
+		bool await_ready() const noexcept {
+			return false;
+		}
+		void await_suspend(std::coroutine_handle<> handle) {
+			SubmitUpload(std::move(upload), [handle] {
+				handle.resume();
+			});
+		}
+		void await_resume() const noexcept {}
+	};
+
+	// Worker half of LoadMeshMaterials: reads the material constants and picks each material's textures
+	// without touching GL or the texture cache. A candidate is taken when its source exists, so one that
+	// then fails to decode leaves the material untextured rather than falling through to the next.
+	void DescribeMeshMaterials(ModelLoad& load) {
+		const aiScene* scene = load.imported.scene;
+		std::filesystem::path objPath(load.path);
+		if (objPath.is_relative()) {
+			objPath = std::filesystem::absolute(objPath);
 		}
+		const std::filesystem::path baseDir = objPath.parent_path();
+		const std::string scenePath = objPath.lexically_normal().string();
+		std::unordered_map<std::string, int> textureIndices;
+
+		auto findTexture = [&](const aiMaterial* material, aiTextureType type) -> int {
+			aiString texPath;
+			if (material->GetTextureCount(type) == 0 ||
+				material->GetTexture(type, 0, &texPath) != AI_SUCCESS) {
+				return -1;
+			}
+			PendingTexture texture;
+			if (texPath.length > 0 && texPath.C_Str()[0] == '*') {
+				const int texIndex = std::atoi(texPath.C_Str() + 1);
+				if (texIndex < 0 || static_cast<unsigned int>(texIndex) >= scene->mNumTextures || !scene->mTextures[texIndex]) {
+					return -1;
+				}
+				texture.key = EmbeddedTextureKey(scenePath, static_cast<unsigned int>(texIndex));
+				texture.embeddedIndex = texIndex;
+			} else {
+				const std::filesystem::path path = ResolveTexturePath(baseDir, texPath);
+				const std::filesystem::path resolved = path.empty() ? path : gPathCache.Resolve(path);
+				if (resolved.empty()) {
+					std::fprintf(stderr, "Texture file not found: %s\n", path.lexically_normal().string().c_str());
+					return -1;
+				}
+				texture.key = resolved.string();
+				texture.file = resolved;
+			}
+			const auto [it, inserted] = textureIndices.emplace(texture.key, static_cast<int>(load.textures.size()));
+			if (inserted) {
+				load.textures.push_back(std::move(texture));
+			}
+			return it->second;
+		};
+		auto firstTexture = [&](const aiMaterial* material, std::initializer_list<aiTextureType> types) {
+			for (aiTextureType type : types) {
+				const int texture = findTexture(material, type);
+				if (texture >= 0) {
+					return texture;
+				}
+			}
+			return -1;
+		};
+
+		if (scene->mNumMaterials == 0) {
+			load.materials.emplace_back();
+			load.materials.front().name = "Default";
+			load.materialTextures.push_back({-1, -1});
+		}
+		for (unsigned int matIndex = 0; matIndex < scene->mNumMaterials; ++matIndex) {
+			Material mat;
+			mat.name = "Material " + std::to_string(matIndex);
+			std::array<int, 2> textures{-1, -1};
+			if (const aiMaterial* material = scene->mMaterials[matIndex]) {
+				ReadMaterialConstants(material, mat);
+				textures[0] = firstTexture(material, {aiTextureType_DIFFUSE, aiTextureType_BASE_COLOR, aiTextureType_AMBIENT});
+				textures[1] = firstTexture(material, {aiTextureType_SPECULAR, aiTextureType_SHININESS, aiTextureType_METALNESS, aiTextureType_REFLECTION});
+			}
+			load.materials.push_back(mat);
+			load.materialTextures.push_back(textures);
+		}
+
+		SceneModel& model = load.model;
+		ImportedMesh& imported = load.imported;
+		model.path = imported.path;
+		model.vertices = std::move(imported.vertices);
+		model.indices = std::move(imported.indices);
+		model.bounds = imported.bounds;
+		model.submeshes = std::move(imported.submeshes);
+		model.vertexCount = model.vertices.size();
+		model.indexCount = model.indices.size();
+		model.materialCount = static_cast<int>(load.materials.size());
+		model.loadGeneration = load.generation;
+		imported.timings.materials = load.materials.size();
 	}
 
-	void KeyCallback(GLFWwindow* window, int key, int scancode, int action, int mods) {
-		if (gGuiInitialized) {
-			ImGui_ImplGlfw_KeyCallback(window, key, scancode, action, mods);
+	void UnpinModelLoadTextures(ModelLoad& load) {
+		for (PendingTexture& texture : load.textures) {
+			if (!texture.pinned) {
+				continue;
+			}
+			auto it = gTextureCache.entries.find(texture.key);
+			if (it != gTextureCache.entries.end()) {
+				it->second.references = std::max(it->second.references - 1, 0);
+			}
+			texture.pinned = false;
 		}
-		if (IsGuiCapturingKeyboard() && key != GLFW_KEY_ESCAPE) {
-			return;
+	}
+
+	// Render thread, after the import: reserves the arena ranges and pins the cached textures the load
+	// reuses, so neither can move or go away while the other threads work on the load.
+	bool PrepareModelLoad(ModelLoad& load) {
+		SceneModel& model = load.model;
+		if (!AllocateArenaRanges(gGeometryArena, model.vertexCount, model.indexCount, model.vertexRange, model.indexRange)) {
+			std::fprintf(stderr, "Failed to allocate geometry arena space for: %s\n", model.path.c_str());
+			return false;
+		}
+		load.reserved = true;
+		for (PendingTexture& texture : load.textures) {
+			texture.texture = FindCachedTexture(texture.key);
+			if (texture.texture != 0) {
+				++gTextureCache.entries[texture.key].references;
+				texture.pinned = true;
+			}
 		}
+		load.compress = ShouldCompressTextures();
+		load.stream = IsTextureStreamingActive();
+		load.wantMaterialSlots = gGeometryArena.materialVbo != 0;
+		return true;
+	}
 
-		if (action != GLFW_PRESS && action != GLFW_REPEAT) {
+	// Worker: indices rebased onto the reserved vertex range, and the material slots.
+	void LayOutModelGeometry(ModelLoad& load) {
+		const SceneModel& model = load.model;
+		const unsigned int baseVertex = static_cast<unsigned int>(model.vertexRange.offset);
+		load.rebasedIndices.resize(model.indices.size());
+		Jobs().ParallelFor(model.indices.size(), kMeshBuildGrain, [&](size_t begin, size_t end) {
+			for (size_t i = begin; i < end; ++i) {
+				load.rebasedIndices[i] = model.indices[i] + baseVertex;
+			}
+		});
+		load.hasSlots = load.wantMaterialSlots && BuildMaterialSlots(model, load.slots);
+	}
+
+	// Upload thread: stages the geometry in buffers of its own. Only the render thread writes the arena,
+	// copying the staging buffers in when it publishes the geometry.
+	void UploadModelGeometry(ModelLoad& load) {
+		if (!IsCurrentModelLoad(load)) {
 			return;
 		}
-		if (key == GLFW_KEY_ESCAPE) {
-			glfwSetWindowShouldClose(window, GLFW_TRUE);
-			return;
+		const auto uploadStart = std::chrono::steady_clock::now();
+		auto stage = [](GLuint& buffer, const void* data, size_t bytes) {
+			pglGenBuffers(1, &buffer);
+			pglBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+			pglBufferData(GL_COPY_WRITE_BUFFER, static_cast<std::ptrdiff_t>(bytes), data, GL_STATIC_DRAW);
+			pglBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+		};
+		const SceneModel& model = load.model;
+		stage(load.stagingVertices, model.vertices.data(), model.vertices.size() * sizeof(Vertex));
+		stage(load.stagingIndices, load.rebasedIndices.data(), load.rebasedIndices.size() * sizeof(unsigned int));
+		if (load.hasSlots) {
+			stage(load.stagingSlots, load.slots.data(), load.slots.size() * sizeof(float));
 		}
-		if (key == GLFW_KEY_P) {
-			gUsePerspective = !gUsePerspective;
-			UpdateWindowTitle();
-			return;
+		load.uploadMs = ElapsedMilliseconds(uploadStart);
+	}
+
+	void DeleteModelLoadStaging(ModelLoad& load) {
+		for (GLuint* buffer : {&load.stagingVertices, &load.stagingIndices, &load.stagingSlots}) {
+			if (*buffer != 0) {
+				pglDeleteBuffers(1, buffer);
+				*buffer = 0;
+			}
 		}
-		if (key == GLFW_KEY_R) {
-			gObjectCamera.yawDeg = 0.0f;
-			gObjectCamera.pitchDeg = 0.0f;
-			gObjectCamera.panX = 0.0f;
-			gObjectCamera.panY = 0.0f;
-			return;
+	}
+
+	// Render thread: gives back what a load cancelled before its geometry was published holds.
+	void ReleaseModelLoad(ModelLoad& load) {
+		if (load.reserved) {
+			gGeometryArena.vertices.Free(load.model.vertexRange);
+			gGeometryArena.indices.Free(load.model.indexRange);
+			load.reserved = false;
 		}
-		if (key == GLFW_KEY_N) {
-			gShowNormals = !gShowNormals;
-			UpdateWindowTitle();
-			return;
+		DeleteModelLoadStaging(load);
+		UnpinModelLoadTextures(load);
+		EvictTextures();
+	}
+
+	// Render thread, once the staged geometry is on the GPU: replaces the scene with the model, textured
+	// with whatever the cache already had. The frame loop draws it from the next frame on, while the
+	// remaining textures are still loading.
+	void PublishModelGeometry(ModelLoad& load) {
+		SceneModel& model = load.model;
+		for (size_t i = 0; i < load.materials.size(); ++i) {
+			Material& mat = load.materials[i];
+			const std::array<int, 2>& textures = load.materialTextures[i];
+			if (textures[0] >= 0) {
+				mat.diffuseTexture = load.textures[static_cast<size_t>(textures[0])].texture;
+				mat.hasDiffuseTexture = mat.diffuseTexture != 0;
+			}
+			if (textures[1] >= 0) {
+				mat.specularTexture = load.textures[static_cast<size_t>(textures[1])].texture;
+				mat.hasSpecularTexture = mat.specularTexture != 0;
+			}
+			ApplySpecularMapDefault(mat);
+		}
+
+		ClearScene();
+		const auto copyStart = std::chrono::steady_clock::now();
+		if (gUseVao) {
+			pglBindVertexArray(0);
 		}
-		if (key == GLFW_KEY_F6) {
-			if (!ReloadShaders() || !ReloadDepthShader()) {
-				std::fprintf(stderr, "F6 shader reload failed.\n");
+		auto copy = [](GLuint source, GLuint target, size_t offsetBytes, size_t bytes) {
+			pglBindBuffer(GL_COPY_READ_BUFFER, source);
+			pglBindBuffer(GL_COPY_WRITE_BUFFER, target);
+			pglCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, static_cast<std::ptrdiff_t>(offsetBytes), static_cast<std::ptrdiff_t>(bytes));
+		};
+		copy(load.stagingVertices, gGeometryArena.vbo, model.vertexRange.offset * sizeof(Vertex), model.vertexCount * sizeof(Vertex));
+		copy(load.stagingIndices, gGeometryArena.ebo, model.indexRange.offset * sizeof(unsigned int), model.indexCount * sizeof(unsigned int));
+		model.materialSlots = load.hasSlots && gGeometryArena.materialVbo != 0;
+		if (model.materialSlots) {
+			copy(load.stagingSlots, gGeometryArena.materialVbo, model.vertexRange.offset * sizeof(float), model.vertexCount * sizeof(float));
+		}
+		pglBindBuffer(GL_COPY_READ_BUFFER, 0);
+		pglBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+		DeleteModelLoadStaging(load);
+		gpurenderer::LoadTimings& timings = load.imported.timings;
+		timings.geometryUploadMs = ElapsedMilliseconds(copyStart) + load.uploadMs;
+		for (const Material& mat : load.materials) {
+			timings.textures += (mat.hasDiffuseTexture ? 1u : 0u) + (mat.hasSpecularTexture ? 1u : 0u);
+		}
+
+		RegisterSceneModel(std::move(model), std::move(load.materials));
+		load.reserved = false;
+		UnpinModelLoadTextures(load);
+		UpdateSceneBounds();
+		FrameSceneBounds();
+		gLastLoadTimings = timings;
+
+		gObjPath = load.path;
+		CopyObjPathToInput(gObjPath);
+		gSelectedModelPath = IndexedModelPath(gObjPath);
+	}
+
+	// Textures of a load that neither the cache had nor the upload thread has created yet.
+	size_t CountMissingTextures(const ModelLoad& load) {
+		return static_cast<size_t>(std::count_if(load.textures.begin(), load.textures.end(), [](const PendingTexture& texture) {
+			return texture.texture == 0;
+		}));
+	}
+
+	// I/O thread: reads the texture files and looks the blocks up in the disk cache, so the decode stage
+	// never waits on the file system. Image headers are parsed here to pick the block format.
+	void ReadPendingTexture(const ModelLoad& load, PendingTexture& texture) {
+		const std::uint8_t* source = nullptr;
+		size_t sourceSize = 0;
+		if (texture.embeddedIndex >= 0) {
+			const aiTexture* embedded = load.imported.scene->mTextures[texture.embeddedIndex];
+			source = reinterpret_cast<const std::uint8_t*>(embedded->pcData);
+			if (embedded->mHeight != 0) {
+				sourceSize = static_cast<size_t>(embedded->mWidth) * static_cast<size_t>(embedded->mHeight) * sizeof(aiTexel);
+				texture.channels = 4;
 			} else {
-				std::fprintf(stdout, "Shaders reloaded.\n");
+				sourceSize = static_cast<size_t>(embedded->mWidth);
+				stbi_info_from_memory(source, static_cast<int>(sourceSize), &texture.width, &texture.height, &texture.channels);
 			}
+		} else {
+			if (!ReadCacheFile(texture.file, texture.fileBytes)) {
+				std::fprintf(stderr, "Failed to load texture: %s\n", texture.key.c_str());
+				return;
+			}
+			stbi_info_from_memory(texture.fileBytes.data(), static_cast<int>(texture.fileBytes.size()), &texture.width, &texture.height, &texture.channels);
+		}
+		texture.compress = load.compress && texture.channels > 0 && ChooseBlockFormat(texture.channels, texture.format);
+		if (!texture.compress) {
 			return;
 		}
+		const std::uint64_t sourceHash = texture.embeddedIndex >= 0 ? HashBytes(source, sourceSize) : HashTextureFile(texture.file);
+		texture.compressedKey = CompressedTextureKey(sourceHash, texture.format);
+		if (LoadCompressedImage(texture.compressedKey, texture.format, texture.compressed)) {
+			texture.fromDisk = true;
+			texture.bytes = texture.compressed.blocks.size();
+			texture.fileBytes = {};
+		}
 	}
 
-	void CharCallback(GLFWwindow* window, unsigned int codepoint) {
-		if (gGuiInitialized) {
-			ImGui_ImplGlfw_CharCallback(window, codepoint);
+	// Worker: gives the decoded pixels shared ownership, as the streamer keeps them until every level is
+	// resident. Assimp's buffer goes away with the scene, so it is copied.
+	void SharePendingTexturePixels(PendingTexture& texture) {
+		if (texture.bgra) {
+			const size_t size = static_cast<size_t>(texture.width) * static_cast<size_t>(texture.height) * 4u;
+			std::shared_ptr<unsigned char> copy(new unsigned char[size], std::default_delete<unsigned char[]>());
+			std::memcpy(copy.get(), texture.pixels, size);
+			texture.streamPixels = std::move(copy);
+		} else {
+			texture.streamPixels = std::shared_ptr<const unsigned char>(std::move(texture.decoded.pixels));
 		}
+		texture.pixels = texture.streamPixels.get();
 	}
 
-	void CopyObjPathToInput(const std::string& path) {
-		std::snprintf(gObjPathInput, sizeof(gObjPathInput), "%s", path.c_str());
+	// Worker: decodes what the I/O stage read and compresses it when asked to, writing the blocks to
+	// the disk cache ahead of their upload. Uncompressed textures are left to the streamer when it is on.
+	void DecodePendingTexture(const ModelLoad& load, PendingTexture& texture) {
+		if (texture.fromDisk) {
+			return;
+		}
+		const aiTexture* embedded = texture.embeddedIndex >= 0 ? load.imported.scene->mTextures[texture.embeddedIndex] : nullptr;
+		if (embedded && embedded->mHeight != 0) {
+			texture.pixels = reinterpret_cast<const unsigned char*>(embedded->pcData);
+			texture.width = static_cast<int>(embedded->mWidth);
+			texture.height = static_cast<int>(embedded->mHeight);
+			texture.bgra = true;
+		} else {
+			const stbi_uc* source = embedded ? reinterpret_cast<const stbi_uc*>(embedded->pcData) : texture.fileBytes.data();
+			const size_t sourceSize = embedded ? static_cast<size_t>(embedded->mWidth) : texture.fileBytes.size();
+			if (sourceSize == 0) {
+				return;
+			}
+			texture.decoded.pixels.reset(stbi_load_from_memory(source, static_cast<int>(sourceSize), &texture.width, &texture.height, &texture.channels, 0));
+			texture.pixels = texture.decoded.pixels.get();
+			texture.fileBytes = {};
+			if (!texture.pixels) {
+				std::fprintf(stderr, "Failed to load texture: %s\n", texture.key.c_str());
+				return;
+			}
+		}
+		texture.bytes = EstimateTextureBytes(texture.width, texture.height, texture.channels, false);
+		if (!texture.compress) {
+			if (load.stream) {
+				SharePendingTexturePixels(texture);
+			}
+			return;
+		}
+		if (texture.bgra) {
+			texture.rgba = SwizzleBgraToRgba(texture.pixels, static_cast<size_t>(texture.width) * static_cast<size_t>(texture.height));
+			texture.pixels = texture.rgba.data();
+			texture.bgra = false;
+		}
+		// Textures are already encoded in parallel with each other, so each encode stays on its worker.
+		texture.compressed = EncodeTexturePixels(
+			texture.pixels,
+			texture.width,
+			texture.height,
+			texture.channels,
+			texture.format,
+			texture.compressedKey,
+			texture.key,
+			1,
+			texture.encodeMs);
+		texture.sourceBytes = texture.bytes;
+		texture.bytes = texture.compressed.blocks.size();
 	}
 
-	void RefreshAvailableObjFiles() {
-		gAvailableObjFiles.clear();
-		std::error_code ec;
-		const std::filesystem::path root = std::filesystem::current_path(ec);
-		if (ec) {
+	// Upload thread: creates the textures the cache did not have, except those left to the streamer.
+	void UploadModelTextures(ModelLoad& load) {
+		if (!IsCurrentModelLoad(load)) {
 			return;
 		}
-
-		size_t count = 0;
-		constexpr size_t kMaxDiscoveredObjs = 512;
-		for (std::filesystem::recursive_directory_iterator it(
-			 root,
-			 std::filesystem::directory_options::skip_permission_denied,
-			 ec), end;
-			 it != end && !ec;
-			 it.increment(ec)) {
-			if (ec || !it->is_regular_file()) {
+		const auto uploadStart = std::chrono::steady_clock::now();
+		for (PendingTexture& texture : load.textures) {
+			if (texture.texture != 0 || texture.streamPixels) {
 				continue;
 			}
+			if (!texture.compressed.blocks.empty()) {
+				texture.texture = CreateCompressedTextureObject(texture.compressed);
+				if (texture.texture == 0) {
+					std::fprintf(stderr, "Compressed upload of %s failed; uploading uncompressed.\n", texture.key.c_str());
+					texture.compressed.blocks.clear();
+					texture.bytes = EstimateTextureBytes(texture.width, texture.height, texture.channels, false);
+				}
+			}
+			if (texture.texture == 0 && texture.pixels) {
+				texture.texture = CreateTextureObject(texture.pixels, texture.width, texture.height, texture.channels, texture.bgra);
+			}
+			texture.created = texture.texture != 0;
+		}
+		load.uploadMs = ElapsedMilliseconds(uploadStart);
+	}
 
-			const std::filesystem::path ext = it->path().extension();
-			std::string extLower = ext.string();
-			std::transform(extLower.begin(), extLower.end(), extLower.begin(), [](unsigned char c) {
-				return static_cast<char>(std::tolower(c));
-				});
-			if (extLower != ".obj") {
+	// Render thread, once the new textures are on the GPU: starts streaming the ones left to the
+	// streamer, caches them all, cancelled or not, and fills them into the published model's
+	// materials if the model is still in the scene.
+	bool PublishModelTextures(ModelLoad& load) {
+		for (PendingTexture& texture : load.textures) {
+			if (texture.streamPixels && IsCurrentModelLoad(load)) {
+				// Like the sync path: the preview levels now, the finer ones through the upload ring.
+				texture.texture = CreateStreamedTexture(texture.streamPixels, texture.width, texture.height, texture.channels, texture.bgra);
+				texture.created = texture.texture != 0;
+			}
+			texture.streamPixels.reset();
+			if (!texture.created) {
 				continue;
 			}
-
-			gAvailableObjFiles.push_back(it->path().lexically_normal().string());
-			++count;
-			if (count >= kMaxDiscoveredObjs) {
-				break;
+			if (IsTextureCached(texture.key)) {
+				// Another load cached the same key meanwhile.
+				DeleteCachedTexture(texture.texture);
+				texture.texture = FindCachedTexture(texture.key);
+				continue;
+			}
+			CacheTexture(texture.key, texture.texture, texture.bytes);
+			if (!texture.compressed.blocks.empty() && texture.fromDisk) {
+				++gTextureCompressionStats.loadedFromDisk;
+			} else if (!texture.compressed.blocks.empty()) {
+				RecordEncodedTexture(texture.encodeMs, texture.sourceBytes, texture.compressed.blocks.size());
 			}
 		}
 
-		std::sort(gAvailableObjFiles.begin(), gAvailableObjFiles.end());
-		gAvailableObjFiles.erase(
-			std::unique(gAvailableObjFiles.begin(), gAvailableObjFiles.end()),
-			gAvailableObjFiles.end());
+		auto model = std::find_if(gSceneModels.begin(), gSceneModels.end(), [&](const SceneModel& candidate) {
+			return candidate.loadGeneration == load.generation;
+		});
+		if (!IsCurrentModelLoad(load) || model == gSceneModels.end()) {
+			EvictTextures();
+			return false;
+		}
+		gpurenderer::LoadTimings& timings = gLastLoadTimings;
+		auto fill = [&](int index, GLuint& texture, bool& hasTexture) {
+			if (index < 0 || !load.textures[static_cast<size_t>(index)].created || texture != 0) {
+				return;
+			}
+			texture = load.textures[static_cast<size_t>(index)].texture;
+			hasTexture = texture != 0;
+			RetainTexture(texture);
+			timings.textures += hasTexture ? 1u : 0u;
+		};
+		for (size_t i = 0; i < load.materialTextures.size() && static_cast<int>(i) < model->materialCount; ++i) {
+			Material& mat = gMaterials[static_cast<size_t>(model->materialBase) + i];
+			fill(load.materialTextures[i][0], mat.diffuseTexture, mat.hasDiffuseTexture);
+			fill(load.materialTextures[i][1], mat.specularTexture, mat.hasSpecularTexture);
+			ApplySpecularMapDefault(mat);
+		}
+		timings.textureDecodeMs = load.decodeMs;
+		timings.textureUploadMs = load.uploadMs;
+		gDrawRecordsDirty = true;
+		gMaterialBatching.dirty = true;
+		EvictTextures();
+		return true;
+	}
 
-		gSelectedObjIndex = -1;
-		for (size_t i = 0; i < gAvailableObjFiles.size(); ++i) {
-			if (gAvailableObjFiles[i] == gObjPath) {
-				gSelectedObjIndex = static_cast<int>(i);
-				break;
+	// Replaces the scene with the model at path, stage by stage on the thread each stage needs: import
+	// and decode on job workers, file reads on the I/O thread, GL object creation on the upload thread,
+	// and scene changes on the render thread between frames. The geometry is published as soon as it
+	// is on the GPU and the textures the cache lacked follow in one batch; with streaming on, the
+	// uncompressed ones go to the texture streamer then, as on the sync path. A newer load cancels
+	// this one: the import stops at Assimp's next progress report and every later stage only gives
+	// back what the load holds. Returns whether the model and all its textures made it into the scene.
+	jobs::AsyncTask<bool> LoadModelAsync(std::string path) {
+		ModelLoad load;
+		load.generation = ++gModelLoadGeneration;
+		load.path = std::move(path);
+		RefreshPathCacheForLoad();
+		gModelLoadStatus = "Loading model: " + load.path;
+
+		co_await ResumeOnWorker{};
+		const bool imported = IsCurrentModelLoad(load) &&
+			ImportMesh(load.path, load.imported, [&load] {
+				return !IsCurrentModelLoad(load);
+			});
+		if (imported) {
+			DescribeMeshMaterials(load);
+		}
+		co_await ResumeOnRenderThread{};
+		if (!IsCurrentModelLoad(load)) {
+			co_return false;
+		}
+		if (!imported) {
+			gModelLoadStatus = "Model load failed: " + load.path;
+			co_return false;
+		}
+		if (!PrepareModelLoad(load)) {
+			gModelLoadStatus = "Model upload failed: " + load.path;
+			co_return false;
+		}
+
+		co_await ResumeOnWorker{};
+		if (IsCurrentModelLoad(load)) {
+			LayOutModelGeometry(load);
+		}
+		co_await ResumeAfterUpload{[&load] {
+			UploadModelGeometry(load);
+		}};
+		if (!IsCurrentModelLoad(load)) {
+			ReleaseModelLoad(load);
+			co_return false;
+		}
+		PublishModelGeometry(load);
+		const size_t missing = CountMissingTextures(load);
+		if (missing == 0) {
+			gModelLoadStatus = "Loaded model: " + load.path;
+			co_return true;
+		}
+		gModelLoadStatus = "Loading " + std::to_string(missing) + " textures of: " + load.path;
+
+		co_await ResumeOnIoThread{};
+		for (PendingTexture& texture : load.textures) {
+			if (texture.texture == 0 && IsCurrentModelLoad(load)) {
+				ReadPendingTexture(load, texture);
 			}
 		}
+		co_await ResumeOnWorker{};
+		if (IsCurrentModelLoad(load)) {
+			const auto decodeStart = std::chrono::steady_clock::now();
+			Jobs().ParallelFor(load.textures.size(), 1, [&](size_t begin, size_t end) {
+				for (size_t i = begin; i < end; ++i) {
+					if (load.textures[i].texture == 0) {
+						DecodePendingTexture(load, load.textures[i]);
+					}
+				}
+			});
+			load.decodeMs = ElapsedMilliseconds(decodeStart);
+		}
+		co_await ResumeAfterUpload{[&load] {
+			UploadModelTextures(load);
+		}};
+		if (!PublishModelTextures(load)) {
+			co_return false;
+		}
+		gModelLoadStatus = "Loaded model: " + load.path;
+		co_return true;
 	}
 
-	void DestroyModelBuffers() {
-		if (pglDeleteBuffers) {
-			if (gEbo != 0) {
-				pglDeleteBuffers(1, &gEbo);
-				gEbo = 0;
-			}
-			if (gVbo != 0) {
-				pglDeleteBuffers(1, &gVbo);
-				gVbo = 0;
-			}
+	jobs::AsyncTask<> RunModelLoad(std::string path) {
+		++gModelLoadsInFlight;
+		const auto start = std::chrono::steady_clock::now();
+		if (co_await LoadModelAsync(path)) {
+			std::printf("Loaded %s in %.1f ms.\n", path.c_str(), ElapsedMilliseconds(start));
 		}
-		if (gUseVao && pglDeleteVertexArrays && gVao != 0) {
-			pglDeleteVertexArrays(1, &gVao);
-			gVao = 0;
+		--gModelLoadsInFlight;
+		// Every load finishes on the render thread; draw the result and status for a few frames.
+		MarkSceneDirty();
+	}
+
+	bool HasModelLoadsInFlight() {
+		return gModelLoadsInFlight > 0;
+	}
+
+	// Runs the work other threads handed to the render thread.
+	void RunRenderThreadWork() {
+		std::function<void()> work;
+		while (gRenderThreadWork.TryPop(work)) {
+			work();
 		}
 	}
 
@@ -3059,48 +8775,57 @@ void main() {
 			gModelLoadStatus = "Model load failed: path is empty.";
 			return false;
 		}
+		if (IsUploadThreadActive()) {
+			Detach(RunModelLoad(objPath));
+			return true;
+		}
 
-		std::vector<Vertex> newVertices;
-		std::vector<unsigned int> newIndices;
-		std::vector<Submesh> newSubmeshes;
+		SceneModel newModel;
 		std::vector<Material> newMaterials;
-		Bounds newBounds;
-		if (!LoadMesh(objPath, newVertices, newIndices, newBounds, newSubmeshes, newMaterials)) {
+		if (!LoadSceneModel(objPath, newModel, newMaterials)) {
 			gModelLoadStatus = "Model load failed: " + objPath;
 			return false;
 		}
 
-		DestroyModelBuffers();
+		// The current scene stays up until the new model is resident, so a failed upload leaves it as it was.
+		if (!UploadSceneModel(newModel, newMaterials.size())) {
+			gModelLoadStatus = "Model upload failed: " + objPath;
+			return false;
+		}
+		ClearScene();
+		RegisterSceneModel(std::move(newModel), std::move(newMaterials));
+		UpdateSceneBounds();
+		FrameSceneBounds();
 
-		gVertices = std::move(newVertices);
-		gIndices = std::move(newIndices);
-		gSubmeshes = std::move(newSubmeshes);
-		gMaterials = std::move(newMaterials);
-		gBounds = newBounds;
-		gIndexCount = static_cast<int>(gIndices.size());
+		gObjPath = objPath;
+		CopyObjPathToInput(gObjPath);
+		gSelectedModelPath = IndexedModelPath(gObjPath);
+		gModelLoadStatus = "Loaded model: " + gObjPath;
+		return true;
+	}
 
-		gCenter = gBounds.Center();
-		const float extent = std::max(gBounds.MaxExtent(), 1.0f);
-		gObjectCamera.distance = extent * 2.5f;
-		gObjectCamera.panX = 0.0f;
-		gObjectCamera.panY = 0.0f;
-		gPlaneHeight = (gBounds.min.y - gCenter.y) - (extent * kPlanePaddingRatio);
-		gPlaneWidth = 2.0f * extent * kPlaneSizeMultiplier;
-		gPlaneLength = 2.0f * extent * kPlaneSizeMultiplier;
-		gPlaneScale = 1.0f;
-		gObjectScale = glm::vec3(1.0f);
-		gLightMarkerScale = 1.0f;
-		gLightDistance = extent * 1.8f;
-		gNearPlane = std::max(0.1f, extent * 0.001f);
-		gFarPlane = std::max(kFarPlane, gObjectCamera.distance + extent * 3.0f);
-		gSelectedMaterialIndex = 0;
+	// Adds another model next to the current ones without reframing the camera.
+	bool AddModelFromPath(const std::string& objPath) {
+		if (objPath.empty()) {
+			gModelLoadStatus = "Model add failed: path is empty.";
+			return false;
+		}
 
-		CreateBuffers();
+		SceneModel newModel;
+		std::vector<Material> newMaterials;
+		if (!LoadSceneModel(objPath, newModel, newMaterials) ||
+			!AddSceneModel(std::move(newModel), std::move(newMaterials))) {
+			gModelLoadStatus = "Model add failed: " + objPath;
+			return false;
+		}
+		gSelectedModelIndex = static_cast<int>(gSceneModels.size()) - 1;
+		gSelectedInstanceIndex = 0;
+		gSelectedMaterialIndex = 0;
+		UpdateSceneBounds();
 
 		gObjPath = objPath;
 		CopyObjPathToInput(gObjPath);
-		RefreshAvailableObjFiles();
-		gModelLoadStatus = "Loaded model: " + gObjPath;
+		gModelLoadStatus = "Added model: " + objPath;
 		return true;
 	}
 
@@ -3252,6 +8977,26 @@ void main() {
 		if (!gEnvironmentLoadStatus.empty()) {
 			ImGui::TextWrapped("%s", gEnvironmentLoadStatus.c_str());
 		}
+		if (!gSoftwareOnly) {
+			ImGui::Checkbox("Prefilter Environment (next load)", &gPrefilterEnvironment);
+			if (gIrradianceCubemap != 0) {
+				ImGui::SliderFloat("Environment Diffuse", &gEnvDiffuseStrength, 0.0f, 1.0f, "%.2f");
+			}
+			if (gEnvironmentStats.faceSize > 0) {
+				ImGui::Text("Environment: %d px, %d levels%s; decode %.1f ms, prefilter %.1f ms",
+					gEnvironmentStats.faceSize,
+					gEnvironmentStats.levels,
+					gEnvironmentStats.fromCache ? " (cached)" : "",
+					gEnvironmentStats.decodeMs,
+					gEnvironmentStats.prefilterMs);
+			}
+		}
+		if (ImGui::Button("Render Software Reference")) {
+			gSoftwareCaptureRequested = true;
+		}
+		if (!gSoftwareReferenceStatus.empty()) {
+			ImGui::TextWrapped("%s", gSoftwareReferenceStatus.c_str());
+		}
 
 		ImGui::Separator();
 		ImGui::TextUnformatted("Light");
@@ -3292,17 +9037,193 @@ void main() {
 		gPlaneScale = std::max(gPlaneScale, 0.01f);
 		gLightMarkerScale = std::max(gLightMarkerScale, 0.1f);
 
+		ImGui::Separator();
+		ImGui::TextUnformatted("Scene Models");
+		ImGui::Text("Models: %zu, draw records: %zu, materials: %zu", gSceneModels.size(), gDrawRecords.size(), gMaterials.size());
+		ImGui::Text("Geometry Arena: %zu/%zu vertices, %zu/%zu indices",
+			gGeometryArena.vertices.used,
+			gGeometryArena.vertices.capacity,
+			gGeometryArena.indices.used,
+			gGeometryArena.indices.capacity);
+		if (gMaterialBatching.supported) {
+			if (ImGui::Checkbox("Merge Draws via Texture Arrays", &gMaterialBatching.enabled)) {
+				gMaterialBatching.dirty = true;
+				gDrawRecordsDirty = true;
+			}
+			ImGui::Text("Texture arrays: %zu (%zu layers, %.1f MB, packed in %.1f ms)",
+				gMaterialBatching.arrays.size(),
+				gMaterialBatching.layers.size(),
+				static_cast<double>(gMaterialBatching.arrayBytes) / (1024.0 * 1024.0),
+				gMaterialBatching.packMs);
+			ImGui::Text("Merged draw records: %zu covering %zu submeshes",
+				gMaterialBatching.mergedRecords,
+				gMaterialBatching.mergedSubmeshes);
+		}
+		if (ImGui::SliderInt("Texture Budget (MB)", &gTextureCache.budgetMb, 64, kMaxTextureBudgetMb)) {
+			EvictTextures();
+		}
+		ImGui::Text("Textures: %zu resident, %.1f MB",
+			gTextureCache.entries.size(),
+			static_cast<double>(gTextureCache.residentBytes) / (1024.0 * 1024.0));
+		ImGui::Text("Texture cache: %zu hits, %zu misses, %zu evictions",
+			gTextureCache.hits,
+			gTextureCache.misses,
+			gTextureCache.evictions);
+		ImGui::Checkbox("Compress Textures (next load)", &gCompressTextures);
+		if (gTextureStreamer.supported) {
+			ImGui::Checkbox("Stream Texture Uploads (next load)", &gTextureStreamer.enabled);
+			ImGui::SliderInt("Upload Budget (MB/frame)", &gTextureStreamer.budgetMb, 1, kMaxUploadBudgetMb);
+			ImGui::Text("Streaming: %zu pending, %zu done, %.1f MB uploaded",
+				gTextureStreamer.textures.size(),
+				gTextureStreamer.completedTextures,
+				static_cast<double>(gTextureStreamer.uploadedBytes) / (1024.0 * 1024.0));
+			ImGui::Text("Upload fences: avg %.2f ms, max %.2f ms; stalls: %zu fence, %zu copy; max issue %.2f ms",
+				gTextureStreamer.fenceSamples > 0 ? gTextureStreamer.fenceLatencyMs / static_cast<double>(gTextureStreamer.fenceSamples) : 0.0,
+				gTextureStreamer.maxFenceLatencyMs,
+				gTextureStreamer.fenceStalls,
+				gTextureStreamer.copyStalls,
+				gTextureStreamer.maxIssueMs);
+			ImGui::Text("Progressive: %zu textures, %.1f MB resident, %zu levels refined, %zu trimmed",
+				gTextureStreamer.progressiveTextures,
+				static_cast<double>(gTextureStreamer.progressiveBytes) / (1024.0 * 1024.0),
+				gTextureStreamer.levelsRefined,
+				gTextureStreamer.levelsTrimmed);
+		}
+		if (IsUploadThreadActive()) {
+			ImGui::Text("Upload thread: %zu in flight, %zu published, avg %.1f ms, max %.1f ms",
+				gUploadThread.inFlight.load(),
+				gUploadThread.published,
+				gUploadThread.published > 0 ? gUploadThread.publishLatencyMs / static_cast<double>(gUploadThread.published) : 0.0,
+				gUploadThread.maxPublishLatencyMs);
+		}
+		if (gTextureCompressionStats.encoded + gTextureCompressionStats.loadedFromDisk > 0) {
+			ImGui::Text("Compressed: %zu encoded (%.0f ms), %zu from disk, saved %.1f MB",
+				gTextureCompressionStats.encoded,
+				gTextureCompressionStats.encodeMs,
+				gTextureCompressionStats.loadedFromDisk,
+				static_cast<double>(gTextureCompressionStats.sourceBytes - gTextureCompressionStats.compressedBytes) / (1024.0 * 1024.0));
+		}
+		SceneModel* selectedModel = nullptr;
+		if (!gSceneModels.empty()) {
+			gSelectedModelIndex = std::clamp(gSelectedModelIndex, 0, static_cast<int>(gSceneModels.size()) - 1);
+			std::vector<std::string> modelLabels;
+			modelLabels.reserve(gSceneModels.size());
+			for (size_t i = 0; i < gSceneModels.size(); ++i) {
+				modelLabels.push_back(std::to_string(i) + ": " + std::filesystem::path(gSceneModels[i].path).filename().string());
+			}
+			std::vector<const char*> modelItems;
+			modelItems.reserve(modelLabels.size());
+			for (const std::string& label : modelLabels) {
+				modelItems.push_back(label.c_str());
+			}
+			if (ImGui::Combo("Scene Model", &gSelectedModelIndex, modelItems.data(), static_cast<int>(modelItems.size()))) {
+				gSelectedInstanceIndex = 0;
+				gSelectedMaterialIndex = 0;
+			}
+			selectedModel = &gSceneModels[static_cast<size_t>(gSelectedModelIndex)];
+			const float dragSpeed = std::max(selectedModel->bounds.MaxExtent(), 1.0f) * 0.01f;
+			bool transformChanged = false;
+			ImGui::Checkbox("Model Visible", &selectedModel->visible);
+			transformChanged |= ImGui::DragFloat3("Model Translation", glm::value_ptr(selectedModel->translation), dragSpeed, 0.0f, 0.0f, "%.2f");
+			transformChanged |= ImGui::DragFloat3("Model Rotation", glm::value_ptr(selectedModel->rotationDeg), 0.5f, -360.0f, 360.0f, "%.1f deg");
+			transformChanged |= ImGui::DragFloat3("Model Scale", glm::value_ptr(selectedModel->scale), 0.01f, 0.01f, 50.0f, "%.2f");
+			selectedModel->scale = glm::max(selectedModel->scale, glm::vec3(0.01f));
+			if (ImGui::Button("Remove Model") && gSceneModels.size() > 1) {
+				RemoveSceneModel(static_cast<size_t>(gSelectedModelIndex));
+				gSelectedModelIndex = std::min(gSelectedModelIndex, static_cast<int>(gSceneModels.size()) - 1);
+				gSelectedInstanceIndex = 0;
+				gSelectedMaterialIndex = 0;
+				selectedModel = &gSceneModels[static_cast<size_t>(gSelectedModelIndex)];
+				transformChanged = true;
+			}
+			if (transformChanged) {
+				UpdateSceneBounds();
+			}
+		}
+
+		ImGui::Separator();
+		ImGui::TextUnformatted("Instances");
+		ImGui::Text("Instances: %zu (drawn %d, reflected %d, shadowed %d)",
+			gInstanceAttributes.size(),
+			gLastMainInstances,
+			gLastReflectionInstances,
+			gLastShadowInstances);
+		ImGui::Text("Instancing: %s", gHasInstancing ? "hardware" : "per-instance loop");
+		if (selectedModel != nullptr) {
+			std::vector<SceneInstance>& instances = selectedModel->instances;
+			const float modelExtent = selectedModel->bounds.MaxExtent();
+			ImGui::SliderInt("Grid Rows", &gInstanceGridRows, 1, kMaxGridInstancesPerAxis);
+			ImGui::SliderInt("Grid Columns", &gInstanceGridColumns, 1, kMaxGridInstancesPerAxis);
+			ImGui::SliderFloat("Grid Spacing", &gInstanceGridSpacing, 0.5f, 5.0f, "%.2fx");
+			if (ImGui::Button("Build Instance Grid")) {
+				const float spacing = std::max(modelExtent, 0.01f) * gInstanceGridSpacing;
+				const float rowOrigin = -0.5f * spacing * static_cast<float>(gInstanceGridRows - 1);
+				const float columnOrigin = -0.5f * spacing * static_cast<float>(gInstanceGridColumns - 1);
+				instances.clear();
+				for (int row = 0; row < gInstanceGridRows; ++row) {
+					for (int column = 0; column < gInstanceGridColumns; ++column) {
+						SceneInstance instance;
+						instance.translation = glm::vec3(
+							columnOrigin + spacing * static_cast<float>(column),
+							0.0f,
+							rowOrigin + spacing * static_cast<float>(row));
+						instances.push_back(instance);
+					}
+				}
+				gSelectedInstanceIndex = 0;
+			}
+			ImGui::SameLine();
+			if (ImGui::Button("Add Instance")) {
+				SceneInstance instance = instances.empty() ? SceneInstance{} : instances[static_cast<size_t>(gSelectedInstanceIndex)];
+				instance.translation.x += std::max(modelExtent, 0.01f) * gInstanceGridSpacing;
+				instances.push_back(instance);
+				gSelectedInstanceIndex = static_cast<int>(instances.size()) - 1;
+			}
+			ImGui::SameLine();
+			if (ImGui::Button("Remove Instance") && instances.size() > 1) {
+				instances.erase(instances.begin() + gSelectedInstanceIndex);
+			}
+			gSelectedInstanceIndex = std::clamp(gSelectedInstanceIndex, 0, static_cast<int>(instances.size()) - 1);
+			if (!instances.empty()) {
+				ImGui::SliderInt("Instance", &gSelectedInstanceIndex, 0, static_cast<int>(instances.size()) - 1);
+				SceneInstance& instance = instances[static_cast<size_t>(gSelectedInstanceIndex)];
+				const float dragSpeed = std::max(modelExtent, 1.0f) * 0.01f;
+				ImGui::Checkbox("Instance Visible", &instance.visible);
+				ImGui::DragFloat3("Instance Translation", glm::value_ptr(instance.translation), dragSpeed, 0.0f, 0.0f, "%.2f");
+				ImGui::DragFloat3("Instance Rotation", glm::value_ptr(instance.rotationDeg), 0.5f, -360.0f, 360.0f, "%.1f deg");
+				ImGui::DragFloat3("Instance Scale", glm::value_ptr(instance.scale), 0.01f, 0.01f, 50.0f, "%.2f");
+				instance.scale = glm::max(instance.scale, glm::vec3(0.01f));
+
+				std::vector<std::string> overrideLabels;
+				overrideLabels.reserve(static_cast<size_t>(selectedModel->materialCount) + 1);
+				overrideLabels.push_back("None");
+				for (int i = 0; i < selectedModel->materialCount; ++i) {
+					const Material& material = gMaterials[static_cast<size_t>(selectedModel->materialBase + i)];
+					overrideLabels.push_back(material.name.empty() ? "Material " + std::to_string(i) : material.name);
+				}
+				std::vector<const char*> overrideItems;
+				overrideItems.reserve(overrideLabels.size());
+				for (const std::string& label : overrideLabels) {
+					overrideItems.push_back(label.c_str());
+				}
+				int overrideItem = std::clamp(instance.materialOverride + 1, 0, selectedModel->materialCount);
+				if (ImGui::Combo("Material Override", &overrideItem, overrideItems.data(), static_cast<int>(overrideItems.size()))) {
+					instance.materialOverride = overrideItem - 1;
+				}
+			}
+		}
+
 		ImGui::Separator();
 		ImGui::TextUnformatted("Object Material");
-		if (gMaterials.empty()) {
+		if (selectedModel == nullptr || selectedModel->materialCount <= 0) {
 			ImGui::TextUnformatted("No materials loaded.");
 		} else {
-			const int maxIndex = static_cast<int>(gMaterials.size()) - 1;
+			const int maxIndex = selectedModel->materialCount - 1;
 			gSelectedMaterialIndex = std::clamp(gSelectedMaterialIndex, 0, maxIndex);
 			std::vector<std::string> materialLabels;
-			materialLabels.reserve(gMaterials.size());
-			for (size_t i = 0; i < gMaterials.size(); ++i) {
-				const std::string& name = gMaterials[i].name;
+			materialLabels.reserve(static_cast<size_t>(selectedModel->materialCount));
+			for (int i = 0; i < selectedModel->materialCount; ++i) {
+				const std::string& name = gMaterials[static_cast<size_t>(selectedModel->materialBase + i)].name;
 				if (name.empty()) {
 					materialLabels.push_back("Material " + std::to_string(i));
 				} else {
@@ -3315,7 +9236,7 @@ void main() {
 				materialItems.push_back(label.c_str());
 			}
 			ImGui::Combo("Material", &gSelectedMaterialIndex, materialItems.data(), static_cast<int>(materialItems.size()));
-			Material& mat = gMaterials[gSelectedMaterialIndex];
+			Material& mat = gMaterials[static_cast<size_t>(selectedModel->materialBase + gSelectedMaterialIndex)];
 			ImGui::ColorEdit3("Ambient", glm::value_ptr(mat.ambient));
 			ImGui::ColorEdit3("Diffuse", glm::value_ptr(mat.diffuse));
 			ImGui::ColorEdit3("Specular", glm::value_ptr(mat.specular));
@@ -3350,25 +9271,126 @@ void main() {
 			LoadModelFromPath(std::string(gObjPathInput));
 		}
 		ImGui::SameLine();
-		if (ImGui::Button("Refresh OBJ List")) {
-			RefreshAvailableObjFiles();
+		if (ImGui::Button("Add OBJ to Scene")) {
+			AddModelFromPath(std::string(gObjPathInput));
 		}
-
-		if (!gAvailableObjFiles.empty()) {
-			std::vector<const char*> items;
-			items.reserve(gAvailableObjFiles.size());
-			for (const std::string& file : gAvailableObjFiles) {
-				items.push_back(file.c_str());
+		ImGui::SameLine();
+		if (ImGui::Button("Rescan Models")) {
+			gAssetIndexer.Rescan(true);
+		}
+
+		UpdateModelList();
+		const gpurenderer::assets::IndexStats indexStats = gAssetIndexer.Stats();
+		ImGui::InputText("Search Models", gModelFilterInput, sizeof(gModelFilterInput));
+		ImGui::Text("%zu of %zu models in %zu directories%s",
+			gModelList.matches.size(),
+			gModelList.files.size(),
+			indexStats.directories,
+			indexStats.scanning ? " (scanning...)" : "");
+		if (!gModelList.matches.empty()) {
+			const std::string root = gAssetIndexer.Root().string();
+			ImGui::BeginChild("##ModelList", ImVec2(0.0f, 8.0f * ImGui::GetTextLineHeightWithSpacing()), true, ImGuiWindowFlags_HorizontalScrollbar);
+			ImGuiListClipper clipper;
+			clipper.Begin(static_cast<int>(gModelList.matches.size()));
+			while (clipper.Step()) {
+				for (int row = clipper.DisplayStart; row < clipper.DisplayEnd; ++row) {
+					const std::string& file = gModelList.files[gModelList.matches[static_cast<size_t>(row)]];
+					// Show paths relative to the indexed root; the prefix is the same on every row.
+					const bool underRoot = file.size() > root.size() + 1 && file.compare(0, root.size(), root) == 0;
+					const char* label = underRoot ? file.c_str() + root.size() + 1 : file.c_str();
+					ImGui::PushID(row);
+					if (ImGui::Selectable(label, file == gSelectedModelPath)) {
+						gSelectedModelPath = file;
+						CopyObjPathToInput(file);
+					}
+					ImGui::PopID();
+				}
 			}
-			if (gSelectedObjIndex < 0 || gSelectedObjIndex >= static_cast<int>(gAvailableObjFiles.size())) {
-				gSelectedObjIndex = 0;
+			ImGui::EndChild();
+			if (ImGui::Button("Load Selected Model")) {
+				LoadModelFromPath(gSelectedModelPath);
 			}
-			ImGui::Combo("Discovered OBJs", &gSelectedObjIndex, items.data(), static_cast<int>(items.size()));
-			if (ImGui::Button("Load Selected OBJ")) {
-				LoadModelFromPath(gAvailableObjFiles[gSelectedObjIndex]);
+			ImGui::SameLine();
+			if (ImGui::Button("Add Selected Model")) {
+				AddModelFromPath(gSelectedModelPath);
 			}
+		} else if (!indexStats.scanning) {
+			ImGui::TextUnformatted(gModelList.files.empty()
+				? "No supported model files found under the current directory."
+				: "No models match the search.");
+		}
+		ImGui::Text("Index: %.1f ms last scan, %zu/%zu directories unchanged, %zu watched%s",
+			indexStats.scanMs,
+			indexStats.directoriesReused,
+			indexStats.directories,
+			indexStats.watchedDirectories,
+			indexStats.loadedFromDisk ? ", loaded from disk" : "");
+
+		const char* retentionModes[] = {"Keep", "Drop", "Keep Compressed"};
+		if (ImGui::Combo("CPU Mesh Retention", &gMeshRetentionPolicy, retentionModes, IM_ARRAYSIZE(retentionModes))) {
+			ApplyMeshRetentionPolicy();
+		}
+		ImGui::Text("CPU Mesh Copy: %.2f MB", static_cast<double>(CpuMeshBytes()) / (1024.0 * 1024.0));
+
+		ImGui::Separator();
+		ImGui::TextUnformatted("Frame Pacing");
+		const char* pacingModes[] = {"VSync", "Uncapped", "Target FPS"};
+		int pacing = static_cast<int>(gFrameScheduler.pacing);
+		if (ImGui::Combo("Pacing", &pacing, pacingModes, IM_ARRAYSIZE(pacingModes))) {
+			gFrameScheduler.pacing = static_cast<gpurenderer::FramePacing>(pacing);
+		}
+		if (gFrameScheduler.pacing == gpurenderer::FramePacing::TargetFps) {
+			ImGui::SliderFloat("Target FPS", &gFrameScheduler.targetFps, 10.0f, 240.0f, "%.0f");
+		}
+		if (gHasFenceSync) {
+			ImGui::SliderInt("Frames In Flight", &gFrameScheduler.framesInFlight, 1, kMaxFramesInFlight);
 		} else {
-			ImGui::TextUnformatted("No .obj files discovered under current directory.");
+			ImGui::TextUnformatted("Frames In Flight: driver default (no GL sync objects)");
+		}
+		ImGui::Text("CPU build %.2f ms, fence wait %.2f ms, submit %.2f ms",
+			gFrameScheduler.cpuBuildMs,
+			gFrameScheduler.fenceWaitMs,
+			gFrameScheduler.submitMs);
+		ImGui::Text("Frame time p50 %.2f ms, p99 %.2f ms (%zu fence timeouts)",
+			gFrameScheduler.RecentPercentile(0.5f),
+			gFrameScheduler.RecentPercentile(0.99f),
+			gFrameScheduler.fenceTimeouts);
+		ImGui::PlotHistogram(
+			"##FrameTimeHistogram",
+			gFrameScheduler.histogram.data(),
+			kFrameHistogramBuckets,
+			0,
+			"frame time, 1 ms buckets",
+			0.0f,
+			FLT_MAX,
+			ImVec2(0.0f, 60.0f));
+		if (ImGui::Button("Reset Frame Histogram")) {
+			gFrameScheduler.ResetStatistics();
+		}
+		ImGui::Checkbox("On-Demand Rendering", &gOnDemandRendering);
+		ImGui::Text("Rendered frames: %zu, idle wakeups: %zu", gRenderedFrameCount, gIdleWakeupCount);
+
+		ImGui::Separator();
+		ImGui::Text("Shader Variants: %zu compiled (F6 rebuilds)", gShaderVariants.size());
+		ImGui::Text("Hot reload: %s%s",
+			gShaderWatcher.inotifyFd >= 0 ? "inotify" : "polling",
+			gHasParallelShaderCompile ? ", parallel compile" : "");
+		if (!gShaderReloadStatus.empty()) {
+			ImGui::TextWrapped("%s", gShaderReloadStatus.c_str());
+		}
+		std::vector<std::uint32_t> variantKeys;
+		variantKeys.reserve(gShaderVariants.size());
+		for (const auto& entry : gShaderVariants) {
+			variantKeys.push_back(entry.first);
+		}
+		std::sort(variantKeys.begin(), variantKeys.end());
+		for (std::uint32_t key : variantKeys) {
+			const ShaderVariant& variant = gShaderVariants[key];
+			ImGui::BulletText("%s: %s, %.1f ms, %zu binds",
+				DescribeShaderVariant(key).c_str(),
+				variant.program != 0 ? "ok" : "failed",
+				variant.buildMs,
+				variant.binds);
 		}
 
 		if (!gModelLoadStatus.empty()) {
@@ -3379,11 +9401,34 @@ void main() {
 		ImGui::End();
 	}
 
-	void EndGuiFrame() {
+	void DrawShaderErrorOverlay() {
+		if (!gGuiInitialized || gShaderErrorText.empty()) {
+			return;
+		}
+		const ImGuiIO& io = ImGui::GetIO();
+		ImGui::SetNextWindowPos(ImVec2(io.DisplaySize.x * 0.5f, 12.0f), ImGuiCond_FirstUseEver, ImVec2(0.5f, 0.0f));
+		ImGui::SetNextWindowSize(ImVec2(640.0f, 280.0f), ImGuiCond_FirstUseEver);
+		ImGui::SetNextWindowBgAlpha(0.92f);
+		if (ImGui::Begin("Shader Errors", nullptr, ImGuiWindowFlags_HorizontalScrollbar)) {
+			ImGui::PushStyleColor(ImGuiCol_Text, ImVec4(1.0f, 0.55f, 0.5f, 1.0f));
+			ImGui::TextUnformatted(gShaderErrorText.c_str());
+			ImGui::PopStyleColor();
+		}
+		ImGui::End();
+	}
+
+	// Finalizes the GUI's draw lists on the CPU; RenderGuiDrawData submits them later in the frame.
+	void BuildGuiDrawData() {
 		if (!gGuiInitialized) {
 			return;
 		}
 		ImGui::Render();
+	}
+
+	void RenderGuiDrawData() {
+		if (!gGuiInitialized) {
+			return;
+		}
 		if (gGuiBackend == GuiBackend::OpenGL3) {
 			ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
 		} else if (gGuiBackend == GuiBackend::OpenGL2) {
@@ -3395,10 +9440,10 @@ void main() {
 
 namespace gpurenderer {
 	bool Initialize(GLFWwindow* window, const std::string& objPath) {
+		ResetStartupTimeline();
 		gWindow = window;
 		gObjPath = objPath;
 		CopyObjPathToInput(gObjPath);
-		RefreshAvailableObjFiles();
 
 		if (!gWindow) {
 			std::fprintf(stderr, "Initialize called with null GLFW window.\n");
@@ -3420,51 +9465,160 @@ namespace gpurenderer {
 		if (!LoadGlFunctions()) {
 			return false;
 		}
+		InitializeInstancing();
+		ResetInstanceAttributes();
+		if (gHasInstancing) {
+			std::printf("Instanced rendering enabled.\n");
+		} else {
+			std::printf("Instanced rendering unavailable; drawing instances in a per-instance loop.\n");
+		}
 		InitializeAnisotropicFiltering();
 		if (gHasAnisotropicFiltering) {
 			std::printf("Anisotropic filtering enabled (max %.2fx).\n", gMaxAnisotropy);
 		} else {
 			std::printf("Anisotropic filtering extension not available.\n");
 		}
+		InitializeTextureStreaming();
+		if (gTextureStreamer.supported) {
+			std::printf("Streaming texture uploads through %zu pixel buffers.\n", kUploadRingSlots);
+		} else {
+			std::printf("Pixel buffer streaming unavailable; uploading textures synchronously.\n");
+		}
+		if (InitializeUploadThread()) {
+			StartIoThread();
+			std::printf("Model loads upload on a shared-context thread.\n");
+		} else {
+			std::printf("Shared-context uploads unavailable; loading models on the render thread.\n");
+		}
+		InitializeMaterialBatching();
+		if (gMaterialBatching.supported) {
+			std::printf("Material batching: texture arrays of up to %d layers, filled by %s.\n",
+				gMaterialBatching.maxLayers,
+				gMaterialBatching.hasCopyImage ? "GPU copies" : "readback");
+		} else {
+			std::printf("Texture arrays unavailable; drawing one material at a time.\n");
+		}
+		InitializeTextureCompression();
+		if (gCompressTextures) {
+			std::printf("Texture compression: S3TC %s, RGTC %s, BPTC %s.\n",
+				gHasS3tc ? "yes" : "no",
+				gHasRgtc && gHasTextureSwizzle ? "yes" : "no",
+				gHasBptc ? "yes" : "no");
+		}
 
 		glEnable(GL_DEPTH_TEST);
 		glEnable(GL_TEXTURE_2D);
 
+		// Startup graph, run as jobs: the three file imports and the cube map preparation run on workers
+		// while shaders compile here, each waiting only for the asset root it needs, and the asset
+		// directory scan runs on the indexer's threads. The GL uploads are main thread jobs that run here
+		// as soon as their inputs are ready, in whatever order that happens.
 		std::printf("Loading mesh...\n");
 		std::fflush(stdout);
-		if (!LoadMesh(gObjPath, gVertices, gIndices, gBounds, gSubmeshes, gMaterials)) {
+		gPathCache.Clear();
+		jobs::JobSystem& jobSystem = Jobs();
+		ImportedMesh modelImport;
+		bool modelImported = false;
+		const jobs::Job modelJob = jobSystem.Submit([&modelImport, &modelImported] {
+			RunStartupStep("import model", [&] {
+				modelImported = ImportMesh(gObjPath, modelImport);
+			});
+		});
+		std::filesystem::path assetRoot;
+		const jobs::Job assetRootJob = jobSystem.Submit([&assetRoot] {
+			RunStartupStep("resolve asset root", [&] {
+				assetRoot = ResolveEnvironmentAssetRoot();
+			});
+		});
+		// The two environment jobs fill disjoint members of environmentImport.
+		EnvironmentImport environmentImport;
+		const jobs::Job cubeJob = jobSystem.Submit([&assetRoot, &environmentImport] {
+			RunStartupStep("import background cube", [&] {
+				ImportEnvironmentCube(assetRoot, environmentImport);
+			});
+		}, {assetRootJob});
+		const jobs::Job cubemapJob = jobSystem.Submit([&assetRoot, &environmentImport] {
+			RunStartupStep("prepare cube map", [&] {
+				PrepareEnvironmentCubemap(assetRoot, environmentImport);
+			});
+		}, {assetRootJob});
+		LightObjectImport lightImport;
+		const jobs::Job lightJob = jobSystem.Submit([&assetRoot, &lightImport] {
+			RunStartupStep("import light object", [&] {
+				lightImport = ImportLightObject(assetRoot);
+			});
+		}, {assetRootJob});
+		// The jobs above write to locals of this frame, so every return below waits for them first.
+		const jobs::Job importsDone = jobSystem.Submit([] {}, {modelJob, cubeJob, cubemapJob, lightJob});
+		StartAssetIndex();
+
+		InitializeProgramBinaryCache();
+		InitializeParallelShaderCompile();
+		const auto shaderStart = std::chrono::steady_clock::now();
+		bool shadersReady = false;
+		RunStartupStep("compile shaders", [&] {
+			shadersReady = ReloadShaders() && ReloadBuiltinShaders();
+		});
+		if (!shadersReady) {
+			jobSystem.Wait(importsDone);
 			return false;
 		}
-		gIndexCount = static_cast<int>(gIndices.size());
-
-		gCenter = gBounds.Center();
-		const float extent = std::max(gBounds.MaxExtent(), 1.0f);
-		gObjectCamera.distance = extent * 2.5f;
-		gObjectCamera.yawDeg = 0.0f;
-		gObjectCamera.pitchDeg = 0.0f;
-		gObjectCamera.panX = 0.0f;
-		gObjectCamera.panY = 0.0f;
-		gPlaneHeight = (gBounds.min.y - gCenter.y) - (extent * kPlanePaddingRatio);
-		gPlaneWidth = 2.0f * extent * kPlaneSizeMultiplier;
-		gPlaneLength = 2.0f * extent * kPlaneSizeMultiplier;
-		gPlaneScale = 1.0f;
-		gObjectScale = glm::vec3(1.0f);
-		gLightMarkerScale = 1.0f;
-		gLightDistance = extent * 1.8f;
-		gNearPlane = std::max(0.1f, extent * 0.001f);
-		gFarPlane = std::max(kFarPlane, gObjectCamera.distance + extent * 3.0f);
+		if (gHasProgramBinary) {
+			std::printf("Program binary cache: %d hit(s), %d miss(es), %d rejected, %.1f ms (%s).\n",
+				gProgramCacheStats.hits,
+				gProgramCacheStats.misses,
+				gProgramCacheStats.rejected,
+				ElapsedMilliseconds(shaderStart),
+				gProgramCacheDir.string().c_str());
+		} else {
+			std::printf("Program binary cache unavailable (no program binary formats); compiled shaders in %.1f ms.\n",
+				ElapsedMilliseconds(shaderStart));
+		}
+		StartShaderWatcher();
 
-		if (!ReloadShaders() || !ReloadDepthShader()) {
+		size_t initialVertexCount = 0;
+		size_t initialIndexCount = 0;
+		bool modelAdded = false;
+		const jobs::Job modelUpload = jobSystem.SubmitToMainThread([&] {
+			if (!modelImported) {
+				return;
+			}
+			initialVertexCount = modelImport.vertices.size();
+			initialIndexCount = modelImport.indices.size();
+			RunStartupStep("upload model", [&] {
+				SceneModel initialModel;
+				std::vector<Material> initialMaterials;
+				FinishSceneModel(modelImport, initialModel, initialMaterials);
+				modelAdded = AddSceneModel(std::move(initialModel), std::move(initialMaterials));
+			});
+			if (!modelAdded) {
+				return;
+			}
+			UpdateSceneBounds();
+			gObjectCamera.yawDeg = 0.0f;
+			gObjectCamera.pitchDeg = 0.0f;
+			FrameSceneBounds();
+			CreatePlaneBuffers();
+		}, {modelJob});
+		bool environmentReady = false;
+		const jobs::Job environmentUpload = jobSystem.SubmitToMainThread([&] {
+			RunStartupStep("upload environment", [&] {
+				environmentReady = FinishEnvironmentAssets(assetRoot, environmentImport);
+			});
+		}, {cubeJob, cubemapJob});
+		const jobs::Job lightUpload = jobSystem.SubmitToMainThread([&] {
+			RunStartupStep("upload light buffers", [&] {
+				CreateLightBuffers(std::move(lightImport));
+			});
+		}, {lightJob});
+		jobSystem.Wait({importsDone, modelUpload, environmentUpload, lightUpload});
+		if (!modelAdded) {
 			return false;
 		}
-
-		CreateBuffers();
-		CreatePlaneBuffers();
-		if (!InitializeEnvironmentAssets()) {
+		if (!environmentReady) {
 			std::fprintf(stderr, "%s\n", gEnvironmentLoadStatus.c_str());
 			return false;
 		}
-		CreateLightBuffers();
 
 		if (!InitializeGui(gWindow)) {
 			std::fprintf(stderr, "Failed to initialize GUI backend.\n");
@@ -3484,80 +9638,305 @@ namespace gpurenderer {
 		Reshape(gWindow, fbWidth, fbHeight);
 		UpdateWindowTitle();
 		CopyObjPathToInput(gObjPath);
-		RefreshAvailableObjFiles();
+		gSelectedModelPath = IndexedModelPath(gObjPath);
 		gModelLoadStatus = "Loaded model: " + gObjPath;
 
 		std::printf("%s\n", gEnvironmentLoadStatus.c_str());
 		std::printf("Controls: Left/right drag = object rotate/zoom, middle drag = pan, CTRL+left drag = light rotate, P = toggle projection, N = normals, F6 = reload shaders.\n");
-		std::printf("Loaded %d triangles (%zu vertices) from %s\n", gIndexCount / 3, gVertices.size(), gObjPath.c_str());
+		std::printf("Loaded %zu triangles (%zu vertices) from %s\n", initialIndexCount / 3, initialVertexCount, gObjPath.c_str());
+		PrintStartupTimeline();
 		return true;
 	}
 
 	void RenderFrame() {
+		// CPU half: GUI and draw lists. This runs while the GPU is still busy with earlier frames.
+		const auto buildStart = std::chrono::steady_clock::now();
+		if (gJobSystem) {
+			gJobSystem->RunMainThreadJobs();
+		}
+		if (IsUploadThreadActive()) {
+			PollUploadThread(false);
+			RunRenderThreadWork();
+		}
 		BeginGuiFrame();
 		DrawGuiPanel();
-		Display();
-		EndGuiFrame();
+		DrawShaderErrorOverlay();
+		gGuiAnimating = gGuiInitialized && ImGui::IsAnyItemActive();
+		BuildGuiDrawData();
+		const bool renderScene = CanRenderScene();
+		FramePlan plan;
+		if (renderScene) {
+			UpdateMaterialBatches();
+			plan = PrepareFramePlan();
+		}
+		gFrameScheduler.cpuBuildMs = static_cast<float>(ElapsedMilliseconds(buildStart));
+
+		WaitForFrameSlot();
+		const auto submitStart = std::chrono::steady_clock::now();
+		if (renderScene) {
+			UpdateTextureResidency(plan);
+		}
+		UpdateTextureStreaming(static_cast<size_t>(gTextureStreamer.budgetMb) * 1024u * 1024u);
+		if (renderScene) {
+			SubmitFramePlan(plan);
+		}
+		if (gSoftwareCaptureRequested) {
+			gSoftwareCaptureRequested = false;
+			CaptureSoftwareReference();
+		}
+		RenderGuiDrawData();
+		EndFrameSubmission();
+		gFrameScheduler.submitMs = static_cast<float>(ElapsedMilliseconds(submitStart));
+		++gRenderedFrameCount;
 	}
 
-	void Shutdown() {
-		ShutdownGui();
-		DestroyBackgroundBuffers();
-		DestroyLightBuffers();
+	void SetOnDemandRendering(bool enabled) {
+		gOnDemandRendering = enabled;
+		MarkSceneDirty();
+	}
 
-		if (pglDeleteBuffers) {
-			if (gEbo != 0) {
-				pglDeleteBuffers(1, &gEbo);
-			}
-			if (gVbo != 0) {
-				pglDeleteBuffers(1, &gVbo);
-			}
-			if (gPlaneEbo != 0) {
-				pglDeleteBuffers(1, &gPlaneEbo);
+	void SetTextureCompression(bool enabled) {
+		gCompressTextures = enabled;
+	}
+
+	bool PumpEvents() {
+		if (UpdateShaderHotReload()) {
+			MarkSceneDirty();
+		}
+		if (gAssetIndexer.Poll()) {
+			MarkSceneDirty();
+		}
+		// Keeps an on-demand loop drawing until every placeholder has been replaced and every finished
+		// upload published. Model loads otherwise wake the loop only when they hand it work.
+		if (HasPendingTextureUploads() || HasFencedUploads()) {
+			MarkSceneDirty();
+		}
+		if (!gOnDemandRendering) {
+			glfwPollEvents();
+			return true;
+		}
+		if (gPendingRedrawFrames > 0 || gGuiAnimating || gRedrawRequested.load()) {
+			glfwPollEvents();
+		} else {
+			glfwWaitEventsTimeout(config::kIdleWaitTimeoutSeconds);
+		}
+		if (gRedrawRequested.exchange(false)) {
+			MarkSceneDirty();
+		}
+		if (gPendingRedrawFrames > 0 || gGuiAnimating) {
+			gPendingRedrawFrames = std::max(gPendingRedrawFrames - 1, 0);
+			return true;
+		}
+		++gIdleWakeupCount;
+		// The gap spent idling is not a frame time; restart interval measurement at the next frame.
+		gFrameScheduler.lastPresent = {};
+		return false;
+	}
+
+	void RequestRedraw() {
+		gRedrawRequested.store(true);
+		glfwPostEmptyEvent();
+	}
+
+	void ConfigureFramePacing(const FramePacingOptions& options) {
+		gFrameScheduler.pacing = options.pacing;
+		gFrameScheduler.targetFps = static_cast<float>(std::max(options.targetFps, 1.0));
+		gFrameScheduler.framesInFlight = std::clamp(options.framesInFlight, 1, config::kMaxFramesInFlight);
+		gFrameScheduler.nextDeadline = {};
+		ApplySwapInterval();
+	}
+
+	void FinishFrame() {
+		FrameScheduler& scheduler = gFrameScheduler;
+		if (scheduler.pacing == FramePacing::TargetFps) {
+			const auto period = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+				std::chrono::duration<double>(1.0 / std::max(scheduler.targetFps, 1.0f)));
+			const auto now = std::chrono::steady_clock::now();
+			if (scheduler.nextDeadline == std::chrono::steady_clock::time_point{} || scheduler.nextDeadline + period < now) {
+				// First frame, or more than a period behind: restart the cadence instead of bursting to catch up.
+				scheduler.nextDeadline = now + period;
 			}
-			if (gPlaneVbo != 0) {
-				pglDeleteBuffers(1, &gPlaneVbo);
+			std::this_thread::sleep_until(scheduler.nextDeadline);
+			scheduler.nextDeadline += period;
+		} else {
+			scheduler.nextDeadline = {};
+		}
+
+		const auto presented = std::chrono::steady_clock::now();
+		if (scheduler.lastPresent != std::chrono::steady_clock::time_point{}) {
+			scheduler.RecordFrameTime(std::chrono::duration<float, std::milli>(presented - scheduler.lastPresent).count());
+		}
+		scheduler.lastPresent = presented;
+		ApplySwapInterval();
+	}
+
+	int RunSoftwareRenderer(const SoftwareRenderOptions& options) {
+		gSoftwareOnly = true;
+		gObjPath = options.objPath;
+		gWindowWidth = std::max(options.width, 1);
+		gWindowHeight = std::max(options.height, 1);
+		stbi_set_flip_vertically_on_load(true);
+
+		std::printf("Loading mesh (software renderer)...\n");
+		std::fflush(stdout);
+		SceneModel initialModel;
+		std::vector<Material> initialMaterials;
+		if (!LoadSceneModel(gObjPath, initialModel, initialMaterials) ||
+			!AddSceneModel(std::move(initialModel), std::move(initialMaterials))) {
+			std::fprintf(stderr, "Failed to load model: %s\n", gObjPath.c_str());
+			return 1;
+		}
+		UpdateSceneBounds();
+		gObjectCamera.yawDeg = 0.0f;
+		gObjectCamera.pitchDeg = 0.0f;
+		FrameSceneBounds();
+		CreatePlaneBuffers();
+		if (!InitializeEnvironmentAssets()) {
+			std::fprintf(stderr, "%s Rendering without the environment map.\n", gEnvironmentLoadStatus.c_str());
+		}
+		CreateLightBuffers(ImportLightObject(gAssetRoot));
+
+		software::ColorTarget image;
+		software::RasterStats stats;
+		gPassTimingSink = options.passTimings;
+		for (int frame = 0; frame < std::max(options.frameCount, 1); ++frame) {
+			const auto frameStart = std::chrono::steady_clock::now();
+			stats = RenderSoftwareFrame(gWindowWidth, gWindowHeight, image);
+			if (gPassTimingSink != nullptr) {
+				gPassTimingSink->frameMs += ElapsedMilliseconds(frameStart);
+				++gPassTimingSink->frames;
 			}
 		}
-		if (gUseVao && pglDeleteVertexArrays) {
-			if (gVao != 0) {
-				pglDeleteVertexArrays(1, &gVao);
+		gPassTimingSink = nullptr;
+		std::printf("Software frame %dx%d: %.1f ms, %zu of %zu triangles rasterized, %zu fragments shaded.\n",
+			image.width,
+			image.height,
+			stats.milliseconds,
+			stats.trianglesRasterized,
+			stats.trianglesSubmitted,
+			stats.fragmentsShaded);
+
+		int result = 0;
+		if (!options.outputPath.empty()) {
+			if (software::WritePpm(image, options.outputPath)) {
+				std::printf("Wrote %s\n", options.outputPath.c_str());
+			} else {
+				result = 1;
 			}
-			if (gPlaneVao != 0) {
-				pglDeleteVertexArrays(1, &gPlaneVao);
+		}
+		if (!options.goldenPath.empty()) {
+			software::ColorTarget golden;
+			if (!software::ReadPpm(options.goldenPath, golden)) {
+				result = 1;
+			} else {
+				const software::ImageComparison comparison = software::CompareImages(golden, image, options.goldenTolerance);
+				if (comparison.sizeMismatch) {
+					std::fprintf(stderr, "Golden image %s is %dx%d, rendered frame is %dx%d.\n",
+						options.goldenPath.c_str(), golden.width, golden.height, image.width, image.height);
+					result = 1;
+				} else {
+					std::printf("Golden comparison: RMSE %.3f, max error %.0f, %zu pixels over tolerance %.0f.\n",
+						comparison.rmse, comparison.maxError, comparison.differingPixels, options.goldenTolerance);
+					if (comparison.differingPixels > 0) {
+						std::fprintf(stderr, "Rendered frame does not match %s.\n", options.goldenPath.c_str());
+						result = 1;
+					}
+				}
 			}
 		}
-		if (gProgram != 0) {
-			pglDeleteProgram(gProgram);
-			gProgram = 0;
+
+		ClearScene();
+		DestroyBackgroundBuffers();
+		DestroyLightBuffers();
+		ReleaseArenaMesh(gPlaneMesh);
+		ClearTextureCache();
+		gSoftwareTextures.clear();
+		gSoftwareEnvironment = software::CubeTexture{};
+		gEnvironmentCubemap = 0;
+		gIrradianceCubemap = 0;
+		gGeometryArena = GeometryArena{};
+		gSoftwareOnly = false;
+		return result;
+	}
+
+	const LoadTimings& GetLastLoadTimings() {
+		return gLastLoadTimings;
+	}
+
+	PassTimings MeasureFramePasses(int frameCount) {
+		if (CanRenderScene()) {
+			UpdateMaterialBatches(true);
+			const FramePlan plan = PrepareFramePlan();
+			FlushTextureUploads(&plan);
+		} else {
+			FlushTextureUploads();
+		}
+		PassTimings timings;
+		gPassTimingSink = &timings;
+		for (int frame = 0; frame < std::max(frameCount, 1); ++frame) {
+			const auto frameStart = std::chrono::steady_clock::now();
+			Display();
+			glFinish();
+			timings.frameMs += ElapsedMilliseconds(frameStart);
+			++timings.frames;
+			if (gWindow) {
+				glfwSwapBuffers(gWindow);
+			}
 		}
-		if (gDepthProgram != 0) {
-			pglDeleteProgram(gDepthProgram);
-			gDepthProgram = 0;
+		gPassTimingSink = nullptr;
+		return timings;
+	}
+
+	void Shutdown() {
+		ShutdownGui();
+		DestroyBackgroundBuffers();
+		DestroyLightBuffers();
+		DestroyInstanceBuffer();
+		DestroyFrameFences();
+		DestroyTextureArrays();
+		// Loads in flight go stale; their remaining stages still run and give back what they hold.
+		++gModelLoadGeneration;
+		while (HasModelLoadsInFlight()) {
+			RunRenderThreadWork();
+			PollUploadThread(false);
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+		StopIoThread();
+		ShutdownUploadThread();
+		ShutdownTextureStreaming();
+		gJobSystem.reset();
+		ReleaseArenaMesh(gPlaneMesh);
+		ClearScene();
+		DestroyGeometryArena(gGeometryArena);
+
+		gAssetIndexer.Stop();
+		StopShaderWatcher();
+		CancelShaderReload();
+		gShaderErrorText.clear();
+		gShaderReloadStatus.clear();
+		DestroyShaderVariants();
+		for (GLuint* program : {&gDepthProgram, &gSkyboxProgram, &gUnlitProgram}) {
+			if (*program != 0) {
+				pglDeleteProgram(*program);
+				*program = 0;
+			}
 		}
 		if (gEnvironmentCubemap != 0) {
 			glDeleteTextures(1, &gEnvironmentCubemap);
 			gEnvironmentCubemap = 0;
 		}
-		if (!gTextureCache.empty()) {
-			std::vector<GLuint> textures;
-			textures.reserve(gTextureCache.size());
-			for (const auto& entry : gTextureCache) {
-				if (entry.second != 0) {
-					textures.push_back(entry.second);
-				}
-			}
-			if (!textures.empty()) {
-				glDeleteTextures(static_cast<GLsizei>(textures.size()), textures.data());
-			}
+		if (gIrradianceCubemap != 0) {
+			glDeleteTextures(1, &gIrradianceCubemap);
+			gIrradianceCubemap = 0;
 		}
+		ClearTextureCache();
 		DestroyRenderTexture();
 		DestroyShadowMap();
-		gTextureCache.clear();
 		gWindow = nullptr;
 	}
 
 	void OnFramebufferSize(GLFWwindow* window, int width, int height) {
+		MarkSceneDirty();
 		Reshape(window, width, height);
 	}
 
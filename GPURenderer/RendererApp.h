@@ -2,6 +2,7 @@
 
 #include <GLFW/glfw3.h>
 
+#include <cstddef>
 #include <string>
 
 namespace gpurenderer {
@@ -9,12 +10,98 @@ namespace gpurenderer {
 		inline constexpr int kDefaultWindowWidth = 1500;
 		inline constexpr int kDefaultWindowHeight = 520;
 		inline constexpr const char* kWindowTitleBase = "GPURenderer - Project 7";
-		inline constexpr const char* kUsageFormat = "Usage: %s <model.obj> [width height]\n";
+		inline constexpr const char* kUsageFormat =
+			"Usage: %s <model.obj> [width height] [--software <out.ppm>] [--golden <reference.ppm>] [--golden-tolerance <0-255>]\n"
+			"          [--pacing vsync|uncapped|<fps>] [--frames-in-flight <1-3>] [--on-demand]\n"
+			"          [--compress-textures]\n";
+		inline constexpr const char* kSoftwareFallbackOutput = "software_frame.ppm";
+		inline constexpr double kDefaultGoldenTolerance = 2.0;
+		inline constexpr double kDefaultTargetFps = 60.0;
+		inline constexpr int kDefaultFramesInFlight = 2;
+		inline constexpr int kMaxFramesInFlight = 3;
+		// Longest an on-demand loop sleeps in glfwWaitEventsTimeout before re-checking for work.
+		inline constexpr double kIdleWaitTimeoutSeconds = 0.5;
 	}
 
+	enum class FramePacing {
+		VSync,
+		Uncapped,
+		TargetFps
+	};
+
+	struct FramePacingOptions {
+		FramePacing pacing = FramePacing::VSync;
+		double targetFps = config::kDefaultTargetFps;
+		// How many submitted frames the CPU may run ahead of the GPU; needs GL 3.2 or ARB_sync.
+		int framesInFlight = config::kDefaultFramesInFlight;
+	};
+
+	// Wall time of each stage of the most recent model load, in milliseconds.
+	struct LoadTimings {
+		double importMs = 0.0;
+		// Vertex/index assembly, excluding normal generation.
+		double meshBuildMs = 0.0;
+		double normalsMs = 0.0;
+		double textureDecodeMs = 0.0;
+		double textureUploadMs = 0.0;
+		double geometryUploadMs = 0.0;
+		size_t vertices = 0;
+		size_t triangles = 0;
+		size_t materials = 0;
+		size_t textures = 0;
+		// Paths resolved through the directory-listing cache, and the file system calls that cost.
+		size_t pathLookups = 0;
+		size_t directoryReads = 0;
+		size_t statCalls = 0;
+	};
+
+	// Per-pass wall time summed over `frames` frames, in milliseconds. GL passes are drained with
+	// glFinish before each lap so the time lands on the pass that issued the work.
+	struct PassTimings {
+		double shadowMs = 0.0;
+		double reflectionMs = 0.0;
+		double mainMs = 0.0;
+		double frameMs = 0.0;
+		int frames = 0;
+	};
+
+	struct SoftwareRenderOptions {
+		std::string objPath;
+		int width = config::kDefaultWindowWidth;
+		int height = config::kDefaultWindowHeight;
+		std::string outputPath;
+		std::string goldenPath;
+		// Largest per-channel difference (0-255) a pixel may have before it counts as a mismatch.
+		double goldenTolerance = config::kDefaultGoldenTolerance;
+		// Frames rendered before the last one is written; only useful together with passTimings.
+		int frameCount = 1;
+		PassTimings* passTimings = nullptr;
+	};
+
 	bool Initialize(GLFWwindow* window, const std::string& objPath);
 	void Shutdown();
 	void RenderFrame();
+	void ConfigureFramePacing(const FramePacingOptions& options);
+	// Call after glfwSwapBuffers: waits out the target-FPS deadline and records the frame interval.
+	void FinishFrame();
+	// In on-demand mode only frames with pending changes are rendered; otherwise every iteration is.
+	void SetOnDemandRendering(bool enabled);
+	// Block-compresses textures loaded from now on where the driver supports BC formats. Call before
+	// Initialize to cover the startup model.
+	void SetTextureCompression(bool enabled);
+	// Processes window events, sleeping until input arrives when on-demand rendering has nothing to
+	// draw. Returns true when the caller should render a frame.
+	bool PumpEvents();
+	// Marks the scene as changed and wakes an idle loop. Safe to call from any thread, e.g. when a
+	// background load finishes.
+	void RequestRedraw();
+	// Renders one frame of the default view with the CPU reference rasterizer; needs no window or GL
+	// context. Returns 0 on success, nonzero on load/write failure or a golden-image mismatch.
+	int RunSoftwareRenderer(const SoftwareRenderOptions& options);
+	const LoadTimings& GetLastLoadTimings();
+	// Draws frameCount frames of the current view without the GUI and reports where the time went.
+	// Requires a successful Initialize.
+	PassTimings MeasureFramePasses(int frameCount);
 
 	void OnFramebufferSize(GLFWwindow* window, int width, int height);
 	void OnMouseButton(GLFWwindow* window, int button, int action, int mods);
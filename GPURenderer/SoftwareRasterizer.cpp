@@ -0,0 +1,1025 @@
+#include "SoftwareRasterizer.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <thread>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define GPURENDERER_SOFTWARE_SSE2 1
+#endif
+
+namespace gpurenderer::software {
+	namespace {
+		constexpr int kTileSize = 64;
+		constexpr size_t kVertexChunk = 4096;
+		constexpr size_t kPrimitiveChunk = 2048;
+		constexpr std::uint32_t kExtraVertexFlag = 0x80000000u;
+		constexpr float kDepthUnit = 1.0f / 16777216.0f;
+
+		// Outputs of shader.vert in declaration order, interpolated as a flat float array.
+		struct Varyings {
+			glm::vec3 normal;
+			glm::vec3 positionView;
+			glm::vec2 texcoord;
+			glm::vec3 worldNormal;
+			glm::vec3 worldPosition;
+			glm::vec4 reflectionClip;
+			glm::vec4 lightClipPos;
+		};
+		constexpr size_t kVaryingCount = 22;
+		using VaryingArray = std::array<float, kVaryingCount>;
+		static_assert(sizeof(Varyings) == sizeof(VaryingArray), "Varyings must be tightly packed floats.");
+
+		struct ClipVertex {
+			glm::vec4 clip{0.0f};
+			VaryingArray varyings{};
+		};
+
+		// Screen-space triangle after clipping, oriented counter-clockwise. v[] indexes the vertex pool.
+		struct SetupTriangle {
+			std::array<std::uint32_t, 3> v{};
+			std::array<float, 3> x{};
+			std::array<float, 3> y{};
+			std::array<float, 3> z{};
+			std::array<float, 3> invW{};
+			float area = 0.0f;
+			float depthOffset = 0.0f;
+			int minX = 0;
+			int minY = 0;
+			int maxX = 0;
+			int maxY = 0;
+			std::uint32_t drawIndex = 0;
+		};
+
+		struct AssemblyChunk {
+			std::vector<SetupTriangle> triangles;
+			std::vector<ClipVertex> extraVertices;
+		};
+
+		struct WorkRange {
+			size_t draw = 0;
+			size_t begin = 0;
+			size_t end = 0;
+		};
+
+#ifdef GPURENDERER_SOFTWARE_SSE2
+		struct Float4 {
+			__m128 v;
+		};
+
+		Float4 Splat(float value) {
+			return Float4{_mm_set1_ps(value)};
+		}
+
+		Float4 Ramp(float start) {
+			return Float4{_mm_setr_ps(start, start + 1.0f, start + 2.0f, start + 3.0f)};
+		}
+
+		Float4 MulAdd(const Float4& a, const Float4& b, const Float4& c) {
+			return Float4{_mm_add_ps(_mm_mul_ps(a.v, b.v), c.v)};
+		}
+
+		// Lane mask of edge values that pass the fill rule: >= 0 on top-left edges, > 0 elsewhere.
+		int EdgeMask(const Float4& value, bool inclusive) {
+			const __m128 zero = _mm_setzero_ps();
+			return _mm_movemask_ps(inclusive ? _mm_cmpge_ps(value.v, zero) : _mm_cmpgt_ps(value.v, zero));
+		}
+
+		float Lane(const Float4& value, int lane) {
+			alignas(16) float lanes[4];
+			_mm_store_ps(lanes, value.v);
+			return lanes[lane];
+		}
+#else
+		struct Float4 {
+			std::array<float, 4> v;
+		};
+
+		Float4 Splat(float value) {
+			return Float4{{value, value, value, value}};
+		}
+
+		Float4 Ramp(float start) {
+			return Float4{{start, start + 1.0f, start + 2.0f, start + 3.0f}};
+		}
+
+		Float4 MulAdd(const Float4& a, const Float4& b, const Float4& c) {
+			Float4 result;
+			for (int i = 0; i < 4; ++i) {
+				result.v[i] = a.v[i] * b.v[i] + c.v[i];
+			}
+			return result;
+		}
+
+		int EdgeMask(const Float4& value, bool inclusive) {
+			int mask = 0;
+			for (int i = 0; i < 4; ++i) {
+				if (inclusive ? value.v[i] >= 0.0f : value.v[i] > 0.0f) {
+					mask |= 1 << i;
+				}
+			}
+			return mask;
+		}
+
+		float Lane(const Float4& value, int lane) {
+			return value.v[lane];
+		}
+#endif
+
+		int ResolveThreadCount(int requested) {
+			if (requested > 0) {
+				return requested;
+			}
+			const unsigned int hardware = std::thread::hardware_concurrency();
+			return hardware > 0 ? static_cast<int>(hardware) : 1;
+		}
+
+		// Runs worker(threadIndex) on threadCount threads, the caller being thread 0.
+		void RunParallel(int threadCount, const std::function<void(int)>& worker) {
+			std::vector<std::thread> threads;
+			threads.reserve(static_cast<size_t>(std::max(threadCount - 1, 0)));
+			for (int i = 1; i < threadCount; ++i) {
+				threads.emplace_back(worker, i);
+			}
+			worker(0);
+			for (std::thread& thread : threads) {
+				thread.join();
+			}
+		}
+
+		// Hands out indices [0, count) to threadCount workers until exhausted.
+		void ParallelFor(int threadCount, size_t count, const std::function<void(size_t)>& body) {
+			std::atomic<size_t> next{0};
+			RunParallel(std::min<int>(threadCount, static_cast<int>(std::max<size_t>(count, 1))), [&](int) {
+				for (size_t i = next.fetch_add(1); i < count; i = next.fetch_add(1)) {
+					body(i);
+				}
+				});
+		}
+
+		glm::vec3 SafeNormalize(const glm::vec3& value) {
+			const float lengthSq = glm::dot(value, value);
+			return lengthSq > 0.0f ? value / std::sqrt(lengthSq) : value;
+		}
+
+		glm::vec3 Reflect(const glm::vec3& incident, const glm::vec3& normal) {
+			return incident - 2.0f * glm::dot(normal, incident) * normal;
+		}
+
+		VaryingArray PackVaryings(const Varyings& varyings) {
+			VaryingArray packed;
+			std::memcpy(packed.data(), &varyings, sizeof(Varyings));
+			return packed;
+		}
+
+		Varyings UnpackVaryings(const VaryingArray& packed) {
+			Varyings varyings;
+			std::memcpy(&varyings, packed.data(), sizeof(Varyings));
+			return varyings;
+		}
+
+		ClipVertex RunVertexShader(const DrawCall& draw, const Vertex& vertex, bool computeVaryings) {
+			const ShaderUniforms& u = draw.uniforms;
+			const glm::vec4 localPos = draw.instanceModel * glm::vec4(vertex.position, 1.0f);
+			ClipVertex result;
+			result.clip = u.mvp * localPos;
+			if (!computeVaryings) {
+				return result;
+			}
+			const glm::vec3 localNormal = draw.instanceNormal * vertex.normal;
+			const glm::vec4 worldPos = u.model * localPos;
+			const glm::vec4 viewPos = u.view * worldPos;
+			Varyings varyings;
+			varyings.positionView = glm::vec3(viewPos);
+			varyings.normal = SafeNormalize(u.normalMatrix * localNormal);
+			varyings.worldNormal = SafeNormalize(u.worldNormalMatrix * localNormal);
+			varyings.worldPosition = glm::vec3(worldPos);
+			varyings.reflectionClip = u.reflectionViewProj * worldPos;
+			varyings.lightClipPos = u.lightViewProj * worldPos;
+			varyings.texcoord = vertex.texcoord;
+			result.varyings = PackVaryings(varyings);
+			return result;
+		}
+
+		ClipVertex LerpClipVertex(const ClipVertex& a, const ClipVertex& b, float t) {
+			ClipVertex result;
+			result.clip = a.clip + (b.clip - a.clip) * t;
+			for (size_t i = 0; i < kVaryingCount; ++i) {
+				result.varyings[i] = a.varyings[i] + (b.varyings[i] - a.varyings[i]) * t;
+			}
+			return result;
+		}
+
+		// Sutherland-Hodgman against the near (z >= -w) and far (z <= w) clip planes; x/y are left to
+		// the viewport scissor. Returns the vertex count of the clipped polygon (0, or 3..5).
+		int ClipAgainstDepthPlanes(std::array<ClipVertex, 8>& polygon, int count) {
+			std::array<ClipVertex, 8> scratch;
+			for (int plane = 0; plane < 2; ++plane) {
+				auto distance = [plane](const ClipVertex& vertex) {
+					return plane == 0 ? vertex.clip.z + vertex.clip.w : vertex.clip.w - vertex.clip.z;
+				};
+				int outCount = 0;
+				for (int i = 0; i < count; ++i) {
+					const ClipVertex& current = polygon[static_cast<size_t>(i)];
+					const ClipVertex& next = polygon[static_cast<size_t>((i + 1) % count)];
+					const float dCurrent = distance(current);
+					const float dNext = distance(next);
+					if (dCurrent >= 0.0f) {
+						scratch[static_cast<size_t>(outCount++)] = current;
+					}
+					if ((dCurrent >= 0.0f) != (dNext >= 0.0f)) {
+						scratch[static_cast<size_t>(outCount++)] = LerpClipVertex(current, next, dCurrent / (dCurrent - dNext));
+					}
+				}
+				count = outCount;
+				polygon = scratch;
+				if (count < 3) {
+					return 0;
+				}
+			}
+			return count;
+		}
+
+		// Projects three clip-space vertices to window space. Returns false for degenerate or off-screen
+		// triangles.
+		bool SetupScreenTriangle(
+			const std::array<const ClipVertex*, 3>& vertices,
+			const std::array<std::uint32_t, 3>& refs,
+			int width,
+			int height,
+			SetupTriangle& triangle) {
+			for (int i = 0; i < 3; ++i) {
+				const glm::vec4& clip = vertices[static_cast<size_t>(i)]->clip;
+				if (clip.w <= 0.0f) {
+					return false;
+				}
+				const float invW = 1.0f / clip.w;
+				triangle.x[i] = (clip.x * invW * 0.5f + 0.5f) * static_cast<float>(width);
+				triangle.y[i] = (clip.y * invW * 0.5f + 0.5f) * static_cast<float>(height);
+				triangle.z[i] = clip.z * invW * 0.5f + 0.5f;
+				triangle.invW[i] = invW;
+				triangle.v[i] = refs[static_cast<size_t>(i)];
+			}
+			float area =
+				(triangle.x[1] - triangle.x[0]) * (triangle.y[2] - triangle.y[0]) -
+				(triangle.y[1] - triangle.y[0]) * (triangle.x[2] - triangle.x[0]);
+			if (!(std::abs(area) > 1e-8f)) {
+				return false;
+			}
+			if (area < 0.0f) {
+				std::swap(triangle.x[1], triangle.x[2]);
+				std::swap(triangle.y[1], triangle.y[2]);
+				std::swap(triangle.z[1], triangle.z[2]);
+				std::swap(triangle.invW[1], triangle.invW[2]);
+				std::swap(triangle.v[1], triangle.v[2]);
+				area = -area;
+			}
+			triangle.area = area;
+
+			const float minX = std::min({triangle.x[0], triangle.x[1], triangle.x[2]});
+			const float maxX = std::max({triangle.x[0], triangle.x[1], triangle.x[2]});
+			const float minY = std::min({triangle.y[0], triangle.y[1], triangle.y[2]});
+			const float maxY = std::max({triangle.y[0], triangle.y[1], triangle.y[2]});
+			triangle.minX = std::max(0, static_cast<int>(std::ceil(std::max(minX - 0.5f, -1.0f))));
+			triangle.minY = std::max(0, static_cast<int>(std::ceil(std::max(minY - 0.5f, -1.0f))));
+			triangle.maxX = std::min(width - 1, static_cast<int>(std::floor(std::min(maxX - 0.5f, static_cast<float>(width)))));
+			triangle.maxY = std::min(height - 1, static_cast<int>(std::floor(std::min(maxY - 0.5f, static_cast<float>(height)))));
+			return triangle.minX <= triangle.maxX && triangle.minY <= triangle.maxY;
+		}
+
+		float ComputePolygonOffset(const SetupTriangle& triangle, float factor, float units) {
+			if (factor == 0.0f && units == 0.0f) {
+				return 0.0f;
+			}
+			const float dzdx =
+				((triangle.z[1] - triangle.z[0]) * (triangle.y[2] - triangle.y[0]) -
+					(triangle.z[2] - triangle.z[0]) * (triangle.y[1] - triangle.y[0])) / triangle.area;
+			const float dzdy =
+				((triangle.x[1] - triangle.x[0]) * (triangle.z[2] - triangle.z[0]) -
+					(triangle.x[2] - triangle.x[0]) * (triangle.z[1] - triangle.z[0])) / triangle.area;
+			return factor * std::max(std::abs(dzdx), std::abs(dzdy)) + units * kDepthUnit;
+		}
+
+		float ComputeSpotFactor(const ShaderUniforms& u, const Varyings& v) {
+			if (!u.useSpotLight) {
+				return 1.0f;
+			}
+			const glm::vec3 lightToFrag = SafeNormalize(v.positionView - u.lightPosView);
+			const float theta = glm::dot(lightToFrag, SafeNormalize(u.lightDirView));
+			const float denom = std::max(u.spotCosInner - u.spotCosOuter, 0.0001f);
+			return std::clamp((theta - u.spotCosOuter) / denom, 0.0f, 1.0f);
+		}
+
+		float ComputeShadowFactor(const ShaderUniforms& u, const Varyings& v, const glm::vec3& n, const glm::vec3& lightDir) {
+			if (u.shadowMap == nullptr) {
+				return 1.0f;
+			}
+			if (std::abs(v.lightClipPos.w) <= 0.0001f) {
+				return 1.0f;
+			}
+			const glm::vec3 projCoords = glm::vec3(v.lightClipPos) / v.lightClipPos.w * 0.5f + glm::vec3(0.5f);
+			if (projCoords.x < 0.0f || projCoords.x > 1.0f ||
+				projCoords.y < 0.0f || projCoords.y > 1.0f ||
+				projCoords.z <= 0.0f || projCoords.z >= 1.0f) {
+				return 1.0f;
+			}
+			const float baseBias = std::max(glm::dot(n, lightDir), 0.0f);
+			const float bias = std::max(u.shadowBias * (2.0f - baseBias), 0.000005f);
+			const float closestDepth = u.shadowMap->Sample(glm::vec2(projCoords.x, projCoords.y));
+			return (projCoords.z - bias <= closestDepth) ? 1.0f : 0.0f;
+		}
+
+		// Line-by-line port of shader.frag's main().
+		glm::vec3 ShadeFragment(const ShaderUniforms& u, const Varyings& v) {
+			if (u.shadeMode == ShadeMode::Normals) {
+				return glm::clamp(v.normal, glm::vec3(0.0f), glm::vec3(1.0f));
+			}
+			if (u.shadeMode == ShadeMode::Marker) {
+				return u.markerColor;
+			}
+			if (u.shadeMode == ShadeMode::Skybox) {
+				const glm::vec3 dir = SafeNormalize(v.worldPosition);
+				return u.envMap != nullptr ? u.envMap->Sample(dir) : glm::vec3(0.0f);
+			}
+
+			const glm::vec3 n = SafeNormalize(v.normal);
+			const glm::vec3 viewDir = SafeNormalize(-v.positionView);
+			const glm::vec3 lightDir = SafeNormalize(u.lightPosView - v.positionView);
+			const float spotFactor = ComputeSpotFactor(u, v);
+			const float shadowFactor = ComputeShadowFactor(u, v, n, lightDir);
+			const float visibility = spotFactor * shadowFactor;
+			const float diff = std::max(glm::dot(n, lightDir), 0.0f);
+			float spec = 0.0f;
+			if (diff > 0.0f) {
+				const glm::vec3 halfDir = SafeNormalize(lightDir + viewDir);
+				spec = std::pow(std::max(glm::dot(n, halfDir), 0.0f), u.shininess);
+			}
+
+			if (u.shadeMode == ShadeMode::Plane) {
+				glm::vec3 planeColor = u.diffuse;
+				if (u.diffuseMap != nullptr && std::abs(v.reflectionClip.w) > 0.0001f) {
+					const float invW = 1.0f / v.reflectionClip.w;
+					const glm::vec2 projectedUv(v.reflectionClip.x * invW * 0.5f + 0.5f, v.reflectionClip.y * invW * 0.5f + 0.5f);
+					const float inside =
+						(projectedUv.x >= 0.0f ? 1.0f : 0.0f) *
+						(projectedUv.y >= 0.0f ? 1.0f : 0.0f) *
+						(projectedUv.x <= 1.0f ? 1.0f : 0.0f) *
+						(projectedUv.y <= 1.0f ? 1.0f : 0.0f);
+					const glm::vec3 projectedReflection = u.diffuseMap->Sample(projectedUv, true) * u.planeReflectionBrightness;
+					const float reflectionMix = std::clamp(inside * u.planeReflectionStrength, 0.0f, 1.0f);
+					planeColor = glm::mix(planeColor, projectedReflection, reflectionMix);
+				}
+				if (u.envMap != nullptr) {
+					const glm::vec3 incidentView = SafeNormalize(v.positionView);
+					const glm::vec3 reflectedView = Reflect(incidentView, n);
+					const glm::vec3 reflectedWorld = SafeNormalize(u.invViewRotation * reflectedView);
+					planeColor += u.envMap->Sample(reflectedWorld) * u.planeEnvStrength;
+				}
+				const glm::vec3 ambient = planeColor * u.ambient * u.lightColor;
+				const glm::vec3 diffuse = planeColor * diff * u.lightColor * visibility;
+				const glm::vec3 specular = u.specular * spec * u.lightColor * visibility;
+				return glm::clamp(ambient + diffuse + specular + u.planeColorBias, glm::vec3(0.0f), glm::vec3(1.0f));
+			}
+
+			const glm::vec3 diffuseTex = u.diffuseMap != nullptr ? u.diffuseMap->Sample(v.texcoord) : glm::vec3(1.0f);
+			const glm::vec3 specularTex = u.specularMap != nullptr ? u.specularMap->Sample(v.texcoord) : glm::vec3(1.0f);
+			const glm::vec3 diffuseColor = u.diffuseMap != nullptr ? diffuseTex : u.diffuse;
+			const glm::vec3 specularColor = u.specular * specularTex;
+			const glm::vec3 ambientColor = u.diffuseMap != nullptr ? (diffuseTex * u.ambient) : u.ambient;
+			const glm::vec3 ambient = ambientColor * u.lightColor;
+			const glm::vec3 diffuse = diffuseColor * diff * u.lightColor * visibility;
+			const glm::vec3 specular = specularColor * spec * u.lightColor * visibility;
+			glm::vec3 color = ambient + diffuse + specular;
+
+			if (u.envMap != nullptr) {
+				const glm::vec3 incidentView = SafeNormalize(v.positionView);
+				const glm::vec3 reflectedView = Reflect(incidentView, n);
+				const glm::vec3 reflectedWorld = SafeNormalize(u.invViewRotation * reflectedView);
+				const glm::vec3 envColor = u.envMap->Sample(reflectedWorld);
+				const float fresnel = std::pow(1.0f - std::max(glm::dot(n, viewDir), 0.0f), 5.0f);
+				const float reflectionWeight = u.envReflectionStrength * (0.6f + 0.4f * fresnel);
+				color += envColor * reflectionWeight;
+			}
+			return color;
+		}
+
+		// Shared geometry front end for color and depth passes: vertex shading, primitive assembly,
+		// clipping, triangle setup and per-thread tile binning.
+		struct FrameGeometry {
+			std::vector<ClipVertex> vertices;
+			std::vector<SetupTriangle> triangles;
+			int tilesX = 0;
+			int tilesY = 0;
+			// bins[binner][tile] lists triangles in submission order; binners cover contiguous ranges.
+			std::vector<std::vector<std::vector<std::uint32_t>>> bins;
+			size_t trianglesSubmitted = 0;
+		};
+
+		void BuildFrameGeometry(
+			const std::vector<DrawCall>& draws,
+			int width,
+			int height,
+			bool computeVaryings,
+			float offsetFactor,
+			float offsetUnits,
+			int threadCount,
+			FrameGeometry& geometry) {
+			// Vertex shading over each draw's referenced index range.
+			std::vector<size_t> vertexBase(draws.size(), 0);
+			std::vector<size_t> firstVertex(draws.size(), 0);
+			std::vector<WorkRange> vertexJobs;
+			size_t vertexTotal = 0;
+			for (size_t d = 0; d < draws.size(); ++d) {
+				const DrawCall& draw = draws[d];
+				size_t first = 0;
+				size_t count = 0;
+				if (draw.primitive == PrimitiveType::Points) {
+					count = draw.vertices != nullptr ? draw.vertexCount : 0;
+				} else if (draw.vertices != nullptr && draw.indices != nullptr && draw.indexCount >= 3) {
+					const auto [minIt, maxIt] = std::minmax_element(draw.indices, draw.indices + draw.indexCount);
+					first = *minIt;
+					count = static_cast<size_t>(*maxIt) - first + 1;
+					if (draw.vertexCount > 0 && static_cast<size_t>(*maxIt) >= draw.vertexCount) {
+						count = 0;
+					}
+				}
+				vertexBase[d] = vertexTotal;
+				firstVertex[d] = first;
+				for (size_t begin = 0; begin < count; begin += kVertexChunk) {
+					vertexJobs.push_back(WorkRange{d, first + begin, first + std::min(count, begin + kVertexChunk)});
+				}
+				vertexTotal += count;
+			}
+			geometry.vertices.resize(vertexTotal);
+			ParallelFor(threadCount, vertexJobs.size(), [&](size_t job) {
+				const WorkRange& range = vertexJobs[job];
+				const DrawCall& draw = draws[range.draw];
+				ClipVertex* out = geometry.vertices.data() + vertexBase[range.draw] - firstVertex[range.draw];
+				for (size_t i = range.begin; i < range.end; ++i) {
+					out[i] = RunVertexShader(draw, draw.vertices[i], computeVaryings);
+				}
+				});
+
+			// Primitive assembly, clipping and setup, chunked so results can be merged in submission order.
+			std::vector<WorkRange> primitiveJobs;
+			for (size_t d = 0; d < draws.size(); ++d) {
+				const DrawCall& draw = draws[d];
+				const bool hasVertices = vertexTotal > 0 && (d + 1 < draws.size() ? vertexBase[d + 1] : vertexTotal) > vertexBase[d];
+				if (!hasVertices) {
+					continue;
+				}
+				const size_t primitiveCount = draw.primitive == PrimitiveType::Points ? draw.vertexCount : draw.indexCount / 3;
+				geometry.trianglesSubmitted += draw.primitive == PrimitiveType::Points ? primitiveCount * 2 : primitiveCount;
+				for (size_t begin = 0; begin < primitiveCount; begin += kPrimitiveChunk) {
+					primitiveJobs.push_back(WorkRange{d, begin, std::min(primitiveCount, begin + kPrimitiveChunk)});
+				}
+			}
+			std::vector<AssemblyChunk> chunks(primitiveJobs.size());
+			ParallelFor(threadCount, primitiveJobs.size(), [&](size_t job) {
+				const WorkRange& range = primitiveJobs[job];
+				const DrawCall& draw = draws[range.draw];
+				AssemblyChunk& chunk = chunks[job];
+				const size_t base = vertexBase[range.draw] - firstVertex[range.draw];
+				const std::uint32_t drawIndex = static_cast<std::uint32_t>(range.draw);
+
+				auto emit = [&](const std::array<const ClipVertex*, 3>& corners, const std::array<std::uint32_t, 3>& refs) {
+					SetupTriangle triangle;
+					if (!SetupScreenTriangle(corners, refs, width, height, triangle)) {
+						return;
+					}
+					triangle.drawIndex = drawIndex;
+					triangle.depthOffset = ComputePolygonOffset(triangle, offsetFactor, offsetUnits);
+					chunk.triangles.push_back(triangle);
+				};
+				auto addExtra = [&](const ClipVertex& vertex) {
+					chunk.extraVertices.push_back(vertex);
+					return kExtraVertexFlag | static_cast<std::uint32_t>(chunk.extraVertices.size() - 1);
+				};
+
+				for (size_t p = range.begin; p < range.end; ++p) {
+					if (draw.primitive == PrimitiveType::Points) {
+						// A point becomes a screen-aligned square of pointSize pixels with constant varyings.
+						const ClipVertex& center = geometry.vertices[base + p];
+						if (center.clip.w <= 0.0f || center.clip.z < -center.clip.w || center.clip.z > center.clip.w) {
+							continue;
+						}
+						const float halfX = draw.pointSize / static_cast<float>(width) * center.clip.w;
+						const float halfY = draw.pointSize / static_cast<float>(height) * center.clip.w;
+						std::array<ClipVertex, 4> quad{center, center, center, center};
+						quad[0].clip += glm::vec4(-halfX, -halfY, 0.0f, 0.0f);
+						quad[1].clip += glm::vec4(halfX, -halfY, 0.0f, 0.0f);
+						quad[2].clip += glm::vec4(halfX, halfY, 0.0f, 0.0f);
+						quad[3].clip += glm::vec4(-halfX, halfY, 0.0f, 0.0f);
+						const size_t firstExtra = chunk.extraVertices.size();
+						std::array<std::uint32_t, 4> refs{};
+						for (size_t i = 0; i < 4; ++i) {
+							refs[i] = addExtra(quad[i]);
+						}
+						const ClipVertex* corners = chunk.extraVertices.data() + firstExtra;
+						emit({&corners[0], &corners[1], &corners[2]}, {refs[0], refs[1], refs[2]});
+						emit({&corners[0], &corners[2], &corners[3]}, {refs[0], refs[2], refs[3]});
+						continue;
+					}
+
+					std::array<std::uint32_t, 3> refs{};
+					std::array<const ClipVertex*, 3> corners{};
+					bool needsClip = false;
+					for (size_t i = 0; i < 3; ++i) {
+						const size_t index = base + draw.indices[p * 3 + i];
+						refs[i] = static_cast<std::uint32_t>(index);
+						corners[i] = &geometry.vertices[index];
+						const glm::vec4& clip = corners[i]->clip;
+						needsClip |= clip.z < -clip.w || clip.z > clip.w;
+					}
+					if (!needsClip) {
+						emit(corners, refs);
+						continue;
+					}
+					std::array<ClipVertex, 8> polygon;
+					polygon[0] = *corners[0];
+					polygon[1] = *corners[1];
+					polygon[2] = *corners[2];
+					const int count = ClipAgainstDepthPlanes(polygon, 3);
+					if (count < 3) {
+						continue;
+					}
+					const size_t firstExtra = chunk.extraVertices.size();
+					std::array<std::uint32_t, 8> polygonRefs{};
+					for (int i = 0; i < count; ++i) {
+						polygonRefs[static_cast<size_t>(i)] = addExtra(polygon[static_cast<size_t>(i)]);
+					}
+					const ClipVertex* clipped = chunk.extraVertices.data() + firstExtra;
+					for (int i = 1; i + 1 < count; ++i) {
+						emit(
+							{&clipped[0], &clipped[i], &clipped[i + 1]},
+							{polygonRefs[0], polygonRefs[static_cast<size_t>(i)], polygonRefs[static_cast<size_t>(i + 1)]});
+					}
+				}
+				});
+
+			size_t triangleTotal = 0;
+			size_t extraTotal = 0;
+			for (const AssemblyChunk& chunk : chunks) {
+				triangleTotal += chunk.triangles.size();
+				extraTotal += chunk.extraVertices.size();
+			}
+			geometry.triangles.reserve(triangleTotal);
+			geometry.vertices.reserve(geometry.vertices.size() + extraTotal);
+			for (AssemblyChunk& chunk : chunks) {
+				const std::uint32_t extraBase = static_cast<std::uint32_t>(geometry.vertices.size());
+				geometry.vertices.insert(geometry.vertices.end(), chunk.extraVertices.begin(), chunk.extraVertices.end());
+				for (SetupTriangle& triangle : chunk.triangles) {
+					for (std::uint32_t& ref : triangle.v) {
+						if ((ref & kExtraVertexFlag) != 0) {
+							ref = extraBase + (ref & ~kExtraVertexFlag);
+						}
+					}
+					geometry.triangles.push_back(triangle);
+				}
+				chunk = AssemblyChunk{};
+			}
+
+			// Binning: each binner owns a contiguous slice of triangles so per-tile order is preserved.
+			geometry.tilesX = (width + kTileSize - 1) / kTileSize;
+			geometry.tilesY = (height + kTileSize - 1) / kTileSize;
+			const size_t tileCount = static_cast<size_t>(geometry.tilesX) * static_cast<size_t>(geometry.tilesY);
+			const int binners = std::max(1, std::min(threadCount, static_cast<int>(geometry.triangles.size() / 1024 + 1)));
+			geometry.bins.assign(static_cast<size_t>(binners), std::vector<std::vector<std::uint32_t>>(tileCount));
+			const size_t perBinner = (geometry.triangles.size() + static_cast<size_t>(binners) - 1) / static_cast<size_t>(binners);
+			RunParallel(binners, [&](int binner) {
+				const size_t begin = static_cast<size_t>(binner) * perBinner;
+				const size_t end = std::min(geometry.triangles.size(), begin + perBinner);
+				auto& bins = geometry.bins[static_cast<size_t>(binner)];
+				for (size_t t = begin; t < end; ++t) {
+					const SetupTriangle& triangle = geometry.triangles[t];
+					for (int ty = triangle.minY / kTileSize; ty <= triangle.maxY / kTileSize; ++ty) {
+						for (int tx = triangle.minX / kTileSize; tx <= triangle.maxX / kTileSize; ++tx) {
+							bins[static_cast<size_t>(ty * geometry.tilesX + tx)].push_back(static_cast<std::uint32_t>(t));
+						}
+					}
+				}
+				});
+		}
+
+		// Walks the pixels of one triangle inside one tile, four pixels per edge-function evaluation, and
+		// calls fragment(x, y, b0, b1, b2, z) for every covered sample. Returns the covered pixel count.
+		template <typename FragmentFn>
+		size_t RasterizeTriangleInTile(const SetupTriangle& triangle, int tileX0, int tileY0, int tileX1, int tileY1, FragmentFn&& fragment) {
+			const int x0 = std::max(triangle.minX, tileX0);
+			const int x1 = std::min(triangle.maxX, tileX1);
+			const int y0 = std::max(triangle.minY, tileY0);
+			const int y1 = std::min(triangle.maxY, tileY1);
+			if (x0 > x1 || y0 > y1) {
+				return 0;
+			}
+
+			// Edge i is opposite vertex i; E(px, py) = a * px + b * py + c is positive inside.
+			std::array<float, 3> a{};
+			std::array<float, 3> b{};
+			std::array<float, 3> c{};
+			std::array<bool, 3> inclusive{};
+			for (int i = 0; i < 3; ++i) {
+				const int from = (i + 1) % 3;
+				const int to = (i + 2) % 3;
+				a[i] = triangle.y[from] - triangle.y[to];
+				b[i] = triangle.x[to] - triangle.x[from];
+				c[i] = triangle.x[from] * triangle.y[to] - triangle.x[to] * triangle.y[from];
+				inclusive[i] = a[i] > 0.0f || (a[i] == 0.0f && b[i] < 0.0f);
+			}
+			const float invArea = 1.0f / triangle.area;
+			const int alignedX0 = x0 & ~3;
+
+			size_t covered = 0;
+			for (int py = y0; py <= y1; ++py) {
+				const float sampleY = static_cast<float>(py) + 0.5f;
+				std::array<Float4, 3> rowStart;
+				for (int i = 0; i < 3; ++i) {
+					rowStart[i] = Splat(b[i] * sampleY + c[i]);
+				}
+				for (int px = alignedX0; px <= x1; px += 4) {
+					const Float4 sampleX = Ramp(static_cast<float>(px) + 0.5f);
+					const Float4 e0 = MulAdd(Splat(a[0]), sampleX, rowStart[0]);
+					const Float4 e1 = MulAdd(Splat(a[1]), sampleX, rowStart[1]);
+					const Float4 e2 = MulAdd(Splat(a[2]), sampleX, rowStart[2]);
+					int mask = EdgeMask(e0, inclusive[0]) & EdgeMask(e1, inclusive[1]) & EdgeMask(e2, inclusive[2]);
+					if (mask == 0) {
+						continue;
+					}
+					for (int lane = 0; lane < 4; ++lane) {
+						const int x = px + lane;
+						if ((mask & (1 << lane)) == 0 || x < x0 || x > x1) {
+							continue;
+						}
+						const float b0 = Lane(e0, lane) * invArea;
+						const float b1 = Lane(e1, lane) * invArea;
+						const float b2 = Lane(e2, lane) * invArea;
+						const float z = b0 * triangle.z[0] + b1 * triangle.z[1] + b2 * triangle.z[2] + triangle.depthOffset;
+						if (fragment(x, py, b0, b1, b2, z)) {
+							++covered;
+						}
+					}
+				}
+			}
+			return covered;
+		}
+
+		template <typename TileFn>
+		void ForEachTile(const FrameGeometry& geometry, int threadCount, TileFn&& tileFn) {
+			const size_t tileCount = static_cast<size_t>(geometry.tilesX) * static_cast<size_t>(geometry.tilesY);
+			ParallelFor(threadCount, tileCount, [&](size_t tile) {
+				const int tx = static_cast<int>(tile % static_cast<size_t>(geometry.tilesX));
+				const int ty = static_cast<int>(tile / static_cast<size_t>(geometry.tilesX));
+				tileFn(tile, tx * kTileSize, ty * kTileSize);
+				});
+		}
+
+		double ElapsedMilliseconds(std::chrono::steady_clock::time_point start) {
+			return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		}
+
+		std::uint8_t ToByte(float value) {
+			return static_cast<std::uint8_t>(std::lround(std::clamp(value, 0.0f, 1.0f) * 255.0f));
+		}
+	}
+
+	glm::vec3 Texture::Sample(const glm::vec2& uv, bool clampToEdge) const {
+		if (Empty()) {
+			return glm::vec3(0.0f);
+		}
+		auto wrap = [clampToEdge](int index, int size) {
+			if (clampToEdge) {
+				return std::clamp(index, 0, size - 1);
+			}
+			const int wrapped = index % size;
+			return wrapped < 0 ? wrapped + size : wrapped;
+		};
+		const float fx = uv.x * static_cast<float>(width) - 0.5f;
+		const float fy = uv.y * static_cast<float>(height) - 0.5f;
+		const float floorX = std::floor(fx);
+		const float floorY = std::floor(fy);
+		const float tx = fx - floorX;
+		const float ty = fy - floorY;
+		const int ix = static_cast<int>(std::fmod(floorX, static_cast<float>(width) * 1024.0f));
+		const int iy = static_cast<int>(std::fmod(floorY, static_cast<float>(height) * 1024.0f));
+		const int x0 = wrap(ix, width);
+		const int x1 = wrap(ix + 1, width);
+		const int y0 = wrap(iy, height);
+		const int y1 = wrap(iy + 1, height);
+		auto texel = [&](int x, int y) {
+			const size_t offset = (static_cast<size_t>(y) * static_cast<size_t>(width) + static_cast<size_t>(x)) * 4u;
+			return glm::vec3(rgba[offset + 0], rgba[offset + 1], rgba[offset + 2]) * (1.0f / 255.0f);
+		};
+		const glm::vec3 top = glm::mix(texel(x0, y0), texel(x1, y0), tx);
+		const glm::vec3 bottom = glm::mix(texel(x0, y1), texel(x1, y1), tx);
+		return glm::mix(top, bottom, ty);
+	}
+
+	bool BuildTexture(const unsigned char* pixels, int width, int height, int channels, Texture& texture) {
+		if (pixels == nullptr || width <= 0 || height <= 0 || channels < 1 || channels > 4) {
+			return false;
+		}
+		texture.width = width;
+		texture.height = height;
+		const size_t texelCount = static_cast<size_t>(width) * static_cast<size_t>(height);
+		texture.rgba.resize(texelCount * 4u);
+		for (size_t i = 0; i < texelCount; ++i) {
+			const unsigned char* src = pixels + i * static_cast<size_t>(channels);
+			std::uint8_t* dst = texture.rgba.data() + i * 4u;
+			if (channels <= 2) {
+				dst[0] = dst[1] = dst[2] = src[0];
+				dst[3] = channels == 2 ? src[1] : 255;
+			} else {
+				dst[0] = src[0];
+				dst[1] = src[1];
+				dst[2] = src[2];
+				dst[3] = channels == 4 ? src[3] : 255;
+			}
+		}
+		return true;
+	}
+
+	bool CubeTexture::Empty() const {
+		for (const Texture& face : faces) {
+			if (face.Empty()) {
+				return true;
+			}
+		}
+		return false;
+	}
+
+	glm::vec3 CubeTexture::Sample(const glm::vec3& direction) const {
+		if (Empty()) {
+			return glm::vec3(0.0f);
+		}
+		// Face selection and (sc, tc) follow the cube map table in the GL specification.
+		const glm::vec3 magnitude = glm::abs(direction);
+		int face = 0;
+		float sc = 0.0f;
+		float tc = 0.0f;
+		float ma = 0.0f;
+		if (magnitude.x >= magnitude.y && magnitude.x >= magnitude.z) {
+			ma = magnitude.x;
+			face = direction.x >= 0.0f ? 0 : 1;
+			sc = direction.x >= 0.0f ? -direction.z : direction.z;
+			tc = -direction.y;
+		} else if (magnitude.y >= magnitude.z) {
+			ma = magnitude.y;
+			face = direction.y >= 0.0f ? 2 : 3;
+			sc = direction.x;
+			tc = direction.y >= 0.0f ? direction.z : -direction.z;
+		} else {
+			ma = magnitude.z;
+			face = direction.z >= 0.0f ? 4 : 5;
+			sc = direction.z >= 0.0f ? direction.x : -direction.x;
+			tc = -direction.y;
+		}
+		if (ma <= 0.0f) {
+			return glm::vec3(0.0f);
+		}
+		const glm::vec2 uv((sc / ma + 1.0f) * 0.5f, (tc / ma + 1.0f) * 0.5f);
+		return faces[static_cast<size_t>(face)].Sample(uv, true);
+	}
+
+	void DepthTarget::Resize(int newWidth, int newHeight) {
+		width = std::max(newWidth, 1);
+		height = std::max(newHeight, 1);
+		depth.assign(static_cast<size_t>(width) * static_cast<size_t>(height), 1.0f);
+	}
+
+	void DepthTarget::Clear(float value) {
+		std::fill(depth.begin(), depth.end(), value);
+	}
+
+	float DepthTarget::Sample(const glm::vec2& uv) const {
+		if (depth.empty()) {
+			return 1.0f;
+		}
+		const int x = std::clamp(static_cast<int>(std::floor(uv.x * static_cast<float>(width))), 0, width - 1);
+		const int y = std::clamp(static_cast<int>(std::floor(uv.y * static_cast<float>(height))), 0, height - 1);
+		return depth[static_cast<size_t>(y) * static_cast<size_t>(width) + static_cast<size_t>(x)];
+	}
+
+	void ColorTarget::Resize(int newWidth, int newHeight) {
+		width = std::max(newWidth, 1);
+		height = std::max(newHeight, 1);
+		const size_t pixelCount = static_cast<size_t>(width) * static_cast<size_t>(height);
+		color.assign(pixelCount, glm::vec3(0.0f));
+		depth.assign(pixelCount, 1.0f);
+	}
+
+	void ColorTarget::Clear(const glm::vec3& clearColor, float clearDepth) {
+		std::fill(color.begin(), color.end(), glm::clamp(clearColor, glm::vec3(0.0f), glm::vec3(1.0f)));
+		std::fill(depth.begin(), depth.end(), clearDepth);
+	}
+
+	Texture ColorTarget::ToTexture() const {
+		Texture texture;
+		texture.width = width;
+		texture.height = height;
+		texture.rgba.resize(color.size() * 4u);
+		for (size_t i = 0; i < color.size(); ++i) {
+			texture.rgba[i * 4u + 0] = ToByte(color[i].r);
+			texture.rgba[i * 4u + 1] = ToByte(color[i].g);
+			texture.rgba[i * 4u + 2] = ToByte(color[i].b);
+			texture.rgba[i * 4u + 3] = 255;
+		}
+		return texture;
+	}
+
+	RasterStats DrawColor(ColorTarget& target, const std::vector<DrawCall>& draws, int threadCount) {
+		const auto start = std::chrono::steady_clock::now();
+		threadCount = ResolveThreadCount(threadCount);
+		FrameGeometry geometry;
+		BuildFrameGeometry(draws, target.width, target.height, true, 0.0f, 0.0f, threadCount, geometry);
+
+		std::atomic<size_t> fragments{0};
+		ForEachTile(geometry, threadCount, [&](size_t tile, int tileX0, int tileY0) {
+			const int tileX1 = std::min(tileX0 + kTileSize, target.width) - 1;
+			const int tileY1 = std::min(tileY0 + kTileSize, target.height) - 1;
+			size_t tileFragments = 0;
+			for (const auto& bins : geometry.bins) {
+				for (const std::uint32_t index : bins[tile]) {
+					const SetupTriangle& triangle = geometry.triangles[index];
+					const DrawCall& draw = draws[triangle.drawIndex];
+					const ClipVertex& v0 = geometry.vertices[triangle.v[0]];
+					const ClipVertex& v1 = geometry.vertices[triangle.v[1]];
+					const ClipVertex& v2 = geometry.vertices[triangle.v[2]];
+					tileFragments += RasterizeTriangleInTile(triangle, tileX0, tileY0, tileX1, tileY1,
+						[&](int x, int y, float b0, float b1, float b2, float z) {
+							const size_t pixel = static_cast<size_t>(y) * static_cast<size_t>(target.width) + static_cast<size_t>(x);
+							const float stored = target.depth[pixel];
+							if (draw.depthLessEqual ? !(z <= stored) : !(z < stored)) {
+								return false;
+							}
+							// Perspective-correct weights.
+							const float w0 = b0 * triangle.invW[0];
+							const float w1 = b1 * triangle.invW[1];
+							const float w2 = b2 * triangle.invW[2];
+							const float invSum = 1.0f / (w0 + w1 + w2);
+							VaryingArray interpolated;
+							for (size_t i = 0; i < kVaryingCount; ++i) {
+								interpolated[i] = (v0.varyings[i] * w0 + v1.varyings[i] * w1 + v2.varyings[i] * w2) * invSum;
+							}
+							target.color[pixel] = glm::clamp(ShadeFragment(draw.uniforms, UnpackVaryings(interpolated)), glm::vec3(0.0f), glm::vec3(1.0f));
+							if (draw.depthWrite) {
+								target.depth[pixel] = z;
+							}
+							return true;
+						});
+				}
+			}
+			fragments += tileFragments;
+			});
+
+		RasterStats stats;
+		stats.trianglesSubmitted = geometry.trianglesSubmitted;
+		stats.trianglesRasterized = geometry.triangles.size();
+		stats.fragmentsShaded = fragments.load();
+		stats.milliseconds = ElapsedMilliseconds(start);
+		return stats;
+	}
+
+	RasterStats DrawDepth(DepthTarget& target, const std::vector<DrawCall>& draws, float offsetFactor, float offsetUnits, int threadCount) {
+		const auto start = std::chrono::steady_clock::now();
+		threadCount = ResolveThreadCount(threadCount);
+		FrameGeometry geometry;
+		BuildFrameGeometry(draws, target.width, target.height, false, offsetFactor, offsetUnits, threadCount, geometry);
+
+		std::atomic<size_t> fragments{0};
+		ForEachTile(geometry, threadCount, [&](size_t tile, int tileX0, int tileY0) {
+			const int tileX1 = std::min(tileX0 + kTileSize, target.width) - 1;
+			const int tileY1 = std::min(tileY0 + kTileSize, target.height) - 1;
+			size_t tileFragments = 0;
+			for (const auto& bins : geometry.bins) {
+				for (const std::uint32_t index : bins[tile]) {
+					const SetupTriangle& triangle = geometry.triangles[index];
+					const DrawCall& draw = draws[triangle.drawIndex];
+					tileFragments += RasterizeTriangleInTile(triangle, tileX0, tileY0, tileX1, tileY1,
+						[&](int x, int y, float, float, float, float z) {
+							const size_t pixel = static_cast<size_t>(y) * static_cast<size_t>(target.width) + static_cast<size_t>(x);
+							z = std::clamp(z, 0.0f, 1.0f);
+							if (draw.depthLessEqual ? !(z <= target.depth[pixel]) : !(z < target.depth[pixel])) {
+								return false;
+							}
+							if (draw.depthWrite) {
+								target.depth[pixel] = z;
+							}
+							return true;
+						});
+				}
+			}
+			fragments += tileFragments;
+			});
+
+		RasterStats stats;
+		stats.trianglesSubmitted = geometry.trianglesSubmitted;
+		stats.trianglesRasterized = geometry.triangles.size();
+		stats.fragmentsShaded = fragments.load();
+		stats.milliseconds = ElapsedMilliseconds(start);
+		return stats;
+	}
+
+	bool WritePpm(const ColorTarget& image, const std::string& path) {
+		std::ofstream file(path, std::ios::binary);
+		if (!file) {
+			std::fprintf(stderr, "Failed to open image for writing: %s\n", path.c_str());
+			return false;
+		}
+		file << "P6\n" << image.width << " " << image.height << "\n255\n";
+		std::vector<std::uint8_t> row(static_cast<size_t>(image.width) * 3u);
+		for (int y = image.height - 1; y >= 0; --y) {
+			for (int x = 0; x < image.width; ++x) {
+				const glm::vec3& color = image.color[static_cast<size_t>(y) * static_cast<size_t>(image.width) + static_cast<size_t>(x)];
+				row[static_cast<size_t>(x) * 3u + 0] = ToByte(color.r);
+				row[static_cast<size_t>(x) * 3u + 1] = ToByte(color.g);
+				row[static_cast<size_t>(x) * 3u + 2] = ToByte(color.b);
+			}
+			file.write(reinterpret_cast<const char*>(row.data()), static_cast<std::streamsize>(row.size()));
+		}
+		return static_cast<bool>(file);
+	}
+
+	bool ReadPpm(const std::string& path, ColorTarget& image) {
+		std::ifstream file(path, std::ios::binary);
+		if (!file) {
+			std::fprintf(stderr, "Failed to open image: %s\n", path.c_str());
+			return false;
+		}
+		auto readToken = [&file]() {
+			std::string token;
+			char ch = 0;
+			while (file.get(ch)) {
+				if (ch == '#') {
+					std::string comment;
+					std::getline(file, comment);
+					continue;
+				}
+				if (std::isspace(static_cast<unsigned char>(ch))) {
+					if (!token.empty()) {
+						break;
+					}
+					continue;
+				}
+				token.push_back(ch);
+			}
+			return token;
+		};
+		const std::string magic = readToken();
+		const int width = std::atoi(readToken().c_str());
+		const int height = std::atoi(readToken().c_str());
+		const int maxValue = std::atoi(readToken().c_str());
+		if (magic != "P6" || width <= 0 || height <= 0 || maxValue != 255) {
+			std::fprintf(stderr, "Unsupported PPM image (expected binary P6, 8-bit): %s\n", path.c_str());
+			return false;
+		}
+		image.Resize(width, height);
+		std::vector<std::uint8_t> row(static_cast<size_t>(width) * 3u);
+		for (int y = height - 1; y >= 0; --y) {
+			if (!file.read(reinterpret_cast<char*>(row.data()), static_cast<std::streamsize>(row.size()))) {
+				std::fprintf(stderr, "Truncated PPM image: %s\n", path.c_str());
+				return false;
+			}
+			for (int x = 0; x < width; ++x) {
+				image.color[static_cast<size_t>(y) * static_cast<size_t>(width) + static_cast<size_t>(x)] = glm::vec3(
+					row[static_cast<size_t>(x) * 3u + 0],
+					row[static_cast<size_t>(x) * 3u + 1],
+					row[static_cast<size_t>(x) * 3u + 2]) * (1.0f / 255.0f);
+			}
+		}
+		return true;
+	}
+
+	ImageComparison CompareImages(const ColorTarget& expected, const ColorTarget& actual, double pixelThreshold) {
+		ImageComparison result;
+		if (expected.width != actual.width || expected.height != actual.height) {
+			result.sizeMismatch = true;
+			return result;
+		}
+		double sumSq = 0.0;
+		for (size_t i = 0; i < expected.color.size(); ++i) {
+			double pixelMax = 0.0;
+			for (int channel = 0; channel < 3; ++channel) {
+				const double error = std::abs(
+					static_cast<double>(ToByte(expected.color[i][channel])) -
+					static_cast<double>(ToByte(actual.color[i][channel])));
+				sumSq += error * error;
+				pixelMax = std::max(pixelMax, error);
+			}
+			result.maxError = std::max(result.maxError, pixelMax);
+			if (pixelMax > pixelThreshold) {
+				++result.differingPixels;
+			}
+		}
+		result.rmse = expected.color.empty() ? 0.0 : std::sqrt(sumSq / static_cast<double>(expected.color.size() * 3u));
+		return result;
+	}
+}
@@ -0,0 +1,159 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// CPU reference implementation of the shader.vert/shader.frag pipeline. It renders the same scene state
+// as the GL path so frames can be checked against golden images on machines without a GPU, and doubles
+// as a fallback renderer when no GL context can be created.
+namespace gpurenderer::software {
+	// Same layout as the renderer's interleaved vertex buffer.
+	struct Vertex {
+		glm::vec3 position;
+		glm::vec3 normal;
+		glm::vec2 texcoord;
+	};
+
+	// RGBA8 image with GL texel addressing: row 0 is t = 0 and texel centers sit at half-texel offsets.
+	struct Texture {
+		int width = 0;
+		int height = 0;
+		std::vector<std::uint8_t> rgba;
+
+		bool Empty() const {
+			return width <= 0 || height <= 0 || rgba.empty();
+		}
+
+		// GL_LINEAR sampling of the base level with GL_REPEAT (or GL_CLAMP_TO_EDGE) wrapping.
+		glm::vec3 Sample(const glm::vec2& uv, bool clampToEdge = false) const;
+	};
+
+	// Expands 1-4 channel 8-bit pixels the way GL_LUMINANCE/GL_LUMINANCE_ALPHA/GL_RGB/GL_RGBA uploads do.
+	bool BuildTexture(const unsigned char* pixels, int width, int height, int channels, Texture& texture);
+
+	// Faces in GL_TEXTURE_CUBE_MAP_POSITIVE_X .. NEGATIVE_Z order.
+	struct CubeTexture {
+		std::array<Texture, 6> faces;
+
+		bool Empty() const;
+		glm::vec3 Sample(const glm::vec3& direction) const;
+	};
+
+	struct DepthTarget {
+		int width = 0;
+		int height = 0;
+		std::vector<float> depth;
+
+		void Resize(int newWidth, int newHeight);
+		void Clear(float value = 1.0f);
+		// GL_NEAREST lookup with GL_CLAMP_TO_EDGE, like the shadow map texture.
+		float Sample(const glm::vec2& uv) const;
+	};
+
+	// Color plus depth render target. Row 0 is the bottom row, matching glReadPixels.
+	struct ColorTarget {
+		int width = 0;
+		int height = 0;
+		std::vector<glm::vec3> color;
+		std::vector<float> depth;
+
+		void Resize(int newWidth, int newHeight);
+		void Clear(const glm::vec3& clearColor, float clearDepth = 1.0f);
+		Texture ToTexture() const;
+	};
+
+	// The first three match the SHADE_MODE values of shader.frag. The GL path draws markers and the
+	// skybox with programs of their own, so Marker and Skybox exist only here.
+	enum class ShadeMode {
+		BlinnPhong = 0,
+		Normals = 1,
+		Plane = 2,
+		Marker = 3,
+		Skybox = 4
+	};
+
+	// Uniform state of one draw, named after the shader uniforms it mirrors.
+	struct ShaderUniforms {
+		glm::mat4 mvp{1.0f};
+		glm::mat4 model{1.0f};
+		glm::mat4 view{1.0f};
+		glm::mat3 normalMatrix{1.0f};
+		glm::mat3 worldNormalMatrix{1.0f};
+		glm::mat3 invViewRotation{1.0f};
+		glm::mat4 reflectionViewProj{1.0f};
+		glm::mat4 lightViewProj{1.0f};
+		glm::vec3 lightPosView{0.0f};
+		glm::vec3 lightDirView{0.0f, 0.0f, -1.0f};
+		glm::vec3 lightColor{1.0f};
+		glm::vec3 ambient{0.2f};
+		glm::vec3 diffuse{0.8f};
+		glm::vec3 specular{0.0f};
+		glm::vec3 markerColor{1.0f};
+		glm::vec3 planeColorBias{0.0f};
+		float shininess = 32.0f;
+		ShadeMode shadeMode = ShadeMode::BlinnPhong;
+		const Texture* diffuseMap = nullptr;
+		const Texture* specularMap = nullptr;
+		const CubeTexture* envMap = nullptr;
+		const DepthTarget* shadowMap = nullptr;
+		float envReflectionStrength = 0.0f;
+		float planeReflectionStrength = 0.0f;
+		float planeEnvStrength = 0.0f;
+		float planeReflectionBrightness = 1.0f;
+		float shadowBias = 0.0f;
+		bool useSpotLight = false;
+		float spotCosInner = 1.0f;
+		float spotCosOuter = 0.0f;
+	};
+
+	enum class PrimitiveType {
+		Triangles,
+		Points
+	};
+
+	// One draw with constant instance attributes (aInstanceModel/aInstanceNormal). Triangles read
+	// indexCount indices; points draw vertexCount vertices as pointSize-pixel squares.
+	struct DrawCall {
+		PrimitiveType primitive = PrimitiveType::Triangles;
+		const Vertex* vertices = nullptr;
+		size_t vertexCount = 0;
+		const unsigned int* indices = nullptr;
+		size_t indexCount = 0;
+		float pointSize = 1.0f;
+		glm::mat4 instanceModel{1.0f};
+		glm::mat3 instanceNormal{1.0f};
+		ShaderUniforms uniforms;
+		bool depthWrite = true;
+		bool depthLessEqual = false;
+	};
+
+	struct RasterStats {
+		size_t trianglesSubmitted = 0;
+		size_t trianglesRasterized = 0;
+		size_t fragmentsShaded = 0;
+		double milliseconds = 0.0;
+	};
+
+	// Rasterizes draws in submission order into 64x64 tiles spread across worker threads.
+	// threadCount <= 0 uses every hardware thread.
+	RasterStats DrawColor(ColorTarget& target, const std::vector<DrawCall>& draws, int threadCount = 0);
+	// Depth-only variant used for the shadow pass, with glPolygonOffset(factor, units) semantics.
+	RasterStats DrawDepth(DepthTarget& target, const std::vector<DrawCall>& draws, float offsetFactor, float offsetUnits, int threadCount = 0);
+
+	struct ImageComparison {
+		bool sizeMismatch = false;
+		double rmse = 0.0;
+		double maxError = 0.0;
+		size_t differingPixels = 0;
+	};
+
+	bool WritePpm(const ColorTarget& image, const std::string& path);
+	bool ReadPpm(const std::string& path, ColorTarget& image);
+	// Errors are in 0..255 units; a pixel differs when any channel is off by more than pixelThreshold.
+	ImageComparison CompareImages(const ColorTarget& expected, const ColorTarget& actual, double pixelThreshold);
+}
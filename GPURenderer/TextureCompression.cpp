@@ -0,0 +1,705 @@
+#include "TextureCompression.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <thread>
+
+namespace gpurenderer::compression {
+	namespace {
+		constexpr int kBlockTexels = 16;
+		// BC7 4-bit index interpolation weights, out of 64.
+		constexpr std::array<int, 16> kBc7Weights4 = {0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64};
+		constexpr int kBc7Mode6 = 6;
+
+		// One 4x4 block as floats, RGBA per texel.
+		using BlockTexels = std::array<std::array<float, 4>, kBlockTexels>;
+
+		void FetchBlock(const std::uint8_t* pixels, int width, int height, int channels, int blockX, int blockY, BlockTexels& block) {
+			for (int y = 0; y < 4; ++y) {
+				const int sy = std::min(blockY * 4 + y, height - 1);
+				for (int x = 0; x < 4; ++x) {
+					const int sx = std::min(blockX * 4 + x, width - 1);
+					const std::uint8_t* texel = pixels + (static_cast<size_t>(sy) * static_cast<size_t>(width) + static_cast<size_t>(sx)) * static_cast<size_t>(channels);
+					std::array<float, 4>& out = block[static_cast<size_t>(y * 4 + x)];
+					const float alpha = channels == 2 || channels == 4 ? static_cast<float>(texel[channels - 1]) : 255.0f;
+					if (channels <= 2) {
+						const float luminance = static_cast<float>(texel[0]);
+						out = {luminance, luminance, luminance, alpha};
+					} else {
+						out = {static_cast<float>(texel[0]), static_cast<float>(texel[1]), static_cast<float>(texel[2]), alpha};
+					}
+				}
+			}
+		}
+
+		// Raw source channel `channel` of a block, 0 when the source has fewer channels.
+		void FetchChannel(const std::uint8_t* pixels, int width, int height, int channels, int channel, int blockX, int blockY, std::array<int, kBlockTexels>& values) {
+			for (int y = 0; y < 4; ++y) {
+				const int sy = std::min(blockY * 4 + y, height - 1);
+				for (int x = 0; x < 4; ++x) {
+					const int sx = std::min(blockX * 4 + x, width - 1);
+					const size_t index = (static_cast<size_t>(sy) * static_cast<size_t>(width) + static_cast<size_t>(sx)) * static_cast<size_t>(channels);
+					values[static_cast<size_t>(y * 4 + x)] = channel < channels ? pixels[index + static_cast<size_t>(channel)] : 0;
+				}
+			}
+		}
+
+		// Principal axis of the first `dims` channels by power iteration on the covariance matrix.
+		template <int Dims>
+		void PrincipalAxis(const BlockTexels& block, std::array<float, 4>& mean, std::array<float, 4>& axis) {
+			mean = {0.0f, 0.0f, 0.0f, 0.0f};
+			for (const auto& texel : block) {
+				for (int c = 0; c < Dims; ++c) {
+					mean[c] += texel[c];
+				}
+			}
+			for (int c = 0; c < Dims; ++c) {
+				mean[c] /= static_cast<float>(kBlockTexels);
+			}
+			float covariance[Dims][Dims] = {};
+			for (const auto& texel : block) {
+				float delta[Dims];
+				for (int c = 0; c < Dims; ++c) {
+					delta[c] = texel[c] - mean[c];
+				}
+				for (int i = 0; i < Dims; ++i) {
+					for (int j = 0; j < Dims; ++j) {
+						covariance[i][j] += delta[i] * delta[j];
+					}
+				}
+			}
+			axis = {1.0f, 1.0f, 1.0f, Dims == 4 ? 1.0f : 0.0f};
+			for (int iteration = 0; iteration < 8; ++iteration) {
+				float next[Dims] = {};
+				for (int i = 0; i < Dims; ++i) {
+					for (int j = 0; j < Dims; ++j) {
+						next[i] += covariance[i][j] * axis[j];
+					}
+				}
+				float length = 0.0f;
+				for (int c = 0; c < Dims; ++c) {
+					length = std::max(length, std::fabs(next[c]));
+				}
+				if (length <= 0.0f) {
+					break;
+				}
+				for (int c = 0; c < Dims; ++c) {
+					axis[c] = next[c] / length;
+				}
+			}
+		}
+
+		// Endpoints at the extremes of the block's projection onto its principal axis.
+		template <int Dims>
+		void FitEndpoints(const BlockTexels& block, std::array<float, 4>& first, std::array<float, 4>& second) {
+			std::array<float, 4> mean{};
+			std::array<float, 4> axis{};
+			PrincipalAxis<Dims>(block, mean, axis);
+			float minT = std::numeric_limits<float>::max();
+			float maxT = std::numeric_limits<float>::lowest();
+			for (const auto& texel : block) {
+				float t = 0.0f;
+				for (int c = 0; c < Dims; ++c) {
+					t += (texel[c] - mean[c]) * axis[c];
+				}
+				minT = std::min(minT, t);
+				maxT = std::max(maxT, t);
+			}
+			float axisLengthSq = 0.0f;
+			for (int c = 0; c < Dims; ++c) {
+				axisLengthSq += axis[c] * axis[c];
+			}
+			axisLengthSq = std::max(axisLengthSq, 1e-12f);
+			for (int c = 0; c < 4; ++c) {
+				first[c] = std::clamp(mean[c] + axis[c] * maxT / axisLengthSq, 0.0f, 255.0f);
+				second[c] = std::clamp(mean[c] + axis[c] * minT / axisLengthSq, 0.0f, 255.0f);
+			}
+		}
+
+		// Least-squares endpoints for fixed per-texel weights (weight of `first`), per channel.
+		template <int Dims>
+		bool SolveEndpoints(const BlockTexels& block, const std::array<float, kBlockTexels>& weights, std::array<float, 4>& first, std::array<float, 4>& second) {
+			float aa = 0.0f;
+			float bb = 0.0f;
+			float ab = 0.0f;
+			std::array<float, 4> ax{};
+			std::array<float, 4> bx{};
+			for (int i = 0; i < kBlockTexels; ++i) {
+				const float a = weights[static_cast<size_t>(i)];
+				const float b = 1.0f - a;
+				aa += a * a;
+				bb += b * b;
+				ab += a * b;
+				for (int c = 0; c < Dims; ++c) {
+					ax[c] += a * block[static_cast<size_t>(i)][c];
+					bx[c] += b * block[static_cast<size_t>(i)][c];
+				}
+			}
+			const float determinant = aa * bb - ab * ab;
+			if (std::fabs(determinant) < 1e-6f) {
+				return false;
+			}
+			for (int c = 0; c < Dims; ++c) {
+				first[c] = std::clamp((ax[c] * bb - bx[c] * ab) / determinant, 0.0f, 255.0f);
+				second[c] = std::clamp((bx[c] * aa - ax[c] * ab) / determinant, 0.0f, 255.0f);
+			}
+			return true;
+		}
+
+		// ---- BC1 colour block ---------------------------------------------------------------------
+
+		std::uint16_t Pack565(const std::array<float, 4>& color) {
+			const int r = static_cast<int>(std::lround(color[0] * 31.0f / 255.0f));
+			const int g = static_cast<int>(std::lround(color[1] * 63.0f / 255.0f));
+			const int b = static_cast<int>(std::lround(color[2] * 31.0f / 255.0f));
+			return static_cast<std::uint16_t>((r << 11) | (g << 5) | b);
+		}
+
+		std::array<int, 3> Expand565(std::uint16_t packed) {
+			const int r = (packed >> 11) & 31;
+			const int g = (packed >> 5) & 63;
+			const int b = packed & 31;
+			return {(r << 3) | (r >> 2), (g << 2) | (g >> 4), (b << 3) | (b >> 2)};
+		}
+
+		// Four-colour BC1 palette; BC3 colour blocks always use this interpretation.
+		std::array<std::array<int, 3>, 4> ColorPalette(std::uint16_t c0, std::uint16_t c1) {
+			const std::array<int, 3> e0 = Expand565(c0);
+			const std::array<int, 3> e1 = Expand565(c1);
+			std::array<std::array<int, 3>, 4> palette{};
+			for (int c = 0; c < 3; ++c) {
+				palette[0][c] = e0[c];
+				palette[1][c] = e1[c];
+				palette[2][c] = (2 * e0[c] + e1[c] + 1) / 3;
+				palette[3][c] = (e0[c] + 2 * e1[c] + 1) / 3;
+			}
+			return palette;
+		}
+
+		struct ColorCandidate {
+			std::uint16_t c0 = 0;
+			std::uint16_t c1 = 0;
+			std::uint32_t indices = 0;
+			float error = std::numeric_limits<float>::max();
+		};
+
+		ColorCandidate EvaluateColor(const BlockTexels& block, std::uint16_t c0, std::uint16_t c1) {
+			ColorCandidate candidate;
+			// Four-colour mode needs c0 > c1; swapping the endpoints swaps the palette order with them.
+			if (c0 < c1) {
+				std::swap(c0, c1);
+			}
+			candidate.c0 = c0;
+			candidate.c1 = c1;
+			candidate.error = 0.0f;
+			const auto palette = ColorPalette(c0, c1);
+			for (int i = 0; i < kBlockTexels; ++i) {
+				const auto& texel = block[static_cast<size_t>(i)];
+				float distances[4];
+				for (int p = 0; p < 4; ++p) {
+					const float dr = texel[0] - static_cast<float>(palette[p][0]);
+					const float dg = texel[1] - static_cast<float>(palette[p][1]);
+					const float db = texel[2] - static_cast<float>(palette[p][2]);
+					distances[p] = dr * dr + dg * dg + db * db;
+				}
+				int best = 0;
+				for (int p = 1; p < 4; ++p) {
+					best = distances[p] < distances[best] ? p : best;
+				}
+				// With equal endpoints every entry is the same colour; index 0 is valid in either mode.
+				if (c0 == c1) {
+					best = 0;
+				}
+				candidate.indices |= static_cast<std::uint32_t>(best) << (2 * i);
+				candidate.error += distances[best];
+			}
+			return candidate;
+		}
+
+		void EncodeColorBlock(const BlockTexels& block, std::uint8_t* out) {
+			std::array<float, 4> first{};
+			std::array<float, 4> second{};
+			FitEndpoints<3>(block, first, second);
+			ColorCandidate best = EvaluateColor(block, Pack565(first), Pack565(second));
+
+			// One least-squares pass with the chosen indices usually gains 1-2 dB over the axis extremes.
+			constexpr float kIndexWeights[4] = {1.0f, 0.0f, 2.0f / 3.0f, 1.0f / 3.0f};
+			std::array<float, kBlockTexels> weights{};
+			for (int i = 0; i < kBlockTexels; ++i) {
+				weights[static_cast<size_t>(i)] = kIndexWeights[(best.indices >> (2 * i)) & 3u];
+			}
+			if (SolveEndpoints<3>(block, weights, first, second)) {
+				const ColorCandidate refined = EvaluateColor(block, Pack565(first), Pack565(second));
+				if (refined.error < best.error) {
+					best = refined;
+				}
+			}
+
+			std::memcpy(out, &best.c0, sizeof(best.c0));
+			std::memcpy(out + 2, &best.c1, sizeof(best.c1));
+			std::memcpy(out + 4, &best.indices, sizeof(best.indices));
+		}
+
+		// ---- BC4 single-channel block -------------------------------------------------------------
+
+		std::array<int, 8> AlphaPalette(int a0, int a1) {
+			std::array<int, 8> palette{};
+			palette[0] = a0;
+			palette[1] = a1;
+			if (a0 > a1) {
+				for (int i = 2; i < 8; ++i) {
+					palette[static_cast<size_t>(i)] = ((8 - i) * a0 + (i - 1) * a1 + 3) / 7;
+				}
+			} else {
+				for (int i = 2; i < 6; ++i) {
+					palette[static_cast<size_t>(i)] = ((6 - i) * a0 + (i - 1) * a1 + 2) / 5;
+				}
+				palette[6] = 0;
+				palette[7] = 255;
+			}
+			return palette;
+		}
+
+		void EncodeAlphaBlock(const std::array<int, kBlockTexels>& values, std::uint8_t* out) {
+			const auto [minIt, maxIt] = std::minmax_element(values.begin(), values.end());
+			const int a0 = *maxIt;
+			const int a1 = *minIt;
+			const auto palette = AlphaPalette(a0, a1);
+			std::uint64_t bits = 0;
+			if (a0 != a1) {
+				for (int i = 0; i < kBlockTexels; ++i) {
+					int best = 0;
+					int bestError = std::abs(values[static_cast<size_t>(i)] - palette[0]);
+					for (int p = 1; p < 8; ++p) {
+						const int error = std::abs(values[static_cast<size_t>(i)] - palette[static_cast<size_t>(p)]);
+						if (error < bestError) {
+							best = p;
+							bestError = error;
+						}
+					}
+					bits |= static_cast<std::uint64_t>(best) << (3 * i);
+				}
+			}
+			out[0] = static_cast<std::uint8_t>(a0);
+			out[1] = static_cast<std::uint8_t>(a1);
+			for (int i = 0; i < 6; ++i) {
+				out[2 + i] = static_cast<std::uint8_t>(bits >> (8 * i));
+			}
+		}
+
+		// ---- BC7 mode 6: one subset, RGBA 7.7.7.7 endpoints with a p-bit each, 4-bit indices ------
+
+		struct Bc7Endpoint {
+			std::array<int, 4> quantized{};
+			int pbit = 0;
+
+			std::array<int, 4> Expanded() const {
+				std::array<int, 4> value{};
+				for (int c = 0; c < 4; ++c) {
+					value[c] = (quantized[c] << 1) | pbit;
+				}
+				return value;
+			}
+		};
+
+		Bc7Endpoint QuantizeBc7(const std::array<float, 4>& color) {
+			Bc7Endpoint best;
+			float bestError = std::numeric_limits<float>::max();
+			for (int pbit = 0; pbit < 2; ++pbit) {
+				Bc7Endpoint candidate;
+				candidate.pbit = pbit;
+				float error = 0.0f;
+				for (int c = 0; c < 4; ++c) {
+					candidate.quantized[c] = std::clamp(static_cast<int>(std::lround((color[c] - static_cast<float>(pbit)) / 2.0f)), 0, 127);
+					const float delta = color[c] - static_cast<float>((candidate.quantized[c] << 1) | pbit);
+					error += delta * delta;
+				}
+				if (error < bestError) {
+					best = candidate;
+					bestError = error;
+				}
+			}
+			return best;
+		}
+
+		struct Bc7Candidate {
+			Bc7Endpoint first;
+			Bc7Endpoint second;
+			std::array<int, kBlockTexels> indices{};
+			float error = std::numeric_limits<float>::max();
+		};
+
+		Bc7Candidate EvaluateBc7(const BlockTexels& block, const Bc7Endpoint& first, const Bc7Endpoint& second) {
+			Bc7Candidate candidate;
+			candidate.first = first;
+			candidate.second = second;
+			candidate.error = 0.0f;
+			const std::array<int, 4> e0 = first.Expanded();
+			const std::array<int, 4> e1 = second.Expanded();
+			std::array<std::array<float, 4>, 16> palette{};
+			for (int k = 0; k < 16; ++k) {
+				const int w = kBc7Weights4[static_cast<size_t>(k)];
+				for (int c = 0; c < 4; ++c) {
+					palette[static_cast<size_t>(k)][c] = static_cast<float>(((64 - w) * e0[c] + w * e1[c] + 32) >> 6);
+				}
+			}
+			for (int i = 0; i < kBlockTexels; ++i) {
+				const auto& texel = block[static_cast<size_t>(i)];
+				std::array<float, 16> distances{};
+				for (int k = 0; k < 16; ++k) {
+					float distance = 0.0f;
+					for (int c = 0; c < 4; ++c) {
+						const float delta = texel[c] - palette[static_cast<size_t>(k)][c];
+						distance += delta * delta;
+					}
+					distances[static_cast<size_t>(k)] = distance;
+				}
+				const auto best = std::min_element(distances.begin(), distances.end());
+				candidate.indices[static_cast<size_t>(i)] = static_cast<int>(best - distances.begin());
+				candidate.error += *best;
+			}
+			return candidate;
+		}
+
+		class BitWriter {
+		public:
+			explicit BitWriter(std::uint8_t* out) : mOut(out) {
+				std::memset(mOut, 0, 16);
+			}
+			void Write(std::uint32_t value, int bits) {
+				for (int i = 0; i < bits; ++i, ++mPosition) {
+					if ((value >> i) & 1u) {
+						mOut[mPosition >> 3] |= static_cast<std::uint8_t>(1u << (mPosition & 7));
+					}
+				}
+			}
+
+		private:
+			std::uint8_t* mOut;
+			int mPosition = 0;
+		};
+
+		class BitReader {
+		public:
+			explicit BitReader(const std::uint8_t* in) : mIn(in) {}
+			std::uint32_t Read(int bits) {
+				std::uint32_t value = 0;
+				for (int i = 0; i < bits; ++i, ++mPosition) {
+					value |= static_cast<std::uint32_t>((mIn[mPosition >> 3] >> (mPosition & 7)) & 1u) << i;
+				}
+				return value;
+			}
+
+		private:
+			const std::uint8_t* mIn;
+			int mPosition = 0;
+		};
+
+		void EncodeBc7Block(const BlockTexels& block, std::uint8_t* out) {
+			std::array<float, 4> first{};
+			std::array<float, 4> second{};
+			FitEndpoints<4>(block, first, second);
+			Bc7Candidate best = EvaluateBc7(block, QuantizeBc7(first), QuantizeBc7(second));
+
+			std::array<float, kBlockTexels> weights{};
+			for (int i = 0; i < kBlockTexels; ++i) {
+				weights[static_cast<size_t>(i)] = 1.0f - static_cast<float>(kBc7Weights4[static_cast<size_t>(best.indices[static_cast<size_t>(i)])]) / 64.0f;
+			}
+			if (SolveEndpoints<4>(block, weights, first, second)) {
+				const Bc7Candidate refined = EvaluateBc7(block, QuantizeBc7(first), QuantizeBc7(second));
+				if (refined.error < best.error) {
+					best = refined;
+				}
+			}
+
+			// Texel 0's index is stored with its top bit implied zero; flip the block if it is set.
+			if (best.indices[0] >= 8) {
+				std::swap(best.first, best.second);
+				for (int& index : best.indices) {
+					index = 15 - index;
+				}
+			}
+
+			BitWriter writer(out);
+			writer.Write(1u << kBc7Mode6, kBc7Mode6 + 1);
+			for (int c = 0; c < 4; ++c) {
+				writer.Write(static_cast<std::uint32_t>(best.first.quantized[c]), 7);
+				writer.Write(static_cast<std::uint32_t>(best.second.quantized[c]), 7);
+			}
+			writer.Write(static_cast<std::uint32_t>(best.first.pbit), 1);
+			writer.Write(static_cast<std::uint32_t>(best.second.pbit), 1);
+			for (int i = 0; i < kBlockTexels; ++i) {
+				writer.Write(static_cast<std::uint32_t>(best.indices[static_cast<size_t>(i)]), i == 0 ? 3 : 4);
+			}
+		}
+
+		// ---- Decoders ------------------------------------------------------------------------------
+
+		void DecodeColorBlock(const std::uint8_t* in, bool allowThreeColor, std::array<std::array<std::uint8_t, 4>, kBlockTexels>& texels) {
+			std::uint16_t c0 = 0;
+			std::uint16_t c1 = 0;
+			std::uint32_t indices = 0;
+			std::memcpy(&c0, in, sizeof(c0));
+			std::memcpy(&c1, in + 2, sizeof(c1));
+			std::memcpy(&indices, in + 4, sizeof(indices));
+			auto palette = ColorPalette(c0, c1);
+			std::array<int, 4> alpha = {255, 255, 255, 255};
+			if (allowThreeColor && c0 <= c1) {
+				const auto e0 = Expand565(c0);
+				const auto e1 = Expand565(c1);
+				for (int c = 0; c < 3; ++c) {
+					palette[2][c] = (e0[c] + e1[c]) / 2;
+					palette[3][c] = 0;
+				}
+				alpha[3] = 0;
+			}
+			for (int i = 0; i < kBlockTexels; ++i) {
+				const unsigned index = (indices >> (2 * i)) & 3u;
+				texels[static_cast<size_t>(i)] = {
+					static_cast<std::uint8_t>(palette[index][0]),
+					static_cast<std::uint8_t>(palette[index][1]),
+					static_cast<std::uint8_t>(palette[index][2]),
+					static_cast<std::uint8_t>(alpha[index])};
+			}
+		}
+
+		void DecodeAlphaBlock(const std::uint8_t* in, std::array<std::uint8_t, kBlockTexels>& values) {
+			const auto palette = AlphaPalette(in[0], in[1]);
+			std::uint64_t bits = 0;
+			for (int i = 0; i < 6; ++i) {
+				bits |= static_cast<std::uint64_t>(in[2 + i]) << (8 * i);
+			}
+			for (int i = 0; i < kBlockTexels; ++i) {
+				values[static_cast<size_t>(i)] = static_cast<std::uint8_t>(palette[(bits >> (3 * i)) & 7u]);
+			}
+		}
+
+		void DecodeBc7Block(const std::uint8_t* in, std::array<std::array<std::uint8_t, 4>, kBlockTexels>& texels) {
+			// The mode is the number of zero bits before the first set bit; bit 7 already belongs to R0.
+			if ((in[0] & 0x7Fu) != (1u << kBc7Mode6)) {
+				// Not a block this encoder writes; decode as opaque black.
+				texels.fill({0, 0, 0, 255});
+				return;
+			}
+			BitReader reader(in);
+			reader.Read(kBc7Mode6 + 1);
+			Bc7Endpoint first;
+			Bc7Endpoint second;
+			for (int c = 0; c < 4; ++c) {
+				first.quantized[c] = static_cast<int>(reader.Read(7));
+				second.quantized[c] = static_cast<int>(reader.Read(7));
+			}
+			first.pbit = static_cast<int>(reader.Read(1));
+			second.pbit = static_cast<int>(reader.Read(1));
+			const auto e0 = first.Expanded();
+			const auto e1 = second.Expanded();
+			for (int i = 0; i < kBlockTexels; ++i) {
+				const int w = kBc7Weights4[reader.Read(i == 0 ? 3 : 4)];
+				for (int c = 0; c < 4; ++c) {
+					texels[static_cast<size_t>(i)][c] = static_cast<std::uint8_t>(((64 - w) * e0[c] + w * e1[c] + 32) >> 6);
+				}
+			}
+		}
+
+		// Calls body(row) for every block row, spread over threadCount threads.
+		template <typename Body>
+		void ForEachBlockRow(int rows, int threadCount, const Body& body) {
+			if (threadCount <= 0) {
+				threadCount = static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+			}
+			threadCount = std::clamp(threadCount, 1, std::max(rows, 1));
+			std::atomic<int> next{0};
+			auto worker = [&]() {
+				for (int row = next.fetch_add(1); row < rows; row = next.fetch_add(1)) {
+					body(row);
+				}
+			};
+			std::vector<std::thread> threads;
+			for (int i = 1; i < threadCount; ++i) {
+				threads.emplace_back(worker);
+			}
+			worker();
+			for (std::thread& thread : threads) {
+				thread.join();
+			}
+		}
+	}
+
+	size_t BlockBytes(BlockFormat format) {
+		return format == BlockFormat::BC1 || format == BlockFormat::BC4 ? 8u : 16u;
+	}
+
+	size_t CompressedSize(BlockFormat format, int width, int height) {
+		const size_t blocksX = static_cast<size_t>((std::max(width, 1) + 3) / 4);
+		const size_t blocksY = static_cast<size_t>((std::max(height, 1) + 3) / 4);
+		return blocksX * blocksY * BlockBytes(format);
+	}
+
+	const char* FormatName(BlockFormat format) {
+		switch (format) {
+		case BlockFormat::BC1:
+			return "BC1";
+		case BlockFormat::BC3:
+			return "BC3";
+		case BlockFormat::BC4:
+			return "BC4";
+		case BlockFormat::BC5:
+			return "BC5";
+		case BlockFormat::BC7:
+			return "BC7";
+		}
+		return "?";
+	}
+
+	CompressedImage Encode(const std::uint8_t* pixels, int width, int height, int channels, BlockFormat format, int threadCount) {
+		CompressedImage image;
+		image.format = format;
+		image.width = width;
+		image.height = height;
+		if (!pixels || width <= 0 || height <= 0 || channels < 1 || channels > 4) {
+			return image;
+		}
+		image.blocks.resize(CompressedSize(format, width, height));
+		const int blocksX = (width + 3) / 4;
+		const int blocksY = (height + 3) / 4;
+		const size_t blockBytes = BlockBytes(format);
+
+		ForEachBlockRow(blocksY, threadCount, [&](int blockY) {
+			BlockTexels block{};
+			std::array<int, kBlockTexels> values{};
+			for (int blockX = 0; blockX < blocksX; ++blockX) {
+				std::uint8_t* out = image.blocks.data() + (static_cast<size_t>(blockY) * static_cast<size_t>(blocksX) + static_cast<size_t>(blockX)) * blockBytes;
+				switch (format) {
+				case BlockFormat::BC1:
+					FetchBlock(pixels, width, height, channels, blockX, blockY, block);
+					EncodeColorBlock(block, out);
+					break;
+				case BlockFormat::BC3:
+					FetchBlock(pixels, width, height, channels, blockX, blockY, block);
+					for (int i = 0; i < kBlockTexels; ++i) {
+						values[static_cast<size_t>(i)] = static_cast<int>(block[static_cast<size_t>(i)][3]);
+					}
+					EncodeAlphaBlock(values, out);
+					EncodeColorBlock(block, out + 8);
+					break;
+				case BlockFormat::BC4:
+					FetchChannel(pixels, width, height, channels, 0, blockX, blockY, values);
+					EncodeAlphaBlock(values, out);
+					break;
+				case BlockFormat::BC5:
+					FetchChannel(pixels, width, height, channels, 0, blockX, blockY, values);
+					EncodeAlphaBlock(values, out);
+					FetchChannel(pixels, width, height, channels, 1, blockX, blockY, values);
+					EncodeAlphaBlock(values, out + 8);
+					break;
+				case BlockFormat::BC7:
+					FetchBlock(pixels, width, height, channels, blockX, blockY, block);
+					EncodeBc7Block(block, out);
+					break;
+				}
+			}
+			});
+		return image;
+	}
+
+	std::vector<std::uint8_t> Decode(const CompressedImage& image) {
+		std::vector<std::uint8_t> rgba(static_cast<size_t>(image.width) * static_cast<size_t>(image.height) * 4u);
+		if (image.blocks.size() != CompressedSize(image.format, image.width, image.height) || rgba.empty()) {
+			return rgba;
+		}
+		const int blocksX = (image.width + 3) / 4;
+		const int blocksY = (image.height + 3) / 4;
+		const size_t blockBytes = BlockBytes(image.format);
+		std::array<std::array<std::uint8_t, 4>, kBlockTexels> texels{};
+		std::array<std::uint8_t, kBlockTexels> first{};
+		std::array<std::uint8_t, kBlockTexels> second{};
+		for (int blockY = 0; blockY < blocksY; ++blockY) {
+			for (int blockX = 0; blockX < blocksX; ++blockX) {
+				const std::uint8_t* in = image.blocks.data() + (static_cast<size_t>(blockY) * static_cast<size_t>(blocksX) + static_cast<size_t>(blockX)) * blockBytes;
+				switch (image.format) {
+				case BlockFormat::BC1:
+					DecodeColorBlock(in, true, texels);
+					break;
+				case BlockFormat::BC3:
+					DecodeColorBlock(in + 8, false, texels);
+					DecodeAlphaBlock(in, first);
+					for (int i = 0; i < kBlockTexels; ++i) {
+						texels[static_cast<size_t>(i)][3] = first[static_cast<size_t>(i)];
+					}
+					break;
+				case BlockFormat::BC4:
+				case BlockFormat::BC5:
+					DecodeAlphaBlock(in, first);
+					second.fill(0);
+					if (image.format == BlockFormat::BC5) {
+						DecodeAlphaBlock(in + 8, second);
+					}
+					for (int i = 0; i < kBlockTexels; ++i) {
+						texels[static_cast<size_t>(i)] = {first[static_cast<size_t>(i)], second[static_cast<size_t>(i)], 0, 255};
+					}
+					break;
+				case BlockFormat::BC7:
+					DecodeBc7Block(in, texels);
+					break;
+				}
+				for (int y = 0; y < 4; ++y) {
+					const int py = blockY * 4 + y;
+					for (int x = 0; x < 4; ++x) {
+						const int px = blockX * 4 + x;
+						if (px < image.width && py < image.height) {
+							std::memcpy(rgba.data() + (static_cast<size_t>(py) * static_cast<size_t>(image.width) + static_cast<size_t>(px)) * 4u,
+								texels[static_cast<size_t>(y * 4 + x)].data(), 4);
+						}
+					}
+				}
+			}
+		}
+		return rgba;
+	}
+
+	double ComputePsnr(const std::uint8_t* pixels, int channels, const CompressedImage& image) {
+		const std::vector<std::uint8_t> decoded = Decode(image);
+		const size_t texels = static_cast<size_t>(image.width) * static_cast<size_t>(image.height);
+		if (!pixels || texels == 0 || decoded.size() != texels * 4u) {
+			return 0.0;
+		}
+
+		double squaredError = 0.0;
+		size_t samples = 0;
+		for (size_t i = 0; i < texels; ++i) {
+			const std::uint8_t* source = pixels + i * static_cast<size_t>(channels);
+			const std::uint8_t* result = decoded.data() + i * 4u;
+			std::array<int, 4> expected{};
+			int compared = 0;
+			switch (image.format) {
+			case BlockFormat::BC4:
+			case BlockFormat::BC5:
+				compared = image.format == BlockFormat::BC4 ? 1 : 2;
+				expected = {source[0], channels > 1 ? source[1] : 0, 0, 0};
+				break;
+			default:
+				compared = image.format == BlockFormat::BC1 ? 3 : 4;
+				if (channels <= 2) {
+					expected = {source[0], source[0], source[0], channels == 2 ? source[1] : 255};
+				} else {
+					expected = {source[0], source[1], source[2], channels == 4 ? source[3] : 255};
+				}
+				break;
+			}
+			for (int c = 0; c < compared; ++c) {
+				const double delta = static_cast<double>(expected[static_cast<size_t>(c)]) - static_cast<double>(result[c]);
+				squaredError += delta * delta;
+			}
+			samples += static_cast<size_t>(compared);
+		}
+		if (squaredError <= 0.0) {
+			return std::numeric_limits<double>::infinity();
+		}
+		const double mse = squaredError / static_cast<double>(samples);
+		return 10.0 * std::log10(255.0 * 255.0 / mse);
+	}
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// CPU block compression of 8-bit textures into the S3TC (BC1/BC3), RGTC (BC4/BC5) and BPTC (BC7)
+// formats, so large textures can be uploaded with glCompressedTexImage2D. Encoding is spread over
+// worker threads by block row; the per-block search loops are written over fixed-size arrays so the
+// compiler can vectorize them.
+namespace gpurenderer::compression {
+	enum class BlockFormat : std::uint32_t {
+		BC1 = 1,
+		BC3 = 3,
+		BC4 = 4,
+		BC5 = 5,
+		BC7 = 7
+	};
+
+	struct CompressedImage {
+		BlockFormat format = BlockFormat::BC1;
+		int width = 0;
+		int height = 0;
+		// Blocks in row-major order, 4x4 texels each; partial edge blocks repeat the last row/column.
+		std::vector<std::uint8_t> blocks;
+	};
+
+	// 8 for BC1/BC4, 16 for the others.
+	size_t BlockBytes(BlockFormat format);
+	size_t CompressedSize(BlockFormat format, int width, int height);
+	const char* FormatName(BlockFormat format);
+
+	// pixels holds 1-4 channel texels expanded the way GL_LUMINANCE/GL_LUMINANCE_ALPHA/GL_RGB/GL_RGBA
+	// uploads are: BC1/BC3/BC7 encode that RGBA expansion, BC4 encodes the first channel and BC5 the
+	// first two. threadCount <= 0 uses every hardware thread.
+	CompressedImage Encode(const std::uint8_t* pixels, int width, int height, int channels, BlockFormat format, int threadCount = 0);
+
+	// RGBA8 decode of images produced by Encode (BC7 supports only the mode-6 blocks Encode writes).
+	// BC4 decodes to (r, 0, 0, 255) and BC5 to (r, g, 0, 255).
+	std::vector<std::uint8_t> Decode(const CompressedImage& image);
+
+	// Peak signal-to-noise ratio in dB of image against the source it was encoded from, over the
+	// channels the format stores. Returns infinity for a lossless result.
+	double ComputePsnr(const std::uint8_t* pixels, int channels, const CompressedImage& image);
+}
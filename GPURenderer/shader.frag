@@ -1,5 +1,35 @@
 #version 120
 
+// Permutation switches, injected by the renderer after #version so each pass compiles only the
+// features it uses. The defaults build the full Blinn-Phong variant.
+// SHADE_MODE: 0 Blinn-Phong, 1 normals, 2 reflective plane.
+#ifndef SHADE_MODE
+#define SHADE_MODE 0
+#endif
+#ifndef HAS_DIFFUSE_MAP
+#define HAS_DIFFUSE_MAP 1
+#endif
+#ifndef HAS_SPECULAR_MAP
+#define HAS_SPECULAR_MAP 1
+#endif
+#ifndef HAS_ENV_MAP
+#define HAS_ENV_MAP 1
+#endif
+#ifndef RECEIVE_SHADOWS
+#define RECEIVE_SHADOWS 1
+#endif
+#ifndef USE_SPOT_LIGHT
+#define USE_SPOT_LIGHT 1
+#endif
+// MATERIAL_TABLE: material colors and texture layers come from the vertex shader's table lookup
+// instead of the material uniforms; the maps are sampled from texture arrays.
+#ifndef MATERIAL_TABLE
+#define MATERIAL_TABLE 0
+#endif
+#if MATERIAL_TABLE
+#extension GL_EXT_texture_array : require
+#endif
+
 varying vec3 vNormal;
 varying vec3 vPositionView;
 varying vec2 vTexCoord;
@@ -7,6 +37,9 @@ varying vec3 vWorldNormal;
 varying vec3 vWorldPosition;
 varying vec4 vReflectionClip;
 varying vec4 vLightClipPos;
+varying vec4 vMaterialAmbient;
+varying vec4 vMaterialDiffuse;
+varying vec4 vMaterialSpecular;
 
 uniform vec3 uLightPosView;
 uniform vec3 uLightDirView;
@@ -14,42 +47,44 @@ uniform vec3 uLightColor;
 uniform vec3 uAmbientColor;
 uniform vec3 uDiffuseColor;
 uniform vec3 uSpecularColor;
-uniform vec3 uMarkerColor;
 uniform float uShininess;
-uniform int uShadeMode;
 uniform sampler2D uDiffuseMap;
 uniform sampler2D uSpecularMap;
-uniform int uUseDiffuseMap;
-uniform int uUseSpecularMap;
+#if MATERIAL_TABLE
+uniform sampler2DArray uDiffuseArray;
+uniform sampler2DArray uSpecularArray;
+#endif
 uniform vec3 uPlaneColorBias;
 uniform samplerCube uEnvMap;
-uniform int uUseEnvMap;
 uniform mat3 uInvViewRotation;
 uniform float uEnvReflectionStrength;
+// Last level of uEnvMap's roughness chain (0 when its mips are box-filtered) and its irradiance cube.
+uniform float uEnvMaxLod;
+uniform samplerCube uIrradianceMap;
+uniform float uEnvDiffuseStrength;
 uniform float uPlaneReflectionStrength;
 uniform float uPlaneEnvStrength;
 uniform float uPlaneReflectionBrightness;
 uniform sampler2D uShadowMap;
-uniform int uReceiveShadows;
 uniform float uShadowBias;
-uniform int uUseSpotLight;
 uniform float uSpotCosInner;
 uniform float uSpotCosOuter;
 
 float ComputeSpotFactor() {
-	if (uUseSpotLight == 0) {
-		return 1.0;
-	}
+#if !USE_SPOT_LIGHT
+	return 1.0;
+#else
 	vec3 lightToFrag = normalize(vPositionView - uLightPosView);
 	float theta = dot(lightToFrag, normalize(uLightDirView));
 	float denom = max(uSpotCosInner - uSpotCosOuter, 0.0001);
 	return clamp((theta - uSpotCosOuter) / denom, 0.0, 1.0);
+#endif
 }
 
 float ComputeShadowFactor(vec3 n, vec3 lightDir) {
-	if (uReceiveShadows == 0) {
-		return 1.0;
-	}
+#if !RECEIVE_SHADOWS
+	return 1.0;
+#else
 	if (abs(vLightClipPos.w) <= 0.0001) {
 		return 1.0;
 	}
@@ -65,24 +100,13 @@ float ComputeShadowFactor(vec3 n, vec3 lightDir) {
 	float bias = max(uShadowBias * (2.0 - baseBias), 0.000005);
 	float closestDepth = texture2D(uShadowMap, projCoords.xy).r;
 	return (projCoords.z - bias <= closestDepth) ? 1.0 : 0.0;
+#endif
 }
 
 void main() {
-	if (uShadeMode == 1) {
-		gl_FragColor = vec4(clamp(vNormal, 0.0, 1.0), 1.0);
-		return;
-	}
-	if (uShadeMode == 2) {
-		gl_FragColor = vec4(uMarkerColor, 1.0);
-		return;
-	}
-	if (uShadeMode == 4) {
-		vec3 dir = normalize(vWorldPosition);
-		vec3 color = (uUseEnvMap == 1) ? textureCube(uEnvMap, dir).rgb : vec3(0.0);
-		gl_FragColor = vec4(color, 1.0);
-		return;
-	}
-
+#if SHADE_MODE == 1
+	gl_FragColor = vec4(clamp(vNormal, 0.0, 1.0), 1.0);
+#else
 	vec3 n = normalize(vNormal);
 	vec3 viewDir = normalize(-vPositionView);
 	vec3 lightDir = normalize(uLightPosView - vPositionView);
@@ -91,64 +115,89 @@ void main() {
 	float visibility = spotFactor * shadowFactor;
 	float diff = max(dot(n, lightDir), 0.0);
 	float spec = 0.0;
+#if SHADE_MODE == 0 && MATERIAL_TABLE
+	float shininess = vMaterialAmbient.w;
+#else
+	float shininess = uShininess;
+#endif
 	if (diff > 0.0) {
 		vec3 halfDir = normalize(lightDir + viewDir);
-		spec = pow(max(dot(n, halfDir), 0.0), uShininess);
+		spec = pow(max(dot(n, halfDir), 0.0), shininess);
 	}
 
-	if (uShadeMode == 3) {
-		vec3 planeColor = uDiffuseColor;
-		if (uUseDiffuseMap == 1 && abs(vReflectionClip.w) > 0.0001) {
-			vec2 projectedUv = (vReflectionClip.xy / vReflectionClip.w) * 0.5 + vec2(0.5);
-			float inside =
-				step(0.0, projectedUv.x) *
-				step(0.0, projectedUv.y) *
-				step(projectedUv.x, 1.0) *
-				step(projectedUv.y, 1.0);
-			vec3 projectedReflection = texture2D(uDiffuseMap, projectedUv).rgb * uPlaneReflectionBrightness;
-			float reflectionMix = clamp(inside * uPlaneReflectionStrength, 0.0, 1.0);
-			planeColor = mix(planeColor, projectedReflection, reflectionMix);
-		}
-		if (uUseEnvMap == 1) {
-			vec3 incidentView = normalize(vPositionView);
-			vec3 reflectedView = reflect(incidentView, n);
-			vec3 reflectedWorld = normalize(uInvViewRotation * reflectedView);
-			vec3 envColor = textureCube(uEnvMap, reflectedWorld).rgb;
-			planeColor += envColor * uPlaneEnvStrength;
-		}
-
-		vec3 ambient = planeColor * uAmbientColor * uLightColor;
-		vec3 diffuse = planeColor * diff * uLightColor * visibility;
-		vec3 specular = uSpecularColor * spec * uLightColor * visibility;
-		gl_FragColor = vec4(clamp(ambient + diffuse + specular + uPlaneColorBias, 0.0, 1.0), 1.0);
-		return;
+#if SHADE_MODE == 2
+	vec3 planeColor = uDiffuseColor;
+#if HAS_DIFFUSE_MAP
+	if (abs(vReflectionClip.w) > 0.0001) {
+		vec2 projectedUv = (vReflectionClip.xy / vReflectionClip.w) * 0.5 + vec2(0.5);
+		float inside =
+			step(0.0, projectedUv.x) *
+			step(0.0, projectedUv.y) *
+			step(projectedUv.x, 1.0) *
+			step(projectedUv.y, 1.0);
+		vec3 projectedReflection = texture2D(uDiffuseMap, projectedUv).rgb * uPlaneReflectionBrightness;
+		float reflectionMix = clamp(inside * uPlaneReflectionStrength, 0.0, 1.0);
+		planeColor = mix(planeColor, projectedReflection, reflectionMix);
 	}
+#endif
+#if HAS_ENV_MAP
+	vec3 incidentView = normalize(vPositionView);
+	vec3 reflectedView = reflect(incidentView, n);
+	vec3 reflectedWorld = normalize(uInvViewRotation * reflectedView);
+	vec3 envColor = textureCube(uEnvMap, reflectedWorld).rgb;
+	planeColor += envColor * uPlaneEnvStrength;
+#endif
 
-	vec3 diffuseTex = (uUseDiffuseMap == 1)
-		? texture2D(uDiffuseMap, vTexCoord).rgb
-		: vec3(1.0);
-	vec3 specularTex = (uUseSpecularMap == 1)
-		? texture2D(uSpecularMap, vTexCoord).rgb
-		: vec3(1.0);
-
-	vec3 diffuseColor = (uUseDiffuseMap == 1) ? diffuseTex : uDiffuseColor;
-	vec3 specularColor = uSpecularColor * specularTex;
+	vec3 ambient = planeColor * uAmbientColor * uLightColor;
+	vec3 diffuse = planeColor * diff * uLightColor * visibility;
+	vec3 specular = uSpecularColor * spec * uLightColor * visibility;
+	gl_FragColor = vec4(clamp(ambient + diffuse + specular + uPlaneColorBias, 0.0, 1.0), 1.0);
+#else
+#if MATERIAL_TABLE
+	// A negative layer means the material has no such map. The arrays are sampled regardless and the
+	// result mixed away, keeping the fetch outside of non-uniform control flow.
+	float hasDiffuseMap = step(0.0, vMaterialDiffuse.w);
+	float hasSpecularMap = step(0.0, vMaterialSpecular.w);
+	vec3 diffuseTex = texture2DArray(uDiffuseArray, vec3(vTexCoord, max(vMaterialDiffuse.w, 0.0))).rgb;
+	vec3 specularTex = texture2DArray(uSpecularArray, vec3(vTexCoord, max(vMaterialSpecular.w, 0.0))).rgb;
+	vec3 diffuseColor = mix(vMaterialDiffuse.rgb, diffuseTex, hasDiffuseMap);
+	vec3 ambientColor = mix(vMaterialAmbient.rgb, diffuseTex * vMaterialAmbient.rgb, hasDiffuseMap);
+	vec3 specularColor = vMaterialSpecular.rgb * mix(vec3(1.0), specularTex, hasSpecularMap);
+#else
+#if HAS_DIFFUSE_MAP
+	vec3 diffuseTex = texture2D(uDiffuseMap, vTexCoord).rgb;
+	vec3 diffuseColor = diffuseTex;
+	vec3 ambientColor = diffuseTex * uAmbientColor;
+#else
+	vec3 diffuseColor = uDiffuseColor;
+	vec3 ambientColor = uAmbientColor;
+#endif
+#if HAS_SPECULAR_MAP
+	vec3 specularColor = uSpecularColor * texture2D(uSpecularMap, vTexCoord).rgb;
+#else
+	vec3 specularColor = uSpecularColor;
+#endif
+#endif
 
-	vec3 ambientColor = (uUseDiffuseMap == 1) ? (diffuseTex * uAmbientColor) : uAmbientColor;
 	vec3 ambient = ambientColor * uLightColor;
 	vec3 diffuse = diffuseColor * diff * uLightColor * visibility;
 	vec3 specular = specularColor * spec * uLightColor * visibility;
 	vec3 color = ambient + diffuse + specular;
 
-	if (uUseEnvMap == 1) {
-		vec3 incidentView = normalize(vPositionView);
-		vec3 reflectedView = reflect(incidentView, n);
-		vec3 reflectedWorld = normalize(uInvViewRotation * reflectedView);
-		vec3 envColor = textureCube(uEnvMap, reflectedWorld).rgb;
-		float fresnel = pow(1.0 - max(dot(n, viewDir), 0.0), 5.0);
-		float reflectionWeight = uEnvReflectionStrength * (0.6 + 0.4 * fresnel);
-		color += envColor * reflectionWeight;
-	}
+#if HAS_ENV_MAP
+	vec3 incidentView = normalize(vPositionView);
+	vec3 reflectedView = reflect(incidentView, n);
+	vec3 reflectedWorld = normalize(uInvViewRotation * reflectedView);
+	// Blinn-Phong exponent to GGX roughness, which selects the prefiltered level through the bias.
+	float roughness = pow(2.0 / (shininess + 2.0), 0.25);
+	vec3 envColor = textureCube(uEnvMap, reflectedWorld, roughness * uEnvMaxLod).rgb;
+	float fresnel = pow(1.0 - max(dot(n, viewDir), 0.0), 5.0);
+	float reflectionWeight = uEnvReflectionStrength * (0.6 + 0.4 * fresnel);
+	color += envColor * reflectionWeight;
+	color += diffuseColor * textureCube(uIrradianceMap, normalize(vWorldNormal)).rgb * uEnvDiffuseStrength;
+#endif
 
 	gl_FragColor = vec4(color, 1.0);
+#endif
+#endif
 }
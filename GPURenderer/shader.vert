@@ -1,8 +1,32 @@
 #version 120
 
+// Permutation switches, injected by the renderer after #version. The defaults build the full
+// Blinn-Phong variant; see shader.frag for the meaning of each switch.
+#ifndef SHADE_MODE
+#define SHADE_MODE 0
+#endif
+#ifndef HAS_DIFFUSE_MAP
+#define HAS_DIFFUSE_MAP 1
+#endif
+#ifndef HAS_SPECULAR_MAP
+#define HAS_SPECULAR_MAP 1
+#endif
+#ifndef RECEIVE_SHADOWS
+#define RECEIVE_SHADOWS 1
+#endif
+#ifndef MATERIAL_TABLE
+#define MATERIAL_TABLE 0
+#endif
+#ifndef MATERIAL_TABLE_SIZE
+#define MATERIAL_TABLE_SIZE 32
+#endif
+
 attribute vec3 aPosition;
 attribute vec3 aNormal;
 attribute vec2 aTexCoord;
+attribute mat4 aInstanceModel;
+attribute mat3 aInstanceNormal;
+attribute float aMaterialSlot;
 
 uniform mat4 uMvp;
 uniform mat4 uModel;
@@ -11,6 +35,8 @@ uniform mat3 uNormalMatrix;
 uniform mat3 uWorldNormalMatrix;
 uniform mat4 uReflectionViewProj;
 uniform mat4 uLightViewProj;
+// Three rows per material: (ambient, shininess), (diffuse, diffuse layer), (specular, specular layer).
+uniform vec4 uMaterialTable[MATERIAL_TABLE_SIZE * 3];
 
 varying vec3 vNormal;
 varying vec3 vPositionView;
@@ -19,16 +45,34 @@ varying vec3 vWorldNormal;
 varying vec3 vWorldPosition;
 varying vec4 vReflectionClip;
 varying vec4 vLightClipPos;
+varying vec4 vMaterialAmbient;
+varying vec4 vMaterialDiffuse;
+varying vec4 vMaterialSpecular;
 
 void main() {
-	vec4 worldPos = uModel * vec4(aPosition, 1.0);
-	vec4 viewPos = uView * worldPos;
-	vPositionView = viewPos.xyz;
-	vNormal = normalize(uNormalMatrix * aNormal);
-	vWorldNormal = normalize(uWorldNormalMatrix * aNormal);
+	vec4 localPos = aInstanceModel * vec4(aPosition, 1.0);
+	gl_Position = uMvp * localPos;
+	vec3 localNormal = aInstanceNormal * aNormal;
+	vNormal = normalize(uNormalMatrix * localNormal);
+#if SHADE_MODE == 0 || SHADE_MODE == 2
+	vec4 worldPos = uModel * localPos;
+	vPositionView = (uView * worldPos).xyz;
+	vWorldNormal = normalize(uWorldNormalMatrix * localNormal);
 	vWorldPosition = worldPos.xyz;
+#if SHADE_MODE == 2
 	vReflectionClip = uReflectionViewProj * worldPos;
+#endif
+#if RECEIVE_SHADOWS
 	vLightClipPos = uLightViewProj * worldPos;
+#endif
+#if SHADE_MODE == 0 && (HAS_DIFFUSE_MAP || HAS_SPECULAR_MAP || MATERIAL_TABLE)
 	vTexCoord = aTexCoord;
-	gl_Position = uMvp * vec4(aPosition, 1.0);
+#endif
+#if SHADE_MODE == 0 && MATERIAL_TABLE
+	int row = int(aMaterialSlot + 0.5) * 3;
+	vMaterialAmbient = uMaterialTable[row];
+	vMaterialDiffuse = uMaterialTable[row + 1];
+	vMaterialSpecular = uMaterialTable[row + 2];
+#endif
+#endif
 }